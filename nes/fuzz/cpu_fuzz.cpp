@@ -0,0 +1,306 @@
+/************************************************************************************
+
+Filename    :   cpu_fuzz.cpp
+Content     :   Differential fuzzer for the CPU execution backends
+Authors     :   Yash Patel
+
+Every fast execution path has to behave exactly like the reference interpreter
+(CPU::step() with FastBus): the dispatch tables, stepOpcode() (which the caller
+hands an opcode it already has), and the instruction semantics recompiled modules
+are built from (aotops.h), run here one instruction at a time. This harness turns
+the fuzzer input into a register file and a 64K memory image, runs the same program
+on the reference and on every other backend, and compares the full state (registers,
+cycle counter and memory) after each block of instructions. The first divergence aborts with both dumps, which
+libFuzzer reports as a crash and saves as a reproducer.
+
+The bus accuracy policies only differ in their bus traffic, so every access is also
+logged (all pages are trapped) and compared per block: ExactBus and CycleBus must
+make the same accesses in the same order, and backends on the same policy must also
+agree on the cycle each access happens on. FastBus backends, which drop the dummy
+accesses, are compared among themselves. Backends that don't fetch their opcodes and
+operands through the bus (stepOpcode, compiled code) are held to the same writes.
+
+Not part of nes.vcxproj (it has its own entrypoint). Build with clang:
+
+    clang++ -std=c++17 -g -O1 -fsanitize=fuzzer,address -I../nes \
+        ../nes/cpu.cpp ../nes/bus.cpp ../nes/statehash.cpp cpu_fuzz.cpp -o cpu_fuzz
+    ./cpu_fuzz -max_len=4096 corpus/
+
+New backends are added to kBackends below.
+
+*************************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <exception>
+#include <iterator>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "aotops.h"
+#include "cpu.h"
+
+namespace {
+
+const int kMemorySize = 65536;
+const int kBlockSize  = 16;  // instructions run between state comparisons
+const int kMaxBlocks  = 64;  // bounds the run, since random code loops easily
+
+struct Machine;
+
+struct Backend {
+    const char* name;
+    void (*step)(Machine& machine);
+    BusAccuracy accuracy;
+    bool fetches; // reads its opcodes and operands through the bus
+};
+
+void stepReference(Machine& machine);
+void stepTable(Machine& machine);
+void stepOpcode(Machine& machine);
+void stepCompiled(Machine& machine);
+
+// kBackends[0] is the reference everything else is diffed against
+const Backend kBackends[] = {
+    { "reference",    &stepReference, BusAccuracy::Fast,  true  },
+    { "table",        &stepTable,     BusAccuracy::Fast,  true  },
+    { "opcode",       &stepOpcode,    BusAccuracy::Fast,  false },
+    { "compiled",     &stepCompiled,  BusAccuracy::Fast,  false },
+    { "exact",        &stepReference, BusAccuracy::Exact, true  },
+    { "exact table",  &stepTable,     BusAccuracy::Exact, true  },
+    { "exact opcode", &stepOpcode,    BusAccuracy::Exact, false },
+    { "cycle",        &stepReference, BusAccuracy::Cycle, true  },
+    { "cycle table",  &stepTable,     BusAccuracy::Cycle, true  },
+    { "cycle opcode", &stepOpcode,    BusAccuracy::Cycle, false },
+};
+const int kBackendCount = sizeof(kBackends) / sizeof(kBackends[0]);
+
+struct Access {
+    uint16_t addr;
+    uint8_t value;
+    bool write;
+    uint64_t cycle; // CPU cycle counter when the access completed
+
+    bool sameAs(const Access& other, bool timed) const {
+        return addr == other.addr && value == other.value && write == other.write &&
+            (!timed || cycle == other.cycle);
+    }
+};
+
+struct Machine : public BusObserver {
+    uint8_t memory[kMemorySize];
+    Bus bus;
+    std::unique_ptr<CPU> cpu;
+    std::vector<Access> traffic; // this block's accesses
+    bool faulted = false; // a handler threw; the machine is stopped from then on
+    AotState compiled;    // registers while stepCompiled() runs an instruction
+
+    void onAccess(uint16_t addr, uint8_t value, bool write) override {
+        traffic.push_back({ addr, value, write, cpu->getCycles() });
+    }
+};
+
+// xorshift so one input byte stream deterministically expands to a full image
+uint32_t nextRandom(uint32_t& seed) {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+// input layout: [pc lo, pc hi, a, x, y, sr, sp, seed0..3, program bytes...]
+// the program is written at pc, everything else in memory is seeded noise
+void buildImage(const uint8_t* data, size_t size, uint8_t* memory, CPUState& state) {
+    state.pc = uint16_t(data[0] | (data[1] << 8));
+    state.ac = data[2];
+    state.x  = data[3];
+    state.y  = data[4];
+    state.sr = data[5];
+    state.sp = data[6];
+    state.cycles = 0;
+
+    uint32_t seed = uint32_t(data[7]) | (uint32_t(data[8]) << 8) |
+        (uint32_t(data[9]) << 16) | (uint32_t(data[10]) << 24);
+    if (seed == 0) { seed = 0x6502; }
+    for (int i = 0; i < kMemorySize; i++) {
+        memory[i] = uint8_t(nextRandom(seed));
+    }
+
+    const uint8_t* program = data + 11;
+    size_t programSize = std::min<size_t>(size - 11, kMemorySize);
+    for (size_t i = 0; i < programSize; i++) {
+        memory[uint16_t(state.pc + i)] = program[i];
+    }
+}
+
+void stepReference(Machine& machine) {
+    machine.cpu->step();
+}
+
+void stepTable(Machine& machine) {
+    machine.cpu->stepTable();
+}
+
+void stepOpcode(Machine& machine) {
+    machine.cpu->stepOpcode(machine.memory[machine.cpu->getPC()]);
+}
+
+// the bus side of AotRuntime, as AotCode provides it: the CPU's cycle counter is
+// brought up to date around each access
+uint8_t compiledRead(void* context, uint16_t addr) {
+    Machine& machine = *static_cast<Machine*>(context);
+    machine.cpu->setCycles(machine.compiled.cycles);
+    return machine.bus.read(addr);
+}
+
+void compiledWrite(void* context, uint16_t addr, uint8_t value) {
+    Machine& machine = *static_cast<Machine*>(context);
+    machine.cpu->setCycles(machine.compiled.cycles);
+    machine.bus.write(addr, value);
+    machine.compiled.cycles = machine.cpu->getCycles();
+}
+
+void compiledBackwardJump(void*) {
+}
+
+// one instruction as a recompiled module runs it, with the bytes at PC as its
+// constants; what aotops.h doesn't implement the interpreter runs, as the console does
+void stepCompiled(Machine& machine) {
+    static const uint8_t* const kNoPages[Bus::kPageCount] = {}; // every access through the bus, so it's logged
+    static const uint8_t kUntrusted[Bus::kPageCount] = {};
+
+    CPUState registers = machine.cpu->state();
+    AotState& state = machine.compiled;
+    state.cycles = registers.cycles;
+    state.limit = ~uint64_t(0);
+    state.instructions = 0;
+    state.pc = registers.pc;
+    state.a = registers.ac;
+    state.x = registers.x;
+    state.y = registers.y;
+    state.sr = registers.sr;
+    state.sp = registers.sp;
+    AotRuntime runtime = { &machine, &state, kNoPages, kUntrusted, &compiledRead, &compiledWrite, &compiledBackwardJump };
+
+    uint8_t opcode = machine.memory[registers.pc];
+    uint16_t operand = uint16_t(machine.memory[uint16_t(registers.pc + 1)] | (machine.memory[uint16_t(registers.pc + 2)] << 8));
+    if (!aotInstruction(&runtime, registers.pc, opcode, operand)) {
+        machine.cpu->step();
+        return;
+    }
+    registers = { state.pc, state.a, state.x, state.y, state.sr, state.sp, state.cycles };
+    machine.cpu->setState(registers);
+}
+
+bool dummyAccesses(BusAccuracy accuracy) {
+    return accuracy != BusAccuracy::Fast;
+}
+
+// the first backend whose traffic `b`'s has to match, or -1
+int trafficReference(int b) {
+    for (int other = 0; other < b; other++) {
+        if (dummyAccesses(kBackends[other].accuracy) == dummyAccesses(kBackends[b].accuracy)) {
+            return other;
+        }
+    }
+    return -1;
+}
+
+[[noreturn]] void report(const char* what, int block, const Machine& reference,
+    const char* referenceName, const Machine& other, const char* name) {
+    std::cerr << "divergence (" << what << ") in block " << block
+        << ": " << referenceName << " vs " << name << std::endl;
+    reference.cpu->dump();
+    other.cpu->dump();
+    for (int addr = 0; addr < kMemorySize; addr++) {
+        if (reference.memory[addr] != other.memory[addr]) {
+            std::cerr << "first memory mismatch at $" << std::hex << addr
+                << ": " << int(reference.memory[addr]) << " vs "
+                << int(other.memory[addr]) << std::dec << std::endl;
+            break;
+        }
+    }
+    abort();
+}
+
+// the accesses compared against a backend that doesn't fetch through the bus
+std::vector<Access> writesOf(const std::vector<Access>& traffic) {
+    std::vector<Access> writes;
+    std::copy_if(traffic.begin(), traffic.end(), std::back_inserter(writes), [](const Access& a) { return a.write; });
+    return writes;
+}
+
+void runBlock(Machine& machine, void (*step)(Machine& machine)) {
+    machine.traffic.clear();
+    for (int i = 0; i < kBlockSize && !machine.faulted; i++) {
+        try {
+            step(machine);
+        }
+        catch (const std::exception&) {
+            machine.faulted = true;
+        }
+    }
+}
+
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    if (size < 12) {
+        return 0;
+    }
+
+    CPUState initial;
+    std::unique_ptr<Machine> machines[kBackendCount];
+    for (int b = 0; b < kBackendCount; b++) {
+        machines[b].reset(new Machine());
+        buildImage(data, size, machines[b]->memory, initial);
+        machines[b]->bus.mapMemory(0x0000, 0xFFFF, machines[b]->memory, kMemorySize, true);
+        machines[b]->cpu.reset(new CPU(&machines[b]->bus));
+        machines[b]->cpu->setAccuracy(kBackends[b].accuracy);
+        machines[b]->cpu->setState(initial);
+        for (int page = 0; page < Bus::kPageCount; page++) {
+            machines[b]->bus.setTraps(uint8_t(page), Bus::kTrapRead | Bus::kTrapWrite);
+        }
+        machines[b]->bus.setObserver(machines[b].get());
+    }
+
+    const Machine& reference = *machines[0];
+    for (int block = 0; block < kMaxBlocks && !reference.faulted; block++) {
+        for (int b = 0; b < kBackendCount; b++) {
+            runBlock(*machines[b], kBackends[b].step);
+        }
+        for (int b = 1; b < kBackendCount; b++) {
+            const Machine& other = *machines[b];
+            if (reference.faulted != other.faulted) {
+                report("fault", block, reference, kBackends[0].name, other, kBackends[b].name);
+            }
+            if (reference.cpu->state() != other.cpu->state()) {
+                report("registers", block, reference, kBackends[0].name, other, kBackends[b].name);
+            }
+            if (memcmp(reference.memory, other.memory, kMemorySize) != 0) {
+                report("memory", block, reference, kBackends[0].name, other, kBackends[b].name);
+            }
+            int t = trafficReference(b);
+            if (t >= 0) {
+                const Machine& expected = *machines[t];
+                bool timed = kBackends[t].accuracy == kBackends[b].accuracy;
+                bool writesOnly = !kBackends[b].fetches;
+                std::vector<Access> want = writesOnly ? writesOf(expected.traffic) : expected.traffic;
+                std::vector<Access> got = writesOnly ? writesOf(other.traffic) : other.traffic;
+                bool same = want.size() == got.size();
+                for (size_t i = 0; same && i < got.size(); i++) {
+                    same = want[i].sameAs(got[i], timed);
+                }
+                if (!same) {
+                    report("bus traffic", block, expected, kBackends[t].name, other, kBackends[b].name);
+                }
+            }
+        }
+    }
+    return 0;
+}
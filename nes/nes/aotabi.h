@@ -0,0 +1,99 @@
+/************************************************************************************
+
+Filename    :   aotabi.h
+Content     :   Interface between the emulator and recompiled program modules
+Authors     :   Yash Patel
+
+A recompiled module is C++ generated from a program image by the Recompiler
+(recompiler.h) and built into a shared library. It is included by that generated
+code as well as by the emulator, so it only uses plain C types.
+
+The generated code owns the control flow: it knows where every basic block starts
+and chains from one block to the next without fetching or decoding anything. Each
+instruction is compiled in, from aotops.h, with its operand and address as
+constants, working on a register file (AotState) the emulator copies in and out
+around run(). Readable memory is read directly through the page table; writes and
+everything else go through the emulator's bus. The semantics are FastBus's (no dummy
+accesses), so the console only runs modules at that accuracy, and the CPU fuzzer
+checks aotops.h against the interpreter.
+
+Before a block runs, its bytes are compared with what's currently mapped, so code
+that changed since it was compiled (self-modifying code, RAM that was loaded
+differently) falls back to the interpreter, as does any PC without a block (indirect
+jump targets the analysis couldn't see). Pages of read-only memory are checked once
+per mapping instead, against the module's page hashes. The one case this misses is
+a block rewriting one of its own later instructions while it runs.
+
+*************************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+
+#define NES_AOT_VERSION 2
+#define NES_AOT_ENTRY "nesAotModule"
+
+#ifdef _WIN32
+#define NES_AOT_EXPORT extern "C" __declspec(dllexport)
+#else
+#define NES_AOT_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
+
+// the CPU's registers while compiled code runs
+struct AotState {
+	uint64_t cycles;
+	uint64_t limit;        // run() returns once cycles reach it
+	uint64_t instructions; // run so far
+	uint16_t pc;
+	uint8_t a;
+	uint8_t x;
+	uint8_t y;
+	uint8_t sr;
+	uint8_t sp;
+};
+
+// the emulator side, valid for one run() call
+struct AotRuntime {
+	void* context;
+	AotState* state;
+	const uint8_t* const* pages; // readable memory per 256-byte page, nullptr for MMIO
+	const uint8_t* trusted;      // per page: read-only and known to match the module
+	// bus accesses, on the cycle in state (which a DMA write may advance)
+	uint8_t (*read)(void* context, uint16_t addr);
+	void (*write)(void* context, uint16_t addr, uint8_t value);
+	// after an instruction leaves PC at or below its own address, as the interpreter
+	// reports them for idle-loop detection (which may advance the cycle counter)
+	void (*backwardJump)(void* context);
+};
+
+struct AotModule {
+	uint32_t version;   // NES_AOT_VERSION
+	uint64_t imageHash; // CodeMap::hashImage() of the image it was compiled from
+	uint16_t base;
+	uint32_t size;
+	uint32_t blocks;
+	const uint16_t* starts;     // where each block starts, ascending
+	const uint64_t* pageHashes; // CodeMap::hashImage() of each 256-byte page compiled from
+	// runs blocks from the current PC until the budget is used up, or PC has no
+	// block, or a block's code changed
+	void (*run)(const AotRuntime* runtime);
+};
+
+typedef const AotModule* (*AotEntry)();
+
+// generated code: true if the `count` bytes of a block at addr are still the ones it
+// was compiled from (operands are compiled in as constants, so they count too)
+inline bool aotMatches(const AotRuntime* runtime, uint16_t addr, const uint8_t* bytes, int count) {
+	uint16_t last = uint16_t(addr + count - 1);
+	if (runtime->trusted[addr >> 8] && runtime->trusted[last >> 8]) {
+		return true;
+	}
+	for (int i = 0; i < count; i++) {
+		uint16_t at = uint16_t(addr + i);
+		const uint8_t* page = runtime->pages[at >> 8];
+		if (page == nullptr || page[at & 0xFF] != bytes[i]) {
+			return false;
+		}
+	}
+	return true;
+}
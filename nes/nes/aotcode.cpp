@@ -0,0 +1,169 @@
+/************************************************************************************
+
+Filename    :   aotcode.cpp
+Content     :   Loads and runs a recompiled program module
+Authors     :   Yash Patel
+
+*************************************************************************************/
+
+#include "aotcode.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <iostream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+#include "bus.h"
+#include "codemap.h"
+#include "cpu.h"
+#include "idleloop.h"
+
+AotCode::AotCode() :
+    library(nullptr),
+    module(nullptr),
+    mappedBus(nullptr),
+    mappedVersion(0),
+    cpu(nullptr),
+    bus(nullptr),
+    idle(nullptr),
+    until(0.0),
+    instructions(0) {
+    memset(entries, 0, sizeof(entries));
+    memset(trusted, 0, sizeof(trusted));
+    memset(verified, 0, sizeof(verified));
+}
+
+AotCode::~AotCode() {
+    unload();
+}
+
+bool AotCode::load(const std::string& path, const uint8_t* image, uint16_t base, size_t size) {
+    unload();
+
+#ifdef _WIN32
+    HMODULE handle = LoadLibraryA(path.c_str());
+    AotEntry entry = handle != nullptr ? AotEntry(GetProcAddress(handle, NES_AOT_ENTRY)) : nullptr;
+    library = handle;
+#else
+    void* handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    AotEntry entry = handle != nullptr ? AotEntry(dlsym(handle, NES_AOT_ENTRY)) : nullptr;
+    library = handle;
+#endif
+    if (entry == nullptr) {
+        std::cout << "couldn't load a recompiled module from " << path << std::endl;
+        unload();
+        return false;
+    }
+
+    const AotModule* candidate = entry();
+    if (candidate->version != NES_AOT_VERSION || candidate->base != base || candidate->size != size ||
+        candidate->imageHash != CodeMap::hashImage(image, size)) {
+        std::cout << path << " was compiled from a different image or emulator version" << std::endl;
+        unload();
+        return false;
+    }
+    module = candidate;
+    for (uint32_t i = 0; i < module->blocks; i++) {
+        entries[module->starts[i] >> 3] |= uint8_t(1 << (module->starts[i] & 7));
+    }
+    memset(verified, 0, sizeof(verified));
+    mappedBus = nullptr;
+    return true;
+}
+
+void AotCode::unload() {
+    module = nullptr;
+    memset(entries, 0, sizeof(entries));
+    if (library == nullptr) {
+        return;
+    }
+#ifdef _WIN32
+    FreeLibrary(HMODULE(library));
+#else
+    dlclose(library);
+#endif
+    library = nullptr;
+}
+
+void AotCode::run(CPU& target, Bus& targetBus, double cycles, IdleLoop* idleLoop) {
+    // mappings only change between runs, so the page table is taken at most once per
+    // call, and only when they did
+    if (mappedBus != &targetBus || mappedVersion != targetBus.getMappingVersion()) {
+        for (int page = 0; page < Bus::kPageCount; page++) {
+            pages[page] = targetBus.readPage(uint8_t(page));
+        }
+        trustPages(targetBus);
+        mappedBus = &targetBus;
+        mappedVersion = targetBus.getMappingVersion();
+    }
+    cpu = &target;
+    bus = &targetBus;
+    idle = idleLoop;
+    until = cycles;
+
+    CPUState registers = cpu->state();
+    state.cycles = registers.cycles;
+    state.limit = uint64_t(ceil(cycles)); // integral cycles reach it exactly when they reach `until`
+    state.instructions = 0;
+    state.pc = registers.pc;
+    state.a = registers.ac;
+    state.x = registers.x;
+    state.y = registers.y;
+    state.sr = registers.sr;
+    state.sp = registers.sp;
+    if (state.cycles < state.limit) {
+        AotRuntime runtime = { this, &state, pages, trusted, &AotCode::read, &AotCode::write, &AotCode::backwardJump };
+        module->run(&runtime);
+        syncCPU();
+        instructions += state.instructions;
+    }
+    cpu = nullptr;
+    bus = nullptr;
+}
+
+void AotCode::trustPages(const Bus& bus) {
+    // read-only memory can't change under a mapping, so a page is hashed once per
+    // mapping instead of its blocks being compared on every entry
+    for (int page = 0; page < Bus::kPageCount; page++) {
+        if (pages[page] == nullptr || bus.isWritable(uint8_t(page))) {
+            trusted[page] = 0;
+            verified[page] = nullptr;
+        } else if (pages[page] != verified[page]) {
+            trusted[page] = CodeMap::hashImage(pages[page], 256) == module->pageHashes[page];
+            verified[page] = pages[page];
+        }
+    }
+}
+
+void AotCode::syncCPU() {
+    CPUState registers = { state.pc, state.a, state.x, state.y, state.sr, state.sp, state.cycles };
+    cpu->setState(registers);
+}
+
+uint8_t AotCode::read(void* context, uint16_t addr) {
+    AotCode* self = static_cast<AotCode*>(context);
+    self->cpu->setCycles(self->state.cycles);
+    return self->bus->read(addr);
+}
+
+void AotCode::write(void* context, uint16_t addr, uint8_t value) {
+    AotCode* self = static_cast<AotCode*>(context);
+    self->cpu->setCycles(self->state.cycles);
+    self->bus->write(addr, value);
+    self->state.cycles = self->cpu->getCycles();
+}
+
+void AotCode::backwardJump(void* context) {
+    AotCode* self = static_cast<AotCode*>(context);
+    if (self->idle != nullptr) {
+        self->syncCPU();
+        self->idle->backwardJump(self->until);
+        self->state.cycles = self->cpu->getCycles();
+    }
+}
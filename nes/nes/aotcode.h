@@ -0,0 +1,73 @@
+/************************************************************************************
+
+Filename    :   aotcode.h
+Content     :   Loads and runs a recompiled program module (header)
+Authors     :   Yash Patel
+
+The emulator side of aotabi.h: loads the shared library the Recompiler's output was
+built into, checks it was compiled from the image that's loaded, and runs it against
+a CPU. The console hands its instruction loop to run() when a module is attached and
+steps the interpreter over whatever the module returns on.
+
+The CPU's registers are copied into the module's AotState for a run and back after
+it. Bus accesses the module can't do itself go through the Bus, with the CPU's cycle
+counter brought up to date first (devices time themselves by it) and taken back
+after (an OAM DMA write stalls it); backward jumps sync everything for the idle loop.
+
+*************************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "aotabi.h"
+
+class Bus;
+class CPU;
+class IdleLoop;
+
+class AotCode {
+public:
+	AotCode();
+	~AotCode(); // unloads
+
+	// false (with a message) if it can't be loaded or doesn't match the image
+	bool load(const std::string& path, const uint8_t* image, uint16_t base, size_t size);
+	void unload();
+	bool isLoaded() const { return module != nullptr; }
+
+	// runs compiled blocks from the CPU's PC until `until` cycles, or the CPU reaches
+	// code the module doesn't have; backward jumps are reported to `idle` if given,
+	// exactly as the console's own instruction loop does
+	void run(CPU& cpu, Bus& bus, double until, IdleLoop* idle = nullptr);
+	// whether run() has anything to do at pc, so callers can skip calling it
+	bool hasBlock(uint16_t pc) const { return (entries[pc >> 3] >> (pc & 7)) & 1; }
+
+	uint64_t getInstructions() const { return instructions; } // run compiled so far
+
+private:
+	static uint8_t read(void* context, uint16_t addr);
+	static void write(void* context, uint16_t addr, uint8_t value);
+	static void backwardJump(void* context);
+	void trustPages(const Bus& bus);
+	void syncCPU();
+
+	void* library;
+	const AotModule* module;
+	const uint8_t* pages[256];
+	uint8_t entries[8192];             // bit per address: a block starts there
+	uint8_t trusted[256];              // see AotRuntime::trusted
+	const uint8_t* verified[256];      // the memory trusted[] was decided for
+	const Bus* mappedBus;              // what pages[] was taken from
+	uint32_t mappedVersion;
+	AotState state;
+
+	CPU* cpu; // during run()
+	Bus* bus;
+	IdleLoop* idle;
+	double until;
+	uint64_t instructions;
+};
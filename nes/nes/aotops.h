@@ -0,0 +1,312 @@
+/************************************************************************************
+
+Filename    :   aotops.h
+Content     :   Instruction semantics for recompiled code
+Authors     :   Yash Patel
+
+What the Recompiler's output compiles each instruction into. aotInstruction() runs
+one official 6502 instruction on an AotState, given its address, opcode and operand
+bytes; the generated code calls it with all three as constants, so the switch folds
+down to the one case and every address an instruction uses without indexing becomes
+a constant too. Timing and bus traffic are FastBus's: the base cycles are charged up
+front, loads add the page-cross cycle, taken branches one or two, and there are no
+dummy accesses.
+
+This is a second copy of the CPU's semantics (the handlers are private members of
+the emulator, which a module can't call), kept honest by the CPU fuzzer, which runs
+it as one of its backends against the interpreter.
+
+*************************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+
+#include "aotabi.h"
+
+#if defined(_MSC_VER)
+#define NES_AOT_INLINE __forceinline
+#else
+#define NES_AOT_INLINE inline __attribute__((always_inline))
+#endif
+
+// status register bits [NV-BDIZC]
+const uint8_t kAotC = 0x01;
+const uint8_t kAotZ = 0x02;
+const uint8_t kAotI = 0x04;
+const uint8_t kAotD = 0x08;
+const uint8_t kAotV = 0x40;
+const uint8_t kAotN = 0x80;
+
+NES_AOT_INLINE uint8_t aotRead(const AotRuntime* runtime, uint16_t addr) {
+	const uint8_t* page = runtime->pages[addr >> 8];
+	return page != nullptr ? page[addr & 0xFF] : runtime->read(runtime->context, addr);
+}
+
+NES_AOT_INLINE void aotWrite(const AotRuntime* runtime, uint16_t addr, uint8_t value) {
+	runtime->write(runtime->context, addr, value);
+}
+
+NES_AOT_INLINE void aotFlag(AotState& s, uint8_t flag, bool set) {
+	s.sr = set ? uint8_t(s.sr | flag) : uint8_t(s.sr & ~flag);
+}
+
+NES_AOT_INLINE uint8_t aotSetZN(AotState& s, uint8_t value) {
+	s.sr = uint8_t((s.sr & ~(kAotN | kAotZ)) | (value & kAotN) | (value == 0 ? kAotZ : 0));
+	return value;
+}
+
+// base + index; loads take an extra cycle when that crosses a page
+NES_AOT_INLINE uint16_t aotIndexed(AotState& s, uint16_t base, uint8_t index, bool load) {
+	uint16_t addr = uint16_t(base + index);
+	if (load && ((base ^ addr) & 0xFF00) != 0) {
+		s.cycles++;
+	}
+	return addr;
+}
+
+// (zp,X): pointer and its high byte wrap within the zeropage
+NES_AOT_INLINE uint16_t aotIndirectX(const AotRuntime* runtime, uint8_t zp) {
+	uint8_t pointer = uint8_t(zp + runtime->state->x);
+	return uint16_t(aotRead(runtime, pointer) | (aotRead(runtime, uint8_t(pointer + 1)) << 8));
+}
+
+// (zp),Y
+NES_AOT_INLINE uint16_t aotIndirectY(const AotRuntime* runtime, uint8_t zp, bool load) {
+	uint16_t base = uint16_t(aotRead(runtime, zp) | (aotRead(runtime, uint8_t(zp + 1)) << 8));
+	return aotIndexed(*runtime->state, base, runtime->state->y, load);
+}
+
+NES_AOT_INLINE void aotPush(const AotRuntime* runtime, uint8_t value) {
+	AotState& s = *runtime->state;
+	aotWrite(runtime, uint16_t(0x100 | s.sp), value);
+	s.sp--;
+}
+
+NES_AOT_INLINE uint8_t aotPull(const AotRuntime* runtime) {
+	AotState& s = *runtime->state;
+	s.sp++;
+	return aotRead(runtime, uint16_t(0x100 | s.sp));
+}
+
+NES_AOT_INLINE void aotAddWithCarry(AotState& s, uint8_t operand) {
+	unsigned sum = s.a + operand + (s.sr & kAotC);
+	aotFlag(s, kAotV, (~(s.a ^ operand) & (s.a ^ sum) & 0x80) != 0);
+	aotFlag(s, kAotC, sum > 0xFF);
+	s.a = aotSetZN(s, uint8_t(sum));
+}
+
+NES_AOT_INLINE void aotCompare(AotState& s, uint8_t reg, uint8_t mem) {
+	aotFlag(s, kAotC, reg >= mem);
+	aotSetZN(s, uint8_t(reg - mem));
+}
+
+// the read-modify-write operations, by the opcode's aaa bits
+NES_AOT_INLINE uint8_t aotModify(AotState& s, int operation, uint8_t value) {
+	uint8_t carry = s.sr & kAotC;
+	switch (operation) {
+	case 0: aotFlag(s, kAotC, (value & 0x80) != 0); return aotSetZN(s, uint8_t(value << 1));           // ASL
+	case 1: aotFlag(s, kAotC, (value & 0x80) != 0); return aotSetZN(s, uint8_t((value << 1) | carry)); // ROL
+	case 2: aotFlag(s, kAotC, (value & 0x01) != 0); return aotSetZN(s, uint8_t(value >> 1));           // LSR
+	case 3: aotFlag(s, kAotC, (value & 0x01) != 0); return aotSetZN(s, uint8_t((value >> 1) | (carry << 7))); // ROR
+	case 6: return aotSetZN(s, uint8_t(value - 1));                                                   // DEC
+	default: return aotSetZN(s, uint8_t(value + 1));                                                  // INC
+	}
+}
+
+// the ALU operations, by the opcode's aaa bits (STA, 4, isn't one)
+NES_AOT_INLINE void aotAlu(AotState& s, int operation, uint8_t value) {
+	switch (operation) {
+	case 0: s.a = aotSetZN(s, uint8_t(s.a | value)); break; // ORA
+	case 1: s.a = aotSetZN(s, uint8_t(s.a & value)); break; // AND
+	case 2: s.a = aotSetZN(s, uint8_t(s.a ^ value)); break; // EOR
+	case 3: aotAddWithCarry(s, value); break;               // ADC
+	case 5: s.a = aotSetZN(s, value); break;                // LDA
+	case 6: aotCompare(s, s.a, value); break;               // CMP
+	default: aotAddWithCarry(s, uint8_t(~value)); break;    // SBC
+	}
+}
+
+NES_AOT_INLINE void aotBranch(AotState& s, uint16_t pc, uint8_t offset, bool taken) {
+	uint16_t next = uint16_t(pc + 2);
+	s.pc = next;
+	if (taken) {
+		s.pc = uint16_t(next + int8_t(offset));
+		s.cycles += ((s.pc ^ next) & 0xFF00) != 0 ? 2 : 1;
+	}
+}
+
+// runs the instruction at pc, whose operand bytes (little endian, as many as it has)
+// are `operand`; false, with nothing done, for an opcode this doesn't implement
+NES_AOT_INLINE bool aotInstruction(const AotRuntime* runtime, uint16_t pc, uint8_t opcode, uint16_t operand) {
+	AotState& s = *runtime->state;
+	const uint8_t zp = uint8_t(operand);
+	const uint16_t pc1 = uint16_t(pc + 1);
+	const uint16_t pc2 = uint16_t(pc + 2);
+	const uint16_t pc3 = uint16_t(pc + 3);
+	const int operation = opcode >> 5;
+	uint16_t addr;
+
+	switch (opcode) {
+	// ALU: ORA AND EOR ADC LDA CMP SBC
+	case 0x01: case 0x21: case 0x41: case 0x61: case 0xA1: case 0xC1: case 0xE1:
+		s.cycles += 6; aotAlu(s, operation, aotRead(runtime, aotIndirectX(runtime, zp))); s.pc = pc2; return true;
+	case 0x05: case 0x25: case 0x45: case 0x65: case 0xA5: case 0xC5: case 0xE5:
+		s.cycles += 3; aotAlu(s, operation, aotRead(runtime, zp)); s.pc = pc2; return true;
+	case 0x09: case 0x29: case 0x49: case 0x69: case 0xA9: case 0xC9: case 0xE9:
+		s.cycles += 2; aotAlu(s, operation, zp); s.pc = pc2; return true;
+	case 0x0D: case 0x2D: case 0x4D: case 0x6D: case 0xAD: case 0xCD: case 0xED:
+		s.cycles += 4; aotAlu(s, operation, aotRead(runtime, operand)); s.pc = pc3; return true;
+	case 0x11: case 0x31: case 0x51: case 0x71: case 0xB1: case 0xD1: case 0xF1:
+		s.cycles += 5; aotAlu(s, operation, aotRead(runtime, aotIndirectY(runtime, zp, true))); s.pc = pc2; return true;
+	case 0x15: case 0x35: case 0x55: case 0x75: case 0xB5: case 0xD5: case 0xF5:
+		s.cycles += 4; aotAlu(s, operation, aotRead(runtime, uint8_t(zp + s.x))); s.pc = pc2; return true;
+	case 0x19: case 0x39: case 0x59: case 0x79: case 0xB9: case 0xD9: case 0xF9:
+		s.cycles += 4; aotAlu(s, operation, aotRead(runtime, aotIndexed(s, operand, s.y, true))); s.pc = pc3; return true;
+	case 0x1D: case 0x3D: case 0x5D: case 0x7D: case 0xBD: case 0xDD: case 0xFD:
+		s.cycles += 4; aotAlu(s, operation, aotRead(runtime, aotIndexed(s, operand, s.x, true))); s.pc = pc3; return true;
+
+	// STA
+	case 0x81: s.cycles += 6; aotWrite(runtime, aotIndirectX(runtime, zp), s.a); s.pc = pc2; return true;
+	case 0x85: s.cycles += 3; aotWrite(runtime, zp, s.a); s.pc = pc2; return true;
+	case 0x8D: s.cycles += 4; aotWrite(runtime, operand, s.a); s.pc = pc3; return true;
+	case 0x91: s.cycles += 6; aotWrite(runtime, aotIndirectY(runtime, zp, false), s.a); s.pc = pc2; return true;
+	case 0x95: s.cycles += 4; aotWrite(runtime, uint8_t(zp + s.x), s.a); s.pc = pc2; return true;
+	case 0x99: s.cycles += 5; aotWrite(runtime, uint16_t(operand + s.y), s.a); s.pc = pc3; return true;
+	case 0x9D: s.cycles += 5; aotWrite(runtime, uint16_t(operand + s.x), s.a); s.pc = pc3; return true;
+
+	// read-modify-write: ASL ROL LSR ROR DEC INC
+	case 0x0A: case 0x2A: case 0x4A: case 0x6A:
+		s.cycles += 2; s.a = aotModify(s, operation, s.a); s.pc = pc1; return true;
+	case 0x06: case 0x26: case 0x46: case 0x66: case 0xC6: case 0xE6:
+		s.cycles += 5; addr = zp; aotWrite(runtime, addr, aotModify(s, operation, aotRead(runtime, addr))); s.pc = pc2; return true;
+	case 0x0E: case 0x2E: case 0x4E: case 0x6E: case 0xCE: case 0xEE:
+		s.cycles += 6; addr = operand; aotWrite(runtime, addr, aotModify(s, operation, aotRead(runtime, addr))); s.pc = pc3; return true;
+	case 0x16: case 0x36: case 0x56: case 0x76: case 0xD6: case 0xF6:
+		s.cycles += 6; addr = uint8_t(zp + s.x); aotWrite(runtime, addr, aotModify(s, operation, aotRead(runtime, addr))); s.pc = pc2; return true;
+	case 0x1E: case 0x3E: case 0x5E: case 0x7E: case 0xDE: case 0xFE:
+		s.cycles += 7; addr = uint16_t(operand + s.x); aotWrite(runtime, addr, aotModify(s, operation, aotRead(runtime, addr))); s.pc = pc3; return true;
+
+	// X and Y loads, stores and compares
+	case 0xA2: s.cycles += 2; s.x = aotSetZN(s, zp); s.pc = pc2; return true;
+	case 0xA6: s.cycles += 3; s.x = aotSetZN(s, aotRead(runtime, zp)); s.pc = pc2; return true;
+	case 0xB6: s.cycles += 4; s.x = aotSetZN(s, aotRead(runtime, uint8_t(zp + s.y))); s.pc = pc2; return true;
+	case 0xAE: s.cycles += 4; s.x = aotSetZN(s, aotRead(runtime, operand)); s.pc = pc3; return true;
+	case 0xBE: s.cycles += 4; s.x = aotSetZN(s, aotRead(runtime, aotIndexed(s, operand, s.y, true))); s.pc = pc3; return true;
+	case 0xA0: s.cycles += 2; s.y = aotSetZN(s, zp); s.pc = pc2; return true;
+	case 0xA4: s.cycles += 3; s.y = aotSetZN(s, aotRead(runtime, zp)); s.pc = pc2; return true;
+	case 0xB4: s.cycles += 4; s.y = aotSetZN(s, aotRead(runtime, uint8_t(zp + s.x))); s.pc = pc2; return true;
+	case 0xAC: s.cycles += 4; s.y = aotSetZN(s, aotRead(runtime, operand)); s.pc = pc3; return true;
+	case 0xBC: s.cycles += 4; s.y = aotSetZN(s, aotRead(runtime, aotIndexed(s, operand, s.x, true))); s.pc = pc3; return true;
+	case 0x86: s.cycles += 3; aotWrite(runtime, zp, s.x); s.pc = pc2; return true;
+	case 0x96: s.cycles += 4; aotWrite(runtime, uint8_t(zp + s.y), s.x); s.pc = pc2; return true;
+	case 0x8E: s.cycles += 4; aotWrite(runtime, operand, s.x); s.pc = pc3; return true;
+	case 0x84: s.cycles += 3; aotWrite(runtime, zp, s.y); s.pc = pc2; return true;
+	case 0x94: s.cycles += 4; aotWrite(runtime, uint8_t(zp + s.x), s.y); s.pc = pc2; return true;
+	case 0x8C: s.cycles += 4; aotWrite(runtime, operand, s.y); s.pc = pc3; return true;
+	case 0xE0: s.cycles += 2; aotCompare(s, s.x, zp); s.pc = pc2; return true;
+	case 0xE4: s.cycles += 3; aotCompare(s, s.x, aotRead(runtime, zp)); s.pc = pc2; return true;
+	case 0xEC: s.cycles += 4; aotCompare(s, s.x, aotRead(runtime, operand)); s.pc = pc3; return true;
+	case 0xC0: s.cycles += 2; aotCompare(s, s.y, zp); s.pc = pc2; return true;
+	case 0xC4: s.cycles += 3; aotCompare(s, s.y, aotRead(runtime, zp)); s.pc = pc2; return true;
+	case 0xCC: s.cycles += 4; aotCompare(s, s.y, aotRead(runtime, operand)); s.pc = pc3; return true;
+
+	// BIT
+	case 0x24: case 0x2C: {
+		s.cycles += opcode == 0x24 ? 3 : 4;
+		uint8_t value = aotRead(runtime, opcode == 0x24 ? uint16_t(zp) : operand);
+		s.sr = uint8_t((s.sr & ~(kAotN | kAotV | kAotZ)) | (value & (kAotN | kAotV)) | ((s.a & value) == 0 ? kAotZ : 0));
+		s.pc = opcode == 0x24 ? pc2 : pc3;
+		return true;
+	}
+
+	// register only
+	case 0xAA: s.cycles += 2; s.x = aotSetZN(s, s.a); s.pc = pc1; return true;  // TAX
+	case 0xA8: s.cycles += 2; s.y = aotSetZN(s, s.a); s.pc = pc1; return true;  // TAY
+	case 0xBA: s.cycles += 2; s.x = aotSetZN(s, s.sp); s.pc = pc1; return true; // TSX
+	case 0x8A: s.cycles += 2; s.a = aotSetZN(s, s.x); s.pc = pc1; return true;  // TXA
+	case 0x9A: s.cycles += 2; s.sp = s.x; s.pc = pc1; return true;              // TXS
+	case 0x98: s.cycles += 2; s.a = aotSetZN(s, s.y); s.pc = pc1; return true;  // TYA
+	case 0xE8: s.cycles += 2; s.x = aotSetZN(s, uint8_t(s.x + 1)); s.pc = pc1; return true; // INX
+	case 0xC8: s.cycles += 2; s.y = aotSetZN(s, uint8_t(s.y + 1)); s.pc = pc1; return true; // INY
+	case 0xCA: s.cycles += 2; s.x = aotSetZN(s, uint8_t(s.x - 1)); s.pc = pc1; return true; // DEX
+	case 0x88: s.cycles += 2; s.y = aotSetZN(s, uint8_t(s.y - 1)); s.pc = pc1; return true; // DEY
+	case 0x18: s.cycles += 2; aotFlag(s, kAotC, false); s.pc = pc1; return true; // CLC
+	case 0x38: s.cycles += 2; aotFlag(s, kAotC, true); s.pc = pc1; return true;  // SEC
+	case 0x58: s.cycles += 2; aotFlag(s, kAotI, false); s.pc = pc1; return true; // CLI
+	case 0x78: s.cycles += 2; aotFlag(s, kAotI, true); s.pc = pc1; return true;  // SEI
+	case 0xB8: s.cycles += 2; aotFlag(s, kAotV, false); s.pc = pc1; return true; // CLV
+	case 0xD8: s.cycles += 2; aotFlag(s, kAotD, false); s.pc = pc1; return true; // CLD
+	case 0xF8: s.cycles += 2; aotFlag(s, kAotD, true); s.pc = pc1; return true;  // SED
+	case 0xEA: s.cycles += 2; s.pc = pc1; return true;                           // NOP
+
+	// branches
+	case 0x10: s.cycles += 2; aotBranch(s, pc, zp, (s.sr & kAotN) == 0); return true; // BPL
+	case 0x30: s.cycles += 2; aotBranch(s, pc, zp, (s.sr & kAotN) != 0); return true; // BMI
+	case 0x50: s.cycles += 2; aotBranch(s, pc, zp, (s.sr & kAotV) == 0); return true; // BVC
+	case 0x70: s.cycles += 2; aotBranch(s, pc, zp, (s.sr & kAotV) != 0); return true; // BVS
+	case 0x90: s.cycles += 2; aotBranch(s, pc, zp, (s.sr & kAotC) == 0); return true; // BCC
+	case 0xB0: s.cycles += 2; aotBranch(s, pc, zp, (s.sr & kAotC) != 0); return true; // BCS
+	case 0xD0: s.cycles += 2; aotBranch(s, pc, zp, (s.sr & kAotZ) == 0); return true; // BNE
+	case 0xF0: s.cycles += 2; aotBranch(s, pc, zp, (s.sr & kAotZ) != 0); return true; // BEQ
+
+	// stack and jumps
+	case 0x48: s.cycles += 3; aotPush(runtime, s.a); s.pc = pc1; return true;                 // PHA
+	case 0x08: s.cycles += 3; aotPush(runtime, uint8_t(s.sr | 0x30)); s.pc = pc1; return true; // PHP
+	case 0x68: s.cycles += 4; s.a = aotSetZN(s, aotPull(runtime)); s.pc = pc1; return true;    // PLA
+	case 0x28: s.cycles += 4; s.sr = aotPull(runtime) & 0xCF; s.pc = pc1; return true;         // PLP
+	case 0x4C: s.cycles += 3; s.pc = operand; return true;                                     // JMP abs
+	case 0x6C:                                                                                 // JMP (ind), with the page wrap
+		s.cycles += 5;
+		s.pc = uint16_t(aotRead(runtime, operand) | (aotRead(runtime, uint16_t((operand & 0xFF00) | uint8_t(operand + 1))) << 8));
+		return true;
+	case 0x20:                                                                                 // JSR
+		s.cycles += 6;
+		aotPush(runtime, uint8_t(pc2 >> 8));
+		aotPush(runtime, uint8_t(pc2));
+		// the high byte is fetched after the pushes, which can overwrite it on the stack page
+		s.pc = (pc2 >> 8) == 0x01 ? uint16_t(zp | (aotRead(runtime, pc2) << 8)) : operand;
+		return true;
+	case 0x60: {                                                                               // RTS
+		s.cycles += 6;
+		uint16_t ll = aotPull(runtime);
+		s.pc = uint16_t((ll | (aotPull(runtime) << 8)) + 1);
+		return true;
+	}
+	case 0x40: {                                                                               // RTI
+		s.cycles += 6;
+		s.sr = aotPull(runtime) & 0xCF;
+		uint16_t ll = aotPull(runtime);
+		s.pc = uint16_t(ll | (aotPull(runtime) << 8));
+		return true;
+	}
+	case 0x00:                                                                                 // BRK
+		s.cycles += 7;
+		aotPush(runtime, uint8_t(pc2 >> 8));
+		aotPush(runtime, uint8_t(pc2));
+		aotPush(runtime, uint8_t(s.sr | 0x30));
+		aotFlag(s, kAotI, true);
+		s.pc = uint16_t(aotRead(runtime, 0xFFFE) | (aotRead(runtime, 0xFFFF) << 8));
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+// generated code, after each instruction: reports a backward jump like the interpreter
+// does, and is true once the budget of this run() is used up
+NES_AOT_INLINE bool aotRetire(const AotRuntime* runtime, uint16_t pc) {
+	AotState& s = *runtime->state;
+	s.instructions++;
+	if (s.pc <= pc) {
+		runtime->backwardJump(runtime->context);
+	}
+	return s.cycles >= s.limit;
+}
+
+// generated code: one instruction; true when run() has to return
+NES_AOT_INLINE bool aotStep(const AotRuntime* runtime, uint16_t pc, uint8_t opcode, uint16_t operand) {
+	aotInstruction(runtime, pc, opcode, operand);
+	return aotRetire(runtime, pc);
+}
@@ -0,0 +1,703 @@
+/************************************************************************************
+
+Filename    :   apu.cpp
+Content     :   Audio processing unit
+Authors     :   Yash Patel
+
+Channel behaviour follows https://www.nesdev.org/wiki/APU. All times are absolute
+CPU cycles. Channels are output-change driven (see apu.h); the only work per CPU
+cycle anywhere in here is none.
+
+Mixer (https://www.nesdev.org/wiki/APU_Mixer), evaluated on band-limited channel
+outputs so it is applied per output sample rather than per clock:
+
+    pulse = 95.88 * (p1 + p2) / (8128 + 100 * (p1 + p2))
+    x     = t / 8227 + n / 12241 + d / 22638
+    tnd   = 159.79 * x / (1 + 100 * x)
+
+*************************************************************************************/
+
+#include "apu.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "cpu.h"
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1) || defined(__SSE__)
+#define NES_APU_SSE 1
+#include <xmmintrin.h>
+#endif
+
+namespace {
+
+const uint8_t kLength[32] = {
+    10, 254, 20,  2, 40,  4, 80,  6, 160,  8, 60, 10, 14, 12, 26, 14,
+    12,  16, 24, 18, 48, 20, 96, 22, 192, 24, 72, 26, 16, 28, 32, 30,
+};
+
+const uint8_t kDuty[4][8] = {
+    { 0, 1, 0, 0, 0, 0, 0, 0 }, // 12.5%
+    { 0, 1, 1, 0, 0, 0, 0, 0 }, // 25%
+    { 0, 1, 1, 1, 1, 0, 0, 0 }, // 50%
+    { 1, 0, 0, 1, 1, 1, 1, 1 }, // 25% negated
+};
+
+const uint8_t kTriangle[32] = {
+    15, 14, 13, 12, 11, 10,  9,  8,  7,  6,  5,  4,  3,  2,  1,  0,
+     0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15,
+};
+
+// [region] periods in CPU cycles
+const uint16_t kNoisePeriod[2][16] = {
+    { 4, 8, 16, 32, 64, 96, 128, 160, 202, 254, 380, 508, 762, 1016, 2034, 4068 },
+    { 4, 8, 14, 30, 60, 88, 118, 148, 188, 236, 354, 472, 708,  944, 1890, 3778 },
+};
+const uint16_t kDmcPeriod[2][16] = {
+    { 428, 380, 340, 320, 286, 254, 226, 214, 190, 160, 142, 128, 106, 84, 72, 54 },
+    { 398, 354, 316, 298, 276, 236, 210, 198, 176, 148, 132, 118,  98, 78, 66, 50 },
+};
+
+// [region][five-step] cycle of each of the 4 sequencer events after the sequence
+// start, then the sequence length. The 5-step mode's silent 4th step is skipped.
+const uint32_t kSequencer[2][2][5] = {
+    { { 7457, 14913, 22371, 29829, 29830 }, { 7457, 14913, 22371, 37281, 37282 } },
+    { { 8313, 16627, 24939, 33253, 33254 }, { 8313, 16627, 24939, 41565, 41566 } },
+};
+
+const uint64_t kNever = ~uint64_t(0);
+
+// cycles the CPU is halted for each DMC sample fetch (3 or 4 depending on what it
+// was doing; we always charge the common case)
+const uint32_t kDmcFetchStall = 4;
+
+} // namespace
+
+APU::APU(Region region, Bus* bus, const CPU* cpu) :
+    region(region),
+    bus(bus),
+    cpu(cpu),
+    synthesis(true),
+    sampleRate(kDefaultSampleRate) {
+    setSampleRate(kDefaultSampleRate);
+    reset();
+}
+
+void APU::reset() {
+    memset(&pulse1, 0, sizeof(pulse1));
+    memset(&pulse2, 0, sizeof(pulse2));
+    memset(&triangle, 0, sizeof(triangle));
+    memset(&noise, 0, sizeof(noise));
+    memset(&dmc, 0, sizeof(dmc));
+
+    int r = (region == Region::PAL) ? 1 : 0;
+    pulse2.second = true;
+    noise.shift = 1;
+    noise.period = kNoisePeriod[r][0];
+    dmc.period = kDmcPeriod[r][0];
+    dmc.bits = 8;
+    dmc.silence = true;
+    dmaStall = 0;
+
+    log.clear();
+    time = frameStart = cpu->getCycles();
+    pulse1.nextClock = pulse2.nextClock = triangle.nextClock = noise.nextClock = dmc.nextClock = time;
+
+    fiveStep = false;
+    irqInhibit = false;
+    frameIrq = false;
+    resetSequencer(time);
+
+    for (BlipBuffer& blip : blips) {
+        blip.clear();
+    }
+    samples.clear();
+    highpassPrev = highpassOut = 0.0f;
+}
+
+void APU::saveState(State& state) const {
+    state.log = log;
+    state.time = time;
+    state.frameStart = frameStart;
+    state.fiveStep = fiveStep;
+    state.irqInhibit = irqInhibit;
+    state.frameIrq = frameIrq;
+    state.sequencerStep = sequencerStep;
+    state.sequencerStart = sequencerStart;
+    state.nextSequencerEvent = nextSequencerEvent;
+    state.pulse1 = pulse1;
+    state.pulse2 = pulse2;
+    state.triangle = triangle;
+    state.noise = noise;
+    state.dmc = dmc;
+    state.dmaStall = dmaStall;
+}
+
+void APU::loadState(const State& state) {
+    int amps[5] = { pulse1.amp, pulse2.amp, triangle.amp, noise.amp, dmc.amp };
+    log = state.log;
+    time = state.time;
+    frameStart = state.frameStart;
+    fiveStep = state.fiveStep;
+    irqInhibit = state.irqInhibit;
+    frameIrq = state.frameIrq;
+    sequencerStep = state.sequencerStep;
+    sequencerStart = state.sequencerStart;
+    nextSequencerEvent = state.nextSequencerEvent;
+    pulse1 = state.pulse1;
+    pulse2 = state.pulse2;
+    triangle = state.triangle;
+    noise = state.noise;
+    dmc = state.dmc;
+    dmaStall = state.dmaStall;
+
+    // amp is what the blip buffers were fed, so it stays; the next refresh emits the step
+    pulse1.amp = amps[0];
+    pulse2.amp = amps[1];
+    triangle.amp = amps[2];
+    noise.amp = amps[3];
+    dmc.amp = amps[4];
+}
+
+void APU::setSampleRate(int rate) {
+    sampleRate = rate;
+    for (BlipBuffer& blip : blips) {
+        blip.setRates(cpuClockRate(region), rate);
+    }
+}
+
+void APU::setSynthesis(bool enabled) {
+    if (enabled && !synthesis) {
+        // amplitudes weren't tracked while muted: restart every channel from silence
+        for (BlipBuffer& blip : blips) {
+            blip.clear();
+        }
+        pulse1.amp = pulse2.amp = triangle.amp = noise.amp = dmc.amp = 0;
+        highpassPrev = highpassOut = 0.0f;
+        synthesis = true;
+        refresh(std::max(time, frameStart));
+        return;
+    }
+    synthesis = enabled;
+}
+
+/************************************************************************************
+
+Registers:
+
+$4000-$4003  pulse 1        DDLC VVVV / EPPP NSSS / LLLL LLLL / llll lHHH
+$4004-$4007  pulse 2        (same)
+$4008-$400B  triangle       CRRR RRRR / ---- ---- / LLLL LLLL / llll lHHH
+$400C-$400F  noise          --LC VVVV / ---- ---- / M--- PPPP / llll l---
+$4010-$4013  DMC            IL-- RRRR / -DDD DDDD / AAAA AAAA / LLLL LLLL
+$4015        status         ---D NT21 (write: enables; read: length/IRQ status)
+$4017        frame counter  MI-- ----
+
+*************************************************************************************/
+
+uint8_t APU::read(uint16_t addr) {
+    if (addr != 0x4015) {
+        return 0;
+    }
+
+    run(cpu->getCycles());
+    uint8_t result = (pulse1.length > 0 ? 0x01 : 0) |
+        (pulse2.length > 0 ? 0x02 : 0) |
+        (triangle.length > 0 ? 0x04 : 0) |
+        (noise.length > 0 ? 0x08 : 0) |
+        (dmc.remaining > 0 ? 0x10 : 0) |
+        (frameIrq ? 0x40 : 0) |
+        (dmc.irq ? 0x80 : 0);
+    frameIrq = false;
+    return result;
+}
+
+void APU::write(uint16_t addr, uint8_t value) {
+    if (addr > 0x4017 || addr == 0x4014 || addr == 0x4016) {
+        return; // not ours
+    }
+    Write w;
+    w.cycle = cpu->getCycles();
+    w.addr = addr;
+    w.value = value;
+    log.push_back(w);
+}
+
+void APU::apply(const Write& w) {
+    uint8_t v = w.value;
+    Pulse& pulse = (w.addr < 0x4004) ? pulse1 : pulse2;
+    int r = (region == Region::PAL) ? 1 : 0;
+
+    switch (w.addr) {
+    case 0x4000: case 0x4004: {
+        pulse.duty = v >> 6;
+        pulse.envelope.loop = (v & 0x20) != 0;
+        pulse.envelope.constant = (v & 0x10) != 0;
+        pulse.envelope.period = v & 0x0F;
+        break;
+    }
+    case 0x4001: case 0x4005: {
+        pulse.sweepEnabled = (v & 0x80) != 0;
+        pulse.sweepPeriod = (v >> 4) & 0x07;
+        pulse.sweepNegate = (v & 0x08) != 0;
+        pulse.sweepShift = v & 0x07;
+        pulse.sweepReload = true;
+        break;
+    }
+    case 0x4002: case 0x4006: { pulse.period = (pulse.period & 0x0700) | v; break; }
+    case 0x4003: case 0x4007: {
+        pulse.period = (pulse.period & 0x00FF) | ((v & 0x07) << 8);
+        if (pulse.enabled) {
+            pulse.length = kLength[v >> 3];
+        }
+        pulse.step = 0;
+        pulse.envelope.start = true;
+        break;
+    }
+    case 0x4008: {
+        triangle.control = (v & 0x80) != 0;
+        triangle.linearReload = v & 0x7F;
+        break;
+    }
+    case 0x400A: { triangle.period = (triangle.period & 0x0700) | v; break; }
+    case 0x400B: {
+        triangle.period = (triangle.period & 0x00FF) | ((v & 0x07) << 8);
+        if (triangle.enabled) {
+            triangle.length = kLength[v >> 3];
+        }
+        triangle.linearReloadFlag = true;
+        break;
+    }
+    case 0x400C: {
+        noise.envelope.loop = (v & 0x20) != 0;
+        noise.envelope.constant = (v & 0x10) != 0;
+        noise.envelope.period = v & 0x0F;
+        break;
+    }
+    case 0x400E: {
+        noise.mode = (v & 0x80) != 0;
+        noise.period = kNoisePeriod[r][v & 0x0F];
+        break;
+    }
+    case 0x400F: {
+        if (noise.enabled) {
+            noise.length = kLength[v >> 3];
+        }
+        noise.envelope.start = true;
+        break;
+    }
+    case 0x4010: {
+        dmc.irqEnabled = (v & 0x80) != 0;
+        if (!dmc.irqEnabled) {
+            dmc.irq = false;
+        }
+        dmc.loop = (v & 0x40) != 0;
+        dmc.period = kDmcPeriod[r][v & 0x0F];
+        break;
+    }
+    case 0x4011: { dmc.level = v & 0x7F; break; }
+    case 0x4012: { dmc.sampleAddr = 0xC000 | (v << 6); break; }
+    case 0x4013: { dmc.sampleLength = (v << 4) | 1; break; }
+    case 0x4015: {
+        pulse1.enabled = (v & 0x01) != 0;
+        pulse2.enabled = (v & 0x02) != 0;
+        triangle.enabled = (v & 0x04) != 0;
+        noise.enabled = (v & 0x08) != 0;
+        if (!pulse1.enabled)   { pulse1.length = 0; }
+        if (!pulse2.enabled)   { pulse2.length = 0; }
+        if (!triangle.enabled) { triangle.length = 0; }
+        if (!noise.enabled)    { noise.length = 0; }
+
+        if (v & 0x10) {
+            if (dmc.remaining == 0) {
+                dmc.addr = dmc.sampleAddr;
+                dmc.remaining = dmc.sampleLength;
+                fetchDMC();
+            }
+        } else {
+            dmc.remaining = 0;
+        }
+        dmc.irq = false;
+        break;
+    }
+    case 0x4017: {
+        fiveStep = (v & 0x80) != 0;
+        irqInhibit = (v & 0x40) != 0;
+        if (irqInhibit) {
+            frameIrq = false;
+        }
+        resetSequencer(w.cycle);
+        break;
+    }
+    default: break;
+    }
+}
+
+void APU::Envelope::clock() {
+    if (start) {
+        start = false;
+        decay = 15;
+        divider = period;
+    } else if (divider == 0) {
+        divider = period;
+        if (decay > 0) {
+            decay--;
+        } else if (loop) {
+            decay = 15;
+        }
+    } else {
+        divider--;
+    }
+}
+
+uint16_t APU::Pulse::sweepTarget() const {
+    int change = period >> sweepShift;
+    int target = sweepNegate ? period - change - (second ? 0 : 1) : period + change;
+    return uint16_t(std::max(target, 0));
+}
+
+bool APU::Pulse::muted() const {
+    return length == 0 || period < 8 || sweepTarget() > 0x07FF;
+}
+
+int APU::Pulse::output() const {
+    return muted() ? 0 : kDuty[duty][step] * envelope.volume();
+}
+
+int APU::Triangle::output() const {
+    return kTriangle[step];
+}
+
+int APU::Noise::output() const {
+    return (length == 0 || (shift & 1)) ? 0 : envelope.volume();
+}
+
+// frame sequencer
+
+void APU::resetSequencer(uint64_t when) {
+    int r = (region == Region::PAL) ? 1 : 0;
+    sequencerStart = when;
+    sequencerStep = 0;
+    nextSequencerEvent = sequencerStart + kSequencer[r][fiveStep][0];
+    if (fiveStep) {
+        // switching to 5-step mode clocks everything immediately
+        quarterFrame();
+        halfFrame();
+    }
+}
+
+void APU::clockSequencer() {
+    int r = (region == Region::PAL) ? 1 : 0;
+    quarterFrame();
+    if (sequencerStep == 1 || sequencerStep == 3) {
+        halfFrame();
+    }
+    if (sequencerStep == 3 && !fiveStep && !irqInhibit) {
+        frameIrq = true;
+    }
+
+    sequencerStep++;
+    if (sequencerStep == 4) {
+        sequencerStep = 0;
+        sequencerStart += kSequencer[r][fiveStep][4];
+    }
+    nextSequencerEvent = sequencerStart + kSequencer[r][fiveStep][sequencerStep];
+}
+
+void APU::quarterFrame() {
+    pulse1.envelope.clock();
+    pulse2.envelope.clock();
+    noise.envelope.clock();
+
+    if (triangle.linearReloadFlag) {
+        triangle.linear = triangle.linearReload;
+    } else if (triangle.linear > 0) {
+        triangle.linear--;
+    }
+    if (!triangle.control) {
+        triangle.linearReloadFlag = false;
+    }
+}
+
+void APU::halfFrame() {
+    Pulse* pulses[2] = { &pulse1, &pulse2 };
+    for (Pulse* pulse : pulses) {
+        if (pulse->length > 0 && !pulse->envelope.loop) {
+            pulse->length--;
+        }
+        if (pulse->sweepDivider == 0 && pulse->sweepEnabled && pulse->sweepShift > 0 && !pulse->muted()) {
+            pulse->period = pulse->sweepTarget();
+        }
+        if (pulse->sweepDivider == 0 || pulse->sweepReload) {
+            pulse->sweepDivider = pulse->sweepPeriod;
+            pulse->sweepReload = false;
+        } else {
+            pulse->sweepDivider--;
+        }
+    }
+    if (triangle.length > 0 && !triangle.control) {
+        triangle.length--;
+    }
+    if (noise.length > 0 && !noise.envelope.loop) {
+        noise.length--;
+    }
+}
+
+// channel timers
+
+void APU::emit(BlipBuffer& blip, int& amp, int value, uint64_t when) {
+    if (value != amp) {
+        blip.addDelta(uint32_t(when - frameStart), float(value - amp));
+        amp = value;
+    }
+}
+
+void APU::refresh(uint64_t when) {
+    if (!synthesis) {
+        return;
+    }
+    emit(blips[0], pulse1.amp, pulse1.output(), when);
+    emit(blips[1], pulse2.amp, pulse2.output(), when);
+    emit(blips[2], triangle.amp, triangle.output(), when);
+    emit(blips[3], noise.amp, noise.output(), when);
+    emit(blips[4], dmc.amp, dmc.level, when);
+}
+
+// skips `clock` forward past `until` in whole periods, returning how many it skipped
+static uint64_t skipPeriods(uint64_t& clock, uint64_t period, uint64_t until) {
+    if (clock >= until) {
+        return 0;
+    }
+    uint64_t steps = (until - clock + period - 1) / period;
+    clock += steps * period;
+    return steps;
+}
+
+void APU::runPulse(Pulse& pulse, BlipBuffer& blip, uint64_t until) {
+    uint64_t period = (uint64_t(pulse.period) + 1) * 2; // timer is clocked every other CPU cycle
+    if (!synthesis || pulse.muted() || pulse.envelope.volume() == 0) {
+        // output can't change (or nobody listens): only the sequencer phase matters
+        pulse.step = uint8_t((pulse.step + skipPeriods(pulse.nextClock, period, until)) & 7);
+        return;
+    }
+    while (pulse.nextClock < until) {
+        pulse.step = (pulse.step + 1) & 7;
+        emit(blip, pulse.amp, pulse.output(), pulse.nextClock);
+        pulse.nextClock += period;
+    }
+}
+
+void APU::runTriangle(uint64_t until) {
+    uint64_t period = uint64_t(triangle.period) + 1;
+    bool running = triangle.length > 0 && triangle.linear > 0 && triangle.period >= 2;
+    if (!running) {
+        // sequencer halted (ultrasonic periods are held too, rather than aliasing)
+        skipPeriods(triangle.nextClock, period, until);
+        return;
+    }
+    if (!synthesis) {
+        triangle.step = uint8_t((triangle.step + skipPeriods(triangle.nextClock, period, until)) & 31);
+        return;
+    }
+    while (triangle.nextClock < until) {
+        triangle.step = (triangle.step + 1) & 31;
+        emit(blips[2], triangle.amp, triangle.output(), triangle.nextClock);
+        triangle.nextClock += period;
+    }
+}
+
+void APU::runNoise(uint64_t until) {
+    if (!synthesis || noise.length == 0 || noise.envelope.volume() == 0) {
+        // the LFSR isn't observable by the CPU, so it only runs while audible
+        skipPeriods(noise.nextClock, noise.period, until);
+        return;
+    }
+    while (noise.nextClock < until) {
+        uint16_t feedback = (noise.shift ^ (noise.shift >> (noise.mode ? 6 : 1))) & 1;
+        noise.shift = (noise.shift >> 1) | (feedback << 14);
+        emit(blips[3], noise.amp, noise.output(), noise.nextClock);
+        noise.nextClock += noise.period;
+    }
+}
+
+void APU::fetchDMC() {
+    if (dmc.bufferFull || dmc.remaining == 0) {
+        return;
+    }
+    // samples live in ROM, so reading at catch-up time rather than on the exact
+    // cycle is indistinguishable
+    dmc.buffer = bus->read(dmc.addr);
+    dmc.bufferFull = true;
+    dmaStall += kDmcFetchStall;
+    dmc.addr = (dmc.addr == 0xFFFF) ? 0x8000 : dmc.addr + 1;
+    dmc.remaining--;
+    if (dmc.remaining == 0) {
+        if (dmc.loop) {
+            dmc.addr = dmc.sampleAddr;
+            dmc.remaining = dmc.sampleLength;
+        } else if (dmc.irqEnabled) {
+            dmc.irq = true;
+        }
+    }
+}
+
+void APU::runDMC(uint64_t until) {
+    if (dmc.silence && !dmc.bufferFull && dmc.remaining == 0) {
+        // idle: only the bit counter keeps cycling
+        uint64_t steps = skipPeriods(dmc.nextClock, dmc.period, until);
+        dmc.bits = uint8_t((dmc.bits - 1 + 8 - steps % 8) % 8 + 1);
+        return;
+    }
+    while (dmc.nextClock < until) {
+        if (!dmc.silence) {
+            if (dmc.shifter & 1) {
+                if (dmc.level <= 125) {
+                    dmc.level += 2;
+                }
+            } else if (dmc.level >= 2) {
+                dmc.level -= 2;
+            }
+            dmc.shifter >>= 1;
+        }
+        if (--dmc.bits == 0) {
+            dmc.bits = 8;
+            if (dmc.bufferFull) {
+                dmc.shifter = dmc.buffer;
+                dmc.bufferFull = false;
+                dmc.silence = false;
+                fetchDMC();
+            } else {
+                dmc.silence = true;
+            }
+        }
+        if (synthesis) {
+            emit(blips[4], dmc.amp, dmc.level, dmc.nextClock);
+        }
+        dmc.nextClock += dmc.period;
+    }
+}
+
+void APU::run(uint64_t until) {
+    size_t applied = 0;
+    while (true) {
+        uint64_t nextWrite = applied < log.size() ? log[applied].cycle : kNever;
+        uint64_t stop = std::min(until, std::min(nextWrite, nextSequencerEvent));
+
+        runPulse(pulse1, blips[0], stop);
+        runPulse(pulse2, blips[1], stop);
+        runTriangle(stop);
+        runNoise(stop);
+        runDMC(stop);
+        time = stop;
+
+        if (stop == nextSequencerEvent) {
+            clockSequencer();
+            refresh(time);
+        } else if (stop == nextWrite) {
+            apply(log[applied++]);
+            refresh(time);
+        } else {
+            break;
+        }
+    }
+    log.erase(log.begin(), log.begin() + applied);
+}
+
+bool APU::irqAsserted() {
+    uint64_t now = cpu->getCycles();
+
+    // pending writes or a playing DMC sample can change the answer: catch up for real
+    bool exact = dmc.irqEnabled && dmc.remaining > 0;
+    for (const Write& w : log) {
+        exact = exact || w.addr == 0x4010 || w.addr == 0x4015 || w.addr == 0x4017;
+    }
+    if (exact) {
+        run(now);
+        return frameIrq || dmc.irq;
+    }
+
+    if (frameIrq || dmc.irq) {
+        return true;
+    }
+    // otherwise the frame IRQ fires at the last step of the current 4-step sequence
+    int r = (region == Region::PAL) ? 1 : 0;
+    return !fiveStep && !irqInhibit && now >= sequencerStart + kSequencer[r][0][3];
+}
+
+uint32_t APU::takeDmaStall() {
+    if (dmc.remaining > 0) {
+        run(cpu->getCycles());
+    }
+    uint32_t stall = dmaStall;
+    dmaStall = 0;
+    return stall;
+}
+
+void APU::endFrame() {
+    uint64_t now = cpu->getCycles();
+    run(now);
+
+    uint32_t clocks = uint32_t(now - frameStart);
+    frameStart = now;
+    samples.clear();
+    if (!synthesis) {
+        return;
+    }
+
+    for (BlipBuffer& blip : blips) {
+        blip.endFrame(clocks);
+    }
+    int count = blips[0].samplesAvailable();
+    for (int c = 0; c < 5; c++) {
+        channelSamples[c].resize(count);
+        blips[c].readSamples(channelSamples[c].data(), count);
+    }
+    mix(count);
+}
+
+void APU::mix(int count) {
+    mixed.resize(count);
+    samples.resize(count);
+
+    const float* p1 = channelSamples[0].data();
+    const float* p2 = channelSamples[1].data();
+    const float* t  = channelSamples[2].data();
+    const float* n  = channelSamples[3].data();
+    const float* d  = channelSamples[4].data();
+    float* out = mixed.data();
+
+    int i = 0;
+#ifdef NES_APU_SSE
+    const __m128 k9588 = _mm_set1_ps(95.88f);
+    const __m128 k8128 = _mm_set1_ps(8128.0f);
+    const __m128 k15979 = _mm_set1_ps(159.79f);
+    const __m128 k100 = _mm_set1_ps(100.0f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 kt = _mm_set1_ps(1.0f / 8227.0f);
+    const __m128 kn = _mm_set1_ps(1.0f / 12241.0f);
+    const __m128 kd = _mm_set1_ps(1.0f / 22638.0f);
+    for (; i + 4 <= count; i += 4) {
+        __m128 p = _mm_add_ps(_mm_loadu_ps(p1 + i), _mm_loadu_ps(p2 + i));
+        __m128 pulse = _mm_div_ps(_mm_mul_ps(k9588, p), _mm_add_ps(k8128, _mm_mul_ps(k100, p)));
+        __m128 x = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(t + i), kt),
+            _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(n + i), kn), _mm_mul_ps(_mm_loadu_ps(d + i), kd)));
+        __m128 tnd = _mm_div_ps(_mm_mul_ps(k15979, x), _mm_add_ps(one, _mm_mul_ps(k100, x)));
+        _mm_storeu_ps(out + i, _mm_add_ps(pulse, tnd));
+    }
+#endif
+    for (; i < count; i++) {
+        float p = p1[i] + p2[i];
+        float x = t[i] / 8227.0f + n[i] / 12241.0f + d[i] / 22638.0f;
+        out[i] = 95.88f * p / (8128.0f + 100.0f * p) + 159.79f * x / (1.0f + 100.0f * x);
+    }
+
+    // DC blocker (the console's output is AC coupled), then to 16-bit
+    for (i = 0; i < count; i++) {
+        float y = out[i] - highpassPrev + 0.999f * highpassOut;
+        highpassPrev = out[i];
+        highpassOut = y;
+        float scaled = y * 30000.0f;
+        samples[i] = int16_t(std::max(-32768.0f, std::min(32767.0f, scaled)));
+    }
+}
@@ -0,0 +1,225 @@
+/************************************************************************************
+
+Filename    :   apu.h
+Content     :   Audio processing unit (header)
+Authors     :   Yash Patel
+
+2A03 APU: 2 pulse channels, a triangle, a noise channel and the DMC, mapped at
+$4000-$4017. Nothing here ticks per CPU cycle. Register writes are logged with the
+CPU cycle they happened on, and the channels are only brought up to date when
+someone needs their state: at the end of each frame (which synthesizes the whole
+frame's audio in one block) or when the CPU reads $4015.
+
+Bringing a channel up to date is event driven: between two events (register write,
+frame sequencer step, end of frame) each channel jumps from one timer clock to the
+next, and output changes are fed to a per-channel BlipBuffer. When synthesis is off
+(turbo frames nobody hears) the timers are skipped over arithmetically; only the
+state the CPU can observe (length counters, IRQ flags) is kept.
+
+*************************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "blip.h"
+#include "bus.h"
+#include "pacer.h"
+
+class CPU;
+
+class APU : public Device {
+public:
+	static const int kDefaultSampleRate = 44100;
+
+	APU(Region region, Bus* bus, const CPU* cpu);
+	~APU() = default;
+
+	uint8_t read(uint16_t addr) override;
+	void write(uint16_t addr, uint8_t value) override;
+
+	void reset();
+	void setSampleRate(int rate);
+	int getSampleRate() const { return sampleRate; }
+
+	// frames nobody will hear skip synthesis (turbo); state stays exact either way
+	void setSynthesis(bool enabled);
+	bool getSynthesis() const { return synthesis; }
+
+	// runs the APU up to the current CPU cycle and mixes the frame's samples
+	void endFrame();
+	const std::vector<int16_t>& getSamples() const { return samples; } // last frame, mono
+
+	bool irqAsserted(); // frame counter or DMC IRQ, as of the current CPU cycle
+
+	// CPU cycles stolen by DMC sample fetches since the last call (4 per fetch). While
+	// a sample is playing this catches the DMC up to the current cycle first.
+	uint32_t takeDmaStall();
+
+private:
+	struct Write {
+		uint64_t cycle;
+		uint16_t addr;
+		uint8_t value;
+	};
+
+	struct Envelope {
+		bool start;
+		bool loop;      // also halts the length counter
+		bool constant;
+		uint8_t period; // doubles as the constant volume
+		uint8_t divider;
+		uint8_t decay;
+
+		void clock();
+		uint8_t volume() const { return constant ? period : decay; }
+	};
+
+	struct Pulse {
+		bool enabled;
+		bool second;      // pulse 2 negates without the extra -1
+		uint8_t duty;
+		uint8_t step;     // position in the 8-step duty sequence
+		uint16_t period;  // 11-bit timer reload
+		uint8_t length;
+		Envelope envelope;
+		bool sweepEnabled;
+		bool sweepNegate;
+		bool sweepReload;
+		uint8_t sweepPeriod;
+		uint8_t sweepShift;
+		uint8_t sweepDivider;
+
+		uint64_t nextClock; // CPU cycle of the next sequencer step
+		int amp;            // last output fed to the blip buffer
+
+		uint16_t sweepTarget() const;
+		bool muted() const;
+		int output() const;
+	};
+
+	struct Triangle {
+		bool enabled;
+		bool control;     // also halts the length counter
+		uint8_t linearReload;
+		uint8_t linear;
+		bool linearReloadFlag;
+		uint16_t period;
+		uint8_t step;     // position in the 32-step sequence
+		uint8_t length;
+
+		uint64_t nextClock;
+		int amp;
+
+		int output() const;
+	};
+
+	struct Noise {
+		bool enabled;
+		bool mode;        // short (93-step) sequence
+		uint16_t period;  // in CPU cycles
+		uint16_t shift;   // 15-bit LFSR
+		uint8_t length;
+		Envelope envelope;
+
+		uint64_t nextClock;
+		int amp;
+
+		int output() const;
+	};
+
+	struct DMC {
+		bool irqEnabled;
+		bool loop;
+		uint16_t period;   // in CPU cycles
+		uint8_t level;     // 7-bit output
+		uint16_t sampleAddr;
+		uint16_t sampleLength;
+		uint16_t addr;     // current read address
+		uint16_t remaining;
+		uint8_t buffer;
+		bool bufferFull;
+		uint8_t shifter;
+		uint8_t bits;
+		bool silence;
+		bool irq;
+
+		uint64_t nextClock;
+		int amp;
+	};
+
+	void run(uint64_t until);   // applies logged writes and advances channels to `until`
+	void apply(const Write& w);
+	void runPulse(Pulse& pulse, BlipBuffer& blip, uint64_t until);
+	void runTriangle(uint64_t until);
+	void runNoise(uint64_t until);
+	void runDMC(uint64_t until);
+	void fetchDMC();
+	void refresh(uint64_t when); // emits deltas for output changes caused by events
+
+	void resetSequencer(uint64_t when);
+	void clockSequencer();
+	void quarterFrame();
+	void halfFrame();
+
+	void emit(BlipBuffer& blip, int& amp, int value, uint64_t when);
+	void mix(int count);
+
+	Region region;
+	Bus* bus;
+	const CPU* cpu;
+
+	std::vector<Write> log; // register writes not yet applied
+	uint64_t time;          // cycle the channels have been run up to
+	uint64_t frameStart;    // cycle the current blip frame started at
+
+	// frame sequencer
+	bool fiveStep;
+	bool irqInhibit;
+	bool frameIrq;
+	int sequencerStep;
+	uint64_t sequencerStart;
+	uint64_t nextSequencerEvent;
+
+	Pulse pulse1;
+	Pulse pulse2;
+	Triangle triangle;
+	Noise noise;
+	DMC dmc;
+	uint32_t dmaStall; // DMC fetch stalls not yet charged to the CPU
+
+	bool synthesis;
+	int sampleRate;
+	BlipBuffer blips[5]; // pulse1, pulse2, triangle, noise, dmc
+	std::vector<float> channelSamples[5];
+	std::vector<float> mixed;
+	std::vector<int16_t> samples;
+	float highpassPrev;  // DC blocker state
+	float highpassOut;
+
+public:
+	// channel and sequencer state for snapshots between frames. Audio output isn't
+	// part of it: loading keeps what the blip buffers were last fed, so a rollback
+	// continues the waveform instead of jumping.
+	struct State {
+		std::vector<Write> log;
+		uint64_t time;
+		uint64_t frameStart;
+		bool fiveStep;
+		bool irqInhibit;
+		bool frameIrq;
+		int sequencerStep;
+		uint64_t sequencerStart;
+		uint64_t nextSequencerEvent;
+		Pulse pulse1;
+		Pulse pulse2;
+		Triangle triangle;
+		Noise noise;
+		DMC dmc;
+		uint32_t dmaStall;
+	};
+	void saveState(State& state) const;
+	void loadState(const State& state);
+};
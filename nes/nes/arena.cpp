@@ -0,0 +1,101 @@
+/************************************************************************************
+
+Filename    :   arena.cpp
+Content     :   Huge-page backed arena for emulator instances
+Authors     :   Yash Patel
+
+*************************************************************************************/
+
+#include "arena.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace {
+
+size_t roundUp(size_t value, size_t multiple) {
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+} // namespace
+
+InstanceArena::InstanceArena(size_t slotSize, size_t capacity) :
+    base(nullptr),
+    slotSize(roundUp(slotSize, kAlignment)),
+    capacity(capacity),
+    reserved(roundUp(roundUp(slotSize, kAlignment) * capacity, kHugePage)),
+    used(0),
+    live(0),
+    hugePages(false) {
+    if (slotSize == 0 || capacity == 0 || capacity > UINT32_MAX) {
+        throw std::runtime_error("Bad instance arena size");
+    }
+
+#ifdef _WIN32
+    // large pages have to be committed up front; normal pages are committed per slot
+    SIZE_T large = GetLargePageMinimum();
+    if (large != 0 && reserved % large == 0) {
+        base = static_cast<uint8_t*>(VirtualAlloc(NULL, reserved, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+            PAGE_READWRITE));
+        hugePages = base != nullptr;
+    }
+    if (base == nullptr) {
+        base = static_cast<uint8_t*>(VirtualAlloc(NULL, reserved, MEM_RESERVE, PAGE_READWRITE));
+    }
+#else
+    void* block = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    block = mmap(nullptr, reserved, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    hugePages = block != MAP_FAILED;
+#endif
+    if (block == MAP_FAILED) {
+        // no huge pages reserved: ask for transparent ones, which the kernel may or may not give
+        block = mmap(nullptr, reserved, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+#ifdef MADV_HUGEPAGE
+        hugePages = block != MAP_FAILED && madvise(block, reserved, MADV_HUGEPAGE) == 0;
+#endif
+    }
+    base = block != MAP_FAILED ? static_cast<uint8_t*>(block) : nullptr;
+#endif
+    if (base == nullptr) {
+        throw std::bad_alloc();
+    }
+}
+
+InstanceArena::~InstanceArena() {
+#ifdef _WIN32
+    VirtualFree(base, 0, MEM_RELEASE);
+#else
+    munmap(base, reserved);
+#endif
+}
+
+void* InstanceArena::allocate() {
+    size_t index;
+    if (!freeSlots.empty()) {
+        index = freeSlots.back();
+        freeSlots.pop_back();
+    } else if (used < capacity) {
+        index = used++;
+    } else {
+        return nullptr;
+    }
+    uint8_t* slot = base + index * slotSize;
+#ifdef _WIN32
+    if (!hugePages && VirtualAlloc(slot, slotSize, MEM_COMMIT, PAGE_READWRITE) == NULL) {
+        freeSlots.push_back(uint32_t(index));
+        return nullptr;
+    }
+#endif
+    live++;
+    return slot;
+}
+
+void InstanceArena::release(void* slot) {
+    size_t index = size_t(static_cast<uint8_t*>(slot) - base) / slotSize;
+    freeSlots.push_back(uint32_t(index));
+    live--;
+}
@@ -0,0 +1,81 @@
+/************************************************************************************
+
+Filename    :   arena.h
+Content     :   Huge-page backed arena for emulator instances (header)
+Authors     :   Yash Patel
+
+Hosting tens of thousands of consoles makes bytes and TLB entries per instance the
+limit. InstanceArena reserves room for a fixed number of same-sized instances in one
+block of address space, backed by 2 MB pages where the OS provides them: explicit
+huge pages (MAP_HUGETLB, or MEM_LARGE_PAGES on Windows, which needs the "lock pages
+in memory" privilege) if any are available, else transparent huge pages on Linux
+(madvise), else normal pages. Slots are cache-line aligned and packed back to back.
+With normal or transparent huge pages nothing is committed until it's touched, so a
+large reservation only costs what is actually allocated; explicit huge pages are
+taken from the pool when the arena is created (MAP_HUGETLB reserves them at mmap,
+MEM_LARGE_PAGES has to commit them up front), so there the whole capacity is paid
+for whether it's used or not. Size those arenas to what will actually run.
+
+    InstanceArena arena(sizeof(Console), 10000);
+    Console* console = arena.create<Console>(Region::NTSC);
+    ...
+    arena.destroy(console);
+
+Not thread safe: create and destroy instances from one thread (running them on
+others is fine).
+
+*************************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+class InstanceArena {
+public:
+	static const size_t kAlignment = 64;              // a cache line
+	static const size_t kHugePage = 2 * 1024 * 1024;
+
+	InstanceArena(size_t slotSize, size_t capacity);
+	~InstanceArena(); // every instance must have been destroyed
+
+	void* allocate(); // nullptr when full
+	void release(void* slot);
+
+	template <class T, class... Args>
+	T* create(Args&&... args) {
+		if (sizeof(T) > slotSize || alignof(T) > kAlignment) {
+			throw std::runtime_error("Instance doesn't fit the arena's slots");
+		}
+		void* slot = allocate();
+		return slot != nullptr ? ::new (slot) T(std::forward<Args>(args)...) : nullptr;
+	}
+
+	template <class T>
+	void destroy(T* instance) {
+		if (instance != nullptr) {
+			instance->~T();
+			release(instance);
+		}
+	}
+
+	size_t getSlotSize() const { return slotSize; }
+	size_t getCapacity() const { return capacity; }
+	size_t getLive() const { return live; }
+	bool usesHugePages() const { return hugePages; }
+
+private:
+	uint8_t* base;
+	size_t slotSize;  // rounded up to kAlignment
+	size_t capacity;
+	size_t reserved;  // bytes, a multiple of kHugePage
+	size_t used;      // slots handed out at least once
+	size_t live;
+	std::vector<uint32_t> freeSlots; // released, reused first (their pages are warm)
+	bool hugePages;
+};
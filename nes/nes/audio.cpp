@@ -0,0 +1,243 @@
+/************************************************************************************
+
+Filename    :   audio.cpp
+Content     :   Audio output: lock-free sample ring and sinks
+Authors     :   Yash Patel
+
+Rate control follows Near's "Dynamic Rate Control" write-up: with the ring's fill
+level f and target T, each frame is resampled by
+
+    ratio = 1 + kMaxDelta * (T - f) / T       (clamped to 1 +/- kMaxDelta)
+
+so a draining ring is topped up slightly faster than real time and an overfull one
+slightly slower. The sinks here have no hardware clock, so the output thread paces
+itself against the steady clock like a sound card would.
+
+*************************************************************************************/
+
+#include "audio.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+// ring
+
+AudioRing::AudioRing(size_t minCapacity) :
+    head(0),
+    tail(0) {
+    size_t capacity = 1;
+    while (capacity < minCapacity) {
+        capacity <<= 1;
+    }
+    buffer.resize(capacity, 0);
+    mask = capacity - 1;
+}
+
+size_t AudioRing::write(const int16_t* data, size_t count) {
+    size_t h = head.load(std::memory_order_relaxed);
+    size_t t = tail.load(std::memory_order_acquire); // consumer is done with everything before t
+    count = std::min(count, buffer.size() - (h - t));
+
+    size_t first = std::min(count, buffer.size() - (h & mask));
+    std::copy(data, data + first, buffer.begin() + (h & mask));
+    std::copy(data + first, data + count, buffer.begin());
+
+    head.store(h + count, std::memory_order_release); // publishes the samples
+    return count;
+}
+
+size_t AudioRing::read(int16_t* data, size_t count) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    size_t h = head.load(std::memory_order_acquire);
+    count = std::min(count, h - t);
+
+    size_t first = std::min(count, buffer.size() - (t & mask));
+    std::copy(buffer.begin() + (t & mask), buffer.begin() + (t & mask) + first, data);
+    std::copy(buffer.begin(), buffer.begin() + (count - first), data + first);
+
+    tail.store(t + count, std::memory_order_release); // hands the space back
+    return count;
+}
+
+size_t AudioRing::size() const {
+    return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+}
+
+// sinks
+
+void writeWavHeader(FILE* file, int sampleRate, int channels, uint32_t dataBytes) {
+    auto put16 = [file](uint16_t v) { fputc(v & 0xFF, file); fputc(v >> 8, file); };
+    auto put32 = [&put16](uint32_t v) { put16(uint16_t(v)); put16(uint16_t(v >> 16)); };
+
+    fwrite("RIFF", 1, 4, file);
+    put32(36 + dataBytes);
+    fwrite("WAVEfmt ", 1, 8, file);
+    put32(16);                                 // fmt chunk size
+    put16(1);                                  // PCM
+    put16(uint16_t(channels));
+    put32(uint32_t(sampleRate));
+    put32(uint32_t(sampleRate * channels * 2)); // byte rate
+    put16(uint16_t(channels * 2));             // block align
+    put16(16);                                 // bits per sample
+    fwrite("data", 1, 4, file);
+    put32(dataBytes);
+}
+
+WavFileSink::WavFileSink(const std::string& path) :
+    path(path),
+    file(nullptr),
+    sampleRate(0),
+    dataBytes(0) {
+}
+
+WavFileSink::~WavFileSink() {
+    close();
+}
+
+void WavFileSink::open(int rate) {
+    close();
+    sampleRate = rate;
+    dataBytes = 0;
+    file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        std::cerr << "Unable to open " << path << " for writing" << std::endl;
+        return;
+    }
+    writeWavHeader(file, sampleRate, 1, 0);
+}
+
+void WavFileSink::write(const int16_t* samples, size_t count) {
+    if (file == nullptr) {
+        return;
+    }
+    // WAV is little endian, as are all the hosts we build for
+    fwrite(samples, sizeof(int16_t), count, file);
+    dataBytes += uint32_t(count * sizeof(int16_t));
+}
+
+void WavFileSink::close() {
+    if (file == nullptr) {
+        return;
+    }
+    fseek(file, 0, SEEK_SET);
+    writeWavHeader(file, sampleRate, 1, dataBytes);
+    fclose(file);
+    file = nullptr;
+}
+
+// output
+
+AudioOutput::AudioOutput(AudioSink* sink, int sampleRate, int latencyMs) :
+    sink(sink),
+    sampleRate(sampleRate),
+    target(size_t(sampleRate) * latencyMs / 1000),
+    ring(target * 4),
+    running(false),
+    phase(0.0),
+    step(1.0),
+    last(0),
+    pushed(0),
+    dropped(0),
+    played(0),
+    underruns(0) {
+}
+
+AudioOutput::~AudioOutput() {
+    stop();
+}
+
+void AudioOutput::start() {
+    if (running) {
+        return;
+    }
+    sink->open(sampleRate);
+    running = true;
+    thread = std::thread(&AudioOutput::outputLoop, this);
+}
+
+void AudioOutput::stop() {
+    if (!running) {
+        return;
+    }
+    running = false;
+    thread.join();
+    sink->close();
+}
+
+void AudioOutput::push(const int16_t* samples, size_t count) {
+    // steer the fill level with the resampling ratio (see top of file)
+    double error = (double(target) - double(ring.size())) / double(target);
+    double ratio = 1.0 + kMaxDelta * std::max(-1.0, std::min(1.0, error));
+    step = 1.0 / ratio;
+
+    // linear interpolation; at a ratio this close to 1 the error is far below the
+    // band-limited output's own noise floor
+    scratch.clear();
+    for (size_t i = 0; i < count; i++) {
+        int16_t next = samples[i];
+        while (phase < 1.0) {
+            scratch.push_back(int16_t(last + (next - last) * phase));
+            phase += step;
+        }
+        phase -= 1.0;
+        last = next;
+    }
+
+    size_t written = ring.write(scratch.data(), scratch.size());
+    pushed += count;
+    dropped += scratch.size() - written;
+}
+
+void AudioOutput::outputLoop() {
+    typedef std::chrono::steady_clock Clock;
+    const std::chrono::duration<double> period(double(kPeriod) / sampleRate);
+
+    int16_t block[kPeriod];
+    bool primed = false; // stay silent until the ring first reaches its target
+    uint64_t periods = 0;
+    Clock::time_point epoch = Clock::now();
+
+    while (running.load(std::memory_order_relaxed)) {
+        size_t got = 0;
+        if (primed || ring.size() >= target) {
+            primed = true;
+            got = ring.read(block, kPeriod);
+            if (got < size_t(kPeriod)) {
+                underruns.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        std::fill(block + got, block + kPeriod, int16_t(0));
+        sink->write(block, kPeriod);
+        played.fetch_add(kPeriod, std::memory_order_relaxed);
+
+        periods++;
+        std::this_thread::sleep_until(epoch + std::chrono::duration_cast<Clock::duration>(period * double(periods)));
+    }
+}
+
+AudioOutput::Stats AudioOutput::stats() const {
+    Stats stats;
+    stats.pushed = pushed;
+    stats.played = played.load(std::memory_order_relaxed);
+    stats.underruns = underruns.load(std::memory_order_relaxed);
+    stats.dropped = dropped;
+    stats.fill = double(ring.size()) / double(target);
+    stats.ratio = 1.0 / step;
+    return stats;
+}
+
+void AudioOutput::dumpStats() const {
+    Stats s = stats();
+    std::ios::fmtflags flags = std::cout.flags(); // restored below, like FramePacer::dumpStats
+    std::streamsize precision = std::cout.precision();
+    std::cout << "[            Audio              ]" << std::endl;
+    std::cout << "rate    " << sampleRate << " Hz" << std::endl;
+    std::cout << "pushed  " << s.pushed << " (" << s.dropped << " dropped)" << std::endl;
+    std::cout << "played  " << s.played << " (" << s.underruns << " underruns)" << std::endl;
+    std::cout << "fill    " << std::fixed << std::setprecision(3) << s.fill << " of target" << std::endl;
+    std::cout << "ratio   " << std::setprecision(5) << s.ratio << std::endl;
+    std::cout.flags(flags);
+    std::cout.precision(precision);
+}
@@ -0,0 +1,139 @@
+/************************************************************************************
+
+Filename    :   audio.h
+Content     :   Audio output: lock-free sample ring and sinks (header)
+Authors     :   Yash Patel
+
+The emulation thread produces a frame's worth of samples at a time; the output
+thread consumes them in small periods at the sink's own clock. The two only meet in
+AudioRing, a single-producer/single-consumer ring with one atomic index per side, so
+neither ever waits on the other.
+
+The two clocks never agree exactly (frame pacing vs. the sound card's crystal), so
+the producer resamples by a ratio within +/-0.5% of 1 that steers the ring's fill
+level towards its target (dynamic rate control). A pitch change that small is
+inaudible, and the buffer neither drains into underruns nor grows into latency.
+
+*************************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+class AudioRing {
+public:
+	explicit AudioRing(size_t minCapacity); // rounded up to a power of two
+	~AudioRing() = default;
+
+	// producer side; returns how many samples fit
+	size_t write(const int16_t* data, size_t count);
+	// consumer side; returns how many samples were available
+	size_t read(int16_t* data, size_t count);
+
+	size_t size() const; // exact from either side, approximate from anywhere else
+	size_t capacity() const { return buffer.size(); }
+
+private:
+	std::vector<int16_t> buffer;
+	size_t mask;
+
+	// free-running counters, each on its own cache line so the two threads don't
+	// bounce a line between them on every access
+	alignas(64) std::atomic<size_t> head; // next sample to write (producer owned)
+	alignas(64) std::atomic<size_t> tail; // next sample to read (consumer owned)
+};
+
+// where samples end up; write() is called from the output thread only
+class AudioSink {
+public:
+	virtual ~AudioSink() = default;
+	virtual void open(int sampleRate) = 0;
+	virtual void write(const int16_t* samples, size_t count) = 0;
+	virtual void close() {}
+};
+
+// discards everything (headless runs, benchmarks)
+class NullSink : public AudioSink {
+public:
+	void open(int) override {}
+	void write(const int16_t*, size_t) override {}
+};
+
+// mono 16-bit WAV file
+class WavFileSink : public AudioSink {
+public:
+	explicit WavFileSink(const std::string& path);
+	~WavFileSink() override;
+
+	void open(int sampleRate) override;
+	void write(const int16_t* samples, size_t count) override;
+	void close() override; // patches the sizes into the header
+
+private:
+	std::string path;
+	FILE* file;
+	int sampleRate;
+	uint32_t dataBytes;
+};
+
+// writes a 44-byte PCM WAV header (sizes may be 0 and patched later)
+void writeWavHeader(FILE* file, int sampleRate, int channels, uint32_t dataBytes);
+
+class AudioOutput {
+public:
+	struct Stats {
+		uint64_t pushed;     // samples from the emulator
+		uint64_t played;     // samples handed to the sink (including silence)
+		uint64_t underruns;  // periods padded with silence
+		uint64_t dropped;    // samples lost to a full ring
+		double fill;         // ring fill relative to the target latency (1.0 = on target)
+		double ratio;        // current resampling ratio (output / input)
+	};
+
+	// sink isn't owned; latency is the fill level rate control aims for
+	AudioOutput(AudioSink* sink, int sampleRate, int latencyMs = 60);
+	~AudioOutput();
+
+	void start();
+	void stop();
+
+	// emulation thread: queues one frame of samples, resampled by the current ratio
+	void push(const int16_t* samples, size_t count);
+	void push(const std::vector<int16_t>& samples) { push(samples.data(), samples.size()); }
+
+	int getSampleRate() const { return sampleRate; }
+	Stats stats() const; // emulation thread
+	void dumpStats() const;
+
+private:
+	static const int kPeriod = 256;         // samples per sink write (~6 ms at 44.1 kHz)
+	static constexpr double kMaxDelta = 0.005; // max resampling deviation from 1
+
+	void outputLoop();
+
+	AudioSink* sink;
+	int sampleRate;
+	size_t target; // ring fill aimed for, in samples
+	AudioRing ring;
+
+	std::thread thread;
+	std::atomic<bool> running;
+
+	// producer-only resampler state
+	std::vector<int16_t> scratch;
+	double phase;  // position between last and the next input sample
+	double step;   // input samples per output sample
+	int16_t last;
+	uint64_t pushed;
+	uint64_t dropped;
+
+	std::atomic<uint64_t> played;
+	std::atomic<uint64_t> underruns;
+};
@@ -0,0 +1,81 @@
+/************************************************************************************
+
+Filename    :   batchenv.cpp
+Content     :   Batched environment API for driving many consoles at once
+Authors     :   Yash Patel
+
+*************************************************************************************/
+
+#include "batchenv.h"
+
+#include <string.h>
+
+BatchEnv::BatchEnv(int batch, const Loader& loader, int frameSkip, Region region, int threads) :
+    loader(loader),
+    applyAction([](Console& console, uint8_t action) { console.getController(0).setButtons(action); }),
+    frameSkip(frameSkip < 1 ? 1 : frameSkip),
+    arena(sizeof(Console), size_t(batch)),
+    pool(threads),
+    frameTensor(size_t(batch) * kFramePixels, 0),
+    emphasisTensor(size_t(batch) * PPU::kHeight, 0),
+    ramTensor(size_t(batch) * kRamSize, 0),
+    frameCounters(batch, 0) {
+    consoles.reserve(batch);
+    for (int i = 0; i < batch; i++) {
+        consoles.push_back(arena.create<Console>(region));
+        consoles.back()->setTurbo(true); // only frames we observe are rendered
+    }
+}
+
+BatchEnv::~BatchEnv() {
+    for (Console* console : consoles) {
+        arena.destroy(console);
+    }
+}
+
+void BatchEnv::reset() {
+    pool.parallelFor(size(), [this](int i) { resetInstance(i); });
+}
+
+void BatchEnv::reset(const bool* mask) {
+    pool.parallelFor(size(), [this, mask](int i) {
+        if (mask[i]) {
+            resetInstance(i);
+        }
+    });
+}
+
+void BatchEnv::step(const uint8_t* actions) {
+    pool.parallelFor(size(), [this, actions](int i) { runInstance(i, actions[i]); });
+}
+
+void BatchEnv::resetInstance(int index) {
+    Console& console = *consoles[index];
+    if (loader) {
+        loader(console);
+    }
+    console.reset();
+    runInstance(index, 0);
+}
+
+void BatchEnv::runInstance(int index, uint8_t action) {
+    Console& console = *consoles[index];
+    for (int i = 0; i < frameSkip; i++) {
+        if (applyAction) {
+            applyAction(console, action);
+        }
+        if (i == frameSkip - 1) {
+            console.requestRender();
+        }
+        console.runFrame();
+    }
+    observe(index);
+}
+
+void BatchEnv::observe(int index) {
+    Console& console = *consoles[index];
+    memcpy(&frameTensor[size_t(index) * kFramePixels], console.getPPU().getPixels(), kFramePixels);
+    memcpy(&emphasisTensor[size_t(index) * PPU::kHeight], console.getPPU().getEmphasis(), PPU::kHeight);
+    memcpy(&ramTensor[size_t(index) * kRamSize], console.getRam(), kRamSize);
+    frameCounters[index] = console.getFrame();
+}
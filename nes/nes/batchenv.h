@@ -0,0 +1,93 @@
+/************************************************************************************
+
+Filename    :   batchenv.h
+Content     :   Batched environment API for driving many consoles at once (header)
+Authors     :   Yash Patel
+
+A fixed batch of independent consoles stepped in lockstep, in the style of RL vector
+environments:
+
+    BatchEnv env(64, loader);
+    env.reset();
+    while (training) {
+        env.step(actions);          // one action per instance
+        use(env.frames(), env.ram());
+    }
+
+Each step repeats the action for frameSkip frames and only renders the last one
+(the others run headless, see Console::setTurbo). Observations land in contiguous
+buffers allocated once up front, laid out [batch][height][width] palette indices for
+frames (plus [batch][height] emphasis bits) and [batch][2048] for work RAM, so they
+can be wrapped as tensors without copying. Models usually take the indices as they
+are; indicesToARGB (video.h) turns them into colors when needed.
+Instances are spread over a thread pool; each instance is only ever touched by one
+thread at a time. They live side by side in an InstanceArena (arena.h), so a large
+batch sits in a few huge pages instead of thousands of scattered allocations.
+
+*************************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <vector>
+
+#include "arena.h"
+#include "console.h"
+#include "pacer.h"
+#include "ppu.h"
+#include "threadpool.h"
+
+class BatchEnv {
+public:
+	static const int kRamSize = Console::kRamSize;
+	static const int kFramePixels = PPU::kWidth * PPU::kHeight;
+
+	// loads the program into a console before it is reset (called on reset, per instance)
+	typedef std::function<void(Console& console)> Loader;
+	// feeds one instance's action to its console before each frame; by default the
+	// action is the button mask of controller 1
+	typedef std::function<void(Console& console, uint8_t action)> ActionFn;
+
+	BatchEnv(int batch, const Loader& loader, int frameSkip = 4, Region region = Region::NTSC, int threads = 0);
+	~BatchEnv();
+
+	void setActionFn(const ActionFn& fn) { applyAction = fn; }
+
+	// resets every instance (or those with mask[i] set) and observes its first frame
+	void reset();
+	void reset(const bool* mask);
+
+	// actions[batch]: runs frameSkip frames per instance and observes the last
+	void step(const uint8_t* actions);
+
+	int size() const { return int(consoles.size()); }
+	int getFrameSkip() const { return frameSkip; }
+	Console& getConsole(int index) { return *consoles[index]; }
+
+	// contiguous observation tensors, valid until destruction
+	const uint8_t* frames() const { return frameTensor.data(); }      // [batch][240][256]
+	const uint8_t* emphasis() const { return emphasisTensor.data(); } // [batch][240]
+	const uint8_t* ram() const { return ramTensor.data(); }       // [batch][2048]
+	const uint64_t* frameNumbers() const { return frameCounters.data(); } // [batch]
+
+private:
+	void resetInstance(int index);
+	void runInstance(int index, uint8_t action);
+	void observe(int index);
+
+	Loader loader;
+	ActionFn applyAction;
+	int frameSkip;
+
+	InstanceArena arena;
+	std::vector<Console*> consoles; // in the arena
+	ThreadPool pool;
+
+	std::vector<uint8_t> frameTensor;
+	std::vector<uint8_t> emphasisTensor;
+	std::vector<uint8_t> ramTensor;
+	std::vector<uint64_t> frameCounters;
+};
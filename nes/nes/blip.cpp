@@ -0,0 +1,85 @@
+/************************************************************************************
+
+Filename    :   blip.cpp
+Content     :   Band-limited step synthesis buffer
+Authors     :   Yash Patel
+
+*************************************************************************************/
+
+#include "blip.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+namespace {
+
+const double kPi = 3.14159265358979323846;
+const double kCutoff = 0.45; // fraction of the output sample rate kept (Nyquist is 0.5)
+const int kMaxFrameSamples = 4096;
+
+} // namespace
+
+const BlipBuffer::Impulses BlipBuffer::kImpulses;
+
+BlipBuffer::Impulses::Impulses() {
+    // tap k of phase p sits at (k - kTaps/2 + 1 - p/kPhases) samples from the step,
+    // so every delta is delayed by kTaps/2 - 1 samples
+    for (int phase = 0; phase < kPhases; phase++) {
+        double frac = double(phase) / kPhases;
+        double sum = 0.0;
+        double values[kTaps];
+        for (int tap = 0; tap < kTaps; tap++) {
+            double x = tap - kTaps / 2 + 1 - frac;
+            double sinc = (x == 0.0) ? 1.0 : sin(2.0 * kPi * kCutoff * x) / (2.0 * kPi * kCutoff * x);
+            // Blackman window over the kernel's span
+            double w = (x + kTaps / 2) / kTaps;
+            double window = 0.42 - 0.5 * cos(2.0 * kPi * w) + 0.08 * cos(4.0 * kPi * w);
+            values[tap] = sinc * window;
+            sum += values[tap];
+        }
+        // each phase integrates to exactly one, so a step lands at its full height
+        for (int tap = 0; tap < kTaps; tap++) {
+            taps[phase][tap] = float(values[tap] / sum);
+        }
+    }
+}
+
+BlipBuffer::BlipBuffer() :
+    factor(0),
+    offset(0),
+    buffer(kMaxFrameSamples + kTaps, 0.0f),
+    integrator(0.0f) {
+}
+
+void BlipBuffer::setRates(double clockRate, double sampleRate) {
+    factor = uint64_t(sampleRate / clockRate * double(uint64_t(1) << kFracBits) + 0.5);
+    clear();
+}
+
+void BlipBuffer::clear() {
+    offset = 0;
+    integrator = 0.0f;
+    std::fill(buffer.begin(), buffer.end(), 0.0f);
+}
+
+void BlipBuffer::endFrame(uint32_t clocks) {
+    offset += clocks * factor;
+}
+
+int BlipBuffer::readSamples(float* out, int count) {
+    count = std::min(count, samplesAvailable());
+    for (int i = 0; i < count; i++) {
+        integrator += buffer[i];
+        out[i] = integrator;
+    }
+
+    // shift the unread samples (and the tails of impulses past them) to the front
+    size_t remaining = std::min(buffer.size() - count, size_t(samplesAvailable() - count + kTaps));
+    memmove(buffer.data(), buffer.data() + count, remaining * sizeof(float));
+    std::fill(buffer.begin() + remaining, buffer.begin() + std::min(buffer.size(), remaining + count), 0.0f);
+
+    offset -= uint64_t(count) << kFracBits;
+    return count;
+}
@@ -0,0 +1,67 @@
+/************************************************************************************
+
+Filename    :   blip.h
+Content     :   Band-limited step synthesis buffer (header)
+Authors     :   Yash Patel
+
+Sound channels on the NES are square-ish waves whose output only changes at timer
+clocks. Rather than running them at the 1.79 MHz CPU clock and low-pass filtering
+down to 44.1 kHz, we record each *change* in output as a delta at its exact CPU
+clock time. Each delta is spread over a few output samples using a band-limited
+impulse (windowed sinc) picked by the fractional sample position, and the samples
+are integrated when read back. Cost is per output change, not per clock, and the
+result has no aliasing. Same idea as blargg's Blip_Buffer.
+
+*************************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+class BlipBuffer {
+public:
+	static const int kTaps      = 16; // impulse width in output samples
+	static const int kPhaseBits = 6;
+	static const int kPhases    = 1 << kPhaseBits;
+
+	BlipBuffer();
+	~BlipBuffer() = default;
+
+	void setRates(double clockRate, double sampleRate);
+	void clear();
+
+	// output changed by delta at `time` clocks after the start of the current frame
+	void addDelta(uint32_t time, float delta) {
+		uint64_t pos = offset + time * factor;
+		uint32_t index = uint32_t(pos >> kFracBits);
+		if (index + kTaps > buffer.size()) {
+			return; // frame far longer than the buffer was sized for
+		}
+		const float* impulse = kImpulses.taps[(pos >> (kFracBits - kPhaseBits)) & (kPhases - 1)];
+		float* out = &buffer[index];
+		for (int tap = 0; tap < kTaps; tap++) {
+			out[tap] += delta * impulse[tap];
+		}
+	}
+
+	// ends the frame after `clocks` clocks; its samples become readable
+	void endFrame(uint32_t clocks);
+	int samplesAvailable() const { return int(offset >> kFracBits); }
+	int readSamples(float* out, int count);
+
+private:
+	static const int kFracBits = 32; // sample positions are 32.32 fixed point
+
+	struct Impulses {
+		Impulses(); // windowed sinc for each fractional phase, built once at startup
+		float taps[kPhases][kTaps];
+	};
+	static const Impulses kImpulses;
+
+	uint64_t factor;  // output samples per clock, 32.32
+	uint64_t offset;  // position of the current frame's start, 32.32
+	std::vector<float> buffer; // deltas, integrated on read
+	float integrator;
+};
@@ -0,0 +1,140 @@
+/************************************************************************************
+
+Filename    :   bus.cpp
+Content     :   CPU address bus
+Authors     :   Yash Patel
+
+*************************************************************************************/
+
+#include "bus.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+Bus::Bus() : openBus(0), sideEffects(0), mappings(0), observer(nullptr) {
+    for (int i = 0; i < kPageCount; i++) {
+        pages[i].read = nullptr;
+        pages[i].write = nullptr;
+        pages[i].memory = nullptr;
+        pages[i].writable = false;
+        pages[i].device = nullptr;
+        pages[i].block = StateHash::kUntracked;
+        pages[i].pollable = false;
+        pages[i].traps = 0;
+    }
+}
+
+void Bus::mapMemory(uint16_t start, uint16_t end, uint8_t* base, uint32_t size, bool writable) {
+    if ((start & 0xFF) != 0 || (end & 0xFF) != 0xFF || size % kPageSize != 0) {
+        throw std::runtime_error("Bus mappings must be page aligned");
+    }
+
+    for (int page = start >> 8; page <= end >> 8; page++) {
+        pages[page].memory = base + (uint32_t(page - (start >> 8)) * kPageSize) % size;
+        pages[page].writable = writable;
+        pages[page].device = nullptr;
+        pages[page].pollable = false;
+    }
+    // before tracking the new memory, so it takes over the blocks of what it replaced
+    // (the same contents hash the same whichever memory holds them)
+    releaseUnmapped();
+
+    // ROM isn't state, so only writable memory is hashed
+    uint32_t firstBlock = StateHash::kUntracked;
+    if (writable) {
+        firstBlock = stateHash.track(base, size);
+        auto same = [base, size](const Tracked& t) { return t.base == base && t.size == size; };
+        if (std::none_of(tracked.begin(), tracked.end(), same)) {
+            tracked.push_back({ base, size });
+        }
+    }
+
+    for (int page = start >> 8; page <= end >> 8; page++) {
+        uint32_t offset = (uint32_t(page - (start >> 8)) * kPageSize) % size;
+        pages[page].block = writable ? firstBlock + (offset >> StateHash::kBlockShift) : StateHash::kUntracked;
+        updateAccess(pages[page]); // traps survive remapping
+    }
+}
+
+void Bus::mapROM(uint16_t start, uint16_t end, const uint8_t* base, uint32_t size) {
+    // never written through: pages that aren't writable get no write pointer
+    mapMemory(start, end, const_cast<uint8_t*>(base), size, false);
+}
+
+void Bus::mapDevice(uint16_t start, uint16_t end, Device* device) {
+    if ((start & 0xFF) != 0 || (end & 0xFF) != 0xFF) {
+        throw std::runtime_error("Bus mappings must be page aligned");
+    }
+
+    for (int page = start >> 8; page <= end >> 8; page++) {
+        pages[page].memory = nullptr;
+        pages[page].writable = false;
+        pages[page].device = device;
+        pages[page].block = StateHash::kUntracked;
+        pages[page].pollable = false;
+        updateAccess(pages[page]);
+    }
+    releaseUnmapped();
+}
+
+void Bus::releaseUnmapped() {
+    for (size_t i = 0; i < tracked.size();) {
+        const Tracked& region = tracked[i];
+        bool mapped = false;
+        for (int page = 0; page < kPageCount && !mapped; page++) {
+            mapped = pages[page].writable && pages[page].memory >= region.base &&
+                pages[page].memory < region.base + region.size;
+        }
+        if (mapped) {
+            i++;
+        } else {
+            stateHash.untrack(region.base, region.size);
+            tracked.erase(tracked.begin() + i);
+        }
+    }
+}
+
+void Bus::markPollable(uint16_t start, uint16_t end) {
+    for (int page = start >> 8; page <= end >> 8; page++) {
+        pages[page].pollable = pages[page].device != nullptr;
+    }
+}
+
+void Bus::setTraps(uint8_t page, uint8_t traps) {
+    pages[page].traps = traps;
+    updateAccess(pages[page]);
+}
+
+void Bus::updateAccess(Page& page) {
+    page.read = (page.traps & kTrapRead) ? nullptr : page.memory;
+    page.write = (page.writable && !(page.traps & kTrapWrite)) ? page.memory : nullptr;
+    mappings++;
+}
+
+uint8_t Bus::readTrapped(uint16_t addr) {
+    const Page& page = pages[addr >> 8];
+    uint8_t value = openBus;
+    if (page.memory != nullptr) {
+        value = page.memory[addr & 0xFF];
+    } else if (page.device != nullptr) {
+        sideEffects += page.pollable ? 0 : 1;
+        value = page.device->read(addr);
+    }
+    if ((page.traps & kTrapRead) && observer != nullptr) {
+        observer->onAccess(addr, value, false);
+    }
+    return value;
+}
+
+void Bus::writeTrapped(uint16_t addr, uint8_t value) {
+    const Page& page = pages[addr >> 8];
+    if (page.writable) {
+        page.memory[addr & 0xFF] = value;
+        stateHash.markDirty(page.block);
+    } else if (page.device != nullptr) {
+        page.device->write(addr, value);
+    }
+    if ((page.traps & kTrapWrite) && observer != nullptr) {
+        observer->onAccess(addr, value, true);
+    }
+}
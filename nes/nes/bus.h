@@ -0,0 +1,155 @@
+/************************************************************************************
+
+Filename    :   bus.h
+Content     :   CPU address bus (header)
+Authors     :   Yash Patel
+
+The 6502's 64K address space is split into 256 pages of 256 bytes. Each page either
+points straight at backing memory (RAM, ROM, or a mirror of either), in which case a
+read/write is a single indexed load/store, or at a Device that decodes the access
+itself (PPU/APU registers, controllers, mappers). Mirrors cost nothing: the mirrored
+pages simply point into the same backing memory.
+
+Writable memory is tracked by the bus's StateHash: every direct write marks the 256-byte
+block of backing memory it landed in (mirrors mark the same block), which is what lets
+the state hash, delta snapshots and forks only look at memory that actually changed.
+Remapping untracks memory no page points at any more, so what's hashed is always
+what's mapped (and memory can be freed once it's mapped out).
+
+The bus also counts accesses with side effects: every write, and every device read
+except from pages marked pollable (devices whose reads only touch state the caller
+can compare, like the PPU's registers). Idle-loop detection uses the count to prove
+a loop iteration changed nothing.
+
+Debugging uses trap bits on pages. A trapped page loses its direct pointer for the
+trapped kind of access, so the access takes the slow path and the observer (the
+debugger) sees it after it completes. Untrapped pages keep the single indexed
+load/store, so watchpoints cost nothing outside the pages they cover.
+
+*************************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "statehash.h"
+
+// memory-mapped I/O; receives the full 16-bit address so it can decode mirrors
+class Device {
+public:
+	virtual ~Device() = default;
+	virtual uint8_t read(uint16_t addr) = 0;
+	virtual void write(uint16_t addr, uint8_t value) = 0;
+};
+
+// sees every access to a trapped page, after it happened
+class BusObserver {
+public:
+	virtual ~BusObserver() = default;
+	virtual void onAccess(uint16_t addr, uint8_t value, bool write) = 0;
+};
+
+class Bus {
+public:
+	static const int kPageSize  = 256;
+	static const int kPageCount = 256;
+
+	static const uint8_t kTrapRead  = 0x01;
+	static const uint8_t kTrapWrite = 0x02;
+
+	Bus();
+	~Bus() = default;
+
+	// maps [start, end] (page aligned) onto `size` bytes at base, mirrored as needed
+	void mapMemory(uint16_t start, uint16_t end, uint8_t* base, uint32_t size, bool writable);
+	// read-only memory that may be shared (e.g. one cartridge ROM behind many consoles)
+	void mapROM(uint16_t start, uint16_t end, const uint8_t* base, uint32_t size);
+	void mapDevice(uint16_t start, uint16_t end, Device* device);
+	void markPollable(uint16_t start, uint16_t end); // device pages, see top of file
+
+	// traps (kTrapRead | kTrapWrite) for one page; accesses are reported to the observer
+	void setTraps(uint8_t page, uint8_t traps);
+	void setObserver(BusObserver* watcher) { observer = watcher; }
+
+	uint8_t read(uint16_t addr) {
+		const Page& page = pages[addr >> 8];
+		if (page.read != nullptr) {
+			return page.read[addr & 0xFF];
+		}
+		if (page.traps != 0) {
+			return readTrapped(addr);
+		}
+		if (page.device == nullptr) {
+			return openBus;
+		}
+		sideEffects += page.pollable ? 0 : 1;
+		return page.device->read(addr);
+	}
+
+	void write(uint16_t addr, uint8_t value) {
+		sideEffects++;
+		Page& page = pages[addr >> 8];
+		if (page.write != nullptr) {
+			page.write[addr & 0xFF] = value;
+			stateHash.markDirty(page.block);
+		} else if (page.traps != 0) {
+			writeTrapped(addr, value);
+		} else if (page.device != nullptr) {
+			page.device->write(addr, value);
+		}
+		openBus = value;
+	}
+
+	// backing memory of a page, or nullptr if the page is MMIO/unmapped (or read
+	// trapped, so bulk copies go through read() and get seen)
+	const uint8_t* readPage(uint8_t page) const { return pages[page].read; }
+	bool isWritable(uint8_t page) const { return pages[page].writable; }
+	// changes whenever any page's mapping or traps do, so page tables can be cached
+	uint32_t getMappingVersion() const { return mappings; }
+
+	// backing memory of a page regardless of traps, nullptr for MMIO/unmapped (snapshots)
+	uint8_t* pageMemory(uint8_t page) const { return pages[page].memory; }
+
+	// side-effect free read for tools: backing memory, 0 for device/unmapped pages
+	uint8_t peek(uint16_t addr) const {
+		const Page& page = pages[addr >> 8];
+		return page.memory != nullptr ? page.memory[addr & 0xFF] : 0;
+	}
+
+	uint8_t getOpenBus() const { return openBus; }
+	void setOpenBus(uint8_t value) { openBus = value; }
+
+	StateHash& getStateHash() { return stateHash; }
+	uint64_t getSideEffects() const { return sideEffects; }
+
+private:
+	struct Page {
+		uint8_t* read;   // direct backing memory, nullptr for device and read-trapped pages
+		uint8_t* write;  // nullptr for ROM, device and write-trapped pages
+		uint8_t* memory; // backing memory regardless of traps
+		Device* device;  // handles accesses that aren't direct
+		uint32_t block;  // StateHash block of the backing memory (writable pages only)
+		bool writable;
+		bool pollable;   // device reads don't count as side effects
+		uint8_t traps;
+	};
+
+	uint8_t readTrapped(uint16_t addr);
+	void writeTrapped(uint16_t addr, uint8_t value);
+	void updateAccess(Page& page); // fast-path pointers from memory/writable/traps
+	void releaseUnmapped(); // untracks memory no page is mapped to any more
+
+	Page pages[kPageCount];
+	StateHash stateHash;
+	struct Tracked {
+		const uint8_t* base;
+		uint32_t size;
+	};
+	std::vector<Tracked> tracked; // writable memory mapped through this bus
+	uint8_t openBus; // last value driven on the bus, returned for unmapped reads
+	uint64_t sideEffects;
+	uint32_t mappings;
+	BusObserver* observer;
+};
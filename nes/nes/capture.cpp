@@ -0,0 +1,271 @@
+/************************************************************************************
+
+Filename    :   capture.cpp
+Content     :   Video / audio capture to Y4M or raw files
+Authors     :   Yash Patel
+
+*************************************************************************************/
+
+#include "capture.h"
+
+#include <ctype.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#include "console.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const size_t kAudioBlock = 1024;
+const int kAudioSeconds = 2; // audio ring size; a lot more than the frame queue ever holds
+
+} // namespace
+
+Capture::Capture(const std::string& videoPath, Format format, Region region,
+    const std::string& audioPath, int sampleRate, Overflow overflow, size_t queueFrames) :
+    videoPath(videoPath),
+    format(format),
+    overflow(overflow),
+    frameRate(1.0 / FramePacer(region).framePeriod()),
+    video(nullptr),
+    audio(audioPath),
+    hasAudio(!audioPath.empty()),
+    sampleRate(sampleRate),
+    slots(queueFrames < 1 ? 1 : queueFrames),
+    head(0),
+    tail(0),
+    samples(size_t(sampleRate) * kAudioSeconds),
+    running(false),
+    submitted(0),
+    lastSubmitted(0),
+    dropped(0),
+    samplesDropped(0),
+    peakQueue(0),
+    waitSeconds(0.0),
+    current(kFrameBytes, 0),
+    block(kAudioBlock),
+    lastNumber(0),
+    haveFrame(false),
+    converted(0),
+    convertNanos(0),
+    written(0),
+    repeated(0) {
+}
+
+Capture::~Capture() {
+    stop();
+}
+
+void* Capture::operator new(size_t size) {
+    void* instance = nullptr;
+#ifdef _WIN32
+    instance = _aligned_malloc(size, alignof(Capture));
+#else
+    if (posix_memalign(&instance, alignof(Capture), size) != 0) {
+        instance = nullptr;
+    }
+#endif
+    if (instance == nullptr) {
+        throw std::bad_alloc();
+    }
+    return instance;
+}
+
+void Capture::operator delete(void* instance) {
+#ifdef _WIN32
+    _aligned_free(instance);
+#else
+    free(instance);
+#endif
+}
+
+Capture::Format Capture::formatFor(const std::string& path) {
+    size_t dot = path.rfind('.');
+    std::string extension = dot == std::string::npos ? "" : path.substr(dot + 1);
+    for (char& c : extension) {
+        c = char(tolower(c));
+    }
+    return extension == "y4m" ? Format::Y4M : Format::Raw;
+}
+
+bool Capture::start() {
+    if (running) {
+        return true;
+    }
+    video = fopen(videoPath.c_str(), "wb");
+    if (video == nullptr) {
+        std::cerr << "Unable to open " << videoPath << " for writing" << std::endl;
+        return false;
+    }
+    if (format == Format::Y4M) {
+        // NES pixels are 8:7; the rate is exact to a microhertz
+        fprintf(video, "YUV4MPEG2 W%d H%d F%lld:1000000 Ip A8:7 C420jpeg\n",
+            PPU::kWidth, PPU::kHeight, (long long)llround(frameRate * 1000000.0));
+    }
+    if (hasAudio) {
+        audio.open(sampleRate);
+    }
+    running = true;
+    thread = std::thread(&Capture::workerLoop, this);
+    return true;
+}
+
+void Capture::stop() {
+    if (!running) {
+        return;
+    }
+    running = false;
+    thread.join(); // the worker drains everything before it exits
+
+    // frames after the last rendered one still need their place in the video
+    fillTo(lastSubmitted + 1);
+    fclose(video);
+    video = nullptr;
+    if (hasAudio) {
+        audio.close();
+    }
+}
+
+void Capture::submit(Console& console) {
+    submitted++;
+    lastSubmitted = console.getFrame();
+
+    const std::vector<int16_t>& frameSamples = console.getAPU().getSamples();
+    const int16_t* data = frameSamples.data();
+    size_t count = frameSamples.size();
+    if (hasAudio) {
+        size_t done = samples.write(data, count);
+        while (overflow == Overflow::Wait && done < count) {
+            std::this_thread::yield();
+            done += samples.write(data + done, count - done);
+        }
+        samplesDropped += count - done;
+    }
+
+    if (!console.lastFrameRendered()) {
+        return; // the worker repeats the previous image
+    }
+
+    size_t in = head.load(std::memory_order_relaxed);
+    size_t queued = in - tail.load(std::memory_order_acquire);
+    if (queued == slots.size()) {
+        if (overflow == Overflow::Drop) {
+            dropped++;
+            return;
+        }
+        Clock::time_point start = Clock::now();
+        while (in - tail.load(std::memory_order_acquire) == slots.size()) {
+            std::this_thread::yield();
+        }
+        waitSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    Slot& slot = slots[in % slots.size()];
+    slot.number = console.getFrame();
+    memcpy(slot.pixels, console.getPPU().getPixels(), sizeof(slot.pixels));
+    memcpy(slot.emphasis, console.getPPU().getEmphasis(), sizeof(slot.emphasis));
+    head.store(in + 1, std::memory_order_release);
+
+    queued = in + 1 - tail.load(std::memory_order_relaxed);
+    peakQueue = std::max(peakQueue, queued);
+}
+
+void Capture::workerLoop() {
+    while (running.load(std::memory_order_relaxed)) {
+        if (!drain()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+    }
+    while (drain()) {
+        // the producer has stopped; flush what's left
+    }
+}
+
+bool Capture::drain() {
+    bool any = false;
+    if (hasAudio) {
+        size_t got;
+        while ((got = samples.read(block.data(), block.size())) > 0) {
+            audio.write(block.data(), got);
+            any = true;
+        }
+    }
+
+    size_t out = tail.load(std::memory_order_relaxed);
+    while (out != head.load(std::memory_order_acquire)) {
+        const Slot& slot = slots[out % slots.size()];
+        Clock::time_point start = Clock::now();
+        fillTo(slot.number);
+
+        uint8_t* y = current.data();
+        uint8_t* u = y + kPlaneBytes;
+        uint8_t* v = u + kPlaneBytes / 4;
+        indicesToYUV420(slot.pixels, slot.emphasis, PPU::kWidth, PPU::kHeight, palette, y, u, v);
+        lastNumber = slot.number;
+        haveFrame = true;
+        tail.store(++out, std::memory_order_release); // the slot is free again
+        writeFrame();
+
+        convertNanos.fetch_add(uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count()),
+            std::memory_order_relaxed);
+        converted.fetch_add(1, std::memory_order_relaxed);
+        any = true;
+    }
+    return any;
+}
+
+void Capture::writeFrame() {
+    if (format == Format::Y4M) {
+        fputs("FRAME\n", video);
+    }
+    fwrite(current.data(), 1, kFrameBytes, video);
+    written.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Capture::fillTo(uint64_t number) {
+    if (!haveFrame) {
+        return; // nothing to repeat before the first picture
+    }
+    for (uint64_t n = lastNumber + 1; n < number; n++) {
+        writeFrame();
+        repeated.fetch_add(1, std::memory_order_relaxed);
+    }
+    lastNumber = std::max(lastNumber, number - 1);
+}
+
+Capture::Stats Capture::stats() const {
+    Stats s;
+    s.submitted = submitted;
+    s.written = written.load(std::memory_order_relaxed);
+    s.repeated = repeated.load(std::memory_order_relaxed);
+    s.dropped = dropped;
+    s.samplesDropped = samplesDropped;
+    s.peakQueue = peakQueue;
+    s.waitMs = waitSeconds * 1000.0;
+    uint64_t frames = converted.load(std::memory_order_relaxed);
+    s.convertMs = frames == 0 ? 0.0 : convertNanos.load(std::memory_order_relaxed) / 1e6 / double(frames);
+    return s;
+}
+
+void Capture::dumpStats() const {
+    Stats s = stats();
+    std::cout << "capture " << s.written << " frames written (" << s.repeated << " repeated) of "
+        << s.submitted << " submitted" << std::endl;
+    std::cout << "        " << s.dropped << " dropped, peak queue " << s.peakQueue << "/" << slots.size()
+        << ", waited " << s.waitMs << " ms, " << s.convertMs << " ms per frame" << std::endl;
+    if (hasAudio) {
+        std::cout << "        " << s.samplesDropped << " samples dropped" << std::endl;
+    }
+}
@@ -0,0 +1,142 @@
+/************************************************************************************
+
+Filename    :   capture.h
+Content     :   Video / audio capture to Y4M or raw files (header)
+Authors     :   Yash Patel
+
+Capture is fed from the emulation thread (typically as an EmuThread frame hook) and
+does all the expensive work on its own thread. submit() only copies the frame's
+palette indices into a slot of a bounded single-producer/single-consumer queue and
+the frame's samples into an AudioRing; the worker converts the indices to YUV 4:2:0
+(see video.h), writes them to a Y4M or raw I420 file and appends the audio to a WAV
+file. No external encoder is involved, so it works the same in headless runs.
+
+When the worker can't keep up, the queue fills. With Overflow::Drop the emulator is
+never held up: the frame is dropped and counted, and the worker repeats the previous
+image in its place, so the video keeps one picture per console frame and stays in
+sync with the audio. With Overflow::Wait (offline captures, where completeness
+matters more than speed) submit() waits for a free slot and the time spent waiting
+is reported instead. Frames the console didn't render (frame skip, turbo) are
+repeated the same way; only frames before the first rendered one have nothing to
+repeat and are left out.
+
+*************************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "audio.h"
+#include "pacer.h"
+#include "ppu.h"
+#include "video.h"
+
+class Console;
+
+class Capture {
+public:
+	enum class Format {
+		Y4M, // YUV4MPEG2 stream, playable as is
+		Raw  // bare I420 planes, one frame after the other
+	};
+
+	enum class Overflow {
+		Drop, // never block the emulator
+		Wait  // never lose a frame
+	};
+
+	struct Stats {
+		uint64_t submitted;      // frames handed to submit()
+		uint64_t written;        // frames in the file, repeats included
+		uint64_t repeated;       // frames filled in with the previous image
+		uint64_t dropped;        // frames lost to a full queue (Drop)
+		uint64_t samplesDropped; // samples lost to a full audio ring (Drop)
+		size_t peakQueue;        // deepest the frame queue got
+		double waitMs;           // time submit() spent blocked (Wait)
+		double convertMs;        // worker time per converted frame (conversion + write)
+	};
+
+	// audioPath may be empty for video only; queueFrames is the bound on frames in flight
+	Capture(const std::string& videoPath, Format format, Region region,
+		const std::string& audioPath, int sampleRate,
+		Overflow overflow = Overflow::Drop, size_t queueFrames = 8);
+	~Capture();
+
+	// the queue indices sit on cache lines of their own; pre-C++17 new doesn't align that
+	static void* operator new(size_t size);
+	static void operator delete(void* instance);
+
+	void setPalette(const Palette& colors) { palette = colors; } // before start()
+
+	bool start(); // false if the video file can't be created
+	void stop();  // once submit() is no longer called: drains the queue, finalizes the files
+
+	// emulation thread, after each frame
+	void submit(Console& console);
+
+	Stats stats() const; // emulation thread, or after stop()
+	void dumpStats() const;
+
+	static Format formatFor(const std::string& path); // .y4m, anything else is raw
+
+private:
+	struct Slot {
+		uint64_t number; // console frame counter
+		uint8_t pixels[PPU::kWidth * PPU::kHeight];
+		uint8_t emphasis[PPU::kHeight];
+	};
+
+	static const size_t kPlaneBytes = PPU::kWidth * PPU::kHeight;
+	static const size_t kFrameBytes = kPlaneBytes * 3 / 2;
+
+	void workerLoop();
+	bool drain(); // writes whatever is queued; false if nothing was
+	void writeFrame();
+	void fillTo(uint64_t number); // repeats the current image up to (excluding) number
+
+	std::string videoPath;
+	Format format;
+	Overflow overflow;
+	double frameRate;
+	Palette palette;
+
+	FILE* video;
+	WavFileSink audio;
+	bool hasAudio;
+	int sampleRate;
+
+	// frame queue (same scheme as AudioRing: free-running counters, one per side)
+	std::vector<Slot> slots;
+	alignas(64) std::atomic<size_t> head; // next slot to fill (producer owned)
+	alignas(64) std::atomic<size_t> tail; // next slot to write out (worker owned)
+	AudioRing samples;
+
+	std::thread thread;
+	std::atomic<bool> running;
+
+	// producer-only
+	uint64_t submitted;
+	uint64_t lastSubmitted; // frame number, so stop() can pad the tail
+	uint64_t dropped;
+	uint64_t samplesDropped;
+	size_t peakQueue;
+	double waitSeconds;
+
+	// worker-only
+	std::vector<uint8_t> current;  // last frame written, YUV
+	std::vector<int16_t> block;
+	uint64_t lastNumber;
+	bool haveFrame;
+
+	std::atomic<uint64_t> converted;
+	std::atomic<uint64_t> convertNanos;
+	std::atomic<uint64_t> written;
+	std::atomic<uint64_t> repeated;
+};
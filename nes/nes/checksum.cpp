@@ -0,0 +1,249 @@
+/************************************************************************************
+
+Filename    :   checksum.cpp
+Content     :   CRC32 and SHA-1 for identifying ROMs
+Authors     :   Yash Patel
+
+*************************************************************************************/
+
+#include "checksum.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "cpufeatures.h"
+
+#ifdef NES_X86
+#define NES_CRC_PCLMUL 1
+#include <smmintrin.h>
+#include <wmmintrin.h>
+#endif
+
+namespace {
+
+const uint32_t kPolynomial = 0xEDB88320; // reflected 0x04C11DB7
+
+struct CrcTable {
+    uint32_t entries[256];
+
+    CrcTable() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int bit = 0; bit < 8; bit++) {
+                c = (c & 1) ? (c >> 1) ^ kPolynomial : c >> 1;
+            }
+            entries[i] = c;
+        }
+    }
+};
+
+const CrcTable kCrcTable;
+
+// on the inverted register, so the folding path can hand over its remainder
+uint32_t crcBytes(uint32_t c, const uint8_t* data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        c = kCrcTable.entries[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+    }
+    return c;
+}
+
+#ifdef NES_CRC_PCLMUL
+// Folds 64-byte blocks four lanes at a time, then down to 128 and 32 bits with a
+// Barrett reduction ("Fast CRC Computation for Generic Polynomials Using PCLMULQDQ",
+// Gopal et al.). Constants are x^n mod P for the bit-reflected polynomial. Needs at
+// least 64 bytes and a multiple of 16; the caller does the rest with the table.
+NES_TARGET("pclmul,sse4.1") uint32_t crcFold(uint32_t c, const uint8_t* data, size_t size) {
+    const __m128i k1k2 = _mm_set_epi64x(0x01C6E41596, 0x0154442BD4);
+    const __m128i k3k4 = _mm_set_epi64x(0x00CCAA009E, 0x01751997D0);
+    const __m128i k5k0 = _mm_set_epi64x(0x0000000000, 0x0163CD6124);
+    const __m128i poly = _mm_set_epi64x(0x01F7011641, 0x01DB710641);
+    const __m128i low32 = _mm_setr_epi32(~0, 0, ~0, 0);
+
+    __m128i x1 = _mm_loadu_si128((const __m128i*)(data + 0x00));
+    __m128i x2 = _mm_loadu_si128((const __m128i*)(data + 0x10));
+    __m128i x3 = _mm_loadu_si128((const __m128i*)(data + 0x20));
+    __m128i x4 = _mm_loadu_si128((const __m128i*)(data + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(int(c)));
+    data += 64;
+    size -= 64;
+
+    for (; size >= 64; data += 64, size -= 64) {
+        __m128i x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+        __m128i x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+        __m128i x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+        __m128i x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+        x1 = _mm_xor_si128(_mm_clmulepi64_si128(x1, k1k2, 0x11), x5);
+        x2 = _mm_xor_si128(_mm_clmulepi64_si128(x2, k1k2, 0x11), x6);
+        x3 = _mm_xor_si128(_mm_clmulepi64_si128(x3, k1k2, 0x11), x7);
+        x4 = _mm_xor_si128(_mm_clmulepi64_si128(x4, k1k2, 0x11), x8);
+        x1 = _mm_xor_si128(x1, _mm_loadu_si128((const __m128i*)(data + 0x00)));
+        x2 = _mm_xor_si128(x2, _mm_loadu_si128((const __m128i*)(data + 0x10)));
+        x3 = _mm_xor_si128(x3, _mm_loadu_si128((const __m128i*)(data + 0x20)));
+        x4 = _mm_xor_si128(x4, _mm_loadu_si128((const __m128i*)(data + 0x30)));
+    }
+
+    // four lanes into one
+    __m128i lanes[3] = { x2, x3, x4 };
+    for (const __m128i& lane : lanes) {
+        __m128i x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, lane), x5);
+    }
+    for (; size >= 16; data += 16, size -= 16) {
+        __m128i x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128((const __m128i*)data)), x5);
+    }
+
+    // 128 -> 64 bits
+    x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, low32);
+    x1 = _mm_xor_si128(_mm_clmulepi64_si128(x1, k5k0, 0x00), x2);
+
+    // Barrett reduction to 32 bits
+    x2 = _mm_and_si128(x1, low32);
+    x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+    x2 = _mm_and_si128(x2, low32);
+    x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    return uint32_t(_mm_extract_epi32(x1, 1));
+}
+#endif
+
+} // namespace
+
+uint32_t crc32Table(const uint8_t* data, size_t size, uint32_t crc) {
+    return ~crcBytes(~crc, data, size);
+}
+
+uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc) {
+    uint32_t c = ~crc;
+#ifdef NES_CRC_PCLMUL
+    if (size >= 64 && cpuFeatures().pclmul && cpuFeatures().sse41) {
+        size_t folded = size & ~size_t(15);
+        c = crcFold(c, data, folded);
+        data += folded;
+        size -= folded;
+    }
+#endif
+    return ~crcBytes(c, data, size);
+}
+
+// SHA-1
+
+namespace {
+
+uint32_t rotl(uint32_t x, int n) {
+    return (x << n) | (x >> (32 - n));
+}
+
+} // namespace
+
+std::string Sha1Digest::hex() const {
+    char text[41];
+    for (int i = 0; i < 20; i++) {
+        snprintf(text + i * 2, 3, "%02x", bytes[i]);
+    }
+    return std::string(text, 40);
+}
+
+bool Sha1Digest::parse(const std::string& text) {
+    if (text.size() != 40) {
+        return false;
+    }
+    for (int i = 0; i < 20; i++) {
+        unsigned value = 0;
+        if (sscanf(text.c_str() + i * 2, "%2x", &value) != 1) {
+            return false;
+        }
+        bytes[i] = uint8_t(value);
+    }
+    return true;
+}
+
+bool Sha1Digest::operator==(const Sha1Digest& other) const {
+    return memcmp(bytes, other.bytes, sizeof(bytes)) == 0;
+}
+
+Sha1::Sha1() :
+    buffered(0),
+    length(0) {
+    state[0] = 0x67452301;
+    state[1] = 0xEFCDAB89;
+    state[2] = 0x98BADCFE;
+    state[3] = 0x10325476;
+    state[4] = 0xC3D2E1F0;
+}
+
+void Sha1::block(const uint8_t* data) {
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (uint32_t(data[i * 4]) << 24) | (uint32_t(data[i * 4 + 1]) << 16) |
+            (uint32_t(data[i * 4 + 2]) << 8) | uint32_t(data[i * 4 + 3]);
+    }
+    for (int i = 16; i < 80; i++) {
+        w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+    for (int i = 0; i < 80; i++) {
+        uint32_t f, k;
+        if (i < 20)      { f = (b & c) | (~b & d);          k = 0x5A827999; }
+        else if (i < 40) { f = b ^ c ^ d;                   k = 0x6ED9EBA1; }
+        else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+        else             { f = b ^ c ^ d;                   k = 0xCA62C1D6; }
+        uint32_t t = rotl(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = rotl(b, 30);
+        b = a;
+        a = t;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+void Sha1::update(const uint8_t* data, size_t size) {
+    length += size;
+    if (buffered > 0) {
+        size_t take = size < 64 - buffered ? size : 64 - buffered;
+        memcpy(buffer + buffered, data, take);
+        buffered += take;
+        data += take;
+        size -= take;
+        if (buffered < 64) {
+            return;
+        }
+        block(buffer);
+        buffered = 0;
+    }
+    for (; size >= 64; data += 64, size -= 64) {
+        block(data);
+    }
+    memcpy(buffer, data, size);
+    buffered = size;
+}
+
+Sha1Digest Sha1::finish() {
+    uint64_t bits = length * 8;
+    uint8_t pad[72] = { 0x80 };
+    size_t padding = (buffered < 56 ? 56 : 120) - buffered;
+    for (int i = 0; i < 8; i++) {
+        pad[padding + i] = uint8_t(bits >> (56 - i * 8));
+    }
+    update(pad, padding + 8);
+
+    Sha1Digest digest;
+    for (int i = 0; i < 5; i++) {
+        digest.bytes[i * 4]     = uint8_t(state[i] >> 24);
+        digest.bytes[i * 4 + 1] = uint8_t(state[i] >> 16);
+        digest.bytes[i * 4 + 2] = uint8_t(state[i] >> 8);
+        digest.bytes[i * 4 + 3] = uint8_t(state[i]);
+    }
+    return digest;
+}
@@ -0,0 +1,49 @@
+/************************************************************************************
+
+Filename    :   checksum.h
+Content     :   CRC32 and SHA-1 for identifying ROMs (header)
+Authors     :   Yash Patel
+
+ROM databases key cartridges by the CRC32 (zlib / PNG polynomial) and SHA-1 of their
+PRG+CHR data. CRC32 folds 64 bytes at a time with carry-less multiplies on x86 CPUs
+with PCLMUL and SSE4.1 (checked at run time, see cpufeatures.h), and uses a table
+otherwise; the two produce identical results. SHA-1 is plain C++.
+
+*************************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+// continues `crc` (0 to start) over data, like zlib's crc32()
+uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0);
+uint32_t crc32Table(const uint8_t* data, size_t size, uint32_t crc = 0); // the portable path
+
+struct Sha1Digest {
+	uint8_t bytes[20];
+
+	std::string hex() const;
+	bool parse(const std::string& text); // 40 hex digits
+	bool operator==(const Sha1Digest& other) const;
+	bool operator!=(const Sha1Digest& other) const { return !(*this == other); }
+};
+
+class Sha1 {
+public:
+	Sha1();
+	~Sha1() = default;
+
+	void update(const uint8_t* data, size_t size);
+	Sha1Digest finish(); // no more updates after this
+
+private:
+	void block(const uint8_t* data);
+
+	uint32_t state[5];
+	uint8_t buffer[64];
+	size_t buffered;
+	uint64_t length; // bytes so far
+};
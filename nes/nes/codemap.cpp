@@ -0,0 +1,346 @@
+/************************************************************************************
+
+Filename    :   codemap.cpp
+Content     :   Static code-flow analysis of a program image
+Authors     :   Yash Patel
+
+*************************************************************************************/
+
+#include "codemap.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "disasm.h"
+#include "statehash.h"
+
+namespace {
+
+struct Vector {
+    uint16_t addr;
+    const char* name;
+};
+
+const Vector kVectors[] = {
+    { 0xFFFC, "reset" },
+    { 0xFFFA, "nmi" },
+    { 0xFFFE, "irq" },
+};
+
+const int kFileVersion = 1;
+
+} // namespace
+
+CodeMap::CodeMap() :
+    base(0),
+    imageHash(0) {
+}
+
+uint64_t CodeMap::hashImage(const uint8_t* image, size_t size) {
+    return hashBytes(image, size, 0xC0DE);
+}
+
+void CodeMap::reset(const uint8_t* image, uint16_t imageBase, size_t size) {
+    bytes.assign(image, image + size);
+    base = imageBase;
+    imageHash = hashImage(image, size);
+    flags.assign(size, 0);
+    routines.clear();
+    indirectJumps.clear();
+}
+
+uint8_t CodeMap::flagsAt(uint16_t addr) const {
+    return contains(addr) ? flags[addr - base] : 0;
+}
+
+size_t CodeMap::codeBytes() const {
+    return size_t(std::count_if(flags.begin(), flags.end(),
+        [](uint8_t f) { return (f & (kOpcode | kOperand)) != 0; }));
+}
+
+void CodeMap::addRoutine(uint16_t addr, const char* vector) {
+    Routine& routine = routines[addr];
+    routine.addr = addr;
+    if (vector != nullptr) {
+        routine.vector = vector;
+    } else {
+        routine.calls++;
+    }
+    if (contains(addr)) {
+        flags[addr - base] |= kRoutine;
+    }
+}
+
+void CodeMap::markInstruction(uint32_t addr, int length) {
+    flags[addr - base] = uint8_t((flags[addr - base] & ~kData) | kOpcode);
+    for (int i = 1; i < length; i++) {
+        flags[addr + i - base] = uint8_t((flags[addr + i - base] & ~kData) | kOperand);
+    }
+}
+
+void CodeMap::analyze(const uint8_t* image, uint16_t imageBase, size_t size, const std::vector<uint16_t>& entries) {
+    reset(image, imageBase, size);
+
+    std::vector<uint16_t> pending; // worklist instead of recursion, so deep call graphs are fine
+    for (const Vector& vector : kVectors) {
+        if (!contains(vector.addr) || !contains(vector.addr + 1u)) {
+            continue;
+        }
+        flags[vector.addr - base] |= kData;
+        flags[vector.addr + 1 - base] |= kData;
+        uint16_t target = uint16_t(byteAt(vector.addr) | (byteAt(vector.addr + 1u) << 8));
+        addRoutine(target, vector.name);
+        pending.push_back(target);
+    }
+    for (uint16_t entry : entries) {
+        addRoutine(entry, nullptr);
+        pending.push_back(entry);
+    }
+
+    std::vector<uint16_t> dataRefs;
+    while (!pending.empty()) {
+        uint32_t pc = pending.back();
+        pending.pop_back();
+
+        // sweep forward until the path ends or runs into code we've already seen
+        while (contains(pc) && !(flags[pc - base] & kOpcode)) {
+            const OpcodeInfo& info = opcodeInfo(byteAt(pc));
+            int length = info.length();
+            if (!info.valid() || !contains(pc + length - 1)) {
+                break;
+            }
+            markInstruction(pc, length);
+
+            uint16_t operand = uint16_t(byteAt(pc + 1) | (byteAt(pc + 2) << 8));
+            if (info.flow & OpcodeInfo::kBranch) {
+                uint16_t target = branchTarget(uint16_t(pc), byteAt(pc + 1));
+                if (contains(target)) {
+                    flags[target - base] |= kLabel;
+                }
+                pending.push_back(target);
+            } else if (info.flow & OpcodeInfo::kCall) {
+                addRoutine(operand, nullptr);
+                pending.push_back(operand);
+            } else if (info.flow & OpcodeInfo::kJump) {
+                if (info.mode == OpcodeInfo::Mode::Indirect) {
+                    indirectJumps.push_back(uint16_t(pc));
+                } else {
+                    if (contains(operand)) {
+                        flags[operand - base] |= kLabel;
+                    }
+                    pending.push_back(operand);
+                }
+                break;
+            } else if (info.flow & (OpcodeInfo::kReturn | OpcodeInfo::kStop)) {
+                break;
+            } else if (info.mode == OpcodeInfo::Mode::Absolute || info.mode == OpcodeInfo::Mode::AbsoluteX ||
+                info.mode == OpcodeInfo::Mode::AbsoluteY) {
+                dataRefs.push_back(operand);
+            }
+            pc += length;
+        }
+    }
+
+    for (uint16_t ref : dataRefs) {
+        if (contains(ref) && !(flags[ref - base] & (kOpcode | kOperand))) {
+            flags[ref - base] |= kData;
+        }
+    }
+    std::sort(indirectJumps.begin(), indirectJumps.end());
+    indirectJumps.erase(std::unique(indirectJumps.begin(), indirectJumps.end()), indirectJumps.end());
+}
+
+std::vector<uint16_t> CodeMap::hotEntries(size_t count) const {
+    std::vector<Routine> ranked;
+    for (const auto& entry : routines) {
+        ranked.push_back(entry.second);
+    }
+    std::stable_sort(ranked.begin(), ranked.end(), [](const Routine& a, const Routine& b) {
+        if ((a.vector != nullptr) != (b.vector != nullptr)) {
+            return a.vector != nullptr;
+        }
+        return a.calls > b.calls;
+    });
+
+    std::vector<uint16_t> hot;
+    for (size_t i = 0; i < ranked.size() && i < count; i++) {
+        hot.push_back(ranked[i].addr);
+    }
+    return hot;
+}
+
+std::string CodeMap::listing() const {
+    std::string out;
+    char line[96];
+    uint32_t end = base + uint32_t(flags.size());
+    for (uint32_t addr = base; addr < end; ) {
+        uint8_t f = flags[addr - base];
+        if (f & kOpcode) {
+            auto routine = routines.find(uint16_t(addr));
+            if (routine != routines.end()) {
+                if (routine->second.vector != nullptr) {
+                    snprintf(line, sizeof(line), "\n%04X:          ; %s\n", addr, routine->second.vector);
+                } else {
+                    snprintf(line, sizeof(line), "\n%04X:          ; called from %u site(s)\n", addr, routine->second.calls);
+                }
+                out += line;
+            } else if (f & kLabel) {
+                snprintf(line, sizeof(line), "%04X:\n", addr);
+                out += line;
+            }
+
+            uint8_t instruction[3] = { byteAt(addr), byteAt(addr + 1), byteAt(addr + 2) };
+            int length = opcodeInfo(instruction[0]).length();
+            char raw[12] = "";
+            for (int i = 0; i < length; i++) {
+                snprintf(raw + i * 3, sizeof(raw) - i * 3, "%02X ", instruction[i]);
+            }
+            snprintf(line, sizeof(line), "    %04X  %-9s %s\n", addr, raw, disassemble(uint16_t(addr), instruction).c_str());
+            out += line;
+            addr += length;
+        } else if (f & kData) {
+            uint32_t start = addr;
+            while (addr < end && (flags[addr - base] & kData) && !(flags[addr - base] & kOpcode)) {
+                addr++;
+            }
+            snprintf(line, sizeof(line), "    %04X  .data %u byte(s)\n", start, addr - start);
+            out += line;
+        } else {
+            addr++;
+        }
+    }
+    return out;
+}
+
+// file
+
+bool CodeMap::save(const std::string& path) const {
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        return false;
+    }
+    fprintf(file, "NESCODEMAP %d\n", kFileVersion);
+    fprintf(file, "image %X %X %llX\n", base, unsigned(flags.size()), (unsigned long long)imageHash);
+
+    uint32_t end = base + uint32_t(flags.size());
+    for (uint32_t addr = base; addr < end; ) {
+        uint8_t f = flags[addr - base];
+        if (f & kOpcode) {
+            // a run continues while the next instruction starts right after this one
+            uint32_t start = addr;
+            uint32_t last = addr;
+            while (addr < end && (flags[addr - base] & kOpcode)) {
+                last = addr;
+                addr += opcodeInfo(bytes[addr - base]).length();
+            }
+            fprintf(file, "code %X %X\n", start, last);
+        } else if ((f & kData) && !(f & kOperand)) {
+            uint32_t start = addr;
+            while (addr < end && (flags[addr - base] & (kData | kOpcode | kOperand)) == kData) {
+                addr++;
+            }
+            fprintf(file, "data %X %X\n", start, addr - 1);
+        } else {
+            addr++;
+        }
+    }
+    for (const auto& entry : routines) {
+        const Routine& routine = entry.second;
+        fprintf(file, "routine %X %X%s%s\n", routine.addr, routine.calls,
+            routine.vector != nullptr ? " " : "", routine.vector != nullptr ? routine.vector : "");
+    }
+    for (uint32_t addr = base; addr < end; addr++) {
+        if (flags[addr - base] & kLabel) {
+            fprintf(file, "label %X\n", addr);
+        }
+    }
+    for (uint16_t site : indirectJumps) {
+        fprintf(file, "indirect %X\n", site);
+    }
+
+    bool ok = ferror(file) == 0;
+    fclose(file);
+    return ok;
+}
+
+bool CodeMap::load(const std::string& path, const uint8_t* image, uint16_t imageBase, size_t size) {
+    FILE* file = fopen(path.c_str(), "r");
+    if (file == nullptr) {
+        return false;
+    }
+
+    int version = 0;
+    unsigned fileBase = 0, fileSize = 0;
+    unsigned long long fileHash = 0;
+    bool ok = fscanf(file, "NESCODEMAP %d image %X %X %llX", &version, &fileBase, &fileSize, &fileHash) == 4 &&
+        version == kFileVersion && fileBase == imageBase && fileSize == size &&
+        fileHash == hashImage(image, size);
+    if (ok) {
+        reset(image, imageBase, size);
+    }
+
+    char keyword[16];
+    while (ok && fscanf(file, "%15s", keyword) == 1) {
+        unsigned a = 0, b = 0;
+        if (strcmp(keyword, "code") == 0 || strcmp(keyword, "data") == 0) {
+            ok = fscanf(file, "%X %X", &a, &b) == 2 && contains(a) && contains(b) && a <= b;
+            bool code = keyword[0] == 'c';
+            for (uint32_t addr = a; ok && addr <= b; ) {
+                if (!code) {
+                    flags[addr++ - base] |= kData;
+                    continue;
+                }
+                int length = opcodeInfo(bytes[addr - base]).length();
+                ok = contains(addr + length - 1);
+                if (ok) {
+                    markInstruction(addr, length);
+                    addr += length;
+                }
+            }
+        } else if (strcmp(keyword, "routine") == 0) {
+            ok = fscanf(file, "%X %X", &a, &b) == 2;
+            Routine& routine = routines[uint16_t(a)];
+            routine.addr = uint16_t(a);
+            routine.calls = b;
+            // an optional vector name follows on the same line
+            int c = fgetc(file);
+            if (c == ' ') {
+                char name[16] = "";
+                ok = ok && fscanf(file, "%15s", name) == 1;
+                for (const Vector& vector : kVectors) {
+                    if (strcmp(name, vector.name) == 0) {
+                        routine.vector = vector.name;
+                    }
+                }
+            }
+            if (contains(a)) {
+                flags[a - base] |= kRoutine;
+            }
+        } else if (strcmp(keyword, "label") == 0) {
+            ok = fscanf(file, "%X", &a) == 1 && contains(a);
+            if (ok) {
+                flags[a - base] |= kLabel;
+            }
+        } else if (strcmp(keyword, "indirect") == 0) {
+            ok = fscanf(file, "%X", &a) == 1;
+            indirectJumps.push_back(uint16_t(a));
+        } else {
+            ok = false;
+        }
+    }
+    fclose(file);
+    if (!ok) {
+        reset(image, imageBase, size); // don't leave half a map behind
+    }
+    return ok;
+}
+
+bool CodeMap::analyzeCached(const std::string& path, const uint8_t* image, uint16_t imageBase, size_t size) {
+    if (load(path, image, imageBase, size)) {
+        return true;
+    }
+    analyze(image, imageBase, size);
+    return save(path);
+}
@@ -0,0 +1,103 @@
+/************************************************************************************
+
+Filename    :   codemap.h
+Content     :   Static code-flow analysis of a program image (header)
+Authors     :   Yash Patel
+
+Separates code from data in a program image by following control flow, starting at
+the reset/NMI/IRQ vectors (when the image covers $FFFA-$FFFF) and any extra entry
+points. Every reachable instruction is decoded with the opcode table (disasm.h); a
+branch continues at both its target and the next instruction, JMP only at its
+target, JSR at both (the callee is recorded as a routine), and RTS/RTI/BRK end the
+path, as do unofficial opcodes and addresses outside the image. Targets of indirect
+jumps aren't known statically; those sites are listed instead. Absolute operands
+of loads/stores that land in the image and aren't code are marked as data.
+
+The image is whatever is mapped at `base`: a PRG bank, or the console's whole
+address space (which is how this tree loads programs today).
+
+The result can be saved to and loaded from a small text file, keyed by a hash of
+the image, so a program is analyzed once and the map reused on later runs:
+
+    NESCODEMAP 1
+    image <base> <size> <hash>
+    code <start> <end>          instructions decode back to back from start
+    data <start> <end>
+    routine <addr> <calls> [reset|nmi|irq]
+    label <addr>                branch / jump target
+    indirect <addr>             JMP ($xxxx) site
+
+(all numbers hex)
+
+*************************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+class CodeMap {
+public:
+	// per-byte classification
+	static const uint8_t kOpcode  = 0x01; // first byte of an instruction
+	static const uint8_t kOperand = 0x02;
+	static const uint8_t kData    = 0x04;
+	static const uint8_t kLabel   = 0x08; // branch / jump target
+	static const uint8_t kRoutine = 0x10; // JSR target or vector
+
+	struct Routine {
+		uint16_t addr;
+		uint32_t calls;   // JSR sites calling it
+		const char* vector; // "reset", "nmi", "irq" or nullptr
+	};
+
+	CodeMap();
+	~CodeMap() = default;
+
+	void analyze(const uint8_t* image, uint16_t base, size_t size,
+		const std::vector<uint16_t>& entries = std::vector<uint16_t>());
+
+	// loads a saved map if it was made from this image, otherwise analyzes and saves it
+	bool analyzeCached(const std::string& path, const uint8_t* image, uint16_t base, size_t size);
+
+	bool save(const std::string& path) const;
+	// false if missing, malformed or made from a different image
+	bool load(const std::string& path, const uint8_t* image, uint16_t base, size_t size);
+
+	static uint64_t hashImage(const uint8_t* image, size_t size);
+
+	uint16_t getBase() const { return uint16_t(base); }
+	const std::vector<uint8_t>& getImage() const { return bytes; }
+	uint64_t getImageHash() const { return imageHash; }
+
+	uint8_t flagsAt(uint16_t addr) const; // 0 outside the image
+	bool isCode(uint16_t addr) const { return (flagsAt(addr) & kOpcode) != 0; }
+	size_t codeBytes() const;
+
+	const std::map<uint16_t, Routine>& getRoutines() const { return routines; }
+	const std::vector<uint16_t>& getIndirectJumps() const { return indirectJumps; }
+
+	// likely hot entry points: vectors first, then routines by number of call sites
+	std::vector<uint16_t> hotEntries(size_t count) const;
+
+	// disassembly of the code regions, with routine and label markers
+	std::string listing() const;
+
+private:
+	bool contains(uint32_t addr) const { return addr >= base && addr < base + flags.size(); }
+	uint8_t byteAt(uint32_t addr) const { return contains(addr) ? bytes[addr - base] : 0; }
+	void reset(const uint8_t* image, uint16_t base, size_t size);
+	void addRoutine(uint16_t addr, const char* vector);
+	void markInstruction(uint32_t addr, int length);
+
+	std::vector<uint8_t> bytes; // copy of the image
+	uint32_t base;
+	uint64_t imageHash;
+	std::vector<uint8_t> flags;
+	std::map<uint16_t, Routine> routines;
+	std::vector<uint16_t> indirectJumps;
+};
@@ -0,0 +1,220 @@
+/************************************************************************************
+
+Filename    :   console.cpp
+Content     :   Whole-system emulation: CPU + PPU + APU + controllers wired to the bus
+Authors     :   Yash Patel
+
+*************************************************************************************/
+
+#include "console.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#include "aotcode.h"
+#include "debugger.h"
+
+Console::Console(Region region) :
+    region(region),
+    ppu(region),
+    cpu(&bus),
+    apu(region, &bus, &cpu),
+    io(&bus, &cpu, &ppu, &apu, &pads[0], &pads[1]),
+    idle(&cpu, &bus, &ppu),
+    debugger(nullptr),
+    compiled(nullptr),
+    turbo(false),
+    idleSkipping(true),
+    renderRequested(false),
+    rendered(false),
+    frame(0) {
+    memset(ram, 0, sizeof(ram));
+    memset(cartRam, 0, sizeof(cartRam));
+
+    // $4100-$5FFF (expansion) and $8000-$FFFF until a cartridge is mapped read as open bus
+    bus.mapMemory(0x0000, 0x1FFF, ram, kRamSize, true);
+    bus.mapDevice(0x2000, 0x3FFF, &ppu);
+    bus.mapDevice(0x4000, 0x40FF, &io);
+    bus.mapMemory(0x6000, 0x7FFF, cartRam, kCartRamSize, true);
+    bus.markPollable(0x2000, 0x3FFF); // idle detection compares the PPU registers itself
+    ppu.trackState(&bus.getStateHash());
+
+    FramePacer pacer(region);
+    cyclesPerScanline = pacer.cyclesPerFrame() / ppu.scanlinesPerFrame();
+    cycleTarget = 0.0;
+    line = 0;
+    lineStarted = false;
+}
+
+void* Console::operator new(size_t size) {
+    void* instance = nullptr;
+#ifdef _WIN32
+    instance = _aligned_malloc(size, alignof(Console));
+#else
+    if (posix_memalign(&instance, alignof(Console), size) != 0) {
+        instance = nullptr;
+    }
+#endif
+    if (instance == nullptr) {
+        throw std::bad_alloc();
+    }
+    return instance;
+}
+
+void Console::operator delete(void* instance) {
+#ifdef _WIN32
+    _aligned_free(instance);
+#else
+    free(instance);
+#endif
+}
+
+void Console::mapPRG(const uint8_t* prg, uint32_t size) {
+    bus.mapROM(0x8000, 0xFFFF, prg, size);
+}
+
+void Console::copyImage(uint8_t* image) const {
+    for (uint32_t addr = 0; addr < uint32_t(kAddressSpace); addr++) {
+        image[addr] = bus.peek(uint16_t(addr));
+    }
+}
+
+bool Console::saveState(State& state) const {
+    if (line != 0 || lineStarted) {
+        return false;
+    }
+    state.cpu = cpu.state();
+    ppu.saveState(state.ppu);
+    apu.saveState(state.apu);
+    state.pads[0] = pads[0];
+    state.pads[1] = pads[1];
+    state.openBus = bus.getOpenBus();
+    memcpy(state.ram, ram, sizeof(ram));
+    const uint8_t* cart = bus.pageMemory(0x60); // ours, or a mapped save file
+    memcpy(state.cartRam, cart != nullptr ? cart : cartRam, sizeof(cartRam));
+    state.cycleTarget = cycleTarget;
+    state.frame = frame;
+    return true;
+}
+
+void Console::loadState(const State& state) {
+    cpu.setState(state.cpu);
+    ppu.loadState(state.ppu);
+    apu.loadState(state.apu);
+    pads[0] = state.pads[0];
+    pads[1] = state.pads[1];
+    bus.setOpenBus(state.openBus);
+    memcpy(ram, state.ram, sizeof(ram));
+    uint8_t* cart = bus.pageMemory(0x60);
+    memcpy(cart != nullptr ? cart : cartRam, state.cartRam, sizeof(cartRam));
+    idle.disarm();
+    cycleTarget = state.cycleTarget;
+    line = 0;
+    lineStarted = false;
+    frame = state.frame;
+    bus.getStateHash().invalidate(); // memory was loaded directly, not through the bus
+}
+
+void Console::reset() {
+    ppu.reset();
+    cpu.reset();
+    apu.reset();
+    pads[0].reset();
+    pads[1].reset();
+    idle.disarm();
+    cycleTarget = 0.0;
+    line = 0;
+    lineStarted = false;
+    frame = 0;
+    bus.getStateHash().invalidate(); // memory was loaded directly, not through the bus
+}
+
+uint64_t Console::stateHash() {
+    CPUState regs = cpu.state();
+    uint8_t packed[7] = {
+        uint8_t(regs.pc), uint8_t(regs.pc >> 8), regs.ac, regs.x, regs.y, regs.sr, regs.sp
+    };
+    return bus.getStateHash().hash() ^ hashBytes(packed, sizeof(packed), 0x6502) ^ ppu.hashRegisters();
+}
+
+bool Console::runFrame(bool render) {
+    if (line == 0 && !lineStarted) {
+        rendered = render && (!turbo || renderRequested);
+        renderRequested = false;
+        ppu.setRenderOutput(rendered);
+        apu.setSynthesis(!turbo || rendered);
+    }
+
+    int scanlines = ppu.scanlinesPerFrame();
+    for (; line < scanlines; line++) {
+        if (!lineStarted) {
+            cycleTarget += cyclesPerScanline;
+            lineStarted = true;
+        }
+        if (debugger != nullptr && debugger->isArmed()) {
+            if (!runDebugged()) {
+                return false;
+            }
+        } else if (compiled != nullptr && cpu.getAccuracy() == BusAccuracy::Fast) {
+            runCompiled();
+        } else {
+            while (double(cpu.getCycles()) < cycleTarget) {
+                uint16_t pc = cpu.getPC();
+                cpu.step();
+                if (idleSkipping && cpu.getPC() <= pc) {
+                    idle.backwardJump(cycleTarget);
+                }
+            }
+        }
+        lineStarted = false;
+        idle.disarm();
+        cpu.stall(apu.takeDmaStall());
+        if (ppu.runScanline()) {
+            cpu.nmi();
+        }
+        if (apu.irqAsserted()) {
+            cpu.irq();
+        }
+    }
+    line = 0;
+    apu.endFrame();
+    frame++;
+    return true;
+}
+
+void Console::runCompiled() {
+    IdleLoop* skipper = idleSkipping ? &idle : nullptr;
+    while (double(cpu.getCycles()) < cycleTarget) {
+        if (compiled->hasBlock(cpu.getPC())) {
+            compiled->run(cpu, bus, cycleTarget, skipper);
+            if (double(cpu.getCycles()) >= cycleTarget) {
+                break;
+            }
+        }
+        // not compiled, or changed since: the interpreter takes this one
+        uint16_t pc = cpu.getPC();
+        cpu.step();
+        if (skipper != nullptr && cpu.getPC() <= pc) {
+            idle.backwardJump(cycleTarget);
+        }
+    }
+}
+
+bool Console::runDebugged() {
+    while (double(cpu.getCycles()) < cycleTarget) {
+        if (debugger->beforeInstruction()) {
+            return false;
+        }
+        cpu.step();
+        if (debugger->afterInstruction()) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,148 @@
+/************************************************************************************
+
+Filename    :   console.h
+Content     :   Whole-system emulation: CPU + PPU + APU + controllers wired to the bus (header)
+Authors     :   Yash Patel
+
+The console runs a frame as a sequence of scanlines: the CPU runs up to the cycle
+budget of the line, then the PPU renders it. In turbo mode frames are emulated
+without pixel output (the PPU keeps producing status flags, sprite 0 hits and NMIs,
+so game logic is unaffected); full rendering resumes when turbo is switched off,
+or for a single frame with requestRender(). Audio synthesis follows the same rule:
+frames that aren't rendered in turbo aren't synthesized either.
+
+Busy-wait loops are fast-forwarded to the end of the scanline once detected (see
+idleloop.h). That never changes results, only how many instructions are actually
+run; it can be switched off to compare.
+
+With a Debugger attached and armed, scanlines run through a second instruction loop
+that checks breakpoints and stepping around each instruction (and idle loops aren't
+skipped). runFrame() then returns false when the debugger stops execution, and the
+next call resumes mid-frame.
+
+With recompiled code attached (aotcode.h), no debugger armed and BusAccuracy::Fast
+(the semantics the module is compiled with), scanlines run through the module, and
+the interpreter only steps the instructions it hands back.
+
+A console holds only the memory the hardware has: 2K of work RAM and 8K of cartridge
+RAM. Cartridge ROM is mapped in place from whoever loaded it (see Rom::install), so
+any number of consoles running one game share a single read-only copy; for large
+numbers of them, allocate from an InstanceArena (arena.h).
+
+*************************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "apu.h"
+#include "bus.h"
+#include "controller.h"
+#include "cpu.h"
+#include "idleloop.h"
+#include "ioports.h"
+#include "pacer.h"
+#include "ppu.h"
+
+class AotCode;
+class Debugger;
+
+class Console {
+public:
+	static const int kRamSize = 2048;     // work RAM, $0000-$07FF mirrored up to $1FFF
+	static const int kCartRamSize = 8192; // cartridge RAM, $6000-$7FFF
+	static const int kAddressSpace = 65536;
+
+	Console(Region region = Region::NTSC);
+	~Console() = default;
+
+	// aligned to a cache line (for the CPU); pre-C++17 new doesn't do that by itself
+	static void* operator new(size_t size);
+	static void operator delete(void* instance);
+
+	// everything that decides how the console continues from a frame boundary: rolled
+	// back to with loadState, it runs the same frames again exactly. ROM, mappings and
+	// settings (turbo, accuracy, attached tools) aren't part of it.
+	struct State {
+		CPUState cpu;
+		PPU::State ppu;
+		APU::State apu;
+		Controller pads[2];
+		uint8_t openBus;
+		uint8_t ram[kRamSize];
+		uint8_t cartRam[kCartRamSize];
+		double cycleTarget;
+		uint64_t frame;
+	};
+	bool saveState(State& state) const; // false mid-frame (stopped by a debugger)
+	void loadState(const State& state);
+
+	uint8_t* getRam() { return ram; }
+	uint8_t* getCartRam() { return cartRam; }
+	// maps 16K or 32K of PRG-ROM at $8000-$FFFF (16K mirrored). It's used in place, so one
+	// ROM can sit behind any number of consoles, and must outlive them. Reset afterwards.
+	void mapPRG(const uint8_t* prg, uint32_t size);
+	// the 64K address space as the CPU would read it, without side effects (device
+	// registers read as 0), for tools that work on a flat image
+	void copyImage(uint8_t* image) const;
+	CPU& getCPU() { return cpu; }
+	PPU& getPPU() { return ppu; }
+	APU& getAPU() { return apu; }
+	Controller& getController(int port) { return pads[port]; } // 0 or 1
+	Bus& getBus() { return bus; }
+	Region getRegion() const { return region; }
+
+	void reset();
+	// render=false: skip pixel output for this frame. Returns false if a debugger
+	// stopped it; calling again resumes (render only applies to a new frame).
+	bool runFrame(bool render = true);
+
+	void setDebugger(Debugger* attached) { debugger = attached; } // see debugger.h
+	void setCompiledCode(AotCode* code) { compiled = code; }     // must be loaded; see aotcode.h
+
+	void setTurbo(bool enabled) { turbo = enabled; }
+	bool isTurbo() const { return turbo; }
+	void requestRender() { renderRequested = true; } // next frame renders even in turbo
+
+	void setIdleSkipping(bool enabled) { idleSkipping = enabled; }
+	bool isIdleSkipping() const { return idleSkipping; }
+	uint64_t getIdleCycles() const { return idle.getSkippedCycles(); } // CPU cycles fast-forwarded
+
+	// hash of everything that determines future behaviour: tracked memory (incremental,
+	// see StateHash), CPU registers and PPU registers. Cycle/frame counters are left
+	// out so identical states reached at different times compare equal.
+	uint64_t stateHash();
+
+	uint64_t getFrame() const { return frame; }
+	bool lastFrameRendered() const { return rendered; }
+
+private:
+	Region region;
+	uint8_t ram[kRamSize];
+	uint8_t cartRam[kCartRamSize];
+	Bus bus;
+	PPU ppu;
+	CPU cpu;
+	APU apu;
+	Controller pads[2];
+	IOPorts io;
+	IdleLoop idle;
+
+	bool runDebugged(); // one scanline's instructions under the debugger; false on a stop
+	void runCompiled(); // one scanline's instructions through the recompiled module
+
+	Debugger* debugger;
+	AotCode* compiled;
+
+	double cyclesPerScanline;
+	double cycleTarget; // fractional CPU cycle at which the current scanline ends
+	int line;           // next scanline to run (nonzero only while stopped mid-frame)
+	bool lineStarted;   // cycleTarget already covers `line`
+
+	bool turbo;
+	bool idleSkipping;
+	bool renderRequested;
+	bool rendered;
+	uint64_t frame;
+};
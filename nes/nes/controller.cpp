@@ -0,0 +1,35 @@
+/************************************************************************************
+
+Filename    :   controller.cpp
+Content     :   Standard controller port
+Authors     :   Yash Patel
+
+*************************************************************************************/
+
+#include "controller.h"
+
+Controller::Controller() {
+    reset();
+}
+
+void Controller::reset() {
+    buttons = 0;
+    shift = 0;
+    strobing = false;
+}
+
+void Controller::strobe(bool high) {
+    strobing = high;
+    if (strobing) {
+        shift = buttons;
+    }
+}
+
+uint8_t Controller::read() {
+    if (strobing) {
+        return buttons & 0x01; // the register keeps reloading, so it's always A
+    }
+    uint8_t bit = shift & 0x01;
+    shift = (shift >> 1) | 0x80; // an official pad shifts in 1s
+    return bit;
+}
@@ -0,0 +1,48 @@
+/************************************************************************************
+
+Filename    :   controller.h
+Content     :   Standard controller port (header)
+Authors     :   Yash Patel
+
+The standard joypad is a parallel-in/serial-out shift register. While the strobe bit
+($4016 bit 0) is high it keeps reloading the buttons; once it goes low, each read of
+the port ($4016 / $4017) returns the next button in the order A, B, Select, Start,
+Up, Down, Left, Right, and 1s after that.
+
+*************************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+
+class Controller {
+public:
+	// button bits, in the order they're shifted out
+	enum Button : uint8_t {
+		A      = 0x01,
+		B      = 0x02,
+		Select = 0x04,
+		Start  = 0x08,
+		Up     = 0x10,
+		Down   = 0x20,
+		Left   = 0x40,
+		Right  = 0x80
+	};
+
+	Controller();
+	~Controller() = default;
+
+	void reset();
+	void setButtons(uint8_t pressed) { buttons = pressed; } // takes effect at the next latch
+	uint8_t getButtons() const { return buttons; }
+
+	void strobe(bool high);
+	uint8_t read(); // bit 0 is the serial data; the caller supplies open bus bits
+
+	uint8_t getShift() const { return shift; }
+
+private:
+	uint8_t buttons;
+	uint8_t shift;
+	bool strobing;
+};
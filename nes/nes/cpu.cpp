@@ -1,6 +1,6 @@
 /************************************************************************************
 
-Filename    :   CPU.cpp
+Filename    :   cpu.cpp
 Content     :   Core CPU emulation
 Authors     :   Yash Patel
 
@@ -10,25 +10,87 @@ resource if you are interested in implementing the 6502 yourself (or understandi
 
 *************************************************************************************/
 
-#include "CPU.h"
+#include "cpu.h"
 
 #include <iomanip>
 #include <iostream>
+#include <memory>
 #include <stdexcept>
+#include <string>
 
-uint16_t CPU::readShort(uint16_t addr) {
-    uint16_t ll = memory[rpc++];
-    uint16_t hh = memory[rpc++];
+uint16_t CPU::readOperandShort() {
+    uint16_t ll = read(rpc++);
+    uint16_t hh = read(rpc++);
     return (hh << 8) | ll;
 }
 
-CPU::CPU(uint8_t* memory) : memory(memory) {
-    rpc = readShort(0xFFFC); // program counter starts w/ value at FFFC
+CPU::CPU(Bus* bus) : bus(bus), cycleTick(0), accuracy(BusAccuracy::Fast) {
+    reset();
+}
+
+void CPU::reset() {
+    rpc = read(0xFFFC) | (read(0xFFFD) << 8); // program counter starts w/ value at FFFC
     rac = 0;  // accumulator (8 bit)
     rx  = 0;  // X register  (8 bit)
     ry  = 0;  // Y register  (8 bit)
-    rsr = 0;  // status register [NV-BDIZC]  (8 bit)
-    rsp = 0;  // stack pointer   (8 bit)
+    rsr = 0b00000100; // status register [NV-BDIZC]  (8 bit); IRQs masked until the program CLIs
+    rsp = 0xFD; // stack pointer (8 bit); the reset sequence leaves it 3 below the top
+    cycles = 0;
+}
+
+// stack lives in page 1 and grows down
+void CPU::push(uint8_t value) {
+    write(0x0100 | rsp, value);
+    rsp--;
+}
+
+uint8_t CPU::pull() {
+    rsp++;
+    return read(0x0100 | rsp);
+}
+
+void CPU::nmi() {
+    interrupt(0xFFFA);
+}
+
+void CPU::irq() {
+    if (getStatusI()) {
+        return;
+    }
+    interrupt(0xFFFE);
+}
+
+void CPU::interrupt(uint16_t vector) {
+    uint64_t start = cycles;
+    internalCycle(2); // the two reads of PC an opcode fetch would have made
+    push(rpc >> 8);
+    push(rpc & 0xFF);
+    push((rsr & 0b11101111) | 0b00100000); // B clear (it's only set by BRK/PHP), the unused bit set as always
+    setStatusI(true);
+    rpc = read(vector) | (read(vector + 1) << 8);
+    cycles = start + 7; // per-cycle timing already counted the pushes and vector reads
+}
+
+CPUState CPU::state() const {
+    CPUState state;
+    state.pc = rpc;
+    state.ac = rac;
+    state.x  = rx;
+    state.y  = ry;
+    state.sr = rsr;
+    state.sp = rsp;
+    state.cycles = cycles;
+    return state;
+}
+
+void CPU::setState(const CPUState& state) {
+    rpc = state.pc;
+    rac = state.ac;
+    rx  = state.x;
+    ry  = state.y;
+    rsr = state.sr;
+    rsp = state.sp;
+    cycles = state.cycles;
 }
 
 /************************************************************************************
@@ -79,7 +141,7 @@ bool CPU::getStatusC() {
 // status setters
 
 // which is 0-indexed from LSB
-uint8_t CPU::setBit(int which, bool bit) {
+void CPU::setBit(int which, bool bit) {
     // setting a bit is significantly more complicated than imagined:
     // we first have to clear the desired bit and then set it:
     //   1111 1111
@@ -110,31 +172,31 @@ uint8_t CPU::setBit(int which, bool bit) {
 }
 
 void CPU::setStatusN(bool bit) {
-    return setBit(bit, 7);
+    setBit(7, bit);
 }
 
 void CPU::setStatusV(bool bit) {
-    return setBit(bit, 6);
+    setBit(6, bit);
 }
 
 void CPU::setStatusB(bool bit) {
-    return setBit(bit, 4);
+    setBit(4, bit);
 }
 
 void CPU::setStatusD(bool bit) {
-    return setBit(bit, 3);
+    setBit(3, bit);
 }
 
 void CPU::setStatusI(bool bit) {
-    return setBit(bit, 2);
+    setBit(2, bit);
 }
 
 void CPU::setStatusZ(bool bit) {
-    return setBit(bit, 1);
+    setBit(1, bit);
 }
 
 void CPU::setStatusC(bool bit) {
-    return setBit(bit, 0);
+    setBit(0, bit);
 }
 
 // semantic setting of registers
@@ -147,7 +209,8 @@ void CPU::setValueN(uint8_t value) {
 }
 
 void CPU::setValueZN(uint8_t value) {
-    setStatusN((bool)(value & 0b10000000));
+    setValueZ(value);
+    setValueN(value);
 }
 
 /************************************************************************************
@@ -180,38 +243,66 @@ uint16_t CPU::operandAcc() {
 }
 
 uint16_t CPU::operandAbs() {
-    uint16_t hhll = readShort(rpc);
+    uint16_t hhll = readOperandShort();
     return hhll;
 }
 
-uint16_t CPU::operandAbsX() {
-    uint16_t hhll = readShort(rpc);
-    return hhll + rx;
+// the index is added to the low byte first, and the CPU reads from that (possibly
+// wrong-page) address while it fixes up the high byte: always for stores and
+// read-modify-writes, only on a page cross for reads, where it's the extra cycle.
+// Every policy pays the cycle; FastBus only skips the dummy read itself
+template <class Accuracy>
+uint16_t CPU::indexed(uint16_t base, uint8_t index, bool always) {
+    uint16_t addr = base + index;
+    bool crossed = ((base ^ addr) & 0xFF00) != 0;
+    if (Accuracy::kDummyAccesses && (always || crossed)) {
+        read((base & 0xFF00) | (addr & 0x00FF)); // with CycleBus this counts the cycle
+    }
+    if (!Accuracy::kCycleTimed && crossed && !always) {
+        cycles++; // the page-cross cycle; stores and RMWs already count it
+    }
+    return addr;
+}
+
+template <class Accuracy>
+uint16_t CPU::operandAbsX(bool always) {
+    uint16_t hhll = readOperandShort();
+    return indexed<Accuracy>(hhll, rx, always);
 }
 
-uint16_t CPU::operandAbsY() {
-    uint16_t hhll = readShort(rpc);
-    return hhll + ry;
+template <class Accuracy>
+uint16_t CPU::operandAbsY(bool always) {
+    uint16_t hhll = readOperandShort();
+    return indexed<Accuracy>(hhll, ry, always);
 }
 
 uint16_t CPU::operandImm() {
-    uint8_t bb = memory[rpc++];
+    uint8_t bb = read(rpc++);
     return bb;
 }
 
+// only JMP uses it; the pointer's high byte is fetched without carrying into the
+// page ($xxFF reads its high byte from $xx00), as on the real chip
 uint16_t CPU::operandInd() {
-    uint16_t hhll = readShort(rpc);
-    return memory[hhll];
+    uint16_t hhll = readOperandShort();
+    return read(hhll) | (read((hhll & 0xFF00) | uint8_t(hhll + 1)) << 8);
 }
 
+template <class Accuracy>
 uint16_t CPU::operandIndX() {
-    uint16_t ll = memory[rpc++];
-    return memory[ll + rx];
+    uint8_t ll = read(rpc++);
+    if (Accuracy::kDummyAccesses) {
+        read(ll); // the pointer is read before X is added
+    }
+    uint8_t pointer = ll + rx; // pointer and its high byte wrap within the zeropage
+    return read(pointer) | (read(uint8_t(pointer + 1)) << 8);
 }
 
-uint16_t CPU::operandIndY() {
-    uint16_t ll = memory[rpc++];
-    return memory[ll] + ry;
+template <class Accuracy>
+uint16_t CPU::operandIndY(bool always) {
+    uint8_t ll = read(rpc++);
+    uint16_t hhll = read(ll) | (read(uint8_t(ll + 1)) << 8); // pointer wraps within the zeropage
+    return indexed<Accuracy>(hhll, ry, always);
 }
 
 uint16_t CPU::operandRelative() {
@@ -219,57 +310,44 @@ uint16_t CPU::operandRelative() {
 }
 
 uint16_t CPU::operandZpg() {
-    uint16_t ll = memory[rpc++];
+    uint16_t ll = read(rpc++);
     return ll;
 }
 
+template <class Accuracy>
 uint16_t CPU::operandZpgX() {
-    uint16_t ll = memory[rpc++];
-    return ll + rx;
+    uint8_t ll = read(rpc++);
+    if (Accuracy::kDummyAccesses) {
+        read(ll); // the unindexed address is read while X is added
+    }
+    return uint8_t(ll + rx); // no carry: stays in the zeropage
 }
 
-uint16_t CPU::operandZpgX() {
-    uint16_t ll = memory[rpc++];
-    return ll + ry;
+template <class Accuracy>
+uint16_t CPU::operandZpgY() {
+    uint8_t ll = read(rpc++);
+    if (Accuracy::kDummyAccesses) {
+        read(ll);
+    }
+    return uint8_t(ll + ry);
 }
 
-/************************************************************************************
-
-ADC  Add Memory to Accumulator with Carry
-
-     A + M + C -> A, C                N Z C I D V
-                                      + + + - - +
-
-     addressing    assembler    opc  bytes  cyles
-     --------------------------------------------
-     immidiate     ADC #oper     69    2     2
-     zeropage      ADC oper      65    2     3
-     zeropage,X    ADC oper,X    75    2     4
-     absolute      ADC oper      6D    3     4
-     absolute,X    ADC oper,X    7D    3     4*
-     absolute,Y    ADC oper,Y    79    3     4*
-     (indirect,X)  ADC (oper,X)  61    2     6
-     (indirect),Y  ADC (oper),Y  71    2     5*
-
-*************************************************************************************/
-void CPU::ADC(uint16_t opcode) { //add with carry
-    uint8_t operand;
-    switch (opcode) {
-    case 0x69: { operand = memory[rpc++];         break; }
-    case 0x65: { operand = memory[operandZpg()];  break; }
-    case 0x75: { operand = memory[operandZpgX()]; break; }
-    case 0x6D: { operand = memory[operandAbs()];  break; }
-    case 0x7D: { operand = memory[operandAbsX()]; break; }
-    case 0x79: { operand = memory[operandAbsY()]; break; }
-    case 0x61: { operand = memory[operandIndX()]; break; }
-    case 0x71: { operand = memory[operandIndY()]; break; }
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+// read-modify-write: the CPU writes the unmodified value back while it computes the
+// new one, so a register sees two writes
+template <class Accuracy>
+void CPU::modify(uint16_t addr, uint8_t old, uint8_t value) {
+    if (Accuracy::kDummyAccesses) {
+        write(addr, old);
     }
+    write(addr, value);
+}
 
+// A + M + C -> A with C and V; SBC is the same with M inverted (A - M - !C)
+void CPU::addWithCarry(uint8_t operand) {
     // http://www.righto.com/2012/12/the-6502-overflow-flag-explained.html
     uint8_t result = 0x0; // we have to do manual adding to get the correct C and V flags
     bool carry = getStatusC();
-    bool c6, c7;
+    bool c6 = false, c7 = false;
     for (int bit = 0; bit < 8; bit++) {
         uint8_t selector = 1;
         selector = selector << bit;
@@ -283,8 +361,7 @@ void CPU::ADC(uint16_t opcode) { //add with carry
         if (bit == 7) {
             c7 = carry;
         }
-        result = result << 1;
-        result |= nextBit;
+        result |= uint8_t(nextBit) << bit;
     }
     
     rac = result;
@@ -296,6 +373,43 @@ void CPU::ADC(uint16_t opcode) { //add with carry
 
 /************************************************************************************
 
+ADC  Add Memory to Accumulator with Carry
+
+     A + M + C -> A, C                N Z C I D V
+                                      + + + - - +
+
+     addressing    assembler    opc  bytes  cyles
+     --------------------------------------------
+     immidiate     ADC #oper     69    2     2
+     zeropage      ADC oper      65    2     3
+     zeropage,X    ADC oper,X    75    2     4
+     absolute      ADC oper      6D    3     4
+     absolute,X    ADC oper,X    7D    3     4*
+     absolute,Y    ADC oper,Y    79    3     4*
+     (indirect,X)  ADC (oper,X)  61    2     6
+     (indirect),Y  ADC (oper),Y  71    2     5*
+
+*************************************************************************************/
+template <class Accuracy>
+void CPU::ADC(uint16_t opcode) { //add with carry
+    uint8_t operand;
+    switch (opcode) {
+    case 0x69: { operand = read(rpc++);         break; }
+    case 0x65: { operand = read(operandZpg());  break; }
+    case 0x75: { operand = read(operandZpgX<Accuracy>()); break; }
+    case 0x6D: { operand = read(operandAbs());  break; }
+    case 0x7D: { operand = read(operandAbsX<Accuracy>()); break; }
+    case 0x79: { operand = read(operandAbsY<Accuracy>()); break; }
+    case 0x61: { operand = read(operandIndX<Accuracy>()); break; }
+    case 0x71: { operand = read(operandIndY<Accuracy>()); break; }
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
+    }
+
+    addWithCarry(operand);
+}
+
+/************************************************************************************
+
 AND  AND Memory with Accumulator
 
      A AND M -> A                     N Z C I D V
@@ -313,18 +427,19 @@ AND  AND Memory with Accumulator
      (indirect),Y  AND (oper),Y  31    2     5*
 
 *************************************************************************************/
+template <class Accuracy>
 void CPU::AND(uint16_t opcode) { //and (with accumulator)
     uint8_t operand;
     switch (opcode) {
-    case 0x29: { operand = memory[rpc++];         break; }
-    case 0x25: { operand = memory[operandZpg()];  break; }
-    case 0x35: { operand = memory[operandZpgX()]; break; }
-    case 0x2D: { operand = memory[operandAbs()];  break; }
-    case 0x3D: { operand = memory[operandAbsX()]; break; }
-    case 0x39: { operand = memory[operandAbsY()]; break; }
-    case 0x21: { operand = memory[operandIndX()]; break; }
-    case 0x31: { operand = memory[operandIndY()]; break; }
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    case 0x29: { operand = read(rpc++);         break; }
+    case 0x25: { operand = read(operandZpg());  break; }
+    case 0x35: { operand = read(operandZpgX<Accuracy>()); break; }
+    case 0x2D: { operand = read(operandAbs());  break; }
+    case 0x3D: { operand = read(operandAbsX<Accuracy>()); break; }
+    case 0x39: { operand = read(operandAbsY<Accuracy>()); break; }
+    case 0x21: { operand = read(operandIndX<Accuracy>()); break; }
+    case 0x31: { operand = read(operandIndY<Accuracy>()); break; }
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
     rac &= operand;
     setValueZN(rac);
@@ -347,44 +462,44 @@ ASL  Shift Left One Bit (Memory or Accumulator)
      absolute,X    ASL oper,X    1E    3     7
 
 *************************************************************************************/
+template <class Accuracy>
 void CPU::ASL(uint16_t opcode) { //arithmetic shift left
     uint8_t operand;
     uint16_t location;
 
     switch (opcode) {
     case 0x0A: { operand = rac;                                        break; }
-    case 0x06: { location = operandZpg();  operand = memory[location]; break; }
-    case 0x16: { location = operandZpgX(); operand = memory[location]; break; }
-    case 0x0E: { location = operandAbs();  operand = memory[location]; break; }
-    case 0x1E: { location = operandAbsX(); operand = memory[location]; break; }
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    case 0x06: { location = operandZpg();  operand = read(location); break; }
+    case 0x16: { location = operandZpgX<Accuracy>(); operand = read(location); break; }
+    case 0x0E: { location = operandAbs();  operand = read(location); break; }
+    case 0x1E: { location = operandAbsX<Accuracy>(true); operand = read(location); break; }
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
 
-    setStatusC((bool)(result & 0b10000000));
+    setStatusC((bool)(operand & 0b10000000));
     uint8_t result = operand << 1;
     setValueN(result);
     setValueZ(result);
 
     switch (opcode) {
     case 0x0A: { rac = result;               break; }
-    default:   { memory[location] = result;  break; }
+    default:   { modify<Accuracy>(location, operand, result); break; }
     }
 }
 
-// generic helper branch function
+// generic helper branch function: a taken branch costs one more cycle, two if the
+// target is on another page (the table only has the not-taken count)
 
-void CPU::branch(uint16_t opcode, uint16_t instOp, bool check) { //branch on carry clear
-    uint8_t operand;
-    switch (opcode) {
-    case instOp: {
-        operand = memory[rpc++];
-        break; 
-    }
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+void CPU::branch(uint16_t opcode, uint16_t instOp, bool check) {
+    if (opcode != instOp) {
+        throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
+    uint8_t operand = read(rpc++);
 
     if (check) {
-        rpc += int8_t(operand);
+        uint16_t target = rpc + int8_t(operand);
+        cycles += ((target ^ rpc) & 0xFF00) != 0 ? 2 : 1;
+        rpc = target;
     }
 }
 
@@ -401,7 +516,7 @@ BCC  Branch on Carry Clear
 
 *************************************************************************************/
 void CPU::BCC(uint16_t opcode) { //branch on carry clear
-    branch(opcode 0x90, !getStatusC());
+    branch(opcode, 0x90, !getStatusC());
 }
 
 /************************************************************************************
@@ -417,7 +532,7 @@ BCS  Branch on Carry Set
 
 *************************************************************************************/
 void CPU::BCS(uint16_t opcode) { //branch on carry set
-    branch(opcode 0xB0, getStatusC());
+    branch(opcode, 0xB0, getStatusC());
 }
 
 /************************************************************************************
@@ -433,7 +548,7 @@ BEQ  Branch on Result Zero
 
 *************************************************************************************/
 void CPU::BEQ(uint16_t opcode) { //branch on equal (zero set)
-    branch(opcode 0xF0, getStatusZ());
+    branch(opcode, 0xF0, getStatusZ());
 }
 
 /************************************************************************************
@@ -455,10 +570,13 @@ BIT  Test Bits in Memory with Accumulator
 void CPU::BIT(uint16_t opcode) { //bit test
     uint8_t operand;
     switch (opcode) {
-    case 0x24: { operand = memory[operandZpg()];  break; }
-    case 0x2C: { operand = memory[operandAbs()];  break; }
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    case 0x24: { operand = read(operandZpg());  break; }
+    case 0x2C: { operand = read(operandAbs());  break; }
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
+    setValueZ(rac & operand);
+    setStatusN((bool)(operand & 0b10000000));
+    setStatusV((bool)(operand & 0b01000000));
 }
 
 /************************************************************************************
@@ -474,7 +592,7 @@ BMI  Branch on Result Minus
 
 *************************************************************************************/
 void CPU::BMI(uint16_t opcode) { //branch on minus (negative set)
-    branch(opcode 0x30, getStatusN());
+    branch(opcode, 0x30, getStatusN());
 }
 
 /************************************************************************************
@@ -490,7 +608,7 @@ BNE  Branch on Result not Zero
 
 *************************************************************************************/
 void CPU::BNE(uint16_t opcode) { //branch on not equal (zero clear)
-    branch(opcode 0xD0, !getStatusZ());
+    branch(opcode, 0xD0, !getStatusZ());
 }
 
 /************************************************************************************
@@ -506,7 +624,7 @@ BPL  Branch on Result Plus
 
 *************************************************************************************/
 void CPU::BPL(uint16_t opcode) { //branch on plus (negative clear)
-    branch(opcode 0x10, !getStatusN());
+    branch(opcode, 0x10, !getStatusN());
 }
 
 /************************************************************************************
@@ -524,8 +642,15 @@ BRK  Force Break
 void CPU::BRK(uint16_t opcode) { //break / interrupt
     switch (opcode) {
     case 0x00: break;
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
+    rpc++; // BRK skips a padding byte
+    internalCycle();
+    push(rpc >> 8);
+    push(rpc & 0xFF);
+    push(rsr | 0b00110000); // B (and the unused bit) set in the pushed copy
+    setStatusI(true);
+    rpc = read(0xFFFE) | (read(0xFFFF) << 8);
 }
 
 /************************************************************************************
@@ -541,7 +666,7 @@ BVC  Branch on Overflow Clear
 
 *************************************************************************************/
 void CPU::BVC(uint16_t opcode) { //branch on overflow clear
-    branch(opcode 0x50, !getStatusV());
+    branch(opcode, 0x50, !getStatusV());
 }
 
 /************************************************************************************
@@ -557,7 +682,7 @@ BVS  Branch on Overflow Set
 
 *************************************************************************************/
 void CPU::BVS(uint16_t opcode) { //branch on overflow set
-    branch(opcode 0x70, getStatusV());
+    branch(opcode, 0x70, getStatusV());
 }
 
 /************************************************************************************
@@ -574,8 +699,8 @@ CLC  Clear Carry Flag
 *************************************************************************************/
 void CPU::CLC(uint16_t opcode) { //clear carry
     switch (opcode) {
-    case 0x18: { setStatusC(false); rpc++; break; }
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    case 0x18: { setStatusC(false); break; }
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
 }
 
@@ -593,8 +718,8 @@ CLD  Clear Decimal Mode
 *************************************************************************************/
 void CPU::CLD(uint16_t opcode) { //clear decimal
     switch (opcode) {
-    case 0xD8: { setStatusD(false); rpc++; break; }
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    case 0xD8: { setStatusD(false); break; }
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
 }
 
@@ -612,8 +737,8 @@ CLI  Clear Interrupt Disable Bit
 *************************************************************************************/
 void CPU::CLI(uint16_t opcode) { //clear interrupt disable
     switch (opcode) {
-    case 0x58: { setStatusI(false); rpc++; break; }
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    case 0x58: { setStatusI(false); break; }
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
 }
 
@@ -631,14 +756,14 @@ CLV  Clear Overflow Flag
 *************************************************************************************/
 void CPU::CLV(uint16_t opcode) { //clear overflow
     switch (opcode) {
-    case 0xB8: { setStatusV(false); rpc++; break; }
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    case 0xB8: { setStatusV(false); break; }
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
 }
 
 void CPU::compare(uint8_t reg, uint8_t mem) { // generic compare and sets flags
     uint8_t result = reg - mem;
-    setStatusC(result >= 0);
+    setStatusC(reg >= mem);
     setValueZN(result);
 }
 
@@ -661,20 +786,21 @@ CMP  Compare Memory with Accumulator
      (indirect),Y  CMP (oper),Y  D1    2     5*
 
 *************************************************************************************/
+template <class Accuracy>
 void CPU::CMP(uint16_t opcode) { //compare (with accumulator)
     uint8_t operand;
     switch (opcode) {
-    case 0xC9: { operand = memory[rpc++];         break; }
-    case 0xC5: { operand = memory[operandZpg()];  break; }
-    case 0xD5: { operand = memory[operandZpgX()]; break; }
-    case 0xCD: { operand = memory[operandAbs()];  break; }
-    case 0xDD: { operand = memory[operandAbsX()]; break; }
-    case 0xD9: { operand = memory[operandAbsY()]; break; }
-    case 0xC1: { operand = memory[operandIndX()]; break; }
-    case 0xD1: { operand = memory[operandIndY()]; break; }
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    case 0xC9: { operand = read(rpc++);         break; }
+    case 0xC5: { operand = read(operandZpg());  break; }
+    case 0xD5: { operand = read(operandZpgX<Accuracy>()); break; }
+    case 0xCD: { operand = read(operandAbs());  break; }
+    case 0xDD: { operand = read(operandAbsX<Accuracy>()); break; }
+    case 0xD9: { operand = read(operandAbsY<Accuracy>()); break; }
+    case 0xC1: { operand = read(operandIndX<Accuracy>()); break; }
+    case 0xD1: { operand = read(operandIndY<Accuracy>()); break; }
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
-    compare(rax, operand);
+    compare(rac, operand);
 }
 
 /************************************************************************************
@@ -694,10 +820,10 @@ CPX  Compare Memory and Index X
 void CPU::CPX(uint16_t opcode) { //compare with X
     uint8_t operand;
     switch (opcode) {
-    case 0xE0: { operand = memory[rpc++];         break; }
-    case 0xE4: { operand = memory[operandZpg()];  break; }
-    case 0xEC: { operand = memory[operandAbs()]; break; }
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    case 0xE0: { operand = read(rpc++);         break; }
+    case 0xE4: { operand = read(operandZpg());  break; }
+    case 0xEC: { operand = read(operandAbs()); break; }
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
     compare(rx, operand);
 }
@@ -719,10 +845,10 @@ CPY  Compare Memory and Index Y
 void CPU::CPY(uint16_t opcode) { //compare with Y
     uint8_t operand;
     switch (opcode) {
-    case 0xC0: { operand = memory[rpc++];         break; }
-    case 0xC4: { operand = memory[operandZpg()];  break; }
-    case 0xCC: { operand = memory[operandAbs()];  break; }
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    case 0xC0: { operand = read(rpc++);         break; }
+    case 0xC4: { operand = read(operandZpg());  break; }
+    case 0xCC: { operand = read(operandAbs());  break; }
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
     compare(ry, operand);
 }
@@ -742,17 +868,20 @@ DEC  Decrement Memory by One
      absolute,X    DEC oper,X    DE    3     7
 
 *************************************************************************************/
+template <class Accuracy>
 void CPU::DEC(uint16_t opcode) { //decrement
-    uint8_t operand;
+    uint16_t operand;
     switch (opcode) {
     case 0xC6: { operand = operandZpg();  break; }
-    case 0xD6: { operand = operandZpgX(); break; }
+    case 0xD6: { operand = operandZpgX<Accuracy>(); break; }
     case 0xCE: { operand = operandAbs();  break; }
-    case 0xDE: { operand = operandAbsX(); break; }
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    case 0xDE: { operand = operandAbsX<Accuracy>(true); break; }
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
-    memory[operand]--;
-    setValueZN(memory[operand]);
+    uint8_t value = read(operand);
+    uint8_t result = value - 1;
+    modify<Accuracy>(operand, value, result);
+    setValueZN(result);
 }
 
 /************************************************************************************
@@ -770,7 +899,7 @@ DEX  Decrement Index X by One
 void CPU::DEX(uint16_t opcode) { //decrement X
     switch (opcode) {
     case 0xCA: break;
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
     rx--;
     setValueZN(rx);
@@ -791,7 +920,7 @@ DEY  Decrement Index Y by One
 void CPU::DEY(uint16_t opcode) { //decrement Y
     switch (opcode) {
     case 0x88: break;
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
     ry--;
     setValueZN(ry);
@@ -816,18 +945,19 @@ EOR  Exclusive-OR Memory with Accumulator
      (indirect),Y  EOR (oper),Y  51    2     5*
 
 *************************************************************************************/
+template <class Accuracy>
 void CPU::EOR(uint16_t opcode) { //exclusive or (with accumulator)
     uint8_t operand;
     switch (opcode) {
-    case 0x49: { operand = memory[rpc++];         break; }
-    case 0x45: { operand = memory[operandZpg()];  break; }
-    case 0x55: { operand = memory[operandZpgX()]; break; }
-    case 0x4D: { operand = memory[operandAbs()];  break; }
-    case 0x5D: { operand = memory[operandAbsX()]; break; }
-    case 0x59: { operand = memory[operandAbsY()]; break; }
-    case 0x41: { operand = memory[operandIndX()]; break; }
-    case 0x51: { operand = memory[operandIndY()]; break; }
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    case 0x49: { operand = read(rpc++);         break; }
+    case 0x45: { operand = read(operandZpg());  break; }
+    case 0x55: { operand = read(operandZpgX<Accuracy>()); break; }
+    case 0x4D: { operand = read(operandAbs());  break; }
+    case 0x5D: { operand = read(operandAbsX<Accuracy>()); break; }
+    case 0x59: { operand = read(operandAbsY<Accuracy>()); break; }
+    case 0x41: { operand = read(operandIndX<Accuracy>()); break; }
+    case 0x51: { operand = read(operandIndY<Accuracy>()); break; }
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
     rac ^= operand;
     setValueZN(rac);
@@ -848,17 +978,20 @@ INC  Increment Memory by One
      absolute,X    INC oper,X    FE    3     7
 
 *************************************************************************************/
+template <class Accuracy>
 void CPU::INC(uint16_t opcode) { //increment
-    uint8_t operand;
+    uint16_t operand;
     switch (opcode) {
-    case 0xE6: { operand = memory[operandZpg()];  break; }
-    case 0xF6: { operand = memory[operandZpgX()]; break; }
-    case 0xEE: { operand = memory[operandAbs()];  break; }
-    case 0xFE: { operand = memory[operandAbsX()]; break; }
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    case 0xE6: { operand = operandZpg();  break; }
+    case 0xF6: { operand = operandZpgX<Accuracy>(); break; }
+    case 0xEE: { operand = operandAbs();  break; }
+    case 0xFE: { operand = operandAbsX<Accuracy>(true); break; }
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
-    rx++;
-    setValueZN(rx);
+    uint8_t value = read(operand);
+    uint8_t result = value + 1;
+    modify<Accuracy>(operand, value, result);
+    setValueZN(result);
 }
 
 /************************************************************************************
@@ -876,8 +1009,10 @@ INX  Increment Index X by One
 void CPU::INX(uint16_t opcode) { //increment X
     switch (opcode) {
     case 0xE8: break;
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
+    rx++;
+    setValueZN(rx);
 }
 
 /************************************************************************************
@@ -895,7 +1030,7 @@ INY  Increment Index Y by One
 void CPU::INY(uint16_t opcode) { //increment Y
     switch (opcode) {
     case 0xC8: break;
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
     ry++;
     setValueZN(ry);
@@ -919,8 +1054,9 @@ void CPU::JMP(uint16_t opcode) { //jump
     switch (opcode) {
     case 0x4C: { operand = operandAbs();         break; }
     case 0x6C: { operand = operandInd();  break; }
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
+    rpc = operand;
 }
 
 /************************************************************************************
@@ -939,8 +1075,14 @@ JSR  Jump to New Location Saving Return Address
 void CPU::JSR(uint16_t opcode) { //jump subroutine
     switch (opcode) {
     case 0x20: break;
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
+    uint16_t ll = read(rpc++);
+    internalCycle(); // the 6502 buffers ll while it peeks at the stack
+    push(rpc >> 8); // the address of the last byte of the JSR, which RTS increments
+    push(rpc & 0xFF);
+    uint16_t hh = read(rpc);
+    rpc = (hh << 8) | ll;
 }
 
 /************************************************************************************
@@ -962,18 +1104,19 @@ LDA  Load Accumulator with Memory
      (indirect),Y  LDA (oper),Y  B1    2     5*
 
 *************************************************************************************/
+template <class Accuracy>
 void CPU::LDA(uint16_t opcode) { //load accumulator
     uint8_t operand;
     switch (opcode) {
-    case 0xA9: { operand = memory[rpc++];         break; }
-    case 0xA5: { operand = memory[operandZpg()];  break; }
-    case 0xB5: { operand = memory[operandZpgX()]; break; }
-    case 0xAD: { operand = memory[operandAbs()];  break; }
-    case 0xBD: { operand = memory[operandAbsX()]; break; }
-    case 0xB9: { operand = memory[operandAbsY()]; break; }
-    case 0xA1: { operand = memory[operandIndX()]; break; }
-    case 0xB1: { operand = memory[operandIndY()]; break; }
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    case 0xA9: { operand = read(rpc++);         break; }
+    case 0xA5: { operand = read(operandZpg());  break; }
+    case 0xB5: { operand = read(operandZpgX<Accuracy>()); break; }
+    case 0xAD: { operand = read(operandAbs());  break; }
+    case 0xBD: { operand = read(operandAbsX<Accuracy>()); break; }
+    case 0xB9: { operand = read(operandAbsY<Accuracy>()); break; }
+    case 0xA1: { operand = read(operandIndX<Accuracy>()); break; }
+    case 0xB1: { operand = read(operandIndY<Accuracy>()); break; }
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
     rac = operand;
     setValueZN(rac);
@@ -995,15 +1138,16 @@ LDX  Load Index X with Memory
      absolute,Y    LDX oper,Y    BE    3     4*
 
 *************************************************************************************/
+template <class Accuracy>
 void CPU::LDX(uint16_t opcode) { //load X
     uint8_t operand;
     switch (opcode) {
-    case 0xA2: { operand = memory[rpc++];         break; }
-    case 0xA6: { operand = memory[operandZpg()];  break; }
-    case 0xB6: { operand = memory[operandZpgX()]; break; }
-    case 0xAE: { operand = memory[operandAbs()];  break; }
-    case 0xBE: { operand = memory[operandAbsX()]; break; }
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    case 0xA2: { operand = read(rpc++);         break; }
+    case 0xA6: { operand = read(operandZpg());  break; }
+    case 0xB6: { operand = read(operandZpgY<Accuracy>()); break; }
+    case 0xAE: { operand = read(operandAbs());  break; }
+    case 0xBE: { operand = read(operandAbsY<Accuracy>()); break; }
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
     rx = operand;
     setValueZN(rx);
@@ -1025,15 +1169,16 @@ LDY  Load Index Y with Memory
      absolute,X    LDY oper,X    BC    3     4*
 
 *************************************************************************************/
+template <class Accuracy>
 void CPU::LDY(uint16_t opcode) { //load Y
     uint8_t operand;
     switch (opcode) {
-    case 0xA0: { operand = memory[rpc++];         break; }
-    case 0xA4: { operand = memory[operandZpg()];  break; }
-    case 0xB4: { operand = memory[operandZpgX()]; break; }
-    case 0xAC: { operand = memory[operandAbs()];  break; }
-    case 0xBC: { operand = memory[operandAbsX()]; break; }
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    case 0xA0: { operand = read(rpc++);         break; }
+    case 0xA4: { operand = read(operandZpg());  break; }
+    case 0xB4: { operand = read(operandZpgX<Accuracy>()); break; }
+    case 0xAC: { operand = read(operandAbs());  break; }
+    case 0xBC: { operand = read(operandAbsX<Accuracy>()); break; }
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
     ry = operand;
     setValueZN(ry);
@@ -1055,27 +1200,28 @@ LSR  Shift One Bit Right (Memory or Accumulator)
      absolute,X    LSR oper,X    5E    3     7
 
 *************************************************************************************/
+template <class Accuracy>
 void CPU::LSR(uint16_t opcode) { //logical shift right
     uint8_t operand;
     uint16_t location;
 
     switch (opcode) {
     case 0x4A: { operand = rac;                                        break; }
-    case 0x46: { location = operandZpg();  operand = memory[location]; break; }
-    case 0x56: { location = operandZpgX(); operand = memory[location]; break; }
-    case 0x4E: { location = operandAbs();  operand = memory[location]; break; }
-    case 0x5E: { location = operandAbsX(); operand = memory[location]; break; }
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    case 0x46: { location = operandZpg();  operand = read(location); break; }
+    case 0x56: { location = operandZpgX<Accuracy>(); operand = read(location); break; }
+    case 0x4E: { location = operandAbs();  operand = read(location); break; }
+    case 0x5E: { location = operandAbsX<Accuracy>(true); operand = read(location); break; }
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
 
-    setStatusC((bool)(result & 0b00000001));
+    setStatusC((bool)(operand & 0b00000001));
     uint8_t result = operand >> 1;
     setValueN(result);
     setValueZ(result);
 
     switch (opcode) {
     case 0x4A: { rac = result;               break; }
-    default:   { memory[location] = result;  break; }
+    default:   { modify<Accuracy>(location, operand, result); break; }
     }
 }
 
@@ -1094,7 +1240,7 @@ NOP  No Operation
 void CPU::NOP(uint16_t opcode) { //no operation
     switch (opcode) {
     case 0xEA: break;
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
 }
 
@@ -1117,18 +1263,19 @@ ORA  OR Memory with Accumulator
      (indirect),Y  ORA (oper),Y  11    2     5*
 
 *************************************************************************************/
+template <class Accuracy>
 void CPU::ORA(uint16_t opcode) { //or with accumulator
     uint8_t operand;
     switch (opcode) {
-    case 0x09: { operand = memory[rpc++];         break; }
-    case 0x05: { operand = memory[operandZpg()];  break; }
-    case 0x15: { operand = memory[operandZpgX()]; break; }
-    case 0x0D: { operand = memory[operandAbs()];  break; }
-    case 0x1D: { operand = memory[operandAbsX()]; break; }
-    case 0x19: { operand = memory[operandAbsY()]; break; }
-    case 0x01: { operand = memory[operandIndX()]; break; }
-    case 0x11: { operand = memory[operandIndY()]; break; }
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    case 0x09: { operand = read(rpc++);         break; }
+    case 0x05: { operand = read(operandZpg());  break; }
+    case 0x15: { operand = read(operandZpgX<Accuracy>()); break; }
+    case 0x0D: { operand = read(operandAbs());  break; }
+    case 0x1D: { operand = read(operandAbsX<Accuracy>()); break; }
+    case 0x19: { operand = read(operandAbsY<Accuracy>()); break; }
+    case 0x01: { operand = read(operandIndX<Accuracy>()); break; }
+    case 0x11: { operand = read(operandIndY<Accuracy>()); break; }
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
     rac |= operand;
     setValueZN(rac);
@@ -1149,8 +1296,10 @@ PHA  Push Accumulator on Stack
 void CPU::PHA(uint16_t opcode) { //push accumulator
     switch (opcode) {
     case 0x48: break;
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
+    internalCycle();
+    push(rac);
 }
 
 /************************************************************************************
@@ -1168,8 +1317,10 @@ PHP  Push Processor Status on Stack
 void CPU::PHP(uint16_t opcode) { //push processor status (SR)
     switch (opcode) {
     case 0x08: break;
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
+    internalCycle();
+    push(rsr | 0b00110000);
 }
 
 /************************************************************************************
@@ -1187,8 +1338,11 @@ PLA  Pull Accumulator from Stack
 void CPU::PLA(uint16_t opcode) { //pull accumulator
     switch (opcode) {
     case 0x68: break;
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
+    internalCycle(2); // the dummy read, then the stack pointer increment
+    rac = pull();
+    setValueZN(rac);
 }
 
 /************************************************************************************
@@ -1206,8 +1360,10 @@ PLP  Pull Processor Status from Stack
 void CPU::PLP(uint16_t opcode) { //pull processor status (SR)
     switch (opcode) {
     case 0x28: break;
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
+    internalCycle(2);
+    rsr = pull() & 0b11001111; // B and the unused bit only exist on the stack
 }
 
 /************************************************************************************
@@ -1226,16 +1382,17 @@ ROL  Rotate One Bit Left (Memory or Accumulator)
      absolute,X    ROL oper,X    3E    3     7
 
 *************************************************************************************/
+template <class Accuracy>
 void CPU::ROL(uint16_t opcode) { //rotate left
     uint8_t operand;
     uint16_t location;
     switch (opcode) {
     case 0x2A: { operand = rac;                   break; }
-    case 0x26: { location = operandZpg();  operand = memory[location];  break; }
-    case 0x36: { location = operandZpgX(); operand = memory[location]; break; }
-    case 0x2E: { location = operandAbs();  operand = memory[location];  break; }
-    case 0x3E: { location = operandAbsX(); operand = memory[location]; break; }
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    case 0x26: { location = operandZpg();  operand = read(location);  break; }
+    case 0x36: { location = operandZpgX<Accuracy>(); operand = read(location); break; }
+    case 0x2E: { location = operandAbs();  operand = read(location);  break; }
+    case 0x3E: { location = operandAbsX<Accuracy>(true); operand = read(location); break; }
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
 
     uint8_t carry = getStatusC();
@@ -1247,7 +1404,7 @@ void CPU::ROL(uint16_t opcode) { //rotate left
 
     switch (opcode) {
     case 0x2A: { rac = result;               break; }
-    default:   { memory[location] = result;  break; }
+    default:   { modify<Accuracy>(location, operand, result); break; }
     }
 }
 
@@ -1267,16 +1424,17 @@ ROR  Rotate One Bit Right (Memory or Accumulator)
      absolute,X    ROR oper,X    7E    3     7
 
 *************************************************************************************/
+template <class Accuracy>
 void CPU::ROR(uint16_t opcode) { //rotate right
     uint8_t operand;
     uint16_t location;
     switch (opcode) {
     case 0x6A: { operand = rac;                   break; }
-    case 0x66: { location = operandZpg();  operand = memory[location];  break; }
-    case 0x76: { location = operandZpgX(); operand = memory[location]; break; }
-    case 0x6E: { location = operandAbs();  operand = memory[location];  break; }
-    case 0x7E: { location = operandAbsX(); operand = memory[location]; break; }
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    case 0x66: { location = operandZpg();  operand = read(location);  break; }
+    case 0x76: { location = operandZpgX<Accuracy>(); operand = read(location); break; }
+    case 0x6E: { location = operandAbs();  operand = read(location);  break; }
+    case 0x7E: { location = operandAbsX<Accuracy>(true); operand = read(location); break; }
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
 
     uint8_t carry = getStatusC();
@@ -1288,8 +1446,8 @@ void CPU::ROR(uint16_t opcode) { //rotate right
     setValueZN(result);
 
     switch (opcode) {
-    case 0x6A: { rac = results;              break; }
-    default:   { memory[location] = result;  break; }
+    case 0x6A: { rac = result;               break; }
+    default:   { modify<Accuracy>(location, operand, result); break; }
     }
 }
 
@@ -1308,8 +1466,13 @@ RTI  Return from Interrupt
 void CPU::RTI(uint16_t opcode) { //return from interrupt
     switch (opcode) {
     case 0x40: break;
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
+    internalCycle(2);
+    rsr = pull() & 0b11001111;
+    uint16_t ll = pull();
+    uint16_t hh = pull();
+    rpc = (hh << 8) | ll;
 }
 
 /************************************************************************************
@@ -1327,8 +1490,12 @@ RTS  Return from Subroutine
 void CPU::RTS(uint16_t opcode) { //return from subroutine
     switch (opcode) {
     case 0x60: break;
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
+    internalCycle(2);
+    uint16_t ll = pull();
+    uint16_t hh = pull();
+    rpc = ((hh << 8) | ll) + 1; // the increment is the last cycle, added by endTimed()
 }
 
 /************************************************************************************
@@ -1350,19 +1517,21 @@ SBC  Subtract Memory from Accumulator with Borrow
      (indirect),Y  SBC (oper),Y  F1    2     5*
 
 *************************************************************************************/
+template <class Accuracy>
 void CPU::SBC(uint16_t opcode) { //subtract with carry
     uint8_t operand;
     switch (opcode) {
-    case 0xE9: { operand = memory[rpc++];         break; }
-    case 0xE5: { operand = memory[operandZpg()];  break; }
-    case 0xF5: { operand = memory[operandZpgX()]; break; }
-    case 0xED: { operand = memory[operandAbs()];  break; }
-    case 0xFD: { operand = memory[operandAbsX()]; break; }
-    case 0xF9: { operand = memory[operandAbsY()]; break; }
-    case 0xE1: { operand = memory[operandIndX()]; break; }
-    case 0xF1: { operand = memory[operandIndY()]; break; }
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    case 0xE9: { operand = read(rpc++);         break; }
+    case 0xE5: { operand = read(operandZpg());  break; }
+    case 0xF5: { operand = read(operandZpgX<Accuracy>()); break; }
+    case 0xED: { operand = read(operandAbs());  break; }
+    case 0xFD: { operand = read(operandAbsX<Accuracy>()); break; }
+    case 0xF9: { operand = read(operandAbsY<Accuracy>()); break; }
+    case 0xE1: { operand = read(operandIndX<Accuracy>()); break; }
+    case 0xF1: { operand = read(operandIndY<Accuracy>()); break; }
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
+    addWithCarry(uint8_t(~operand));
 }
 
 /************************************************************************************
@@ -1379,8 +1548,8 @@ SEC  Set Carry Flag
 *************************************************************************************/
 void CPU::SEC(uint16_t opcode) { //set carry
     switch (opcode) {
-    case 0x38: { setStatusC(true); rpc++; break; }
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    case 0x38: { setStatusC(true); break; }
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
 }
 
@@ -1398,8 +1567,8 @@ SED  Set Decimal Flag
 *************************************************************************************/
 void CPU::SED(uint16_t opcode) { //set decimal
     switch (opcode) {
-    case 0xF8: { setStatusD(true); rpc++; break; }
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    case 0xF8: { setStatusD(true); break; }
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
 }
 
@@ -1417,8 +1586,8 @@ SEI  Set Interrupt Disable Status
 *************************************************************************************/
 void CPU::SEI(uint16_t opcode) { //set interrupt disable
     switch (opcode) {
-    case 0x78: { setStatusI(true); rpc++; break; }
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    case 0x78: { setStatusI(true); break; }
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
 }
 
@@ -1440,19 +1609,20 @@ STA  Store Accumulator in Memory
      (indirect),Y  STA (oper),Y  91    2     6
 
 *************************************************************************************/
+template <class Accuracy>
 void CPU::STA(uint16_t opcode) { //store accumulator
     uint16_t operand;
     switch (opcode) {
     case 0x85: { operand = operandZpg();  break; }
-    case 0x95: { operand = operandZpgX(); break; }
+    case 0x95: { operand = operandZpgX<Accuracy>(); break; }
     case 0x8D: { operand = operandAbs();  break; }
-    case 0x9D: { operand = operandAbsX(); break; }
-    case 0x99: { operand = operandAbsY(); break; }
-    case 0x81: { operand = operandIndX(); break; }
-    case 0x91: { operand = operandIndY(); break; }
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    case 0x9D: { operand = operandAbsX<Accuracy>(true); break; }
+    case 0x99: { operand = operandAbsY<Accuracy>(true); break; }
+    case 0x81: { operand = operandIndX<Accuracy>(); break; }
+    case 0x91: { operand = operandIndY<Accuracy>(true); break; }
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
-    memory[operand] = rac;
+    write(operand, rac);
 }
 
 /************************************************************************************
@@ -1469,15 +1639,16 @@ STX  Store Index X in Memory
      absolute      STX oper      8E    3     4
 
 *************************************************************************************/
+template <class Accuracy>
 void CPU::STX(uint16_t opcode) { //store X
     uint16_t operand;
     switch (opcode) {
     case 0x86: { operand = operandZpg();  break; }
-    case 0x96: { operand = operandZpgX(); break; }
+    case 0x96: { operand = operandZpgY<Accuracy>(); break; }
     case 0x8E: { operand = operandAbs();  break; }
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
-    memory[operand] = rx;
+    write(operand, rx);
 }
 
 /************************************************************************************
@@ -1494,15 +1665,16 @@ STY  Store Index Y in Memory
      absolute      STY oper      8C    3     4
 
 *************************************************************************************/
+template <class Accuracy>
 void CPU::STY(uint16_t opcode) { //store Y
     uint16_t operand;
     switch (opcode) {
     case 0x84: { operand = operandZpg();  break; }
-    case 0x94: { operand = operandZpgX(); break; }
+    case 0x94: { operand = operandZpgX<Accuracy>(); break; }
     case 0x8C: { operand = operandAbs();  break; }
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
-    memory[operand] = ry;
+    write(operand, ry);
 }
 
 /************************************************************************************
@@ -1519,8 +1691,8 @@ TAX  Transfer Accumulator to Index X
 *************************************************************************************/
 void CPU::TAX(uint16_t opcode) { //transfer accumulator to X
     switch (opcode) {
-    case 0xAA: { rx = rac; rpc++; break; }
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    case 0xAA: { rx = rac; setValueZN(rx); break; }
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
 }
 
@@ -1538,8 +1710,8 @@ TAY  Transfer Accumulator to Index Y
 *************************************************************************************/
 void CPU::TAY(uint16_t opcode) { //transfer accumulator to Y
     switch (opcode) {
-    case 0xA8: { ry = rac; rpc++; break; }
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    case 0xA8: { ry = rac; setValueZN(ry); break; }
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
 }
 
@@ -1557,8 +1729,8 @@ TSX  Transfer Stack Pointer to Index X
 *************************************************************************************/
 void CPU::TSX(uint16_t opcode) { //transfer stack pointer to X
     switch (opcode) {
-    case 0xBA: { rx = rsp; rpc++; break; }
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    case 0xBA: { rx = rsp; setValueZN(rx); break; }
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
 }
 
@@ -1576,8 +1748,8 @@ TXA  Transfer Index X to Accumulator
 *************************************************************************************/
 void CPU::TXA(uint16_t opcode) { //transfer X to accumulator
     switch (opcode) {
-    case 0x8A: { rac = rx; rpc++; break; }
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    case 0x8A: { rac = rx; setValueZN(rac); break; }
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
 }
 
@@ -1595,8 +1767,8 @@ TXS  Transfer Index X to Stack Register
 *************************************************************************************/
 void CPU::TXS(uint16_t opcode) { //transfer X to stack pointer
     switch (opcode) {
-    case 0x9A: { rsp = rx; rpc++; break; }
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    case 0x9A: { rsp = rx; break; }
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
 }
 
@@ -1614,8 +1786,8 @@ TYA  Transfer Index Y to Accumulator
 *************************************************************************************/
 void CPU::TYA(uint16_t opcode) { //transfer Y to accumulator
     switch (opcode) {
-    case 0x98: { rac = ry; rpc++; break; }
-    default: throw std::runtime_error("Incorrect dispatch: " + opcode);
+    case 0x98: { rac = ry; setValueZN(rac); break; }
+    default: throw std::runtime_error("Incorrect dispatch: " + std::to_string(opcode));
     }
 }
 
@@ -1655,164 +1827,281 @@ void CPU::dump() {
     std::cout << separator << std::endl;
 }
 
+// base cycle counts from the opcode tables above; unimplemented opcodes are charged 2
+const uint8_t CPU::kCycles[256] = {
+    /* 0_ */ 7, 6, 2, 2, 2, 3, 5, 2, 3, 2, 2, 2, 2, 4, 6, 2,
+    /* 1_ */ 2, 5, 2, 2, 2, 4, 6, 2, 2, 4, 2, 2, 2, 4, 7, 2,
+    /* 2_ */ 6, 6, 2, 2, 3, 3, 5, 2, 4, 2, 2, 2, 4, 4, 6, 2,
+    /* 3_ */ 2, 5, 2, 2, 2, 4, 6, 2, 2, 4, 2, 2, 2, 4, 7, 2,
+    /* 4_ */ 6, 6, 2, 2, 2, 3, 5, 2, 3, 2, 2, 2, 3, 4, 6, 2,
+    /* 5_ */ 2, 5, 2, 2, 2, 4, 6, 2, 2, 4, 2, 2, 2, 4, 7, 2,
+    /* 6_ */ 6, 6, 2, 2, 2, 3, 5, 2, 4, 2, 2, 2, 5, 4, 6, 2,
+    /* 7_ */ 2, 5, 2, 2, 2, 4, 6, 2, 2, 4, 2, 2, 2, 4, 7, 2,
+    /* 8_ */ 2, 6, 2, 2, 3, 3, 3, 2, 2, 2, 2, 2, 4, 4, 4, 2,
+    /* 9_ */ 2, 6, 2, 2, 4, 4, 4, 2, 2, 5, 2, 2, 2, 5, 2, 2,
+    /* A_ */ 2, 6, 2, 2, 3, 3, 3, 2, 2, 2, 2, 2, 4, 4, 4, 2,
+    /* B_ */ 2, 5, 2, 2, 4, 4, 4, 2, 2, 4, 2, 2, 4, 4, 4, 2,
+    /* C_ */ 2, 6, 2, 2, 3, 3, 5, 2, 2, 2, 2, 2, 4, 4, 6, 2,
+    /* D_ */ 2, 5, 2, 2, 2, 4, 6, 2, 2, 4, 2, 2, 2, 4, 7, 2,
+    /* E_ */ 2, 6, 2, 2, 3, 3, 5, 2, 2, 2, 2, 2, 4, 4, 6, 2,
+    /* F_ */ 2, 5, 2, 2, 2, 4, 6, 2, 2, 4, 2, 2, 2, 4, 7, 2
+};
+
 void CPU::step() {
-    uint8_t opcode = memory[rpc++];
+    uint64_t start = cycles;
+    uint8_t opcode = read(rpc++);
 //    uint16_t byte = rawByte; // need to reassign to allow shift
 //    opcode = (byte << 8) | (opcode >> 8);
 
+    if (accuracy == BusAccuracy::Cycle) {
+        execute<CycleBus>(opcode);
+        endTimed(start, opcode);
+        return;
+    }
+    cycles += kCycles[opcode];
+    if (accuracy == BusAccuracy::Exact) {
+        execute<ExactBus>(opcode);
+    } else {
+        execute<FastBus>(opcode);
+    }
+}
+
+// per-cycle timing: every access has already advanced the clock by one, and so has
+// every internalCycle() that comes before one; the rest (internal cycles after the
+// last access, page-cross and branch penalties) is added here
+void CPU::endTimed(uint64_t start, uint8_t opcode) {
+    if (cycles < start + kCycles[opcode]) {
+        cycles = start + kCycles[opcode];
+    }
+}
+
+template <class Accuracy>
+void CPU::execute(uint8_t opcode) {
     switch (opcode) {
     case 0x00: BRK(opcode); break;
-    case 0x01: ORA(opcode); break;
-    case 0x05: ORA(opcode); break;
-    case 0x06: ASL(opcode); break;
+    case 0x01: ORA<Accuracy>(opcode); break;
+    case 0x05: ORA<Accuracy>(opcode); break;
+    case 0x06: ASL<Accuracy>(opcode); break;
     case 0x08: PHP(opcode); break;
-    case 0x09: ORA(opcode); break;
-    case 0x0A: ASL(opcode); break;
-    case 0x0D: ORA(opcode); break;
-    case 0x0E: ASL(opcode); break;
+    case 0x09: ORA<Accuracy>(opcode); break;
+    case 0x0A: ASL<Accuracy>(opcode); break;
+    case 0x0D: ORA<Accuracy>(opcode); break;
+    case 0x0E: ASL<Accuracy>(opcode); break;
     case 0x10: BPL(opcode); break;
-    case 0x11: ORA(opcode); break;
-    case 0x15: ORA(opcode); break;
-    case 0x16: ASL(opcode); break;
+    case 0x11: ORA<Accuracy>(opcode); break;
+    case 0x15: ORA<Accuracy>(opcode); break;
+    case 0x16: ASL<Accuracy>(opcode); break;
     case 0x18: CLC(opcode); break;
-    case 0x19: ORA(opcode); break;
-    case 0x1D: ORA(opcode); break;
-    case 0x1E: ASL(opcode); break;
+    case 0x19: ORA<Accuracy>(opcode); break;
+    case 0x1D: ORA<Accuracy>(opcode); break;
+    case 0x1E: ASL<Accuracy>(opcode); break;
     case 0x20: JSR(opcode); break;
-    case 0x21: AND(opcode); break;
+    case 0x21: AND<Accuracy>(opcode); break;
     case 0x24: BIT(opcode); break;
-    case 0x25: AND(opcode); break;
-    case 0x26: ROL(opcode); break;
+    case 0x25: AND<Accuracy>(opcode); break;
+    case 0x26: ROL<Accuracy>(opcode); break;
     case 0x28: PLP(opcode); break;
-    case 0x29: AND(opcode); break;
-    case 0x2A: ROL(opcode); break;
+    case 0x29: AND<Accuracy>(opcode); break;
+    case 0x2A: ROL<Accuracy>(opcode); break;
     case 0x2C: BIT(opcode); break;
-    case 0x2D: AND(opcode); break;
-    case 0x2E: ROL(opcode); break;
+    case 0x2D: AND<Accuracy>(opcode); break;
+    case 0x2E: ROL<Accuracy>(opcode); break;
     case 0x30: BMI(opcode); break;
-    case 0x31: AND(opcode); break;
-    case 0x35: AND(opcode); break;
-    case 0x36: ROL(opcode); break;
+    case 0x31: AND<Accuracy>(opcode); break;
+    case 0x35: AND<Accuracy>(opcode); break;
+    case 0x36: ROL<Accuracy>(opcode); break;
     case 0x38: SEC(opcode); break;
-    case 0x39: AND(opcode); break;
-    case 0x3D: AND(opcode); break;
-    case 0x3E: ROL(opcode); break;
+    case 0x39: AND<Accuracy>(opcode); break;
+    case 0x3D: AND<Accuracy>(opcode); break;
+    case 0x3E: ROL<Accuracy>(opcode); break;
     case 0x40: RTI(opcode); break;
-    case 0x41: EOR(opcode); break;
-    case 0x45: EOR(opcode); break;
-    case 0x46: LSR(opcode); break;
+    case 0x41: EOR<Accuracy>(opcode); break;
+    case 0x45: EOR<Accuracy>(opcode); break;
+    case 0x46: LSR<Accuracy>(opcode); break;
     case 0x48: PHA(opcode); break;
-    case 0x49: EOR(opcode); break;
-    case 0x4A: LSR(opcode); break;
+    case 0x49: EOR<Accuracy>(opcode); break;
+    case 0x4A: LSR<Accuracy>(opcode); break;
     case 0x4C: JMP(opcode); break;
-    case 0x4D: EOR(opcode); break;
-    case 0x4E: LSR(opcode); break;
+    case 0x4D: EOR<Accuracy>(opcode); break;
+    case 0x4E: LSR<Accuracy>(opcode); break;
     case 0x50: BVC(opcode); break;
-    case 0x51: EOR(opcode); break;
-    case 0x55: EOR(opcode); break;
-    case 0x56: LSR(opcode); break;
+    case 0x51: EOR<Accuracy>(opcode); break;
+    case 0x55: EOR<Accuracy>(opcode); break;
+    case 0x56: LSR<Accuracy>(opcode); break;
     case 0x58: CLI(opcode); break;
-    case 0x59: EOR(opcode); break;
-    case 0x5D: EOR(opcode); break;
-    case 0x5E: LSR(opcode); break;
+    case 0x59: EOR<Accuracy>(opcode); break;
+    case 0x5D: EOR<Accuracy>(opcode); break;
+    case 0x5E: LSR<Accuracy>(opcode); break;
     case 0x60: RTS(opcode); break;
-    case 0x61: ADC(opcode); break;
-    case 0x65: ADC(opcode); break;
-    case 0x66: ROR(opcode); break;
+    case 0x61: ADC<Accuracy>(opcode); break;
+    case 0x65: ADC<Accuracy>(opcode); break;
+    case 0x66: ROR<Accuracy>(opcode); break;
     case 0x68: PLA(opcode); break;
-    case 0x69: ADC(opcode); break;
-    case 0x6A: ROR(opcode); break;
+    case 0x69: ADC<Accuracy>(opcode); break;
+    case 0x6A: ROR<Accuracy>(opcode); break;
     case 0x6C: JMP(opcode); break;
-    case 0x6D: ADC(opcode); break;
-    case 0x6E: ROR(opcode); break;
+    case 0x6D: ADC<Accuracy>(opcode); break;
+    case 0x6E: ROR<Accuracy>(opcode); break;
     case 0x70: BVS(opcode); break;
-    case 0x71: ADC(opcode); break;
-    case 0x75: ADC(opcode); break;
-    case 0x76: ROR(opcode); break;
+    case 0x71: ADC<Accuracy>(opcode); break;
+    case 0x75: ADC<Accuracy>(opcode); break;
+    case 0x76: ROR<Accuracy>(opcode); break;
     case 0x78: SEI(opcode); break;
-    case 0x79: ADC(opcode); break;
-    case 0x7D: ADC(opcode); break;
-    case 0x7E: ROR(opcode); break;
-    case 0x81: STA(opcode); break;
-    case 0x84: STY(opcode); break;
-    case 0x85: STA(opcode); break;
-    case 0x86: STX(opcode); break;
+    case 0x79: ADC<Accuracy>(opcode); break;
+    case 0x7D: ADC<Accuracy>(opcode); break;
+    case 0x7E: ROR<Accuracy>(opcode); break;
+    case 0x81: STA<Accuracy>(opcode); break;
+    case 0x84: STY<Accuracy>(opcode); break;
+    case 0x85: STA<Accuracy>(opcode); break;
+    case 0x86: STX<Accuracy>(opcode); break;
     case 0x88: DEY(opcode); break;
     case 0x8A: TXA(opcode); break;
-    case 0x8C: STY(opcode); break;
-    case 0x8D: STA(opcode); break;
-    case 0x8E: STX(opcode); break;
+    case 0x8C: STY<Accuracy>(opcode); break;
+    case 0x8D: STA<Accuracy>(opcode); break;
+    case 0x8E: STX<Accuracy>(opcode); break;
     case 0x90: BCC(opcode); break;
-    case 0x91: STA(opcode); break;
-    case 0x94: STY(opcode); break;
-    case 0x95: STA(opcode); break;
-    case 0x96: STX(opcode); break;
+    case 0x91: STA<Accuracy>(opcode); break;
+    case 0x94: STY<Accuracy>(opcode); break;
+    case 0x95: STA<Accuracy>(opcode); break;
+    case 0x96: STX<Accuracy>(opcode); break;
     case 0x98: TYA(opcode); break;
-    case 0x99: STA(opcode); break;
+    case 0x99: STA<Accuracy>(opcode); break;
     case 0x9A: TXS(opcode); break;
-    case 0x9D: STA(opcode); break;
-    case 0xA0: LDY(opcode); break;
-    case 0xA1: LDA(opcode); break;
-    case 0xA2: LDX(opcode); break;
-    case 0xA4: LDY(opcode); break;
-    case 0xA5: LDA(opcode); break;
-    case 0xA6: LDX(opcode); break;
+    case 0x9D: STA<Accuracy>(opcode); break;
+    case 0xA0: LDY<Accuracy>(opcode); break;
+    case 0xA1: LDA<Accuracy>(opcode); break;
+    case 0xA2: LDX<Accuracy>(opcode); break;
+    case 0xA4: LDY<Accuracy>(opcode); break;
+    case 0xA5: LDA<Accuracy>(opcode); break;
+    case 0xA6: LDX<Accuracy>(opcode); break;
     case 0xA8: TAY(opcode); break;
-    case 0xA9: LDA(opcode); break;
+    case 0xA9: LDA<Accuracy>(opcode); break;
     case 0xAA: TAX(opcode); break;
-    case 0xAC: LDY(opcode); break;
-    case 0xAD: LDA(opcode); break;
-    case 0xAE: LDX(opcode); break;
+    case 0xAC: LDY<Accuracy>(opcode); break;
+    case 0xAD: LDA<Accuracy>(opcode); break;
+    case 0xAE: LDX<Accuracy>(opcode); break;
     case 0xB0: BCS(opcode); break;
-    case 0xB1: LDA(opcode); break;
-    case 0xB4: LDY(opcode); break;
-    case 0xB5: LDA(opcode); break;
-    case 0xB6: LDX(opcode); break;
+    case 0xB1: LDA<Accuracy>(opcode); break;
+    case 0xB4: LDY<Accuracy>(opcode); break;
+    case 0xB5: LDA<Accuracy>(opcode); break;
+    case 0xB6: LDX<Accuracy>(opcode); break;
     case 0xB8: CLV(opcode); break;
-    case 0xB9: LDA(opcode); break;
+    case 0xB9: LDA<Accuracy>(opcode); break;
     case 0xBA: TSX(opcode); break;
-    case 0xBC: LDY(opcode); break;
-    case 0xBD: LDA(opcode); break;
-    case 0xBE: LDX(opcode); break;
+    case 0xBC: LDY<Accuracy>(opcode); break;
+    case 0xBD: LDA<Accuracy>(opcode); break;
+    case 0xBE: LDX<Accuracy>(opcode); break;
     case 0xC0: CPY(opcode); break;
-    case 0xC1: CMP(opcode); break;
+    case 0xC1: CMP<Accuracy>(opcode); break;
     case 0xC4: CPY(opcode); break;
-    case 0xC5: CMP(opcode); break;
-    case 0xC6: DEC(opcode); break;
+    case 0xC5: CMP<Accuracy>(opcode); break;
+    case 0xC6: DEC<Accuracy>(opcode); break;
     case 0xC8: INY(opcode); break;
-    case 0xC9: CMP(opcode); break;
+    case 0xC9: CMP<Accuracy>(opcode); break;
     case 0xCA: DEX(opcode); break;
     case 0xCC: CPY(opcode); break;
-    case 0xCD: CMP(opcode); break;
-    case 0xCE: DEC(opcode); break;
+    case 0xCD: CMP<Accuracy>(opcode); break;
+    case 0xCE: DEC<Accuracy>(opcode); break;
     case 0xD0: BNE(opcode); break;
-    case 0xD1: CMP(opcode); break;
-    case 0xD5: CMP(opcode); break;
-    case 0xD6: DEC(opcode); break;
+    case 0xD1: CMP<Accuracy>(opcode); break;
+    case 0xD5: CMP<Accuracy>(opcode); break;
+    case 0xD6: DEC<Accuracy>(opcode); break;
     case 0xD8: CLD(opcode); break;
-    case 0xD9: CMP(opcode); break;
-    case 0xDD: CMP(opcode); break;
-    case 0xDE: DEC(opcode); break;
+    case 0xD9: CMP<Accuracy>(opcode); break;
+    case 0xDD: CMP<Accuracy>(opcode); break;
+    case 0xDE: DEC<Accuracy>(opcode); break;
     case 0xE0: CPX(opcode); break;
-    case 0xE1: SBC(opcode); break;
+    case 0xE1: SBC<Accuracy>(opcode); break;
     case 0xE4: CPX(opcode); break;
-    case 0xE5: SBC(opcode); break;
-    case 0xE6: INC(opcode); break;
+    case 0xE5: SBC<Accuracy>(opcode); break;
+    case 0xE6: INC<Accuracy>(opcode); break;
     case 0xE8: INX(opcode); break;
-    case 0xE9: SBC(opcode); break;
+    case 0xE9: SBC<Accuracy>(opcode); break;
     case 0xEA: NOP(opcode); break;
     case 0xEC: CPX(opcode); break;
-    case 0xED: SBC(opcode); break;
-    case 0xEE: INC(opcode); break;
+    case 0xED: SBC<Accuracy>(opcode); break;
+    case 0xEE: INC<Accuracy>(opcode); break;
     case 0xF0: BEQ(opcode); break;
-    case 0xF1: SBC(opcode); break;
-    case 0xF5: SBC(opcode); break;
-    case 0xF6: INC(opcode); break;
+    case 0xF1: SBC<Accuracy>(opcode); break;
+    case 0xF5: SBC<Accuracy>(opcode); break;
+    case 0xF6: INC<Accuracy>(opcode); break;
     case 0xF8: SED(opcode); break;
-    case 0xF9: SBC(opcode); break;
-    case 0xFD: SBC(opcode); break;
-    case 0xFE: INC(opcode); break;
+    case 0xF9: SBC<Accuracy>(opcode); break;
+    case 0xFD: SBC<Accuracy>(opcode); break;
+    case 0xFE: INC<Accuracy>(opcode); break;
     default:
-        std::cout << "Unexpected opcode: " << opcode << std::endl;
+        std::cout << "Unexpected opcode: $" << std::hex << int(opcode) << std::dec << std::endl;
+    }
+}
+
+// table-driven dispatch: mirrors the switch in execute() one-to-one, so the two paths
+// can be diffed against each other (see fuzz/cpu_fuzz.cpp); one table per policy
+template <class Accuracy>
+const CPU::Handler CPU::Dispatch<Accuracy>::kTable[256] = {
+    /* 0_ */ &CPU::BRK          , &CPU::ORA<Accuracy>, nullptr            , nullptr            , nullptr            , &CPU::ORA<Accuracy>, &CPU::ASL<Accuracy>, nullptr            ,
+             &CPU::PHP          , &CPU::ORA<Accuracy>, &CPU::ASL<Accuracy>, nullptr            , nullptr            , &CPU::ORA<Accuracy>, &CPU::ASL<Accuracy>, nullptr            ,
+    /* 1_ */ &CPU::BPL          , &CPU::ORA<Accuracy>, nullptr            , nullptr            , nullptr            , &CPU::ORA<Accuracy>, &CPU::ASL<Accuracy>, nullptr            ,
+             &CPU::CLC          , &CPU::ORA<Accuracy>, nullptr            , nullptr            , nullptr            , &CPU::ORA<Accuracy>, &CPU::ASL<Accuracy>, nullptr            ,
+    /* 2_ */ &CPU::JSR          , &CPU::AND<Accuracy>, nullptr            , nullptr            , &CPU::BIT          , &CPU::AND<Accuracy>, &CPU::ROL<Accuracy>, nullptr            ,
+             &CPU::PLP          , &CPU::AND<Accuracy>, &CPU::ROL<Accuracy>, nullptr            , &CPU::BIT          , &CPU::AND<Accuracy>, &CPU::ROL<Accuracy>, nullptr            ,
+    /* 3_ */ &CPU::BMI          , &CPU::AND<Accuracy>, nullptr            , nullptr            , nullptr            , &CPU::AND<Accuracy>, &CPU::ROL<Accuracy>, nullptr            ,
+             &CPU::SEC          , &CPU::AND<Accuracy>, nullptr            , nullptr            , nullptr            , &CPU::AND<Accuracy>, &CPU::ROL<Accuracy>, nullptr            ,
+    /* 4_ */ &CPU::RTI          , &CPU::EOR<Accuracy>, nullptr            , nullptr            , nullptr            , &CPU::EOR<Accuracy>, &CPU::LSR<Accuracy>, nullptr            ,
+             &CPU::PHA          , &CPU::EOR<Accuracy>, &CPU::LSR<Accuracy>, nullptr            , &CPU::JMP          , &CPU::EOR<Accuracy>, &CPU::LSR<Accuracy>, nullptr            ,
+    /* 5_ */ &CPU::BVC          , &CPU::EOR<Accuracy>, nullptr            , nullptr            , nullptr            , &CPU::EOR<Accuracy>, &CPU::LSR<Accuracy>, nullptr            ,
+             &CPU::CLI          , &CPU::EOR<Accuracy>, nullptr            , nullptr            , nullptr            , &CPU::EOR<Accuracy>, &CPU::LSR<Accuracy>, nullptr            ,
+    /* 6_ */ &CPU::RTS          , &CPU::ADC<Accuracy>, nullptr            , nullptr            , nullptr            , &CPU::ADC<Accuracy>, &CPU::ROR<Accuracy>, nullptr            ,
+             &CPU::PLA          , &CPU::ADC<Accuracy>, &CPU::ROR<Accuracy>, nullptr            , &CPU::JMP          , &CPU::ADC<Accuracy>, &CPU::ROR<Accuracy>, nullptr            ,
+    /* 7_ */ &CPU::BVS          , &CPU::ADC<Accuracy>, nullptr            , nullptr            , nullptr            , &CPU::ADC<Accuracy>, &CPU::ROR<Accuracy>, nullptr            ,
+             &CPU::SEI          , &CPU::ADC<Accuracy>, nullptr            , nullptr            , nullptr            , &CPU::ADC<Accuracy>, &CPU::ROR<Accuracy>, nullptr            ,
+    /* 8_ */ nullptr            , &CPU::STA<Accuracy>, nullptr            , nullptr            , &CPU::STY<Accuracy>, &CPU::STA<Accuracy>, &CPU::STX<Accuracy>, nullptr            ,
+             &CPU::DEY          , nullptr            , &CPU::TXA          , nullptr            , &CPU::STY<Accuracy>, &CPU::STA<Accuracy>, &CPU::STX<Accuracy>, nullptr            ,
+    /* 9_ */ &CPU::BCC          , &CPU::STA<Accuracy>, nullptr            , nullptr            , &CPU::STY<Accuracy>, &CPU::STA<Accuracy>, &CPU::STX<Accuracy>, nullptr            ,
+             &CPU::TYA          , &CPU::STA<Accuracy>, &CPU::TXS          , nullptr            , nullptr            , &CPU::STA<Accuracy>, nullptr            , nullptr            ,
+    /* A_ */ &CPU::LDY<Accuracy>, &CPU::LDA<Accuracy>, &CPU::LDX<Accuracy>, nullptr            , &CPU::LDY<Accuracy>, &CPU::LDA<Accuracy>, &CPU::LDX<Accuracy>, nullptr            ,
+             &CPU::TAY          , &CPU::LDA<Accuracy>, &CPU::TAX          , nullptr            , &CPU::LDY<Accuracy>, &CPU::LDA<Accuracy>, &CPU::LDX<Accuracy>, nullptr            ,
+    /* B_ */ &CPU::BCS          , &CPU::LDA<Accuracy>, nullptr            , nullptr            , &CPU::LDY<Accuracy>, &CPU::LDA<Accuracy>, &CPU::LDX<Accuracy>, nullptr            ,
+             &CPU::CLV          , &CPU::LDA<Accuracy>, &CPU::TSX          , nullptr            , &CPU::LDY<Accuracy>, &CPU::LDA<Accuracy>, &CPU::LDX<Accuracy>, nullptr            ,
+    /* C_ */ &CPU::CPY          , &CPU::CMP<Accuracy>, nullptr            , nullptr            , &CPU::CPY          , &CPU::CMP<Accuracy>, &CPU::DEC<Accuracy>, nullptr            ,
+             &CPU::INY          , &CPU::CMP<Accuracy>, &CPU::DEX          , nullptr            , &CPU::CPY          , &CPU::CMP<Accuracy>, &CPU::DEC<Accuracy>, nullptr            ,
+    /* D_ */ &CPU::BNE          , &CPU::CMP<Accuracy>, nullptr            , nullptr            , nullptr            , &CPU::CMP<Accuracy>, &CPU::DEC<Accuracy>, nullptr            ,
+             &CPU::CLD          , &CPU::CMP<Accuracy>, nullptr            , nullptr            , nullptr            , &CPU::CMP<Accuracy>, &CPU::DEC<Accuracy>, nullptr            ,
+    /* E_ */ &CPU::CPX          , &CPU::SBC<Accuracy>, nullptr            , nullptr            , &CPU::CPX          , &CPU::SBC<Accuracy>, &CPU::INC<Accuracy>, nullptr            ,
+             &CPU::INX          , &CPU::SBC<Accuracy>, &CPU::NOP          , nullptr            , &CPU::CPX          , &CPU::SBC<Accuracy>, &CPU::INC<Accuracy>, nullptr            ,
+    /* F_ */ &CPU::BEQ          , &CPU::SBC<Accuracy>, nullptr            , nullptr            , nullptr            , &CPU::SBC<Accuracy>, &CPU::INC<Accuracy>, nullptr            ,
+             &CPU::SED          , &CPU::SBC<Accuracy>, nullptr            , nullptr            , nullptr            , &CPU::SBC<Accuracy>, &CPU::INC<Accuracy>, nullptr
+};
+
+void CPU::stepTable() {
+    uint64_t start = cycles;
+    uint8_t opcode = read(rpc++);
+    dispatch(start, opcode);
+}
+
+void CPU::stepOpcode(uint8_t opcode) {
+    uint64_t start = cycles;
+    rpc++;
+    cycles += cycleTick; // the fetch we skipped
+    dispatch(start, opcode);
+}
+
+void CPU::dispatch(uint64_t start, uint8_t opcode) {
+    Handler handler;
+    switch (accuracy) {
+    case BusAccuracy::Fast:  handler = Dispatch<FastBus>::kTable[opcode];  break;
+    case BusAccuracy::Exact: handler = Dispatch<ExactBus>::kTable[opcode]; break;
+    default:                 handler = Dispatch<CycleBus>::kTable[opcode]; break;
+    }
+    if (accuracy != BusAccuracy::Cycle) {
+        cycles += kCycles[opcode];
+    }
+    if (handler == nullptr) {
+        std::cout << "Unexpected opcode: $" << std::hex << int(opcode) << std::dec << std::endl;
+        endTimed(start, opcode);
+        return;
+    }
+    (this->*handler)(opcode);
+    if (accuracy == BusAccuracy::Cycle) {
+        endTimed(start, opcode);
     }
 }
\ No newline at end of file
@@ -10,8 +10,12 @@ Authors     :   Yash Patel
 
 *************************************************************************************/
 
+#pragma once
+
 #include <stdint.h>
 
+#include "bus.h"
+
 // reference 6502 documentation: https://www.masswerk.at/6502/6502_instruction_set.html#PLP
 enum class AddressMode {
 	Immidiate,
@@ -20,14 +24,76 @@ enum class AddressMode {
 	Indirect
 };
 
-class CPU {
+// bus accuracy policies for the instruction handlers. The real 6502 touches the bus on
+// every cycle, including dummy accesses whose result it throws away: read-modify-write
+// instructions write the old value back before the new one, and indexed modes read
+// from the address before the carry into the high byte is fixed up (always for stores
+// and read-modify-writes, on a page cross for loads, where it's the extra cycle).
+// Memory-mapped registers and mappers can see those accesses. ExactBus performs them;
+// with FastBus they compile away entirely.
+//
+// CycleBus performs them too, and also timestamps them: instead of charging an
+// instruction's cycles up front, every bus access advances the cycle counter by one,
+// so getCycles() seen from a device's read()/write() is the cycle that access happens
+// on rather than the end of the instruction (cycles with no access in between, like
+// the stack pointer increment of a pull, are counted where they happen, so stack
+// traffic is stamped on the hardware's cycle too). Catch-up devices (the APU logs writes
+// with getCycles()) then interleave with the CPU at cycle granularity, while the run
+// loop still steps whole instructions and never has to stop for them.
+struct FastBus  { static const bool kDummyAccesses = false; static const bool kCycleTimed = false; };
+struct ExactBus { static const bool kDummyAccesses = true;  static const bool kCycleTimed = false; };
+struct CycleBus { static const bool kDummyAccesses = true;  static const bool kCycleTimed = true;  };
+
+// per-instance choice between the instantiations
+enum class BusAccuracy : uint8_t {
+	Fast,
+	Exact,
+	Cycle  // ExactBus plus per-access timing
+};
+
+// register state plus cycle counter, so tooling (fuzzers, snapshots) can read/restore
+// the CPU without going through dump()
+struct CPUState {
+	uint16_t pc;
+	uint8_t ac;
+	uint8_t x;
+	uint8_t y;
+	uint8_t sr;
+	uint8_t sp;
+	uint64_t cycles;
+
+	bool operator==(const CPUState& other) const {
+		return pc == other.pc && ac == other.ac && x == other.x &&
+			y == other.y && sr == other.sr && sp == other.sp && cycles == other.cycles;
+	}
+	bool operator!=(const CPUState& other) const { return !(*this == other); }
+};
+
+// Everything an instruction touches (registers, cycle counter, bus pointer, mode)
+// fits in one cache line, and the class is aligned to it, so stepping a CPU costs a
+// single line of its console however many consoles share the cache.
+class alignas(64) CPU {
 public:
-	CPU(uint8_t* memory);
+	CPU(Bus* bus);
 	~CPU() = default;
 
+	void reset(); // loads PC from the reset vector at FFFC
+	void nmi();   // non-maskable interrupt (raised by the PPU at vblank)
+	void irq();   // maskable interrupt (APU frame counter / DMC); ignored while I is set
 	void step();
+    void stepTable(); // same semantics as step(), dispatched through the Dispatch tables
+    void stepOpcode(uint8_t opcode); // stepTable() for an opcode the caller already read at PC
     void dump(); // dumps state (just used for debugging purposes)
 
+    CPUState state() const;
+    void setState(const CPUState& state);
+    uint64_t getCycles() const { return cycles; }
+    uint16_t getPC() const { return rpc; }
+    void stall(uint32_t count) { cycles += count; } // DMA: the CPU is halted for count cycles
+    void setCycles(uint64_t value) { cycles = value; } // compiled code (aotcode.h) keeps its own count
+    void setAccuracy(BusAccuracy value) { accuracy = value; cycleTick = value == BusAccuracy::Cycle ? 1 : 0; }
+    BusAccuracy getAccuracy() const { return accuracy; }
+
 private: 
 	// SR Flags (bit 7 to bit 0) carry different semantics -- functions to disentangle
     bool getStatusN();
@@ -37,7 +103,7 @@ private:
     bool getStatusI();
     bool getStatusZ();
     bool getStatusC();
-    uint8_t setBit(int which, bool bit);
+    void setBit(int which, bool bit);
     void setStatusN(bool bit);
     void setStatusV(bool bit);
     void setStatusB(bool bit);
@@ -45,25 +111,33 @@ private:
     void setStatusI(bool bit);
     void setStatusZ(bool bit);
     void setStatusC(bool bit);
+    void setValueZ(uint8_t value);
+    void setValueN(uint8_t value);
+    void setValueZN(uint8_t value);
 
     uint16_t operandAcc();
     uint16_t operandAbs();
-    uint16_t operandAbsX();
-    uint16_t operandAbsY();
+    template <class Accuracy> uint16_t operandAbsX(bool always = false); // always: store / RMW
+    template <class Accuracy> uint16_t operandAbsY(bool always = false);
     uint16_t operandImm();
     uint16_t operandInd();
-    uint16_t operandIndX();
-    uint16_t operandIndY();
+    template <class Accuracy> uint16_t operandIndX();
+    template <class Accuracy> uint16_t operandIndY(bool always = false);
     uint16_t operandRelative();
     uint16_t operandZpg();
-    uint16_t operandZpgX();
-    uint16_t operandZpgX();
+    template <class Accuracy> uint16_t operandZpgX();
+    template <class Accuracy> uint16_t operandZpgY();
 
-    void branch();
+    template <class Accuracy> uint16_t indexed(uint16_t base, uint8_t index, bool always);
+    template <class Accuracy> void modify(uint16_t addr, uint8_t old, uint8_t value);
 
-    void ADC(uint16_t opcode);
-    void AND(uint16_t opcode);
-    void ASL(uint16_t opcode);
+    void branch(uint16_t opcode, uint16_t instOp, bool check);
+    void compare(uint8_t reg, uint8_t mem);
+    void addWithCarry(uint8_t operand);
+
+    template <class Accuracy> void ADC(uint16_t opcode);
+    template <class Accuracy> void AND(uint16_t opcode);
+    template <class Accuracy> void ASL(uint16_t opcode);
     void BCC(uint16_t opcode);
     void BCS(uint16_t opcode);
     void BEQ(uint16_t opcode);
@@ -78,39 +152,39 @@ private:
     void CLD(uint16_t opcode);
     void CLI(uint16_t opcode);
     void CLV(uint16_t opcode);
-    void CMP(uint16_t opcode);
+    template <class Accuracy> void CMP(uint16_t opcode);
     void CPX(uint16_t opcode);
     void CPY(uint16_t opcode);
-    void DEC(uint16_t opcode);
+    template <class Accuracy> void DEC(uint16_t opcode);
     void DEX(uint16_t opcode);
     void DEY(uint16_t opcode);
-    void EOR(uint16_t opcode);
-    void INC(uint16_t opcode);
+    template <class Accuracy> void EOR(uint16_t opcode);
+    template <class Accuracy> void INC(uint16_t opcode);
     void INX(uint16_t opcode);
     void INY(uint16_t opcode);
     void JMP(uint16_t opcode);
     void JSR(uint16_t opcode);
-    void LDA(uint16_t opcode);
-    void LDX(uint16_t opcode);
-    void LDY(uint16_t opcode);
-    void LSR(uint16_t opcode);
+    template <class Accuracy> void LDA(uint16_t opcode);
+    template <class Accuracy> void LDX(uint16_t opcode);
+    template <class Accuracy> void LDY(uint16_t opcode);
+    template <class Accuracy> void LSR(uint16_t opcode);
     void NOP(uint16_t opcode);
-    void ORA(uint16_t opcode);
+    template <class Accuracy> void ORA(uint16_t opcode);
     void PHA(uint16_t opcode);
     void PHP(uint16_t opcode);
     void PLA(uint16_t opcode);
     void PLP(uint16_t opcode);
-    void ROL(uint16_t opcode);
-    void ROR(uint16_t opcode);
+    template <class Accuracy> void ROL(uint16_t opcode);
+    template <class Accuracy> void ROR(uint16_t opcode);
     void RTI(uint16_t opcode);
     void RTS(uint16_t opcode);
-    void SBC(uint16_t opcode);
+    template <class Accuracy> void SBC(uint16_t opcode);
     void SEC(uint16_t opcode);
     void SED(uint16_t opcode);
     void SEI(uint16_t opcode);
-    void STA(uint16_t opcode);
-    void STX(uint16_t opcode);
-    void STY(uint16_t opcode);
+    template <class Accuracy> void STA(uint16_t opcode);
+    template <class Accuracy> void STX(uint16_t opcode);
+    template <class Accuracy> void STY(uint16_t opcode);
     void TAX(uint16_t opcode);
     void TAY(uint16_t opcode);
     void TSX(uint16_t opcode);
@@ -118,9 +192,29 @@ private:
     void TXS(uint16_t opcode);
     void TYA(uint16_t opcode);
 
-    uint16_t readShort(uint16_t addr);
+    uint16_t readOperandShort(); // little-endian operand at PC, advancing past it
+    // a cycle without a bus access (or with a dummy one the handlers don't perform), so
+    // CycleBus stamps the accesses after it on the right cycle
+    void internalCycle(uint8_t count = 1) { cycles += cycleTick * count; }
+    uint8_t read(uint16_t addr) { cycles += cycleTick; return bus->read(addr); }
+    void write(uint16_t addr, uint8_t value) { cycles += cycleTick; bus->write(addr, value); }
+    void push(uint8_t value);
+    uint8_t pull();
+    void interrupt(uint16_t vector); // NMI/IRQ sequence: push PC and status, jump through vector
+
+    template <class Accuracy> void execute(uint8_t opcode);
+    void endTimed(uint64_t start, uint8_t opcode);
+    void dispatch(uint64_t start, uint8_t opcode); // stepTable() after the fetch
 
-	uint8_t* memory;
+    typedef void (CPU::*Handler)(uint16_t opcode);
+    template <class Accuracy>
+    struct Dispatch {
+        static const Handler kTable[256]; // opcode -> handler, nullptr if unimplemented
+    };
+    static const uint8_t kCycles[256];   // opcode -> base cycle count (no page-cross/branch penalty)
+
+	Bus* bus;
+	uint64_t cycles; // CPU cycles executed since power on
 
     uint16_t opcode;
 	uint16_t rpc; // program counter (16 bit)
@@ -129,4 +223,8 @@ private:
 	uint8_t ry;   // Y register  (8 bit)
 	uint8_t rsr;  // status register [NV-BDIZC]  (8 bit)
 	uint8_t rsp;  // stack pointer   (8 bit)
-};
\ No newline at end of file
+
+	uint8_t cycleTick; // 1 with BusAccuracy::Cycle, so the fast path stays branch free
+	BusAccuracy accuracy;
+};
+static_assert(sizeof(CPU) == 64, "CPU state is meant to fit one cache line");
\ No newline at end of file
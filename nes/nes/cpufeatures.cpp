@@ -0,0 +1,46 @@
+/************************************************************************************
+
+Filename    :   cpufeatures.cpp
+Content     :   Instruction set extensions of the CPU we run on
+Authors     :   Yash Patel
+
+*************************************************************************************/
+
+#include "cpufeatures.h"
+
+#if defined(NES_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(NES_X86)
+#include <cpuid.h>
+#endif
+
+namespace {
+
+CpuFeatures detect() {
+    CpuFeatures features = {};
+#ifdef NES_X86
+    // leaf 1: feature bits in ECX
+    unsigned int ecx = 0;
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    ecx = unsigned(info[2]);
+#else
+    unsigned int eax, ebx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        ecx = 0;
+    }
+#endif
+    features.ssse3 = (ecx & (1u << 9)) != 0;
+    features.sse41 = (ecx & (1u << 19)) != 0;
+    features.pclmul = (ecx & (1u << 1)) != 0;
+#endif
+    return features;
+}
+
+} // namespace
+
+const CpuFeatures& cpuFeatures() {
+    static const CpuFeatures features = detect();
+    return features;
+}
@@ -0,0 +1,38 @@
+/************************************************************************************
+
+Filename    :   cpufeatures.h
+Content     :   Instruction set extensions of the CPU we run on (header)
+Authors     :   Yash Patel
+
+The SIMD paths are compiled into every x86 build, whatever the compiler was told it
+may assume (MSVC's intrinsics don't need /arch, GCC and Clang get a target attribute
+on each function that uses them), and only taken when the CPU running the emulator
+reports the extension. That keeps the project settings free of /arch flags, which
+would make the whole binary require the extension.
+
+    #ifdef NES_X86
+    if (cpuFeatures().ssse3) { ... NES_TARGET("ssse3") function ... }
+    #endif
+
+*************************************************************************************/
+
+#pragma once
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define NES_X86 1
+#endif
+
+// lets a GCC/Clang function use an extension's intrinsics; MSVC always does
+#if defined(_MSC_VER) && !defined(__clang__)
+#define NES_TARGET(features)
+#else
+#define NES_TARGET(features) __attribute__((target(features)))
+#endif
+
+struct CpuFeatures {
+	bool ssse3;
+	bool sse41;
+	bool pclmul;
+};
+
+const CpuFeatures& cpuFeatures(); // detected on first use
@@ -0,0 +1,234 @@
+/************************************************************************************
+
+Filename    :   debugger.cpp
+Content     :   Breakpoints, watchpoints and stepping
+Authors     :   Yash Patel
+
+*************************************************************************************/
+
+#include "debugger.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "console.h"
+
+namespace {
+
+const uint8_t kJSR = 0x20;
+const uint8_t kRTS = 0x60;
+const uint8_t kRTI = 0x40;
+
+} // namespace
+
+Debugger::Debugger(Console& console) :
+    console(console),
+    cpu(console.getCPU()),
+    bus(console.getBus()),
+    nextId(1),
+    step(StepMode::None),
+    stepTarget(0),
+    stepStack(0),
+    lastOpcode(0),
+    pending(false),
+    resuming(false),
+    stopPC(0) {
+    memset(breakPages, 0, sizeof(breakPages));
+    stop.reason = Reason::None;
+    stop.id = -1;
+    stop.addr = 0;
+    stop.value = 0;
+    stop.write = false;
+    bus.setObserver(this);
+    console.setDebugger(this);
+}
+
+Debugger::~Debugger() {
+    clear();
+    console.setDebugger(nullptr);
+    bus.setObserver(nullptr);
+}
+
+int Debugger::addBreakpoint(uint16_t pc, const Condition& condition) {
+    Breakpoint breakpoint = { nextId, pc, condition };
+    breakpoints.push_back(breakpoint);
+    breakPages[pc >> 8]++;
+    return nextId++;
+}
+
+int Debugger::addWatchpoint(uint16_t start, uint16_t end, Access access, const Condition& condition) {
+    Watchpoint watchpoint = { nextId, start, std::max(start, end), access, condition };
+    watchpoints.push_back(watchpoint);
+    updateTraps();
+    return nextId++;
+}
+
+void Debugger::remove(int id) {
+    for (size_t i = 0; i < breakpoints.size(); i++) {
+        if (breakpoints[i].id == id) {
+            breakPages[breakpoints[i].pc >> 8]--;
+            breakpoints.erase(breakpoints.begin() + i);
+            return;
+        }
+    }
+    for (size_t i = 0; i < watchpoints.size(); i++) {
+        if (watchpoints[i].id == id) {
+            watchpoints.erase(watchpoints.begin() + i);
+            updateTraps();
+            return;
+        }
+    }
+}
+
+void Debugger::clear() {
+    breakpoints.clear();
+    watchpoints.clear();
+    memset(breakPages, 0, sizeof(breakPages));
+    step = StepMode::None;
+    pending = false;
+    updateTraps();
+}
+
+void Debugger::updateTraps() {
+    uint8_t traps[Bus::kPageCount] = {};
+    for (const Watchpoint& watchpoint : watchpoints) {
+        uint8_t bits = 0;
+        bits |= (int(watchpoint.access) & int(Access::Read)) ? Bus::kTrapRead : 0;
+        bits |= (int(watchpoint.access) & int(Access::Write)) ? Bus::kTrapWrite : 0;
+        for (int page = watchpoint.start >> 8; page <= watchpoint.end >> 8; page++) {
+            traps[page] |= bits;
+        }
+    }
+    for (int page = 0; page < Bus::kPageCount; page++) {
+        bus.setTraps(uint8_t(page), traps[page]);
+    }
+}
+
+// running
+
+Debugger::Reason Debugger::run(int maxFrames) {
+    stop.reason = Reason::None;
+    resuming = true;
+    for (int i = 0; i < maxFrames; i++) {
+        if (!console.runFrame()) {
+            return stop.reason;
+        }
+    }
+    step = StepMode::None; // don't leave a step armed behind an unfinished run
+    return Reason::None;
+}
+
+Debugger::Reason Debugger::resume(int maxFrames) {
+    return run(maxFrames);
+}
+
+Debugger::Reason Debugger::stepInto() {
+    step = StepMode::Into;
+    return run(2); // the next instruction is at most one scanline boundary away
+}
+
+Debugger::Reason Debugger::stepOver(int maxFrames) {
+    uint16_t pc = cpu.getPC();
+    if (bus.peek(pc) != kJSR) {
+        return stepInto();
+    }
+    step = StepMode::Over;
+    stepTarget = uint16_t(pc + 3);
+    stepStack = cpu.state().sp;
+    return run(maxFrames);
+}
+
+Debugger::Reason Debugger::stepOut(int maxFrames) {
+    step = StepMode::Out;
+    stepStack = cpu.state().sp;
+    return run(maxFrames);
+}
+
+// console side
+
+bool Debugger::beforeInstruction() {
+    if (pending) {
+        // an access outside any instruction (interrupt pushes, DMA) hit a watchpoint
+        pending = false;
+        step = StepMode::None;
+        stopPC = cpu.getPC();
+        return true;
+    }
+
+    uint16_t pc = cpu.getPC();
+    if (step == StepMode::Out) {
+        lastOpcode = bus.peek(pc);
+    }
+    bool skip = resuming && pc == stopPC;
+    resuming = false;
+    if (skip || breakPages[pc >> 8] == 0) {
+        return false;
+    }
+
+    for (const Breakpoint& breakpoint : breakpoints) {
+        if (breakpoint.pc != pc) {
+            continue;
+        }
+        uint8_t opcode = bus.peek(pc);
+        if (!breakpoint.condition || breakpoint.condition(cpu.state(), pc, opcode)) {
+            stop.reason = Reason::Breakpoint;
+            stop.id = breakpoint.id;
+            stop.addr = pc;
+            stop.value = opcode;
+            stop.write = false;
+            step = StepMode::None;
+            stopPC = pc;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Debugger::afterInstruction() {
+    CPUState state = cpu.state();
+    bool done = pending;
+    pending = false;
+
+    if (!done) {
+        switch (step) {
+        case StepMode::None: return false;
+        case StepMode::Into: done = true; break;
+        case StepMode::Over: done = state.pc == stepTarget && state.sp == stepStack; break;
+        case StepMode::Out:  done = (lastOpcode == kRTS || lastOpcode == kRTI) && state.sp > stepStack; break;
+        }
+        if (done) {
+            stop.reason = Reason::Step;
+            stop.id = -1;
+            stop.addr = state.pc;
+            stop.value = 0;
+            stop.write = false;
+        }
+    }
+    if (done) {
+        step = StepMode::None;
+        stopPC = state.pc;
+    }
+    return done;
+}
+
+void Debugger::onAccess(uint16_t addr, uint8_t value, bool write) {
+    if (pending) {
+        return; // the first hit of an instruction is the one reported
+    }
+    Access kind = write ? Access::Write : Access::Read;
+    for (const Watchpoint& watchpoint : watchpoints) {
+        if (addr < watchpoint.start || addr > watchpoint.end || !(int(watchpoint.access) & int(kind))) {
+            continue;
+        }
+        if (!watchpoint.condition || watchpoint.condition(cpu.state(), addr, value)) {
+            stop.reason = Reason::Watchpoint;
+            stop.id = watchpoint.id;
+            stop.addr = addr;
+            stop.value = value;
+            stop.write = write;
+            pending = true;
+            return;
+        }
+    }
+}
@@ -0,0 +1,127 @@
+/************************************************************************************
+
+Filename    :   debugger.h
+Content     :   Breakpoints, watchpoints and stepping (header)
+Authors     :   Yash Patel
+
+A Debugger attaches to a live console; nothing about the console changes until
+something is armed. Watchpoints set trap bits on the pages they cover (see bus.h),
+so only accesses to those pages leave the direct path and get checked. Breakpoints
+and stepping are checked at instruction boundaries, but only while anything at all
+is armed: the console picks its instruction loop once per scanline, and with
+nothing armed it runs the plain one.
+
+Stops happen at instruction boundaries. A breakpoint stops before its instruction
+runs; a watchpoint stops after the instruction that made the access. When stopped,
+Console::runFrame() has returned false in the middle of a frame, and calling it
+again (or any of the run functions here) resumes exactly where it left off.
+
+Conditions get the CPU registers at the time of the check plus the address and value
+involved (the opcode for breakpoints), and return whether to stop.
+
+*************************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <functional>
+#include <vector>
+
+#include "bus.h"
+#include "cpu.h"
+
+class Console;
+
+class Debugger : public BusObserver {
+public:
+	enum class Access {
+		Read = 1,
+		Write = 2,
+		ReadWrite = 3
+	};
+
+	enum class Reason {
+		None,       // still running (frame limit reached)
+		Breakpoint,
+		Watchpoint,
+		Step
+	};
+
+	struct Stop {
+		Reason reason;
+		int id;          // breakpoint / watchpoint that hit, -1 for steps
+		uint16_t addr;   // PC for breakpoints, accessed address for watchpoints
+		uint8_t value;   // value read or written
+		bool write;
+	};
+
+	typedef std::function<bool(const CPUState& cpu, uint16_t addr, uint8_t value)> Condition;
+
+	explicit Debugger(Console& console); // attaches
+	~Debugger() override;                // detaches and clears every trap
+
+	int addBreakpoint(uint16_t pc, const Condition& condition = Condition());
+	int addWatchpoint(uint16_t start, uint16_t end, Access access, const Condition& condition = Condition());
+	void remove(int id);
+	void clear();
+
+	// each runs frames until a stop, or maxFrames frames; returns the stop reason
+	Reason resume(int maxFrames = 600);
+	Reason stepInto();                   // one instruction
+	Reason stepOver(int maxFrames = 600); // a JSR runs to its return as one step
+	Reason stepOut(int maxFrames = 600);  // until the current subroutine returns
+
+	const Stop& lastStop() const { return stop; }
+	bool isArmed() const { return !breakpoints.empty() || !watchpoints.empty() || step != StepMode::None; }
+
+	// console side, only called while armed; true stops execution
+	bool beforeInstruction();
+	bool afterInstruction();
+
+	void onAccess(uint16_t addr, uint8_t value, bool write) override;
+
+private:
+	enum class StepMode {
+		None,
+		Into,
+		Over, // until PC == stepTarget with the stack back at stepStack
+		Out   // until an RTS/RTI leaves the stack above stepStack
+	};
+
+	struct Breakpoint {
+		int id;
+		uint16_t pc;
+		Condition condition;
+	};
+
+	struct Watchpoint {
+		int id;
+		uint16_t start;
+		uint16_t end;
+		Access access;
+		Condition condition;
+	};
+
+	Reason run(int maxFrames);
+	void updateTraps(); // recomputes the bus trap bits from the watchpoints
+
+	Console& console;
+	CPU& cpu;
+	Bus& bus;
+
+	std::vector<Breakpoint> breakpoints;
+	std::vector<Watchpoint> watchpoints;
+	uint16_t breakPages[Bus::kPageCount]; // breakpoints per page, so most PCs cost one load
+	int nextId;
+
+	StepMode step;
+	uint16_t stepTarget;
+	uint8_t stepStack;
+	uint8_t lastOpcode;
+
+	bool pending;     // a watchpoint hit during the current instruction
+	bool resuming;    // skip the breakpoint at the PC we stopped on, once
+	uint16_t stopPC;
+	Stop stop;
+};
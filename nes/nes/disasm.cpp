@@ -0,0 +1,142 @@
+/************************************************************************************
+
+Filename    :   disasm.cpp
+Content     :   6502 opcode table and disassembler
+Authors     :   Yash Patel
+
+*************************************************************************************/
+
+#include "disasm.h"
+
+#include <stdio.h>
+
+namespace {
+
+typedef OpcodeInfo::Mode Mode;
+
+const uint8_t kBranch = OpcodeInfo::kBranch;
+const uint8_t kJump   = OpcodeInfo::kJump;
+const uint8_t kCall   = OpcodeInfo::kCall;
+const uint8_t kReturn = OpcodeInfo::kReturn;
+const uint8_t kStop   = OpcodeInfo::kStop;
+
+// reference: https://www.masswerk.at/6502/6502_instruction_set.html
+const OpcodeInfo kOpcodes[256] = {
+    /* 0_ */ { "BRK", Mode::Implied, kStop },    { "ORA", Mode::IndirectX, 0 },      { "???", Mode::Implied, kStop },    { "???", Mode::Implied, kStop },
+              { "???", Mode::Implied, kStop },    { "ORA", Mode::ZeroPage, 0 },       { "ASL", Mode::ZeroPage, 0 },       { "???", Mode::Implied, kStop },
+              { "PHP", Mode::Implied, 0 },        { "ORA", Mode::Immediate, 0 },      { "ASL", Mode::Accumulator, 0 },    { "???", Mode::Implied, kStop },
+              { "???", Mode::Implied, kStop },    { "ORA", Mode::Absolute, 0 },       { "ASL", Mode::Absolute, 0 },       { "???", Mode::Implied, kStop },
+    /* 1_ */ { "BPL", Mode::Relative, kBranch }, { "ORA", Mode::IndirectY, 0 },      { "???", Mode::Implied, kStop },    { "???", Mode::Implied, kStop },
+              { "???", Mode::Implied, kStop },    { "ORA", Mode::ZeroPageX, 0 },      { "ASL", Mode::ZeroPageX, 0 },      { "???", Mode::Implied, kStop },
+              { "CLC", Mode::Implied, 0 },        { "ORA", Mode::AbsoluteY, 0 },      { "???", Mode::Implied, kStop },    { "???", Mode::Implied, kStop },
+              { "???", Mode::Implied, kStop },    { "ORA", Mode::AbsoluteX, 0 },      { "ASL", Mode::AbsoluteX, 0 },      { "???", Mode::Implied, kStop },
+    /* 2_ */ { "JSR", Mode::Absolute, kCall },   { "AND", Mode::IndirectX, 0 },      { "???", Mode::Implied, kStop },    { "???", Mode::Implied, kStop },
+              { "BIT", Mode::ZeroPage, 0 },       { "AND", Mode::ZeroPage, 0 },       { "ROL", Mode::ZeroPage, 0 },       { "???", Mode::Implied, kStop },
+              { "PLP", Mode::Implied, 0 },        { "AND", Mode::Immediate, 0 },      { "ROL", Mode::Accumulator, 0 },    { "???", Mode::Implied, kStop },
+              { "BIT", Mode::Absolute, 0 },       { "AND", Mode::Absolute, 0 },       { "ROL", Mode::Absolute, 0 },       { "???", Mode::Implied, kStop },
+    /* 3_ */ { "BMI", Mode::Relative, kBranch }, { "AND", Mode::IndirectY, 0 },      { "???", Mode::Implied, kStop },    { "???", Mode::Implied, kStop },
+              { "???", Mode::Implied, kStop },    { "AND", Mode::ZeroPageX, 0 },      { "ROL", Mode::ZeroPageX, 0 },      { "???", Mode::Implied, kStop },
+              { "SEC", Mode::Implied, 0 },        { "AND", Mode::AbsoluteY, 0 },      { "???", Mode::Implied, kStop },    { "???", Mode::Implied, kStop },
+              { "???", Mode::Implied, kStop },    { "AND", Mode::AbsoluteX, 0 },      { "ROL", Mode::AbsoluteX, 0 },      { "???", Mode::Implied, kStop },
+    /* 4_ */ { "RTI", Mode::Implied, kReturn },  { "EOR", Mode::IndirectX, 0 },      { "???", Mode::Implied, kStop },    { "???", Mode::Implied, kStop },
+              { "???", Mode::Implied, kStop },    { "EOR", Mode::ZeroPage, 0 },       { "LSR", Mode::ZeroPage, 0 },       { "???", Mode::Implied, kStop },
+              { "PHA", Mode::Implied, 0 },        { "EOR", Mode::Immediate, 0 },      { "LSR", Mode::Accumulator, 0 },    { "???", Mode::Implied, kStop },
+              { "JMP", Mode::Absolute, kJump },   { "EOR", Mode::Absolute, 0 },       { "LSR", Mode::Absolute, 0 },       { "???", Mode::Implied, kStop },
+    /* 5_ */ { "BVC", Mode::Relative, kBranch }, { "EOR", Mode::IndirectY, 0 },      { "???", Mode::Implied, kStop },    { "???", Mode::Implied, kStop },
+              { "???", Mode::Implied, kStop },    { "EOR", Mode::ZeroPageX, 0 },      { "LSR", Mode::ZeroPageX, 0 },      { "???", Mode::Implied, kStop },
+              { "CLI", Mode::Implied, 0 },        { "EOR", Mode::AbsoluteY, 0 },      { "???", Mode::Implied, kStop },    { "???", Mode::Implied, kStop },
+              { "???", Mode::Implied, kStop },    { "EOR", Mode::AbsoluteX, 0 },      { "LSR", Mode::AbsoluteX, 0 },      { "???", Mode::Implied, kStop },
+    /* 6_ */ { "RTS", Mode::Implied, kReturn },  { "ADC", Mode::IndirectX, 0 },      { "???", Mode::Implied, kStop },    { "???", Mode::Implied, kStop },
+              { "???", Mode::Implied, kStop },    { "ADC", Mode::ZeroPage, 0 },       { "ROR", Mode::ZeroPage, 0 },       { "???", Mode::Implied, kStop },
+              { "PLA", Mode::Implied, 0 },        { "ADC", Mode::Immediate, 0 },      { "ROR", Mode::Accumulator, 0 },    { "???", Mode::Implied, kStop },
+              { "JMP", Mode::Indirect, kJump },   { "ADC", Mode::Absolute, 0 },       { "ROR", Mode::Absolute, 0 },       { "???", Mode::Implied, kStop },
+    /* 7_ */ { "BVS", Mode::Relative, kBranch }, { "ADC", Mode::IndirectY, 0 },      { "???", Mode::Implied, kStop },    { "???", Mode::Implied, kStop },
+              { "???", Mode::Implied, kStop },    { "ADC", Mode::ZeroPageX, 0 },      { "ROR", Mode::ZeroPageX, 0 },      { "???", Mode::Implied, kStop },
+              { "SEI", Mode::Implied, 0 },        { "ADC", Mode::AbsoluteY, 0 },      { "???", Mode::Implied, kStop },    { "???", Mode::Implied, kStop },
+              { "???", Mode::Implied, kStop },    { "ADC", Mode::AbsoluteX, 0 },      { "ROR", Mode::AbsoluteX, 0 },      { "???", Mode::Implied, kStop },
+    /* 8_ */ { "???", Mode::Implied, kStop },    { "STA", Mode::IndirectX, 0 },      { "???", Mode::Implied, kStop },    { "???", Mode::Implied, kStop },
+              { "STY", Mode::ZeroPage, 0 },       { "STA", Mode::ZeroPage, 0 },       { "STX", Mode::ZeroPage, 0 },       { "???", Mode::Implied, kStop },
+              { "DEY", Mode::Implied, 0 },        { "???", Mode::Implied, kStop },    { "TXA", Mode::Implied, 0 },        { "???", Mode::Implied, kStop },
+              { "STY", Mode::Absolute, 0 },       { "STA", Mode::Absolute, 0 },       { "STX", Mode::Absolute, 0 },       { "???", Mode::Implied, kStop },
+    /* 9_ */ { "BCC", Mode::Relative, kBranch }, { "STA", Mode::IndirectY, 0 },      { "???", Mode::Implied, kStop },    { "???", Mode::Implied, kStop },
+              { "STY", Mode::ZeroPageX, 0 },      { "STA", Mode::ZeroPageX, 0 },      { "STX", Mode::ZeroPageY, 0 },      { "???", Mode::Implied, kStop },
+              { "TYA", Mode::Implied, 0 },        { "STA", Mode::AbsoluteY, 0 },      { "TXS", Mode::Implied, 0 },        { "???", Mode::Implied, kStop },
+              { "???", Mode::Implied, kStop },    { "STA", Mode::AbsoluteX, 0 },      { "???", Mode::Implied, kStop },    { "???", Mode::Implied, kStop },
+    /* A_ */ { "LDY", Mode::Immediate, 0 },      { "LDA", Mode::IndirectX, 0 },      { "LDX", Mode::Immediate, 0 },      { "???", Mode::Implied, kStop },
+              { "LDY", Mode::ZeroPage, 0 },       { "LDA", Mode::ZeroPage, 0 },       { "LDX", Mode::ZeroPage, 0 },       { "???", Mode::Implied, kStop },
+              { "TAY", Mode::Implied, 0 },        { "LDA", Mode::Immediate, 0 },      { "TAX", Mode::Implied, 0 },        { "???", Mode::Implied, kStop },
+              { "LDY", Mode::Absolute, 0 },       { "LDA", Mode::Absolute, 0 },       { "LDX", Mode::Absolute, 0 },       { "???", Mode::Implied, kStop },
+    /* B_ */ { "BCS", Mode::Relative, kBranch }, { "LDA", Mode::IndirectY, 0 },      { "???", Mode::Implied, kStop },    { "???", Mode::Implied, kStop },
+              { "LDY", Mode::ZeroPageX, 0 },      { "LDA", Mode::ZeroPageX, 0 },      { "LDX", Mode::ZeroPageY, 0 },      { "???", Mode::Implied, kStop },
+              { "CLV", Mode::Implied, 0 },        { "LDA", Mode::AbsoluteY, 0 },      { "TSX", Mode::Implied, 0 },        { "???", Mode::Implied, kStop },
+              { "LDY", Mode::AbsoluteX, 0 },      { "LDA", Mode::AbsoluteX, 0 },      { "LDX", Mode::AbsoluteY, 0 },      { "???", Mode::Implied, kStop },
+    /* C_ */ { "CPY", Mode::Immediate, 0 },      { "CMP", Mode::IndirectX, 0 },      { "???", Mode::Implied, kStop },    { "???", Mode::Implied, kStop },
+              { "CPY", Mode::ZeroPage, 0 },       { "CMP", Mode::ZeroPage, 0 },       { "DEC", Mode::ZeroPage, 0 },       { "???", Mode::Implied, kStop },
+              { "INY", Mode::Implied, 0 },        { "CMP", Mode::Immediate, 0 },      { "DEX", Mode::Implied, 0 },        { "???", Mode::Implied, kStop },
+              { "CPY", Mode::Absolute, 0 },       { "CMP", Mode::Absolute, 0 },       { "DEC", Mode::Absolute, 0 },       { "???", Mode::Implied, kStop },
+    /* D_ */ { "BNE", Mode::Relative, kBranch }, { "CMP", Mode::IndirectY, 0 },      { "???", Mode::Implied, kStop },    { "???", Mode::Implied, kStop },
+              { "???", Mode::Implied, kStop },    { "CMP", Mode::ZeroPageX, 0 },      { "DEC", Mode::ZeroPageX, 0 },      { "???", Mode::Implied, kStop },
+              { "CLD", Mode::Implied, 0 },        { "CMP", Mode::AbsoluteY, 0 },      { "???", Mode::Implied, kStop },    { "???", Mode::Implied, kStop },
+              { "???", Mode::Implied, kStop },    { "CMP", Mode::AbsoluteX, 0 },      { "DEC", Mode::AbsoluteX, 0 },      { "???", Mode::Implied, kStop },
+    /* E_ */ { "CPX", Mode::Immediate, 0 },      { "SBC", Mode::IndirectX, 0 },      { "???", Mode::Implied, kStop },    { "???", Mode::Implied, kStop },
+              { "CPX", Mode::ZeroPage, 0 },       { "SBC", Mode::ZeroPage, 0 },       { "INC", Mode::ZeroPage, 0 },       { "???", Mode::Implied, kStop },
+              { "INX", Mode::Implied, 0 },        { "SBC", Mode::Immediate, 0 },      { "NOP", Mode::Implied, 0 },        { "???", Mode::Implied, kStop },
+              { "CPX", Mode::Absolute, 0 },       { "SBC", Mode::Absolute, 0 },       { "INC", Mode::Absolute, 0 },       { "???", Mode::Implied, kStop },
+    /* F_ */ { "BEQ", Mode::Relative, kBranch }, { "SBC", Mode::IndirectY, 0 },      { "???", Mode::Implied, kStop },    { "???", Mode::Implied, kStop },
+              { "???", Mode::Implied, kStop },    { "SBC", Mode::ZeroPageX, 0 },      { "INC", Mode::ZeroPageX, 0 },      { "???", Mode::Implied, kStop },
+              { "SED", Mode::Implied, 0 },        { "SBC", Mode::AbsoluteY, 0 },      { "???", Mode::Implied, kStop },    { "???", Mode::Implied, kStop },
+              { "???", Mode::Implied, kStop },    { "SBC", Mode::AbsoluteX, 0 },      { "INC", Mode::AbsoluteX, 0 },      { "???", Mode::Implied, kStop },
+};
+
+} // namespace
+
+int OpcodeInfo::length() const {
+    switch (mode) {
+    case Mode::Implied:
+    case Mode::Accumulator:
+        return 1;
+    case Mode::Absolute:
+    case Mode::AbsoluteX:
+    case Mode::AbsoluteY:
+    case Mode::Indirect:
+        return 3;
+    default:
+        return 2;
+    }
+}
+
+const OpcodeInfo& opcodeInfo(uint8_t opcode) {
+    return kOpcodes[opcode];
+}
+
+std::string disassemble(uint16_t addr, const uint8_t* bytes) {
+    const OpcodeInfo& info = kOpcodes[bytes[0]];
+    uint8_t lo = bytes[1];
+    unsigned word = bytes[1] | (bytes[2] << 8);
+
+    char operand[16] = "";
+    switch (info.mode) {
+    case Mode::Implied:     break;
+    case Mode::Accumulator: snprintf(operand, sizeof(operand), " A"); break;
+    case Mode::Immediate:   snprintf(operand, sizeof(operand), " #$%02X", lo); break;
+    case Mode::ZeroPage:    snprintf(operand, sizeof(operand), " $%02X", lo); break;
+    case Mode::ZeroPageX:   snprintf(operand, sizeof(operand), " $%02X,X", lo); break;
+    case Mode::ZeroPageY:   snprintf(operand, sizeof(operand), " $%02X,Y", lo); break;
+    case Mode::Absolute:    snprintf(operand, sizeof(operand), " $%04X", word); break;
+    case Mode::AbsoluteX:   snprintf(operand, sizeof(operand), " $%04X,X", word); break;
+    case Mode::AbsoluteY:   snprintf(operand, sizeof(operand), " $%04X,Y", word); break;
+    case Mode::Indirect:    snprintf(operand, sizeof(operand), " ($%04X)", word); break;
+    case Mode::IndirectX:   snprintf(operand, sizeof(operand), " ($%02X,X)", lo); break;
+    case Mode::IndirectY:   snprintf(operand, sizeof(operand), " ($%02X),Y", lo); break;
+    case Mode::Relative:    snprintf(operand, sizeof(operand), " $%04X", branchTarget(addr, lo)); break;
+    }
+    if (!info.valid()) {
+        snprintf(operand, sizeof(operand), " ; $%02X", bytes[0]);
+    }
+    return std::string(info.mnemonic) + operand;
+}
+
+std::string disassemble(const Bus& bus, uint16_t addr) {
+    uint8_t bytes[3] = { bus.peek(addr), bus.peek(uint16_t(addr + 1)), bus.peek(uint16_t(addr + 2)) };
+    return disassemble(addr, bytes);
+}
@@ -0,0 +1,64 @@
+/************************************************************************************
+
+Filename    :   disasm.h
+Content     :   6502 opcode table and disassembler (header)
+Authors     :   Yash Patel
+
+One entry per opcode: mnemonic, addressing mode (which fixes the instruction length
+and operand syntax) and how the instruction affects control flow, which is all the
+code-flow analyzer (codemap.h) needs. Unofficial opcodes are listed as "???" and
+treated as the end of a code path.
+
+*************************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+
+#include "bus.h"
+
+struct OpcodeInfo {
+	enum class Mode {
+		Implied,
+		Accumulator,
+		Immediate,
+		ZeroPage,
+		ZeroPageX,
+		ZeroPageY,
+		Absolute,
+		AbsoluteX,
+		AbsoluteY,
+		Indirect,
+		IndirectX,
+		IndirectY,
+		Relative
+	};
+
+	// control flow
+	static const uint8_t kBranch = 0x01; // conditional, falls through
+	static const uint8_t kJump   = 0x02; // JMP, doesn't fall through
+	static const uint8_t kCall   = 0x04; // JSR
+	static const uint8_t kReturn = 0x08; // RTS / RTI
+	static const uint8_t kStop   = 0x10; // BRK and unofficial opcodes
+
+	const char* mnemonic;
+	Mode mode;
+	uint8_t flow;
+
+	bool valid() const { return mnemonic[0] != '?'; }
+	int length() const; // 1-3 bytes
+};
+
+const OpcodeInfo& opcodeInfo(uint8_t opcode);
+
+// target of a relative branch at addr
+inline uint16_t branchTarget(uint16_t addr, uint8_t offset) {
+	return uint16_t(addr + 2 + int8_t(offset));
+}
+
+// "LDA ($10),Y", "BPL $6005", ... bytes must hold the whole instruction
+std::string disassemble(uint16_t addr, const uint8_t* bytes);
+// same, fetching the bytes with Bus::peek (no side effects)
+std::string disassemble(const Bus& bus, uint16_t addr);
@@ -0,0 +1,65 @@
+/************************************************************************************
+
+Filename    :   emuthread.cpp
+Content     :   Runs the console on its own thread
+Authors     :   Yash Patel
+
+*************************************************************************************/
+
+#include "emuthread.h"
+
+#include <string.h>
+
+EmuThread::EmuThread(Console& console, Region region, AudioOutput* audio) :
+    console(console),
+    audio(audio),
+    pacer(region),
+    running(false),
+    published(0) {
+}
+
+EmuThread::~EmuThread() {
+    stop();
+}
+
+void EmuThread::start() {
+    if (running) {
+        return;
+    }
+    running = true;
+    thread = std::thread(&EmuThread::loop, this);
+}
+
+void EmuThread::stop() {
+    if (!running) {
+        return;
+    }
+    running = false;
+    thread.join();
+}
+
+const EmuThread::Frame* EmuThread::latestFrame() {
+    return frames.update() ? &frames.readSlot() : nullptr;
+}
+
+void EmuThread::loop() {
+    pacer.run(
+        [this](bool render) {
+            console.runFrame(render);
+            if (audio != nullptr) {
+                audio->push(console.getAPU().getSamples());
+            }
+            if (console.lastFrameRendered()) {
+                Frame& frame = frames.writeSlot();
+                frame.number = console.getFrame();
+                memcpy(frame.pixels, console.getPPU().getPixels(), sizeof(frame.pixels));
+                memcpy(frame.emphasis, console.getPPU().getEmphasis(), sizeof(frame.emphasis));
+                frames.publish();
+                published.fetch_add(1, std::memory_order_relaxed);
+            }
+            if (frameHook) {
+                frameHook(console);
+            }
+        },
+        [this]() { return running.load(std::memory_order_relaxed); });
+}
@@ -0,0 +1,72 @@
+/************************************************************************************
+
+Filename    :   emuthread.h
+Content     :   Runs the console on its own thread (header)
+Authors     :   Yash Patel
+
+The emulation thread owns the console while it runs: it paces frames (FramePacer),
+feeds audio (AudioOutput) and publishes every presented frame into a triple buffer.
+Presentation, encoders, screenshots etc. pick up the latest frame from any other
+thread with latestFrame(); they can be arbitrarily slow without ever stalling the
+emulator, they just see fewer frames.
+
+Nothing else may touch the console between start() and stop().
+
+*************************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <functional>
+#include <thread>
+
+#include "audio.h"
+#include "console.h"
+#include "pacer.h"
+#include "ppu.h"
+#include "triplebuffer.h"
+
+class EmuThread {
+public:
+	struct Frame {
+		uint64_t number; // console frame counter when it was rendered
+		uint8_t pixels[PPU::kWidth * PPU::kHeight]; // palette indices (indicesToARGB for colors)
+		uint8_t emphasis[PPU::kHeight];
+	};
+
+	// audio is optional (not owned); it should already be started
+	EmuThread(Console& console, Region region, AudioOutput* audio = nullptr);
+	~EmuThread();
+
+	// called on the emulation thread after every frame (exporters, recorders);
+	// set before start()
+	typedef std::function<void(Console& console)> FrameHook;
+	void setFrameHook(const FrameHook& hook) { frameHook = hook; }
+
+	void start();
+	void stop();
+	bool isRunning() const { return running; }
+
+	// single consumer: returns the newest published frame, or nullptr if none has been
+	// published since the last call. The frame stays valid until the next call.
+	const Frame* latestFrame();
+
+	// only meaningful once stopped
+	const FramePacer& getPacer() const { return pacer; }
+	uint64_t framesPublished() const { return published; }
+
+private:
+	void loop();
+
+	Console& console;
+	AudioOutput* audio;
+	FrameHook frameHook;
+	FramePacer pacer;
+	TripleBuffer<Frame> frames;
+
+	std::thread thread;
+	std::atomic<bool> running;
+	std::atomic<uint64_t> published;
+};
@@ -0,0 +1,50 @@
+/************************************************************************************
+
+Filename    :   idleloop.cpp
+Content     :   Idle-loop detection and fast-forward
+Authors     :   Yash Patel
+
+*************************************************************************************/
+
+#include "idleloop.h"
+
+IdleLoop::IdleLoop(CPU* cpu, Bus* bus, PPU* ppu) :
+    cpu(cpu),
+    bus(bus),
+    ppu(ppu),
+    armed(false),
+    hashed(false),
+    sideEffects(0),
+    ppuHash(0),
+    skipped(0) {
+}
+
+void IdleLoop::backwardJump(double lineEnd) {
+    CPUState now = cpu->state();
+    bool same = armed && now.pc == head.pc && now.ac == head.ac && now.x == head.x &&
+        now.y == head.y && now.sr == head.sr && now.sp == head.sp &&
+        bus->getSideEffects() == sideEffects;
+
+    if (same && !hashed) {
+        // registers and memory repeat; one more iteration to check the PPU too
+        ppuHash = ppu->hashRegisters();
+        hashed = true;
+        head.cycles = now.cycles;
+        return;
+    }
+    if (same && ppu->hashRegisters() == ppuHash) {
+        uint64_t period = now.cycles - head.cycles;
+        uint64_t iterations = uint64_t((lineEnd - double(now.cycles)) / double(period));
+        if (iterations > 0) {
+            cpu->stall(uint32_t(iterations * period)); // the CPU ends up exactly where it is now
+            skipped += iterations * period;
+        }
+        head.cycles = cpu->getCycles();
+        return;
+    }
+
+    armed = true;
+    hashed = false;
+    head = now;
+    sideEffects = bus->getSideEffects();
+}
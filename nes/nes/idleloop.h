@@ -0,0 +1,62 @@
+/************************************************************************************
+
+Filename    :   idleloop.h
+Content     :   Idle-loop detection and fast-forward (header)
+Authors     :   Yash Patel
+
+Games spend much of each frame in loops like `LDA $2002 / BPL` or `JMP *`, waiting
+for something that can only happen at the next scanline boundary: that's the only
+point where the console runs the PPU and delivers NMIs and IRQs, and the APU is
+caught up lazily from register writes, so nothing the CPU can observe changes in
+between.
+
+Detection is by observation, not by pattern. Whenever the CPU jumps backwards, the
+target is taken as a loop head and the state there is recorded: CPU registers, the
+bus's side-effect count (see bus.h) and the PPU registers. If the CPU arrives at the
+same head with the same registers, having made no writes and no side-effecting
+reads, and the PPU registers are also unchanged, then the iteration was a pure
+function of that state. Every following iteration must repeat it exactly until
+the scanline ends. The cycle counter then jumps over as many whole iterations as
+fit before the end of the scanline, and the remainder is stepped as usual. The
+result is identical to stepping everything, cycle counts included.
+
+The PPU hash is only taken once registers and side effects already match, so loops
+that make progress (counters, copies) cost a register compare per iteration. The
+recorded state is dropped at every scanline boundary, since what happens there
+isn't part of any iteration.
+
+*************************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+
+#include "bus.h"
+#include "cpu.h"
+#include "ppu.h"
+
+class IdleLoop {
+public:
+	IdleLoop(CPU* cpu, Bus* bus, PPU* ppu);
+	~IdleLoop() = default;
+
+	// after a step that moved the PC backwards (or onto itself); lineEnd is the CPU
+	// cycle the current scanline ends at
+	void backwardJump(double lineEnd);
+	void disarm() { armed = false; } // at every scanline boundary
+
+	uint64_t getSkippedCycles() const { return skipped; }
+
+private:
+	CPU* cpu;
+	Bus* bus;
+	PPU* ppu;
+
+	bool armed;
+	bool hashed;       // ppuHash is valid
+	CPUState head;     // registers at the loop head
+	uint64_t sideEffects;
+	uint64_t ppuHash;
+
+	uint64_t skipped;  // cycles fast-forwarded since construction
+};
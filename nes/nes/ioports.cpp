@@ -0,0 +1,56 @@
+/************************************************************************************
+
+Filename    :   ioports.cpp
+Content     :   CPU I/O registers at $4000-$40FF
+Authors     :   Yash Patel
+
+*************************************************************************************/
+
+#include "ioports.h"
+
+IOPorts::IOPorts(Bus* bus, CPU* cpu, PPU* ppu, APU* apu, Controller* port1, Controller* port2) :
+    bus(bus),
+    cpu(cpu),
+    ppu(ppu),
+    apu(apu) {
+    ports[0] = port1;
+    ports[1] = port2;
+}
+
+uint8_t IOPorts::read(uint16_t addr) {
+    switch (addr) {
+    case 0x4015: return apu->read(addr);
+    // the pads only drive bit 0; the upper bits float at the last value on the bus,
+    // which for an absolute read of $4016/$4017 is the address high byte
+    case 0x4016: return 0x40 | ports[0]->read();
+    case 0x4017: return 0x40 | ports[1]->read();
+    default:     return 0x40;
+    }
+}
+
+void IOPorts::write(uint16_t addr, uint8_t value) {
+    if (addr == 0x4014) {
+        oamDma(value);
+    } else if (addr == 0x4016) {
+        ports[0]->strobe(value & 0x01);
+        ports[1]->strobe(value & 0x01);
+    } else if (addr <= 0x4017) {
+        apu->write(addr, value);
+    }
+}
+
+void IOPorts::oamDma(uint8_t page) {
+    const uint8_t* source = bus->readPage(page);
+    uint8_t buffer[256];
+    if (source == nullptr) {
+        for (int i = 0; i < 256; i++) {
+            buffer[i] = bus->read(uint16_t((page << 8) | i));
+        }
+        source = buffer;
+    }
+    ppu->writeOAM(source);
+
+    // 1 dummy cycle (+1 to align to a read cycle when starting on an odd one), then
+    // 256 read/write pairs
+    cpu->stall((cpu->getCycles() & 1) ? 514 : 513);
+}
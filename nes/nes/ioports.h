@@ -0,0 +1,44 @@
+/************************************************************************************
+
+Filename    :   ioports.h
+Content     :   CPU I/O registers at $4000-$40FF (header)
+Authors     :   Yash Patel
+
+The bus maps devices a page at a time, and page $40 holds registers of several
+devices: the APU ($4000-$4013, $4015, $4017 writes), OAM DMA ($4014) and the
+controller ports ($4016 writes strobe both pads, $4016/$4017 reads shift one out).
+This device sits on the page and routes each register to its owner.
+
+OAM DMA copies a 256-byte page into OAM in one go: straight from the page's backing
+memory when it has any (RAM/ROM, the normal case), byte by byte through the bus
+only for MMIO pages. The CPU is charged the whole 513/514-cycle stall at once.
+
+*************************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+
+#include "apu.h"
+#include "bus.h"
+#include "controller.h"
+#include "cpu.h"
+#include "ppu.h"
+
+class IOPorts : public Device {
+public:
+	IOPorts(Bus* bus, CPU* cpu, PPU* ppu, APU* apu, Controller* port1, Controller* port2);
+	~IOPorts() = default;
+
+	uint8_t read(uint16_t addr) override;
+	void write(uint16_t addr, uint8_t value) override;
+
+private:
+	void oamDma(uint8_t page);
+
+	Bus* bus;
+	CPU* cpu;
+	PPU* ppu;
+	APU* apu;
+	Controller* ports[2];
+};
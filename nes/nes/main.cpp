@@ -38,44 +38,590 @@ find some of the components either not completed, broken, or both.
 *************************************************************************************/
 
 #include <conio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include <iostream>
 #include <thread>
 #include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "aotcode.h"
+#include "audio.h"
+#include "batchenv.h"
+#include "capture.h"
+#include "codemap.h"
+#include "console.h"
+#include "debugger.h"
+#include "disasm.h"
+#include "emuthread.h"
+#include "movie.h"
+#include "netplay.h"
+#include "pacer.h"
+#include "recompiler.h"
+#include "rom.h"
+#include "romdb.h"
+#include "saveram.h"
+#include "sharedexport.h"
+#include "transport.h"
+
+// free-running mode: emulation runs paced to the console's refresh rate on its own
+// thread, audio on another; this thread stands in for presentation and only picks
+// up the latest frame. On a keypress it reports frame-time percentiles. With a
+// segment name, every frame is also exported to shared memory; with a capture path,
+// video (and audio, next to it as .wav) is recorded without ever holding up emulation.
+void runRealtime(Console& console, Region region, AudioSink& sink, const std::string& shmName,
+	const std::string& capturePath) {
+	AudioOutput audio(&sink, console.getAPU().getSampleRate());
+	audio.start();
+	EmuThread emulation(console, region, &audio);
+
+	SharedExport shared;
+	bool sharing = !shmName.empty() && shared.open(shmName);
+	std::unique_ptr<Capture> capture;
+	if (!capturePath.empty()) {
+		capture.reset(new Capture(capturePath, Capture::formatFor(capturePath), region,
+			capturePath + ".wav", console.getAPU().getSampleRate()));
+		if (!capture->start()) {
+			capture.reset();
+		}
+	}
+	Capture* recorder = capture.get();
+	emulation.setFrameHook([&shared, sharing, recorder](Console& c) {
+		if (sharing) {
+			shared.publish(c);
+		}
+		if (recorder != nullptr) {
+			recorder->submit(c);
+		}
+	});
+	emulation.start();
+
+	uint64_t presented = 0;
+	while (!_kbhit()) {
+		if (emulation.latestFrame() != nullptr) {
+			presented++;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(4));
+	}
+
+	emulation.stop();
+	audio.stop();
+	_getch(); // consume the key that stopped us
+	emulation.getPacer().dumpStats();
+	std::cout << "shown   " << presented << " of " << emulation.framesPublished() << " published" << std::endl;
+	audio.dumpStats();
+	if (capture) {
+		capture->stop();
+		capture->dumpStats();
+	}
+}
+
+// fast-forward mode: unthrottled and without pixel output, reports the speedup
+void runTurbo(Console& console, int frames) {
+	FramePacer pacer(Region::NTSC); // only used for the real-time reference rate
+	console.setTurbo(true);
+
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < frames; i++) {
+		console.runFrame();
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << frames << " frames in " << seconds * 1000.0 << " ms ("
+		<< (frames * pacer.framePeriod()) / seconds << "x real time)" << std::endl;
+	std::cout << 100.0 * double(console.getIdleCycles()) / double(console.getCPU().getCycles())
+		<< "% of CPU cycles fast-forwarded in idle loops" << std::endl;
+}
+
+// batch mode: steps a batch of consoles in parallel (frame skip 4) and reports throughput
+void runBatch(const BatchEnv::Loader& loader, int batch, int steps) {
+	BatchEnv env(batch, loader);
+	std::vector<uint8_t> actions(batch, 0);
+
+	auto start = std::chrono::steady_clock::now();
+	env.reset();
+	for (int i = 0; i < steps; i++) {
+		env.step(actions.data());
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	double frames = double(batch) * (steps + 1) * env.getFrameSkip();
+	std::cout << batch << " instances x " << steps << " steps in " << seconds * 1000.0 << " ms ("
+		<< frames / seconds << " frames/s)" << std::endl;
+}
+
+// interactive debugging: reports why execution stopped and the next instruction
+void reportStop(Console& console, const Debugger& debugger, Debugger::Reason reason) {
+	const Debugger::Stop& stop = debugger.lastStop();
+	std::cout << std::hex;
+	switch (reason) {
+	case Debugger::Reason::None:
+		std::cout << "no stop within the frame limit" << std::endl;
+		break;
+	case Debugger::Reason::Breakpoint:
+		std::cout << "breakpoint " << stop.id << " at $" << stop.addr << std::endl;
+		break;
+	case Debugger::Reason::Watchpoint:
+		std::cout << "watchpoint " << stop.id << ": " << (stop.write ? "write $" : "read $")
+			<< int(stop.value) << (stop.write ? " to $" : " from $") << stop.addr << std::endl;
+		break;
+	case Debugger::Reason::Step:
+		break;
+	}
+	std::cout << std::dec << disassemble(console.getBus(), console.getCPU().getPC()) << std::endl;
+}
+
+// analyze mode: separates code from data in the loaded image, reusing a saved map
+// when the image hasn't changed, and prints the disassembly and hot entry points
+void runAnalyze(Console& console, const std::string& path) {
+	std::vector<uint8_t> image(Console::kAddressSpace);
+	console.copyImage(image.data());
+	CodeMap map;
+	if (!map.analyzeCached(path, image.data(), 0, Console::kAddressSpace)) {
+		std::cout << "couldn't write " << path << std::endl;
+	}
+	std::cout << map.listing() << std::endl;
+	std::cout << map.codeBytes() << " code bytes, " << map.getRoutines().size() << " routines, "
+		<< map.getIndirectJumps().size() << " indirect jumps" << std::endl << "hot entries:" << std::hex;
+	for (uint16_t entry : map.hotEntries(8)) {
+		std::cout << " $" << entry;
+	}
+	std::cout << std::dec << std::endl;
+}
+
+// recompile mode: emits C++ for the code found in the loaded image (see recompiler.h),
+// to be built into a shared library and loaded back with --aot
+void runRecompile(Console& console, const std::string& path, const std::string& mapPath) {
+	std::vector<uint8_t> image(Console::kAddressSpace);
+	console.copyImage(image.data());
+	CodeMap map;
+	map.analyzeCached(mapPath, image.data(), 0, Console::kAddressSpace);
+	Recompiler recompiler(map);
+	if (!recompiler.emit(path)) {
+		std::cout << "couldn't write " << path << std::endl;
+		return;
+	}
+	std::cout << recompiler.blockCount() << " blocks written to " << path << std::endl;
+}
+
+// capture mode: renders every frame as fast as possible into a video file (plus
+// .wav audio next to it); the emulator waits for the encoder rather than drop frames
+void runCapture(Console& console, Region region, const std::string& path, int frames) {
+	Capture capture(path, Capture::formatFor(path), region, path + ".wav",
+		console.getAPU().getSampleRate(), Capture::Overflow::Wait);
+	if (!capture.start()) {
+		return;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < frames; i++) {
+		console.runFrame();
+		capture.submit(console);
+	}
+	capture.stop();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << frames << " frames captured in " << seconds * 1000.0 << " ms" << std::endl;
+	capture.dumpStats();
+}
+
+// record mode: records a movie of scripted input (buttons re-rolled every 15 frames
+// from a fixed seed) so benchmark and regression runs see identical input
+void runRecord(Console& console, const std::string& path, int frames) {
+	Movie movie;
+	MovieRecorder recorder(console, movie);
+	console.setTurbo(true);
+
+	uint32_t seed = 0x1234567;
+	uint8_t buttons = 0;
+	for (int i = 0; i < frames; i++) {
+		if (i % 15 == 0) {
+			seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+			buttons = uint8_t(seed);
+		}
+		recorder.runFrame(buttons);
+	}
+
+	if (!movie.save(path)) {
+		std::cout << "Unable to write " << path << std::endl;
+		return;
+	}
+	std::cout << "recorded " << frames << " frames into " << movie.encode().size() << " bytes" << std::endl;
+}
+
+// play mode: replays a movie at full speed and verifies it against its state hashes
+int runPlay(Console& console, const std::string& path) {
+	Movie movie;
+	if (!movie.load(path)) {
+		std::cout << "Unable to read movie " << path << std::endl;
+		return 1;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	MoviePlayer player(console, movie);
+	MoviePlayer::Status status = player.play();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	if (status == MoviePlayer::Status::Desync) {
+		std::cout << "desync at frame " << player.getDesyncFrame() << std::endl;
+		return 1;
+	}
+	std::cout << player.getFrame() << " frames verified in " << seconds * 1000.0 << " ms" << std::endl;
+	return 0;
+}
+
+// scripted buttons for netplay runs: re-rolled every 15 frames, differently per player,
+// so each side only knows the other's input once it arrives
+uint8_t scriptedButtons(int player, uint64_t frame) {
+	uint32_t x = uint32_t(frame / 15) * 2654435761u + uint32_t(player + 1) * 0x9e3779b9u;
+	x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+	return uint8_t(x);
+}
+
+// without a ROM, netplay runs this instead of the usual test program, since that one
+// never reads the controllers: each NMI shifts both pads into zero page and folds them
+// into running sums, so any input difference shows up in the state from then on
+std::vector<uint8_t> padTestProgram() {
+	std::vector<uint8_t> prg(16384, 0);
+	const uint8_t program[] = {
+		0xa9, 0x80, 0x8d, 0x00, 0x20, // C000: LDA #$80, STA $2000 (NMI on)
+		0x4c, 0x05, 0xc0,             // C005: JMP $C005
+		0xa9, 0x01, 0x8d, 0x16, 0x40, // C008: LDA #$01, STA $4016 (latch pads)
+		0xa9, 0x00, 0x8d, 0x16, 0x40, //       LDA #$00, STA $4016
+		0xa2, 0x08,                   //       LDX #$08
+		0xad, 0x16, 0x40, 0x29, 0x01, // C014: LDA $4016, AND #$01
+		0x65, 0x00, 0x0a, 0x85, 0x00, //       ADC $00, ASL A, STA $00
+		0x65, 0x02, 0x85, 0x02,       //       ADC $02, STA $02
+		0xad, 0x17, 0x40, 0x29, 0x01, //       LDA $4017, AND #$01
+		0x65, 0x01, 0x0a, 0x85, 0x01, //       ADC $01, ASL A, STA $01
+		0x65, 0x03, 0x85, 0x03,       //       ADC $03, STA $03
+		0xca, 0xd0, 0xe1,             //       DEX, BNE $C014
+		0x40,                         //       RTI
+	};
+	memcpy(prg.data(), program, sizeof(program));
+	prg[0x3FFA] = 0x08; // NMI vector $C008
+	prg[0x3FFB] = 0xC0;
+	prg[0x3FFC] = 0x00; // reset vector $C000
+	prg[0x3FFD] = 0xC0;
+	return prg;
+}
+
+// netplay test mode: two rollback sessions over an in-process link with `latency`
+// packets of delay (and every dropEvery-th packet lost), checked frame by frame
+// against a third console that was given both players' real input up front
+int runNetplayTest(const BatchEnv::Loader& loader, Region region, int frames, int latency, int dropEvery) {
+	std::unique_ptr<Console> consoles[3];
+	for (auto& console : consoles) {
+		console.reset(new Console(region));
+		loader(*console);
+		console->reset();
+	}
+	std::vector<uint64_t> expected(frames);
+	consoles[2]->setTurbo(true);
+	for (int i = 0; i < frames; i++) {
+		consoles[2]->getController(0).setButtons(scriptedButtons(0, i));
+		consoles[2]->getController(1).setButtons(scriptedButtons(1, i));
+		consoles[2]->runFrame(false);
+		expected[i] = consoles[2]->stateHash();
+	}
+
+	LoopbackTransport ends[2];
+	LoopbackTransport::connect(ends[0], ends[1], latency, dropEvery);
+	RollbackSession first(*consoles[0], ends[0], 0);
+	RollbackSession second(*consoles[1], ends[1], 1);
+	RollbackSession* sessions[2] = { &first, &second };
+
+	auto start = std::chrono::steady_clock::now();
+	uint64_t checked[2] = { 0, 0 };
+	uint64_t mismatch = ~uint64_t(0);
+	for (int pass = 0; pass < frames * 4 + 1000; pass++) { // gives up if the link can't get through
+		bool done = true;
+		for (int p = 0; p < 2; p++) {
+			RollbackSession& session = *sessions[p];
+			session.advance(scriptedButtons(p, session.getFrame()));
+			uint64_t hash;
+			for (; checked[p] < uint64_t(frames) && session.confirmedHash(checked[p], hash); checked[p]++) {
+				if (hash != expected[checked[p]] && checked[p] < mismatch) {
+					mismatch = checked[p];
+				}
+			}
+			done = done && checked[p] == uint64_t(frames);
+		}
+		if (done) {
+			break;
+		}
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	for (int p = 0; p < 2; p++) {
+		RollbackSession& session = *sessions[p];
+		std::cout << "player " << p + 1 << ": " << session.getFrame() << " frames, " << session.getRollbacks()
+			<< " rollbacks (" << session.getResimulated() << " frames re-run, deepest "
+			<< session.getDeepestRollback() << "), " << session.getStalls() << " stalls" << std::endl;
+	}
+	std::cout << "both sides in " << seconds * 1000.0 << " ms" << std::endl;
+	if (mismatch != ~uint64_t(0) || first.desynced() || second.desynced()) {
+		std::cout << "desync at frame " << (mismatch != ~uint64_t(0) ? mismatch :
+			first.desynced() ? first.getDesyncFrame() : second.getDesyncFrame()) << std::endl;
+		return 1;
+	}
+	if (checked[0] < uint64_t(frames) || checked[1] < uint64_t(frames)) {
+		std::cout << "only " << checked[0] << " and " << checked[1] << " frames confirmed" << std::endl;
+		return 1;
+	}
+	std::cout << frames << " frames match the reference on both sides" << std::endl;
+	return 0;
+}
+
+// netplay mode: one side of a game over UDP with another process, paced to real time
+// with scripted input; both print the state hash after the last frame to compare
+int runNetplay(Console& console, Region region, int player, uint16_t localPort, const std::string& remoteHost,
+	uint16_t remotePort, int frames) {
+	UdpTransport transport;
+	if (!transport.open(localPort, remoteHost, remotePort)) {
+		return 1;
+	}
+	RollbackSession session(console, transport, player);
+	FramePacer pacer(region);
+
+	auto lastProgress = std::chrono::steady_clock::now();
+	uint64_t confirmed = 0;
+	pacer.run([&session, player](bool) {
+			session.advance(scriptedButtons(player, session.getFrame()));
+		},
+		[&]() {
+			if (session.getConfirmedFrame() != confirmed) {
+				confirmed = session.getConfirmedFrame();
+				lastProgress = std::chrono::steady_clock::now();
+			}
+			return confirmed < uint64_t(frames) && !session.desynced() &&
+				std::chrono::steady_clock::now() - lastProgress < std::chrono::seconds(5);
+		});
+	// keep sending a little longer, in case the other side still needs our last inputs
+	for (int i = 0; i < 30; i++) {
+		session.advance(scriptedButtons(player, session.getFrame()));
+		std::this_thread::sleep_for(std::chrono::milliseconds(16));
+	}
+
+	std::cout << session.getFrame() << " frames, " << session.getRollbacks() << " rollbacks ("
+		<< session.getResimulated() << " frames re-run, deepest " << session.getDeepestRollback() << "), "
+		<< session.getStalls() << " stalls" << std::endl;
+	if (session.desynced()) {
+		std::cout << "desync at frame " << session.getDesyncFrame() << std::endl;
+		return 1;
+	}
+	uint64_t hash;
+	if (confirmed < uint64_t(frames) || !session.confirmedHash(uint64_t(frames) - 1, hash)) {
+		std::cout << "the other side stopped answering at frame " << confirmed << std::endl;
+		return 1;
+	}
+	char text[17];
+	snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(hash));
+	std::cout << "state hash after frame " << frames - 1 << ": " << text << std::endl;
+	return 0;
+}
+
+// identify mode: prints what each ROM file is, using the cache for files seen before
+int runIdentify(const std::vector<std::string>& files, const RomDatabase& database, RomCache& cache) {
+	int failed = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (const std::string& file : files) {
+		RomIdentity identity;
+		if (!identifyRom(file, &database, &cache, identity)) {
+			failed++;
+			continue;
+		}
+		char crc[9];
+		snprintf(crc, sizeof(crc), "%08x", identity.id.crc32);
+		std::cout << file << ": crc32 " << crc << " sha1 " << identity.id.sha1.hex() << ", mapper "
+			<< identity.info.mapper << (identity.info.region == Region::PAL ? ", PAL" : ", NTSC");
+		if (identity.known) {
+			std::cout << ", " << (identity.name.empty() ? "known" : identity.name);
+		}
+		if (identity.corrected) {
+			std::cout << " (header corrected, said mapper " << identity.header.mapper << ")";
+		}
+		std::cout << std::endl;
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << files.size() - failed << " of " << files.size() << " identified in " << seconds * 1000.0
+		<< " ms" << std::endl;
+	return failed == 0 ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+	// nes --realtime [pal] [--wav file] [--shm name] [--capture file] | --turbo [frames] |
+	//     --batch [instances] [steps] | --record file [frames] | --play file |
+	//     --capture file [frames] | --analyze [mapfile] | --recompile file.cpp [mapfile] |
+	//     --identify rom... | --netplay-test [frames] [latency] [dropEvery] |
+	//     --netplay player localPort remotePort [frames] [host]; any mode runs --rom file (iNES, corrected from --romdb file)
+	//     in place of the built-in test program (battery RAM lives in the .sav next to it);
+	// with no mode we single step under the debugger: [--break addr] [--watch addr] (hex,
+	// repeatable), then space/n/u step into/over/out, c continues, d dumps the CPU;
+	// any mode takes --accuracy exact to perform the CPU's dummy bus accesses, or --accuracy
+	// cycle to also time every access to its own cycle, and --aot library to run the
+	// program through its recompiled module
+	std::string mode = argc > 1 ? argv[1] : "";
+	bool pal = mode == "--realtime" && argc > 2 && std::string(argv[2]) == "pal";
+	Region region = pal ? Region::PAL : Region::NTSC;
+	std::string wavPath;
+	std::string shmName;
+	std::string capturePath;
+	std::vector<uint16_t> breakpoints;
+	std::vector<uint16_t> watchpoints;
+	BusAccuracy accuracy = BusAccuracy::Fast;
+	std::string aotPath;
+	std::string romPath;
+	std::string romDbPath;
+	for (int i = 1; i + 1 < argc; i++) {
+		     if (std::string(argv[i]) == "--wav") { wavPath = argv[i + 1]; }
+		else if (std::string(argv[i]) == "--shm") { shmName = argv[i + 1]; }
+		else if (std::string(argv[i]) == "--capture") { capturePath = argv[i + 1]; }
+		else if (std::string(argv[i]) == "--break") { breakpoints.push_back(uint16_t(strtol(argv[i + 1], nullptr, 16))); }
+		else if (std::string(argv[i]) == "--watch") { watchpoints.push_back(uint16_t(strtol(argv[i + 1], nullptr, 16))); }
+		else if (std::string(argv[i]) == "--aot") { aotPath = argv[i + 1]; }
+		else if (std::string(argv[i]) == "--rom") { romPath = argv[i + 1]; }
+		else if (std::string(argv[i]) == "--romdb") { romDbPath = argv[i + 1]; }
+		else if (std::string(argv[i]) == "--accuracy") { accuracy = std::string(argv[i + 1]) == "cycle" ? BusAccuracy::Cycle :
+			std::string(argv[i + 1]) == "exact" ? BusAccuracy::Exact : BusAccuracy::Fast; }
+	}
+
+	RomDatabase database;
+	if (!romDbPath.empty() && !database.load(romDbPath)) {
+		std::cout << "couldn't read " << romDbPath << std::endl;
+	}
+	RomCache romCache("nes.romcache");
+	if (mode == "--identify") {
+		std::vector<std::string> files;
+		for (int i = 2; i < argc && argv[i][0] != '-'; i++) {
+			files.push_back(argv[i]);
+		}
+		return runIdentify(files, database, romCache);
+	}
+
+	Rom rom;
+	bool haveRom = !romPath.empty();
+	if (haveRom) {
+		if (!rom.load(romPath, &database, &romCache)) {
+			return 1;
+		}
+		region = rom.getIdentity().info.region; // the cartridge decides, not the command line
+	}
+
+	// without a ROM, a small test program as a 16K PRG-ROM, shared by every console here
+	std::vector<uint8_t> testPrg(16384, 0);
+	const uint8_t program[] = {
+		0xa9, 0x01, 0x8d, 0x00, 0x02, // LDA #$01, STA $0200
+		0xa9, 0x05, 0x8d, 0x01, 0x02, // LDA #$05, STA $0201
+		0xa9, 0x08, 0x8d, 0x02, 0x02, // LDA #$08, STA $0202
+	};
+	memcpy(testPrg.data(), program, sizeof(program));
+	// 6502 has a reset vector of FFFC and FFFD and also is little endian ==> 00 C0 is 0xC000
+	// (the start of the ROM, mirrored at $8000 and $C000)
+	testPrg[0x3FFC] = 0x00;
+	testPrg[0x3FFD] = 0xC0;
+
+	std::unique_ptr<Console> console(new Console(region)); // too big for the stack
+	SaveRam save; // goes first, detaching from the console it's attached to
+	console->mapPRG(testPrg.data(), uint32_t(testPrg.size()));
+	console->reset();
+	if (haveRom && !rom.install(*console)) {
+		return 1;
+	}
+	if (haveRom && rom.getIdentity().info.battery && save.open(SaveRam::pathFor(romPath))) {
+		save.attach(*console);
+	}
+	CPU& cpu = console->getCPU();
+	cpu.setAccuracy(accuracy);
+
+	AotCode compiled;
+	if (!aotPath.empty()) {
+		std::vector<uint8_t> image(Console::kAddressSpace);
+		console->copyImage(image.data());
+		if (compiled.load(aotPath, image.data(), 0, Console::kAddressSpace)) {
+			console->setCompiledCode(&compiled);
+		}
+	}
+
+	if (mode == "--realtime") {
+		std::unique_ptr<AudioSink> sink;
+		if (wavPath.empty()) { sink.reset(new NullSink()); }
+		else                 { sink.reset(new WavFileSink(wavPath)); }
+		runRealtime(*console, region, *sink, shmName, capturePath);
+		return 0;
+	}
+	if (mode == "--batch") {
+		// every instance runs the same (shared) ROM
+		runBatch([&testPrg, &rom, haveRom](Console& c) {
+				if (haveRom) { rom.install(c); }
+				else         { c.mapPRG(testPrg.data(), uint32_t(testPrg.size())); }
+			},
+			argc > 2 ? atoi(argv[2]) : 16, argc > 3 ? atoi(argv[3]) : 1000);
+		return 0;
+	}
+	if (mode == "--netplay-test" || mode == "--netplay") {
+		// both sides must start from the same state, so netplay uses pristine consoles
+		std::vector<uint8_t> padPrg = padTestProgram();
+		BatchEnv::Loader loader = [&padPrg, &rom, haveRom, accuracy](Console& c) {
+			if (haveRom) { rom.install(c); }
+			else         { c.mapPRG(padPrg.data(), uint32_t(padPrg.size())); }
+			c.getCPU().setAccuracy(accuracy);
+		};
+		if (mode == "--netplay-test") {
+			return runNetplayTest(loader, region, argc > 2 ? atoi(argv[2]) : 3600, argc > 3 ? atoi(argv[3]) : 3,
+				argc > 4 ? atoi(argv[4]) : 0);
+		}
+		if (argc > 4) {
+			std::unique_ptr<Console> player(new Console(region));
+			loader(*player);
+			player->reset();
+			return runNetplay(*player, region, atoi(argv[2]) - 1, uint16_t(atoi(argv[3])), argc > 6 ? argv[6] : "127.0.0.1",
+				uint16_t(atoi(argv[4])), argc > 5 ? atoi(argv[5]) : 600);
+		}
+	}
+	if (mode == "--record" && argc > 2) {
+		runRecord(*console, argv[2], argc > 3 ? atoi(argv[3]) : 3600);
+		return 0;
+	}
+	if (mode == "--capture" && argc > 2) {
+		runCapture(*console, region, argv[2], argc > 3 ? atoi(argv[3]) : 600);
+		return 0;
+	}
+	if (mode == "--play" && argc > 2) {
+		return runPlay(*console, argv[2]);
+	}
+	if (mode == "--analyze") {
+		runAnalyze(*console, argc > 2 ? argv[2] : "nes.codemap");
+		return 0;
+	}
+	if (mode == "--recompile" && argc > 2) {
+		runRecompile(*console, argv[2], argc > 3 && argv[3][0] != '-' ? argv[3] : "nes.codemap");
+		return 0;
+	}
+	if (mode == "--turbo") {
+		runTurbo(*console, argc > 2 ? atoi(argv[2]) : 3600);
+		return 0;
+	}
 
-#include "cpu.h"
-
-int main() {
-	const int kMemorySize = 65536;
-	uint8_t memory[kMemorySize]; // 6502 has 16 address lines, meaning it can address 2^16 bytes
-	std::fill(memory, memory + kMemorySize, 0x00);
-
-	// TODO: load memory manually for now -- we will obviously load in actual ROMs in the end
-	memory[0x6000] = 0xa9;
-	memory[0x6001] = 0x01;
-	memory[0x6002] = 0x8d;
-	memory[0x6003] = 0x00;
-	memory[0x6004] = 0x02;
-	memory[0x6005] = 0xa9;
-	memory[0x6006] = 0x05;
-	memory[0x6007] = 0x8d;
-	memory[0x6008] = 0x01;
-	memory[0x6009] = 0x02;
-	memory[0x600A] = 0xa9;
-	memory[0x600B] = 0x08;
-	memory[0x600C] = 0x8d;
-	memory[0x600D] = 0x02;
-	memory[0x600E] = 0x02;
-
-	// 6502 has a reset vector of FFFC and FFFD and also is little endian ==> 00 60 is 0x6000
-	memory[0xFFFC] = 0x00;
-	memory[0xFFFD] = 0x60;
-
-	CPU cpu(memory);
+	Debugger debugger(*console);
+	for (uint16_t pc : breakpoints) {
+		debugger.addBreakpoint(pc);
+	}
+	for (uint16_t addr : watchpoints) {
+		debugger.addWatchpoint(addr, addr, Debugger::Access::ReadWrite);
+	}
 
 	char control; // just used for stepping for now
 	while (true) {
 		control = _getch();
-		     if (control == ' ') { cpu.step(); }
+		     if (control == ' ') { reportStop(*console, debugger, debugger.stepInto()); }
+		else if (control == 'n') { reportStop(*console, debugger, debugger.stepOver()); }
+		else if (control == 'u') { reportStop(*console, debugger, debugger.stepOut()); }
+		else if (control == 'c') { reportStop(*console, debugger, debugger.resume()); }
 		else if (control == 'd') { cpu.dump(); }
 		else { continue; }
 	}
@@ -0,0 +1,252 @@
+/************************************************************************************
+
+Filename    :   movie.cpp
+Content     :   Input movie recording and playback
+Authors     :   Yash Patel
+
+*************************************************************************************/
+
+#include "movie.h"
+
+#include <stdio.h>
+
+namespace {
+
+const char kMagic[4] = { 'N', 'E', 'S', 'M' };
+const uint64_t kVersion = 1;
+
+void putVarint(std::vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(uint8_t(value) | 0x80);
+        value >>= 7;
+    }
+    out.push_back(uint8_t(value));
+}
+
+void putU64(std::vector<uint8_t>& out, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        out.push_back(uint8_t(value >> (8 * i)));
+    }
+}
+
+// bounds-checked reader; any overrun latches `ok` to false
+struct Reader {
+    const std::vector<uint8_t>& data;
+    size_t pos;
+    bool ok;
+
+    uint8_t byte() {
+        if (pos >= data.size()) {
+            ok = false;
+            return 0;
+        }
+        return data[pos++];
+    }
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t b = byte();
+            value |= uint64_t(b & 0x7F) << shift;
+            if (!(b & 0x80)) {
+                return value;
+            }
+        }
+        ok = false;
+        return 0;
+    }
+    uint64_t u64() {
+        uint64_t value = 0;
+        for (int i = 0; i < 8; i++) {
+            value |= uint64_t(byte()) << (8 * i);
+        }
+        return value;
+    }
+};
+
+} // namespace
+
+Movie::Movie() {
+    clear(Region::NTSC);
+}
+
+void Movie::clear(Region movieRegion, int interval) {
+    region = movieRegion;
+    hashInterval = interval < 1 ? 1 : interval;
+    startHash = 0;
+    inputs.clear();
+    hashes.clear();
+}
+
+std::vector<uint8_t> Movie::encode() const {
+    std::vector<uint8_t> out(kMagic, kMagic + 4);
+    putVarint(out, kVersion);
+    out.push_back(region == Region::PAL ? 1 : 0);
+    putVarint(out, uint64_t(hashInterval));
+    putU64(out, startHash);
+    putVarint(out, inputs.size());
+
+    std::vector<uint8_t> runs;
+    uint64_t runCount = 0;
+    for (size_t i = 0; i < inputs.size();) {
+        size_t end = i + 1;
+        while (end < inputs.size() && inputs[end] == inputs[i]) {
+            end++;
+        }
+        putVarint(runs, end - i);
+        runs.push_back(uint8_t(inputs[i]));
+        runs.push_back(uint8_t(inputs[i] >> 8));
+        runCount++;
+        i = end;
+    }
+    putVarint(out, runCount);
+    out.insert(out.end(), runs.begin(), runs.end());
+
+    putVarint(out, hashes.size());
+    for (uint64_t hash : hashes) {
+        putU64(out, hash);
+    }
+    return out;
+}
+
+bool Movie::decode(const std::vector<uint8_t>& data) {
+    Reader in = { data, 0, true };
+    for (char c : kMagic) {
+        if (in.byte() != uint8_t(c)) {
+            return false;
+        }
+    }
+    if (in.varint() != kVersion) {
+        return false;
+    }
+
+    Region movieRegion = in.byte() ? Region::PAL : Region::NTSC;
+    uint64_t interval = in.varint();
+    uint64_t start = in.u64();
+    uint64_t frames = in.varint();
+    if (!in.ok || interval == 0 || interval > 0x7FFFFFFF || frames > kMaxFrames) {
+        return false;
+    }
+
+    std::vector<uint16_t> decoded;
+    uint64_t runCount = in.varint();
+    for (uint64_t r = 0; r < runCount && in.ok; r++) {
+        uint64_t length = in.varint();
+        uint16_t value = in.byte();
+        value |= uint16_t(in.byte()) << 8;
+        if (length > frames - decoded.size()) {
+            return false;
+        }
+        decoded.insert(decoded.end(), size_t(length), value);
+    }
+
+    std::vector<uint64_t> checkpoints;
+    uint64_t hashCount = in.varint();
+    for (uint64_t h = 0; h < hashCount && in.ok; h++) {
+        checkpoints.push_back(in.u64());
+    }
+    if (!in.ok || decoded.size() != frames) {
+        return false;
+    }
+
+    region = movieRegion;
+    hashInterval = int(interval);
+    startHash = start;
+    inputs.swap(decoded);
+    hashes.swap(checkpoints);
+    return true;
+}
+
+bool Movie::save(const std::string& path) const {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    std::vector<uint8_t> data = encode();
+    bool ok = fwrite(data.data(), 1, data.size(), file) == data.size();
+    return (fclose(file) == 0) && ok;
+}
+
+bool Movie::load(const std::string& path) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    std::vector<uint8_t> data;
+    uint8_t chunk[4096];
+    size_t got;
+    while ((got = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        data.insert(data.end(), chunk, chunk + got);
+    }
+    fclose(file);
+    return decode(data);
+}
+
+// recording
+
+MovieRecorder::MovieRecorder(Console& console, Movie& movie, int hashInterval) :
+    console(console),
+    movie(movie) {
+    movie.clear(console.getRegion(), hashInterval);
+    console.reset();
+    movie.startHash = console.stateHash();
+}
+
+void MovieRecorder::runFrame(uint8_t port1, uint8_t port2, bool render) {
+    console.getController(0).setButtons(port1);
+    console.getController(1).setButtons(port2);
+    console.runFrame(render);
+
+    movie.inputs.push_back(uint16_t(port1 | (port2 << 8)));
+    if (movie.inputs.size() % movie.hashInterval == 0) {
+        movie.hashes.push_back(console.stateHash());
+    }
+}
+
+// playback
+
+MoviePlayer::MoviePlayer(Console& console, const Movie& movie) :
+    console(console),
+    movie(movie),
+    status(Status::Playing),
+    frame(0),
+    desyncFrame(-1) {
+    console.setTurbo(true);
+    console.reset();
+    if (console.getRegion() != movie.region || console.stateHash() != movie.startHash) {
+        // different program (or console) than the one that was recorded
+        status = Status::Desync;
+        desyncFrame = 0;
+    } else if (movie.frameCount() == 0) {
+        status = Status::Finished;
+    }
+}
+
+MoviePlayer::Status MoviePlayer::runFrame() {
+    if (status != Status::Playing) {
+        return status;
+    }
+
+    console.getController(0).setButtons(movie.buttons(frame, 0));
+    console.getController(1).setButtons(movie.buttons(frame, 1));
+    console.runFrame();
+    frame++;
+
+    if (frame % movie.hashInterval == 0) {
+        size_t checkpoint = size_t(frame / movie.hashInterval) - 1;
+        if (checkpoint < movie.hashes.size() && console.stateHash() != movie.hashes[checkpoint]) {
+            status = Status::Desync;
+            desyncFrame = int64_t(frame);
+            return status;
+        }
+    }
+    if (frame == movie.frameCount()) {
+        status = Status::Finished;
+    }
+    return status;
+}
+
+MoviePlayer::Status MoviePlayer::play() {
+    while (runFrame() == Status::Playing) {
+    }
+    return status;
+}
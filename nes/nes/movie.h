@@ -0,0 +1,97 @@
+/************************************************************************************
+
+Filename    :   movie.h
+Content     :   Input movie recording and playback (header)
+Authors     :   Yash Patel
+
+A movie is everything needed to replay a session deterministically: the buttons held
+on both controller ports for every frame since reset, plus the console's state hash
+every hashInterval frames so playback can prove it's still on the recorded path
+(and report the first checkpoint where it isn't).
+
+File format (integers are LEB128 varints unless noted):
+
+    "NESM"  version  region(byte)  hashInterval  startHash(u64 LE)  frameCount
+    runCount  { length  port1(byte)  port2(byte) } * runCount
+    hashCount { hash(u64 LE) } * hashCount
+
+Input is run-length encoded: pads change rarely relative to 60 frames a second, so
+an hour of play is typically a few KB.
+
+*************************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "console.h"
+#include "pacer.h"
+
+class Movie {
+public:
+	static const int kDefaultHashInterval = 60;
+	static const uint64_t kMaxFrames = 60 * 60 * 60 * 24; // a day of play; bounds what load() allocates
+
+	Movie();
+	~Movie() = default;
+
+	void clear(Region region, int hashInterval = kDefaultHashInterval);
+
+	std::vector<uint8_t> encode() const;
+	bool decode(const std::vector<uint8_t>& data); // false if malformed
+	bool save(const std::string& path) const;
+	bool load(const std::string& path);
+
+	size_t frameCount() const { return inputs.size(); }
+	uint8_t buttons(size_t frame, int port) const { return uint8_t(inputs[frame] >> (8 * port)); }
+
+	Region region;
+	int hashInterval;
+	uint64_t startHash;            // state hash right after reset
+	std::vector<uint16_t> inputs;  // per frame: port1 | port2 << 8
+	std::vector<uint64_t> hashes;  // hashes[k]: state hash after frame (k + 1) * hashInterval
+};
+
+// resets the console (load the program first) and records every frame run through it
+class MovieRecorder {
+public:
+	MovieRecorder(Console& console, Movie& movie, int hashInterval = Movie::kDefaultHashInterval);
+	~MovieRecorder() = default;
+
+	void runFrame(uint8_t port1, uint8_t port2 = 0, bool render = true);
+
+private:
+	Console& console;
+	Movie& movie;
+};
+
+// resets the console (load the program first) and replays the movie in turbo mode
+class MoviePlayer {
+public:
+	enum class Status {
+		Playing,
+		Finished,
+		Desync // state hash (or region) didn't match the recording
+	};
+
+	MoviePlayer(Console& console, const Movie& movie);
+	~MoviePlayer() = default;
+
+	Status runFrame();
+	Status play(); // runs to the end (or the first desync)
+
+	Status getStatus() const { return status; }
+	uint64_t getFrame() const { return frame; }  // frames played
+	int64_t getDesyncFrame() const { return desyncFrame; } // first mismatching checkpoint, -1 if none
+
+private:
+	Console& console;
+	const Movie& movie;
+	Status status;
+	uint64_t frame;
+	int64_t desyncFrame;
+};
@@ -0,0 +1,182 @@
+/************************************************************************************
+
+Filename    :   netplay.cpp
+Content     :   Rollback netplay for two players
+Authors     :   Yash Patel
+
+*************************************************************************************/
+
+#include "netplay.h"
+
+#include <string.h>
+
+namespace {
+
+// packet layout, little endian:
+//   u32 first input's frame, u8 input count, u32 ack (inputs received from the
+//   other side), u32 frames confirmed, u64 state hash after the last confirmed
+//   frame, then one byte of buttons per input
+const size_t kHeaderSize = 4 + 1 + 4 + 4 + 8;
+
+void put(std::vector<uint8_t>& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out.push_back(uint8_t(value >> (8 * i)));
+    }
+}
+
+uint64_t get(const uint8_t* in, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) {
+        value |= uint64_t(in[i]) << (8 * i);
+    }
+    return value;
+}
+
+} // namespace
+
+RollbackSession::RollbackSession(Console& console, Transport& transport, int localPlayer, int maxRollback) :
+    console(console),
+    transport(transport),
+    localPlayer(localPlayer & 1),
+    maxRollback(maxRollback < 1 ? 1 : maxRollback > kMaxRollback ? kMaxRollback : maxRollback),
+    current(0),
+    remoteCount(0),
+    peerAcked(0),
+    rollbackFrom(kNone),
+    states(size_t(this->maxRollback + 1)),
+    peerSyncFrame(0),
+    peerSyncHash(0),
+    rollbacks(0),
+    resimulated(0),
+    deepest(0),
+    stalls(0),
+    desyncFrame(kNone) {
+    memset(localInputs, 0, sizeof(localInputs));
+    memset(remoteInputs, 0, sizeof(remoteInputs));
+    memset(hashes, 0, sizeof(hashes));
+}
+
+bool RollbackSession::advance(uint8_t buttons) {
+    poll();
+    if (rollbackFrom != kNone) {
+        rollback(rollbackFrom);
+        rollbackFrom = kNone;
+    }
+    checkSync();
+
+    // the snapshot before frame remoteCount must survive this frame's
+    if (current >= remoteCount + uint64_t(maxRollback)) {
+        stalls++;
+        sendInputs();
+        return false;
+    }
+    localInputs[current % kHistory] = buttons;
+    simulate(current, true);
+    current++;
+    sendInputs();
+    return true;
+}
+
+bool RollbackSession::confirmedHash(uint64_t frame, uint64_t& hash) const {
+    if (frame >= getConfirmedFrame() || frame + kHistory < current) {
+        return false;
+    }
+    hash = hashes[frame % kHistory];
+    return true;
+}
+
+void RollbackSession::poll() {
+    while (transport.receive(packet)) {
+        if (packet.size() < kHeaderSize) {
+            continue;
+        }
+        const uint8_t* p = packet.data();
+        uint64_t first = get(p, 4);
+        size_t count = p[4];
+        uint64_t ack = get(p + 5, 4);
+        uint64_t syncFrame = get(p + 9, 4);
+        uint64_t syncHash = get(p + 13, 8);
+        if (packet.size() < kHeaderSize + count) {
+            continue;
+        }
+        const uint8_t* inputs = p + kHeaderSize;
+
+        if (ack > peerAcked && ack <= current) {
+            peerAcked = ack;
+        }
+        if (syncFrame > peerSyncFrame) {
+            peerSyncFrame = syncFrame;
+            peerSyncHash = syncHash;
+        }
+        // only contiguous inputs are taken: earlier ones are duplicates, and after a
+        // gap a later packet resends the missing ones
+        for (uint64_t frame = first; frame < first + count; frame++) {
+            if (frame != remoteCount) {
+                continue;
+            }
+            uint8_t real = inputs[frame - first];
+            if (frame < current && remoteInputs[frame % kHistory] != real && frame < rollbackFrom) {
+                rollbackFrom = frame;
+            }
+            remoteInputs[frame % kHistory] = real;
+            remoteCount++;
+        }
+    }
+}
+
+void RollbackSession::rollback(uint64_t from) {
+    console.loadState(states[from % states.size()]);
+    bool turbo = console.isTurbo();
+    console.setTurbo(true); // nothing re-simulated is shown or heard
+    for (uint64_t frame = from; frame < current; frame++) {
+        simulate(frame, false);
+    }
+    console.setTurbo(turbo);
+
+    int depth = int(current - from);
+    rollbacks++;
+    resimulated += uint64_t(depth);
+    if (depth > deepest) {
+        deepest = depth;
+    }
+}
+
+void RollbackSession::simulate(uint64_t frame, bool render) {
+    if (frame >= remoteCount) {
+        remoteInputs[frame % kHistory] = remoteCount > 0 ? remoteInputs[(remoteCount - 1) % kHistory] : 0;
+    }
+    console.saveState(states[frame % states.size()]);
+    console.getController(localPlayer).setButtons(localInputs[frame % kHistory]);
+    console.getController(localPlayer ^ 1).setButtons(remoteInputs[frame % kHistory]);
+    console.runFrame(render);
+    hashes[frame % kHistory] = console.stateHash();
+}
+
+void RollbackSession::sendInputs() {
+    uint64_t first = peerAcked;
+    if (current > uint64_t(kMaxPacketInputs) && first < current - kMaxPacketInputs) {
+        first = current - kMaxPacketInputs;
+    }
+    uint64_t confirmed = getConfirmedFrame();
+
+    packet.clear();
+    put(packet, first, 4);
+    put(packet, current - first, 1);
+    put(packet, remoteCount, 4);
+    put(packet, confirmed, 4);
+    put(packet, confirmed > 0 ? hashes[(confirmed - 1) % kHistory] : 0, 8);
+    for (uint64_t frame = first; frame < current; frame++) {
+        packet.push_back(localInputs[frame % kHistory]);
+    }
+    transport.send(packet.data(), packet.size());
+}
+
+void RollbackSession::checkSync() {
+    if (desyncFrame != kNone || peerSyncFrame == 0) {
+        return;
+    }
+    uint64_t hash;
+    if (confirmedHash(peerSyncFrame - 1, hash) && hash != peerSyncHash) {
+        desyncFrame = peerSyncFrame - 1;
+    }
+}
@@ -0,0 +1,107 @@
+/************************************************************************************
+
+Filename    :   netplay.h
+Content     :   Rollback netplay for two players (header)
+Authors     :   Yash Patel
+
+Each side runs its own console and never waits for the other's input. A frame runs
+as soon as the local input is known; the remote input is predicted (the last one
+that arrived, since buttons change rarely from one frame to the next). When the
+real remote input for a frame turns out different from the prediction, the console
+is rolled back to its snapshot from before that frame and the frames since are run
+again, headless, with the corrected input, all before the next frame is shown.
+
+    LoopbackTransport a, b;            // or UdpTransport, see transport.h
+    LoopbackTransport::connect(a, b, 3);
+    RollbackSession session(console, a, 0);
+    while (playing) {
+        session.advance(localButtons);  // once per displayed frame
+    }
+
+A snapshot is taken before every frame (Console::saveState, a few tens of KB) into a
+ring of maxRollback + 1. Rolling back further isn't possible, so a side that gets
+maxRollback frames ahead of the last input it has from the other stalls instead:
+advance() returns false without running a frame. That bounds a rollback to
+maxRollback re-simulated frames, which is what has to fit in one frame's budget.
+
+Packets carry the local inputs the other side hasn't acknowledged yet (so a lost
+packet is covered by the next one), an acknowledgement, and the state hash after
+the newest frame whose inputs are confirmed on both sides; a different hash for
+the same frame on the other side flags a desync.
+
+Both consoles must start from the same state (same ROM, freshly reset, same
+settings), and the session owns their controllers while it runs.
+
+*************************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "console.h"
+#include "transport.h"
+
+class RollbackSession {
+public:
+	static const int kDefaultRollback = 8;
+	static const int kMaxRollback = 16;
+	static const int kHistory = 64; // frames of inputs and hashes kept
+
+	// localPlayer: 0 or 1, which controller the local input goes to
+	RollbackSession(Console& console, Transport& transport, int localPlayer, int maxRollback = kDefaultRollback);
+	~RollbackSession() = default;
+
+	// takes in whatever arrived, rolls back if a prediction was wrong, then runs the
+	// next frame (rendered) with `buttons` for the local player. False if stalled
+	// waiting for the other side; keep calling once per frame (it also keeps sending).
+	bool advance(uint8_t buttons);
+
+	uint64_t getFrame() const { return current; }           // frames run
+	uint64_t getConfirmedFrame() const { return remoteCount < current ? remoteCount : current; } // frames final on both sides
+	// state hash after `frame`, once that frame is confirmed and still in the history
+	bool confirmedHash(uint64_t frame, uint64_t& hash) const;
+
+	uint64_t getRollbacks() const { return rollbacks; }
+	uint64_t getResimulated() const { return resimulated; } // frames run again
+	int getDeepestRollback() const { return deepest; }
+	uint64_t getStalls() const { return stalls; }
+	bool desynced() const { return desyncFrame != kNone; }
+	uint64_t getDesyncFrame() const { return desyncFrame; }
+
+private:
+	static const uint64_t kNone = ~uint64_t(0);
+	static const int kMaxPacketInputs = 32;
+
+	void poll();                           // reads packets; may request a rollback
+	void rollback(uint64_t from);
+	void simulate(uint64_t frame, bool render);
+	void sendInputs();
+	void checkSync();
+
+	Console& console;
+	Transport& transport;
+	int localPlayer;
+	int maxRollback;
+
+	uint64_t current;      // next frame to run
+	uint64_t remoteCount;  // remote inputs received, contiguous from frame 0
+	uint64_t peerAcked;    // local inputs the other side has
+	uint64_t rollbackFrom; // earliest mispredicted frame, kNone if none
+
+	uint8_t localInputs[kHistory];
+	uint8_t remoteInputs[kHistory]; // received, or what was predicted
+	uint64_t hashes[kHistory];      // state hash after each frame
+	std::vector<Console::State> states; // before each frame, maxRollback + 1 of them
+
+	uint64_t peerSyncFrame; // frames the other side has confirmed
+	uint64_t peerSyncHash;  // its state hash after the last of them
+	std::vector<uint8_t> packet;
+
+	uint64_t rollbacks;
+	uint64_t resimulated;
+	int deepest;
+	uint64_t stalls;
+	uint64_t desyncFrame;
+};
@@ -0,0 +1,167 @@
+/************************************************************************************
+
+Filename    :   pacer.cpp
+Content     :   Real-time frame pacing
+Authors     :   Yash Patel
+
+Timing reference (https://www.nesdev.org/wiki/Cycle_reference_chart):
+
+            CPU clock        cycles / frame     frame rate
+    NTSC    1789772.7 Hz     29780.5            60.0988 Hz
+    PAL     1662607.0 Hz     33247.5            50.0070 Hz
+
+*************************************************************************************/
+
+#include "pacer.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+namespace {
+
+const double kNtscCpuClock = 236.25e6 / 11.0 / 12.0;
+const double kNtscFrameCycles = 29780.5;
+const double kPalCpuClock = 26.601712e6 / 16.0;
+const double kPalFrameCycles = 33247.5;
+
+const std::chrono::nanoseconds kMinSleepMargin(200 * 1000);      // 0.2 ms
+const std::chrono::nanoseconds kInitialSleepMargin(2000 * 1000); // 2 ms
+
+} // namespace
+
+double cpuClockRate(Region region) {
+    return (region == Region::NTSC) ? kNtscCpuClock : kPalCpuClock;
+}
+
+FramePacer::FramePacer(Region region) :
+    sleepMargin(kInitialSleepMargin),
+    intervals(kHistory, 0.0),
+    nextInterval(0),
+    havePresent(false),
+    frames(0),
+    skipped(0),
+    resyncs(0) {
+    if (region == Region::NTSC) {
+        frameCycles = kNtscFrameCycles;
+        period = kNtscFrameCycles / kNtscCpuClock;
+    } else {
+        frameCycles = kPalFrameCycles;
+        period = kPalFrameCycles / kPalCpuClock;
+    }
+}
+
+void FramePacer::run(const FrameFn& frame, const std::function<bool()>& keepRunning) {
+    const std::chrono::duration<double> periodDuration(period);
+    const Clock::duration maxLag =
+        std::chrono::duration_cast<Clock::duration>(periodDuration * double(kMaxLagFrames));
+
+    // deadlines are computed from an epoch and a frame count rather than by adding
+    // the period repeatedly, so the fractional period never drifts
+    Clock::time_point epoch = Clock::now();
+    uint64_t scheduled = 0;
+    int skippedInRow = 0;
+
+    while (keepRunning()) {
+        Clock::time_point deadline = epoch +
+            std::chrono::duration_cast<Clock::duration>(periodDuration * double(scheduled));
+        Clock::time_point now = Clock::now();
+
+        if (now - deadline > maxLag) {
+            // too far behind to catch up without a burst of skipped frames: start over
+            epoch = now;
+            scheduled = 0;
+            deadline = now;
+            resyncs++;
+        }
+
+        // a whole frame behind schedule: emulate this one without presenting it
+        bool late = now - deadline >= periodDuration;
+        bool render = !late || skippedInRow >= kMaxSkip;
+
+        if (!late) {
+            waitUntil(deadline);
+        }
+        if (render) {
+            recordInterval(Clock::now());
+            skippedInRow = 0;
+        } else {
+            skipped++;
+            skippedInRow++;
+        }
+
+        frame(render);
+        frames++;
+        scheduled++;
+    }
+}
+
+void FramePacer::waitUntil(Clock::time_point deadline) {
+    Clock::time_point now = Clock::now();
+    if (deadline - now > sleepMargin) {
+        Clock::duration target = (deadline - now) - sleepMargin;
+        std::this_thread::sleep_for(target);
+        Clock::duration oversleep = (Clock::now() - now) - target;
+
+        // grow the margin quickly when the OS oversleeps, shrink it slowly otherwise
+        std::chrono::nanoseconds wanted =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(oversleep * 3 / 2);
+        std::chrono::nanoseconds decayed = sleepMargin - sleepMargin / 16;
+        std::chrono::nanoseconds maxMargin =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double>(period));
+        sleepMargin = std::min(maxMargin, std::max(kMinSleepMargin, std::max(wanted, decayed)));
+    }
+
+    // spin the remainder; yield keeps us polite on hosts with few cores
+    while (Clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+}
+
+void FramePacer::recordInterval(Clock::time_point now) {
+    if (havePresent) {
+        intervals[nextInterval % kHistory] =
+            std::chrono::duration<double, std::milli>(now - lastPresent).count();
+        nextInterval++;
+    }
+    lastPresent = now;
+    havePresent = true;
+}
+
+FramePacer::Stats FramePacer::stats() const {
+    Stats stats;
+    stats.frames = frames;
+    stats.skipped = skipped;
+    stats.resyncs = resyncs;
+    stats.p50 = stats.p95 = stats.p99 = stats.max = 0.0;
+
+    size_t count = std::min<size_t>(nextInterval, kHistory);
+    if (count == 0) {
+        return stats;
+    }
+
+    std::vector<double> sorted(intervals.begin(), intervals.begin() + count);
+    std::sort(sorted.begin(), sorted.end());
+    stats.p50 = sorted[(count - 1) * 50 / 100];
+    stats.p95 = sorted[(count - 1) * 95 / 100];
+    stats.p99 = sorted[(count - 1) * 99 / 100];
+    stats.max = sorted[count - 1];
+    return stats;
+}
+
+void FramePacer::dumpStats() const {
+    Stats s = stats();
+    std::ios::fmtflags flags = std::cout.flags(); // restored below, so later output isn't fixed too
+    std::streamsize precision = std::cout.precision();
+    std::cout << "[         Frame Pacing          ]" << std::endl;
+    std::cout << "target  " << std::fixed << std::setprecision(3) << period * 1000.0 << " ms" << std::endl;
+    std::cout << "frames  " << s.frames << " (" << s.skipped << " skipped, "
+        << s.resyncs << " resyncs)" << std::endl;
+    std::cout << "p50     " << s.p50 << " ms" << std::endl;
+    std::cout << "p95     " << s.p95 << " ms" << std::endl;
+    std::cout << "p99     " << s.p99 << " ms" << std::endl;
+    std::cout << "max     " << s.max << " ms" << std::endl;
+    std::cout.flags(flags);
+    std::cout.precision(precision);
+}
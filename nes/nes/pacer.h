@@ -0,0 +1,81 @@
+/************************************************************************************
+
+Filename    :   pacer.h
+Content     :   Real-time frame pacing (header)
+Authors     :   Yash Patel
+
+Runs the emulator one whole frame at a time and throttles it to the console's real
+refresh rate: NTSC runs at 60.0988 Hz, PAL at 50.007 Hz. Frame deadlines are absolute
+(start + n * period), so rounding never accumulates into drift. Waiting is a coarse
+sleep followed by a short spin, with the sleep margin adapted to how much the OS
+actually oversleeps. When the host falls behind, frames are emulated without being
+presented until the schedule is caught up again.
+
+*************************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <chrono>
+#include <functional>
+#include <vector>
+
+enum class Region {
+	NTSC,
+	PAL
+};
+
+double cpuClockRate(Region region); // Hz
+
+class FramePacer {
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	// frame(render) emulates one frame; render is false for frames being skipped
+	typedef std::function<void(bool render)> FrameFn;
+
+	struct Stats {
+		uint64_t frames;  // frames emulated
+		uint64_t skipped; // frames emulated without being presented
+		uint64_t resyncs; // times the schedule was abandoned because we fell too far behind
+		double p50;       // frame-to-frame interval percentiles (ms)
+		double p95;
+		double p99;
+		double max;
+	};
+
+	FramePacer(Region region);
+	~FramePacer() = default;
+
+	// runs frames until keepRunning() returns false
+	void run(const FrameFn& frame, const std::function<bool()>& keepRunning);
+
+	double framePeriod() const { return period; }          // seconds
+	double cyclesPerFrame() const { return frameCycles; } // CPU cycles (fractional)
+
+	Stats stats() const;
+	void dumpStats() const;
+
+private:
+	void waitUntil(Clock::time_point deadline);
+	void recordInterval(Clock::time_point now);
+
+	static const int kMaxSkip = 4;          // consecutive unpresented frames before we present anyway
+	static const int kMaxLagFrames = 8;     // lag at which we stop catching up and resync
+	static const int kHistory = 4096;       // frame intervals kept for percentiles
+
+	double period;
+	double frameCycles;
+
+	std::chrono::nanoseconds sleepMargin; // spin this long before each deadline
+
+	std::vector<double> intervals; // ring buffer of frame intervals (ms)
+	size_t nextInterval;
+	Clock::time_point lastPresent;
+	bool havePresent;
+
+	uint64_t frames;
+	uint64_t skipped;
+	uint64_t resyncs;
+};
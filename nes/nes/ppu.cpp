@@ -0,0 +1,672 @@
+/************************************************************************************
+
+Filename    :   ppu.cpp
+Content     :   Picture processing unit
+Authors     :   Yash Patel
+
+Register and scrolling behaviour follows https://www.nesdev.org/wiki/PPU_registers and
+https://www.nesdev.org/wiki/PPU_scrolling. Timing is per scanline rather than per dot:
+each visible line is drawn in one go from the scroll position at its start, then the
+end-of-line scroll updates (increment fine/coarse Y, reload horizontal bits from t)
+are applied the way the hardware does them at dots 256/257.
+
+*************************************************************************************/
+
+#include "ppu.h"
+
+#include <string.h>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define NES_PPU_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// $3F10/$3F14/$3F18/$3F1C are mirrors of $3F00/$3F04/$3F08/$3F0C
+uint8_t paletteIndex(uint16_t addr) {
+    addr &= 0x1F;
+    if ((addr & 0x13) == 0x10) {
+        addr &= 0x0F;
+    }
+    return uint8_t(addr);
+}
+
+} // namespace
+
+PPU::PPU(Region region) :
+    lastScanline(region == Region::PAL ? 311 : 261),
+    renderOutput(false),
+    mirroring(Mirroring::Vertical),
+    chr(chrRam),
+    stateHash(nullptr),
+    chrBlock(0),
+    vramBlock(0),
+    oamBlock(0) {
+    reset();
+}
+
+void PPU::trackState(StateHash* hash) {
+    stateHash = hash;
+    chrBlock = hash->track(chrRam, sizeof(chrRam));
+    vramBlock = hash->track(vram, sizeof(vram));
+    oamBlock = hash->track(oam, sizeof(oam));
+}
+
+uint64_t PPU::hashRegisters() const {
+    uint8_t packed[16 + sizeof(palette)];
+    packed[0] = ctrl;
+    packed[1] = mask;
+    packed[2] = status;
+    packed[3] = oamAddr;
+    packed[4] = latch;
+    packed[5] = readBuffer;
+    packed[6] = uint8_t(v);
+    packed[7] = uint8_t(v >> 8);
+    packed[8] = uint8_t(t);
+    packed[9] = uint8_t(t >> 8);
+    packed[10] = x;
+    packed[11] = w;
+    packed[12] = nmiPending;
+    packed[13] = uint8_t(scanline);
+    packed[14] = uint8_t(scanline >> 8);
+    packed[15] = 0;
+    memcpy(packed + 16, palette, sizeof(palette));
+    return hashBytes(packed, sizeof(packed), 0x2C02);
+}
+
+void PPU::reset() {
+    scanline = 0;
+    ctrl = mask = status = oamAddr = latch = readBuffer = 0;
+    v = t = 0;
+    x = 0;
+    w = false;
+    nmiPending = false;
+
+    memset(oam, 0, sizeof(oam));
+    spriteListsDirty = true;
+    spriteListHeight = 0;
+    memset(vram, 0, sizeof(vram));
+    memset(palette, 0, sizeof(palette));
+    memset(chrRam, 0, sizeof(chrRam)); // CHR-ROM stays loaded
+    if (output) {
+        memset(output->pixels, 0, sizeof(output->pixels));
+    }
+    memset(emphasis, 0, sizeof(emphasis));
+    invalidateCaches();
+}
+
+void PPU::loadCHR(const uint8_t* rom) {
+    chr = rom != nullptr ? rom : chrRam;
+    invalidateCaches();
+}
+
+void PPU::saveState(State& state) const {
+    state.scanline = scanline;
+    state.nmiPending = nmiPending;
+    state.w = w;
+    state.ctrl = ctrl;
+    state.mask = mask;
+    state.status = status;
+    state.oamAddr = oamAddr;
+    state.latch = latch;
+    state.readBuffer = readBuffer;
+    state.x = x;
+    state.v = v;
+    state.t = t;
+    memcpy(state.oam, oam, sizeof(oam));
+    memcpy(state.vram, vram, sizeof(vram));
+    memcpy(state.palette, palette, sizeof(palette));
+    memcpy(state.chrRam, chrRam, sizeof(chrRam));
+}
+
+void PPU::loadState(const State& state) {
+    scanline = state.scanline;
+    nmiPending = state.nmiPending;
+    w = state.w;
+    ctrl = state.ctrl;
+    mask = state.mask;
+    status = state.status;
+    oamAddr = state.oamAddr;
+    latch = state.latch;
+    readBuffer = state.readBuffer;
+    x = state.x;
+    v = state.v;
+    t = state.t;
+    memcpy(oam, state.oam, sizeof(oam));
+    memcpy(vram, state.vram, sizeof(vram));
+    memcpy(palette, state.palette, sizeof(palette));
+    memcpy(chrRam, state.chrRam, sizeof(chrRam));
+    invalidateCaches(); // also rebuilds the sprite lists
+}
+
+void PPU::setRenderOutput(bool enabled) {
+    if (enabled && !output) {
+        output.reset(new Output());
+        memset(bgTiles, 0, sizeof(bgTiles)); // nothing decoded into the new cache yet
+    }
+    renderOutput = enabled;
+}
+
+const uint8_t* PPU::getPixels() const {
+    static const uint8_t kBlank[kWidth * kHeight] = {};
+    return output ? output->pixels : kBlank;
+}
+
+void PPU::invalidateCaches() {
+    memset(bgTiles, 0, sizeof(bgTiles));
+    for (uint32_t& version : chrVersion) {
+        version = 1;
+    }
+    spriteListsDirty = true;
+}
+
+/************************************************************************************
+
+Registers ($2000-$2007, mirrored every 8 bytes up to $3FFF):
+
+$2000  PPUCTRL    VPHB SINN   NMI enable, master/slave, sprite height, bg pattern table,
+                              sprite pattern table, VRAM increment, base nametable
+$2001  PPUMASK    BGRs bMmG   emphasis, show sprites/bg, show sprites/bg in left 8, grayscale
+$2002  PPUSTATUS  VSO- ----   vblank, sprite 0 hit, sprite overflow (read clears V and w)
+$2003  OAMADDR
+$2004  OAMDATA
+$2005  PPUSCROLL  x then y (two writes)
+$2006  PPUADDR    high then low byte (two writes)
+$2007  PPUDATA
+
+*************************************************************************************/
+
+uint8_t PPU::read(uint16_t addr) {
+    switch (addr & 0x7) {
+    case 2: {
+        uint8_t result = (status & 0xE0) | (latch & 0x1F);
+        status &= 0x7F;
+        w = false;
+        return result;
+    }
+    case 4: return oam[oamAddr];
+    case 7: {
+        uint8_t result;
+        if ((v & 0x3FFF) >= 0x3F00) {
+            // palette reads aren't buffered, but still refill the buffer with the
+            // nametable byte "underneath" the palette
+            result = readVRAM(v);
+            readBuffer = readVRAM(v - 0x1000);
+        } else {
+            result = readBuffer;
+            readBuffer = readVRAM(v);
+        }
+        v = (v + ((ctrl & 0x04) ? 32 : 1)) & 0x7FFF;
+        return result;
+    }
+    default: return latch;
+    }
+}
+
+void PPU::write(uint16_t addr, uint8_t value) {
+    latch = value;
+    switch (addr & 0x7) {
+    case 0: {
+        // enabling NMI while already in vblank raises one immediately
+        if (!(ctrl & 0x80) && (value & 0x80) && (status & 0x80)) {
+            nmiPending = true;
+        }
+        ctrl = value;
+        t = (t & 0xF3FF) | ((value & 0x03) << 10);
+        break;
+    }
+    case 1: { mask = value;    break; }
+    case 3: { oamAddr = value; break; }
+    case 4: {
+        if (stateHash != nullptr) {
+            stateHash->markDirty(oamBlock);
+        }
+        oam[oamAddr++] = value;
+        oamChanged();
+        break;
+    }
+    case 5: {
+        if (!w) {
+            t = (t & 0xFFE0) | (value >> 3);
+            x = value & 0x07;
+        } else {
+            t = (t & 0x8C1F) | ((value & 0x07) << 12) | ((value & 0xF8) << 2);
+        }
+        w = !w;
+        break;
+    }
+    case 6: {
+        if (!w) {
+            t = (t & 0x00FF) | ((value & 0x3F) << 8);
+        } else {
+            t = (t & 0xFF00) | value;
+            v = t;
+        }
+        w = !w;
+        break;
+    }
+    case 7: {
+        writeVRAM(v, value);
+        v = (v + ((ctrl & 0x04) ? 32 : 1)) & 0x7FFF;
+        break;
+    }
+    default: break;
+    }
+}
+
+void PPU::writeOAM(const uint8_t* data) {
+    // OAMADDR ends up where it started, having wrapped all the way round
+    memcpy(oam + oamAddr, data, 256 - oamAddr);
+    memcpy(oam, data + (256 - oamAddr), oamAddr);
+    if (stateHash != nullptr) {
+        stateHash->markDirty(oamBlock);
+    }
+    oamChanged();
+}
+
+uint16_t PPU::nametableIndex(uint16_t addr) const {
+    uint16_t offset = (addr - 0x2000) & 0x0FFF;
+    uint16_t table = offset >> 10;
+    uint16_t physical = (mirroring == Mirroring::Vertical) ? (table & 1) : (table >> 1);
+    return (physical << 10) | (offset & 0x03FF);
+}
+
+uint8_t PPU::readVRAM(uint16_t addr) {
+    addr &= 0x3FFF;
+    if (addr < 0x2000) {
+        return chr[addr];
+    }
+    if (addr < 0x3F00) {
+        return vram[nametableIndex(addr)];
+    }
+    return palette[paletteIndex(addr)];
+}
+
+void PPU::writeVRAM(uint16_t addr, uint8_t value) {
+    addr &= 0x3FFF;
+    if (addr < 0x2000) {
+        if (chr != chrRam) {
+            return; // CHR-ROM
+        }
+        chrRam[addr] = value;
+        uint32_t& version = chrVersion[addr >> 4];
+        version = (version == 0xFFFFFFFF) ? 1 : version + 1; // 0 is reserved for "invalid"
+        if (stateHash != nullptr) {
+            stateHash->markDirty(chrBlock + (addr >> StateHash::kBlockShift));
+        }
+    } else if (addr < 0x3F00) {
+        uint16_t index = nametableIndex(addr);
+        vram[index] = value;
+        nametableChanged(index);
+        if (stateHash != nullptr) {
+            stateHash->markDirty(vramBlock + (index >> StateHash::kBlockShift));
+        }
+    } else {
+        palette[paletteIndex(addr)] = value & 0x3F;
+    }
+}
+
+// scroll helpers, see https://www.nesdev.org/wiki/PPU_scrolling#Wrapping_around
+
+void PPU::incrementX(uint16_t& addr) const {
+    if ((addr & 0x001F) == 31) {
+        addr &= ~0x001F;
+        addr ^= 0x0400; // switch horizontal nametable
+    } else {
+        addr++;
+    }
+}
+
+void PPU::incrementY() {
+    if ((v & 0x7000) != 0x7000) {
+        v += 0x1000;
+        return;
+    }
+    v &= ~0x7000;
+    int coarseY = (v & 0x03E0) >> 5;
+    if (coarseY == 29) {
+        coarseY = 0;
+        v ^= 0x0800; // switch vertical nametable
+    } else if (coarseY == 31) {
+        coarseY = 0;
+    } else {
+        coarseY++;
+    }
+    v = (v & ~0x03E0) | (coarseY << 5);
+}
+
+void PPU::copyX() {
+    v = (v & ~0x041F) | (t & 0x041F);
+}
+
+void PPU::copyY() {
+    v = (v & ~0x7BE0) | (t & 0x7BE0);
+}
+
+bool PPU::runScanline() {
+    bool raisedNmi = nmiPending;
+    nmiPending = false;
+
+    if (scanline < kHeight) {
+        if (renderingEnabled()) {
+            if (renderOutput) {
+                renderScanline();
+            } else {
+                evaluateSprites();
+            }
+            incrementY();
+            copyX();
+        } else if (renderOutput) {
+            // rendering disabled: the screen shows the backdrop color
+            memset(output->pixels + scanline * kWidth, palette[0] & ((mask & 0x01) ? 0x30 : 0x3F), kWidth);
+            emphasis[scanline] = mask >> 5;
+        }
+    } else if (scanline == kVblankScanline) {
+        status |= 0x80;
+        raisedNmi = raisedNmi || (ctrl & 0x80) != 0;
+    } else if (scanline == lastScanline) {
+        status &= 0x1F; // clear vblank, sprite 0 hit, sprite overflow
+        if (renderingEnabled()) {
+            incrementY();
+            copyX();
+            copyY();
+        }
+    }
+
+    scanline = (scanline == lastScanline) ? 0 : scanline + 1;
+    return raisedNmi;
+}
+
+uint16_t PPU::spritePatternRow(int sprite) const {
+    const uint8_t* entry = oam + sprite * 4;
+    int height = spriteHeight();
+    int row = scanline - (entry[0] + 1);
+    if (entry[2] & 0x80) {
+        row = height - 1 - row; // vertical flip
+    }
+
+    uint16_t tile = entry[1];
+    uint16_t base;
+    if (height == 16) {
+        // 8x16 sprites pick their pattern table with bit 0 of the tile index
+        base = (tile & 1) ? 0x1000 : 0x0000;
+        tile &= 0xFE;
+        if (row >= 8) {
+            tile++;
+            row -= 8;
+        }
+    } else {
+        base = (ctrl & 0x08) ? 0x1000 : 0x0000;
+    }
+    return base + tile * 16 + row;
+}
+
+uint8_t PPU::spritePixel(int sprite, int px) const {
+    const uint8_t* entry = oam + sprite * 4;
+    int row = scanline - (entry[0] + 1);
+    int col = px - entry[3];
+    if (row < 0 || row >= spriteHeight() || col < 0 || col >= 8) {
+        return 0;
+    }
+    uint16_t addr = spritePatternRow(sprite);
+    int bit = (entry[2] & 0x40) ? col : 7 - col; // horizontal flip
+    return ((chr[addr] >> bit) & 1) | (((chr[addr + 8] >> bit) & 1) << 1);
+}
+
+uint8_t PPU::backgroundPixel(int px) const {
+    int pos = px + x;
+    uint16_t addr = v;
+    int coarseX = (addr & 0x001F) + pos / 8;
+    if (coarseX >= 32) {
+        coarseX -= 32;
+        addr ^= 0x0400;
+    }
+    addr = (addr & ~0x001F) | coarseX;
+
+    uint8_t tile = vram[nametableIndex(0x2000 | (addr & 0x0FFF))];
+    uint16_t pattern = ((ctrl & 0x10) ? 0x1000 : 0x0000) + tile * 16 + ((v >> 12) & 0x7);
+    int bit = 7 - (pos & 7);
+    return ((chr[pattern] >> bit) & 1) | (((chr[pattern + 8] >> bit) & 1) << 1);
+}
+
+void PPU::buildSpriteLists() {
+    int height = spriteHeight();
+    if (!spriteListsDirty && spriteListHeight == height) {
+        return;
+    }
+
+    memset(lineCount, 0, sizeof(lineCount));
+    memset(lineOverflow, 0, sizeof(lineOverflow));
+    for (int i = 0; i < 64; i++) {
+        int top = oam[i * 4] + 1; // sprites are drawn one line below their Y
+        int bottom = top + height < kHeight ? top + height : kHeight;
+        for (int line = top; line < bottom; line++) {
+            if (lineCount[line] == 8) {
+                lineOverflow[line] = true;
+            } else {
+                lineSprites[line][lineCount[line]++] = uint8_t(i);
+            }
+        }
+    }
+    spriteListsDirty = false;
+    spriteListHeight = height;
+}
+
+void PPU::evaluateSprites() {
+    // headless: nothing is drawn, but the flags must match what renderScanline produces
+    buildSpriteLists();
+    if (lineOverflow[scanline]) {
+        status |= 0x20;
+    }
+
+    bool spriteZeroOnLine = lineCount[scanline] > 0 && lineSprites[scanline][0] == 0;
+    if (!spriteZeroOnLine || (status & 0x40) || (mask & 0x18) != 0x18) {
+        return;
+    }
+    for (int col = 0; col < 8; col++) {
+        int px = oam[3] + col;
+        if (px >= 255) {
+            break; // hit never triggers at x=255
+        }
+        if (px < 8 && (mask & 0x06) != 0x06) {
+            continue; // left column clipped for sprites or background
+        }
+        if (spritePixel(0, px) != 0 && backgroundPixel(px) != 0) {
+            status |= 0x40;
+            break;
+        }
+    }
+}
+
+// background tile cache
+
+void PPU::nametableChanged(uint16_t index) {
+    int table = index >> 10;
+    int offset = index & 0x03FF;
+    if (offset < 0x03C0) {
+        bgTiles[table][offset >> 5][offset & 31].version = 0;
+        return;
+    }
+    // an attribute byte covers a 4x4 block of tiles
+    int row = ((offset - 0x03C0) >> 3) * 4;
+    int col = ((offset - 0x03C0) & 7) * 4;
+    for (int r = row; r < row + 4 && r < 30; r++) {
+        for (int c = col; c < col + 4; c++) {
+            bgTiles[table][r][c].version = 0;
+        }
+    }
+}
+
+void PPU::decodeTile(int table, int row, int col) {
+    const uint8_t* nametable = vram + (table << 10);
+    uint16_t pattern = ((ctrl & 0x10) ? 256 : 0) + nametable[row * 32 + col];
+    uint8_t attribute = nametable[0x03C0 + (row >> 2) * 8 + (col >> 2)];
+    uint8_t pal = uint8_t(((attribute >> (((row & 2) << 1) | (col & 2))) & 0x03) << 2);
+
+    for (int fineY = 0; fineY < 8; fineY++) {
+        uint8_t lo = chr[pattern * 16 + fineY];
+        uint8_t hi = chr[pattern * 16 + fineY + 8];
+        uint8_t* out = &output->bgCache[table][row * 8 + fineY][col * 8];
+        for (int bit = 0; bit < 8; bit++) {
+            uint8_t value = ((lo >> (7 - bit)) & 1) | (((hi >> (7 - bit)) & 1) << 1);
+            out[bit] = value ? uint8_t(pal | value) : 0;
+        }
+    }
+    bgTiles[table][row][col].pattern = pattern;
+    bgTiles[table][row][col].version = chrVersion[pattern];
+}
+
+void PPU::backgroundLine(uint8_t* line) {
+    int coarseY = (v >> 5) & 31;
+    if (coarseY >= 30) {
+        // scrolled into the attribute table: rare enough to decode directly
+        decodeBackgroundLine(line);
+        return;
+    }
+
+    int fineY = (v >> 12) & 0x7;
+    int coarseX = v & 31;
+    uint16_t patternBase = (ctrl & 0x10) ? 256 : 0;
+    uint8_t row[33 * 8];
+    for (int tile = 0; tile < 33; tile++) {
+        int cx = coarseX + tile;
+        int logical = ((v >> 10) & 0x3) ^ (cx >= 32 ? 1 : 0);
+        int table = nametableIndex(uint16_t(0x2000 | (logical << 10))) >> 10;
+        int col = cx & 31;
+
+        const CachedTile& cached = bgTiles[table][coarseY][col];
+        if (cached.version == 0 || (cached.pattern & 256) != patternBase ||
+            chrVersion[cached.pattern] != cached.version) {
+            decodeTile(table, coarseY, col);
+        }
+        memcpy(row + tile * 8, &output->bgCache[table][coarseY * 8 + fineY][col * 8], 8);
+    }
+    memcpy(line, row + x, kWidth);
+}
+
+void PPU::decodeBackgroundLine(uint8_t* line) {
+    uint16_t addr = v;
+    uint16_t fineY = (v >> 12) & 0x7;
+    uint16_t base = (ctrl & 0x10) ? 0x1000 : 0x0000;
+    for (int tile = 0; tile < 33; tile++) {
+        uint8_t index = vram[nametableIndex(0x2000 | (addr & 0x0FFF))];
+        uint8_t attribute = vram[nametableIndex(
+            0x23C0 | (addr & 0x0C00) | ((addr >> 4) & 0x38) | ((addr >> 2) & 0x07))];
+        int shift = ((addr >> 4) & 0x04) | (addr & 0x02);
+        uint8_t pal = (attribute >> shift) & 0x03;
+
+        uint8_t lo = chr[base + index * 16 + fineY];
+        uint8_t hi = chr[base + index * 16 + fineY + 8];
+        for (int bit = 0; bit < 8; bit++) {
+            int px = tile * 8 + bit - x;
+            if (px < 0 || px >= kWidth) {
+                continue;
+            }
+            uint8_t value = ((lo >> (7 - bit)) & 1) | (((hi >> (7 - bit)) & 1) << 1);
+            line[px] = value ? uint8_t((pal << 2) | value) : 0;
+        }
+        incrementX(addr);
+    }
+}
+
+void PPU::renderScanline() {
+    // per-pixel palette-relative values: (palette << 2) | pixel, where pixel 0 is transparent
+    uint8_t bgLine[kWidth];
+    uint8_t spriteLine[kWidth];
+    memset(bgLine, 0, sizeof(bgLine));
+    memset(spriteLine, 0, sizeof(spriteLine));
+
+    if (mask & 0x08) {
+        backgroundLine(bgLine);
+        if (!(mask & 0x02)) {
+            memset(bgLine, 0, 8);
+        }
+    }
+
+    // sprites: masks are 0xFF/0x00 per pixel so they can be combined 16 at a time
+    uint8_t spriteBehind[kWidth];
+    uint8_t spriteZero[kWidth];
+    memset(spriteBehind, 0, sizeof(spriteBehind));
+    memset(spriteZero, 0, sizeof(spriteZero));
+
+    buildSpriteLists();
+    if (lineOverflow[scanline]) {
+        status |= 0x20;
+    }
+    if (mask & 0x10) {
+        for (int k = 0; k < lineCount[scanline]; k++) {
+            int i = lineSprites[scanline][k];
+            const uint8_t* entry = oam + i * 4;
+            uint16_t addr = spritePatternRow(i);
+            uint8_t lo = chr[addr];
+            uint8_t hi = chr[addr + 8];
+            for (int col = 0; col < 8; col++) {
+                int px = entry[3] + col;
+                if (px >= kWidth) {
+                    break;
+                }
+                if (px < 8 && !(mask & 0x04)) {
+                    continue;
+                }
+                int bit = (entry[2] & 0x40) ? col : 7 - col;
+                uint8_t value = ((lo >> bit) & 1) | (((hi >> bit) & 1) << 1);
+                // lower OAM index wins, even when it's behind the background
+                if (value == 0 || spriteLine[px] != 0) {
+                    continue;
+                }
+                spriteLine[px] = uint8_t(0x10 | ((entry[2] & 0x03) << 2) | value);
+                spriteBehind[px] = (entry[2] & 0x20) ? 0xFF : 0x00;
+                spriteZero[px] = (i == 0) ? 0xFF : 0x00;
+            }
+        }
+    }
+    spriteZero[kWidth - 1] = 0; // hit never triggers at x=255
+
+    // priority: an opaque sprite pixel shows unless it's behind an opaque bg pixel;
+    // sprite 0 hit wherever sprite 0 and the background are both opaque
+    uint8_t line[kWidth];
+    bool hit = false;
+    int px = 0;
+#ifdef NES_PPU_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    __m128i hits = zero;
+    for (; px < kWidth; px += 16) {
+        __m128i bg = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bgLine + px));
+        __m128i sprite = _mm_loadu_si128(reinterpret_cast<const __m128i*>(spriteLine + px));
+        __m128i behind = _mm_loadu_si128(reinterpret_cast<const __m128i*>(spriteBehind + px));
+        __m128i zeroHit = _mm_loadu_si128(reinterpret_cast<const __m128i*>(spriteZero + px));
+
+        __m128i bgClear = _mm_cmpeq_epi8(bg, zero);
+        __m128i spriteClear = _mm_cmpeq_epi8(sprite, zero);
+        // use = sprite opaque && (bg clear || !behind)
+        __m128i use = _mm_andnot_si128(spriteClear, _mm_or_si128(bgClear, _mm_andnot_si128(behind, _mm_set1_epi8(-1))));
+        __m128i index = _mm_or_si128(_mm_and_si128(use, sprite), _mm_andnot_si128(use, bg));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(line + px), index);
+
+        hits = _mm_or_si128(hits, _mm_andnot_si128(_mm_or_si128(bgClear, spriteClear), zeroHit));
+    }
+    hit = _mm_movemask_epi8(hits) != 0;
+#endif
+    for (; px < kWidth; px++) {
+        uint8_t bg = bgLine[px];
+        uint8_t sprite = spriteLine[px];
+        hit = hit || (sprite && bg && spriteZero[px]);
+        line[px] = (sprite && (!bg || !spriteBehind[px])) ? sprite : bg;
+    }
+    if (hit) {
+        status |= 0x40;
+    }
+
+    // palette RAM lookup; turning indices into colors is left to whoever needs RGB
+    uint8_t gray = (mask & 0x01) ? 0x30 : 0x3F;
+    uint8_t colors[32];
+    for (int i = 0; i < 32; i++) {
+        colors[i] = palette[i] & gray;
+    }
+    uint8_t* out = output->pixels + scanline * kWidth;
+    for (px = 0; px < kWidth; px++) {
+        out[px] = colors[line[px]];
+    }
+    emphasis[scanline] = mask >> 5;
+}
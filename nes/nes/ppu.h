@@ -0,0 +1,188 @@
+/************************************************************************************
+
+Filename    :   ppu.h
+Content     :   Picture processing unit (header)
+Authors     :   Yash Patel
+
+2C02 PPU emulated a scanline at a time. Registers are mapped at $2000-$2007 (mirrored
+up to $3FFF) and the PPU has its own 14-bit address space:
+
+    $0000-$1FFF   pattern tables (CHR; 8K of CHR-RAM until cartridges exist)
+    $2000-$2FFF   4 nametables backed by 2K of VRAM, mirrored per the cartridge
+    $3F00-$3F1F   palette RAM
+
+Output is a 6-bit master palette index per pixel (61 KB a frame) plus the 3 color
+emphasis bits of each line; conversion to RGB is a separate step (see video.h) that
+only consumers who want colors pay for.
+
+Pixel output can be switched off (headless): the scanline still advances scrolling
+and still produces every flag the CPU can observe (vblank, sprite 0 hit, sprite
+overflow), it just doesn't draw anything. Output starts off, and the frame and tile
+cache (180 KB) are only allocated the first time it's switched on, so a console that
+never renders stays small.
+
+The background is drawn from a cache of decoded nametable tiles (pixel values with
+their attribute palette applied, before the palette lookup), one 256x240 plane per
+physical nametable. A tile is decoded again only when its inputs change: its
+nametable or attribute byte, the CHR tile it points at, or the background pattern
+table. Scrolling and palette changes never invalidate it, so a static or scrolling
+background costs a copy per line rather than a decode.
+
+Sprite evaluation doesn't scan OAM every line. OAM is bucketed into per-scanline
+lists of (up to 8) sprites plus an overflow flag, rebuilt only when OAM or the sprite
+height changes, so each line starts from the handful of sprites actually on it.
+
+*************************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+
+#include "bus.h"
+#include "pacer.h"
+#include "statehash.h"
+
+enum class Mirroring {
+	Horizontal,
+	Vertical
+};
+
+class PPU : public Device {
+public:
+	static const int kWidth  = 256;
+	static const int kHeight = 240;
+
+	PPU(Region region);
+	~PPU() = default;
+
+	uint8_t read(uint16_t addr) override;
+	void write(uint16_t addr, uint8_t value) override;
+
+	void reset();
+	// runs the current scanline; returns true if it raised NMI
+	bool runScanline();
+	int getScanline() const { return scanline; }
+	int scanlinesPerFrame() const { return lastScanline + 1; }
+
+	void setRenderOutput(bool enabled); // allocates the frame on first use
+	bool getRenderOutput() const { return renderOutput; }
+	void setMirroring(Mirroring mode) { mirroring = mode; }
+
+	// registers CHR/VRAM/OAM with the hash so PPU writes mark their blocks dirty
+	void trackState(StateHash* hash);
+	uint64_t hashRegisters() const; // registers, scroll and palette (too small to track)
+
+	const uint8_t* getPixels() const; // palette indices, kWidth x kHeight (all 0 before any output)
+	const uint8_t* getEmphasis() const { return emphasis; } // per line: PPUMASK bits 5-7 (BGR)
+	const uint8_t* getCHR() const { return chr; } // pattern tables as rendered: ROM or RAM
+	uint8_t* getCHRRAM() { return chrRam; } // after writing it directly, call invalidateCaches()
+	// 8K of cartridge CHR-ROM, used in place rather than copied (so one ROM can sit behind
+	// any number of PPUs; it must outlive them), read-only through $2007 and kept across
+	// reset(). nullptr goes back to CHR-RAM.
+	void loadCHR(const uint8_t* rom);
+	void invalidateCaches();
+
+	// OAM DMA ($4014): 256 bytes as if written to $2004, i.e. starting at OAMADDR
+	void writeOAM(const uint8_t* data);
+
+	// everything that decides what the PPU does next, for snapshots between frames;
+	// caches are rebuilt and the last frame's pixels aren't part of it
+	struct State {
+		int scanline;
+		bool nmiPending;
+		bool w;
+		uint8_t ctrl, mask, status, oamAddr, latch, readBuffer, x;
+		uint16_t v, t;
+		uint8_t oam[256];
+		uint8_t vram[2048];
+		uint8_t palette[32];
+		uint8_t chrRam[8192];
+	};
+	void saveState(State& state) const;
+	void loadState(const State& state);
+
+private:
+	static const int kVblankScanline = 241;
+
+	bool renderingEnabled() const { return (mask & 0x18) != 0; }
+	int spriteHeight() const { return (ctrl & 0x20) ? 16 : 8; }
+
+	uint8_t readVRAM(uint16_t addr);
+	void writeVRAM(uint16_t addr, uint8_t value);
+	uint16_t nametableIndex(uint16_t addr) const;
+
+	void renderScanline();       // background + sprites into pixels
+	void evaluateSprites();      // sprite overflow + sprite 0 hit only (headless)
+	void backgroundLine(uint8_t* line);       // from the tile cache
+	void decodeBackgroundLine(uint8_t* line); // straight from VRAM (fallback)
+	void decodeTile(int table, int row, int col);
+	void nametableChanged(uint16_t index);    // invalidates the tile(s) it feeds
+
+	void oamChanged() { spriteListsDirty = true; }
+	void buildSpriteLists();     // rebuckets OAM if it changed since the last build
+	uint8_t backgroundPixel(int x) const;           // 2-bit pixel value at x on this line
+	uint8_t spritePixel(int sprite, int x) const;   // 2-bit pixel value, 0 if not covering x
+	uint16_t spritePatternRow(int sprite) const;    // pattern address of this line's row
+
+	void incrementX(uint16_t& addr) const;
+	void incrementY();
+	void copyX();
+	void copyY();
+
+	int scanline;
+	int lastScanline; // pre-render line: 261 NTSC, 311 PAL
+	bool renderOutput;
+	bool nmiPending; // NMI enabled mid-vblank, raised at the next runScanline()
+	Mirroring mirroring;
+
+	uint8_t ctrl;    // $2000
+	uint8_t mask;    // $2001
+	uint8_t status;  // $2002
+	uint8_t oamAddr; // $2003
+	uint8_t latch;   // last value written to a register (PPU open bus)
+	uint8_t readBuffer; // delayed $2007 reads
+
+	// loopy scroll registers (https://www.nesdev.org/wiki/PPU_scrolling)
+	uint16_t v; // current VRAM address
+	uint16_t t; // temporary VRAM address
+	uint8_t x;  // fine x scroll
+	bool w;     // first/second write toggle
+
+	uint8_t oam[256];
+
+	// per-scanline sprite buckets, in OAM order (see top of file)
+	uint8_t lineSprites[kHeight][8];
+	uint8_t lineCount[kHeight];
+	bool lineOverflow[kHeight];
+	bool spriteListsDirty;
+	int spriteListHeight; // sprite height the buckets were built for
+	uint8_t vram[2048];
+	uint8_t palette[32];
+	uint8_t chrRam[8192];
+	const uint8_t* chr; // chrRam, or the cartridge's CHR-ROM
+
+	uint8_t emphasis[kHeight];
+
+	// background tile cache (see top of file)
+	struct CachedTile {
+		uint16_t pattern; // CHR tile (0-511) it was decoded from
+		uint32_t version; // chrVersion of that tile at the time; 0 = needs decoding
+	};
+	CachedTile bgTiles[2][30][32];
+	uint32_t chrVersion[512]; // bumped on every write to the CHR tile
+
+	// only needed while output is on, so allocated then (see top of file)
+	struct Output {
+		uint8_t pixels[kWidth * kHeight];
+		uint8_t bgCache[2][kHeight][kWidth];
+	};
+	std::unique_ptr<Output> output;
+
+	StateHash* stateHash; // nullptr when untracked
+	uint32_t chrBlock;
+	uint32_t vramBlock;
+	uint32_t oamBlock;
+};
@@ -0,0 +1,192 @@
+/************************************************************************************
+
+Filename    :   recompiler.cpp
+Content     :   Ahead-of-time recompiler from a program image to C++
+Authors     :   Yash Patel
+
+*************************************************************************************/
+
+#include "recompiler.h"
+
+#include <stdio.h>
+
+#include "codemap.h"
+#include "disasm.h"
+
+Recompiler::Recompiler(const CodeMap& map) :
+    map(map) {
+    findBlocks();
+}
+
+void Recompiler::findBlocks() {
+    const std::vector<uint8_t>& image = map.getImage();
+    uint32_t base = map.getBase();
+    uint32_t end = base + uint32_t(image.size());
+    auto byteAt = [&](uint32_t addr) { return addr < end ? image[addr - base] : uint8_t(0); };
+
+    // execution can (re)enter at routines, labels, and after branches and calls
+    std::vector<bool> starts(image.size(), false);
+    for (uint32_t addr = base; addr < end; addr++) {
+        uint8_t flags = map.flagsAt(uint16_t(addr));
+        if (!(flags & CodeMap::kOpcode)) {
+            continue;
+        }
+        if (flags & (CodeMap::kRoutine | CodeMap::kLabel)) {
+            starts[addr - base] = true;
+        }
+        const OpcodeInfo& info = opcodeInfo(byteAt(addr));
+        uint32_t next = addr + info.length();
+        if ((info.flow & (OpcodeInfo::kBranch | OpcodeInfo::kCall)) && next < end) {
+            starts[next - base] = true;
+        }
+    }
+
+    // walk each start in address order; anything a walk already covered is only a
+    // block of its own if something jumps there
+    std::vector<bool> covered(image.size(), false);
+    for (uint32_t addr = base; addr < end; addr++) {
+        if (!(map.flagsAt(uint16_t(addr)) & CodeMap::kOpcode) || (covered[addr - base] && !starts[addr - base])) {
+            continue;
+        }
+
+        Block block;
+        block.start = uint16_t(addr);
+        block.next = -1;
+        uint32_t pc = addr;
+        while (true) {
+            const OpcodeInfo& info = opcodeInfo(byteAt(pc));
+            block.instructions.push_back(uint16_t(pc));
+            covered[pc - base] = true;
+            pc += info.length();
+            if (info.flow != 0 || pc >= end || !(map.flagsAt(uint16_t(pc)) & CodeMap::kOpcode)) {
+                break; // control flow, or the analysis didn't follow the path any further
+            }
+            if (starts[pc - base] || block.instructions.size() == size_t(kMaxBlockInstructions)) {
+                block.next = int32_t(pc); // falls into the next block
+                starts[pc - base] = true;
+                break;
+            }
+        }
+        blocks.push_back(block);
+    }
+}
+
+bool Recompiler::emit(const std::string& path) const {
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        return false;
+    }
+
+    const std::vector<uint8_t>& image = map.getImage();
+    uint32_t base = map.getBase();
+    uint32_t end = base + uint32_t(image.size());
+    auto byteAt = [&](uint32_t addr) { return addr < end ? image[addr - base] : uint8_t(0); };
+    std::vector<bool> isBlock(0x10000, false);
+    for (const Block& block : blocks) {
+        isBlock[block.start] = true;
+    }
+
+    fprintf(file,
+        "// Generated by the nes recompiler from image %016llX ($%04X, %u bytes); don't edit.\n"
+        "// Build it into a shared library with the emulator's headers on the include path:\n"
+        "//     cl /LD /O2 /I<nes> <this file>\n"
+        "//     g++ -O2 -shared -fPIC -I<nes> <this file> -o <name>.so\n\n"
+        "#include \"aotabi.h\"\n"
+        "#include \"aotops.h\"\n\n"
+        "namespace {\n\n",
+        (unsigned long long)map.getImageHash(), unsigned(base), unsigned(image.size()));
+
+    // hashes of the pages the image fills completely, for AotRuntime::trusted
+    fprintf(file, "const uint64_t kPageHashes[256] = {");
+    for (uint32_t page = 0; page < 256; page++) {
+        uint64_t hash = 0;
+        if (page * 256 >= base && page * 256 + 256 <= end) {
+            hash = CodeMap::hashImage(&image[page * 256 - base], 256);
+        }
+        fprintf(file, "%s0x%016llXull,", page % 4 ? " " : "\n    ", (unsigned long long)hash);
+    }
+    fprintf(file, "\n};\n\n");
+
+    fprintf(file, "const uint16_t kStarts[] = {");
+    for (size_t i = 0; i < blocks.size(); i++) {
+        fprintf(file, "%s0x%04X,", i % 8 ? " " : "\n    ", blocks[i].start);
+    }
+    fprintf(file, "\n};\n\n");
+
+    // the bytes each block was compiled from, for aotMatches()
+    for (const Block& block : blocks) {
+        uint16_t last = block.instructions.back();
+        uint32_t size = last + opcodeInfo(byteAt(last)).length() - block.start;
+        fprintf(file, "const uint8_t kBytes%04X[] = {", block.start);
+        for (uint32_t i = 0; i < size; i++) {
+            fprintf(file, "%s0x%02X", i ? ", " : " ", byteAt(block.start + i));
+        }
+        fprintf(file, " };\n");
+    }
+
+    fprintf(file, "\nvoid run(const AotRuntime* runtime) {\n    AotState& s = *runtime->state;\n"
+        "    for (;;) {\n        switch (s.pc) {\n");
+    for (const Block& block : blocks) {
+        fprintf(file, "        case 0x%04X: goto b%04X;\n", block.start, block.start);
+    }
+    fprintf(file, "        default: return; // not compiled: the interpreter takes it\n        }\n");
+
+    for (const Block& block : blocks) {
+        uint16_t last = block.instructions.back();
+        fprintf(file, "\n    b%04X:\n", block.start);
+        fprintf(file, "        if (!aotMatches(runtime, 0x%04X, kBytes%04X, int(sizeof(kBytes%04X)))) { return; }\n",
+            block.start, block.start, block.start);
+        for (uint16_t addr : block.instructions) {
+            uint8_t bytes[3] = { byteAt(addr), 0, 0 };
+            const OpcodeInfo& info = opcodeInfo(bytes[0]);
+            for (int i = 1; i < info.length(); i++) {
+                bytes[i] = byteAt(uint32_t(addr) + i);
+            }
+            if (!info.valid()) {
+                fprintf(file, "        s.pc = 0x%04X; return; // %04X  %s (the interpreter runs it)\n",
+                    addr, addr, disassemble(addr, bytes).c_str());
+                continue;
+            }
+            fprintf(file, "        if (aotStep(runtime, 0x%04X, 0x%02X, 0x%04X)) { return; } // %04X  %s\n",
+                addr, bytes[0], unsigned(bytes[1] | (bytes[2] << 8)), addr, disassemble(addr, bytes).c_str());
+        }
+
+        // chain straight to the blocks control flow can statically reach
+        const OpcodeInfo& info = opcodeInfo(byteAt(last));
+        uint16_t next = uint16_t(last + info.length());
+        if (block.next >= 0) {
+            fprintf(file, "        goto b%04X;\n", unsigned(block.next));
+            continue;
+        }
+        if ((info.flow & (OpcodeInfo::kJump | OpcodeInfo::kCall)) && info.mode == OpcodeInfo::Mode::Absolute) {
+            uint16_t target = uint16_t(byteAt(uint32_t(last) + 1) | (byteAt(uint32_t(last) + 2) << 8));
+            if (isBlock[target]) {
+                fprintf(file, "        goto b%04X;\n", target);
+                continue;
+            }
+        }
+        if (info.flow & OpcodeInfo::kBranch) {
+            uint16_t target = branchTarget(last, byteAt(uint32_t(last) + 1));
+            if (isBlock[target]) {
+                fprintf(file, "        if (s.pc == 0x%04X) { goto b%04X; }\n", target, target);
+            }
+            if (isBlock[next]) {
+                fprintf(file, "        if (s.pc == 0x%04X) { goto b%04X; }\n", next, next);
+            }
+        }
+        fprintf(file, "        continue;\n");
+    }
+    fprintf(file, "    }\n}\n\n");
+
+    fprintf(file,
+        "const AotModule kModule = { NES_AOT_VERSION, 0x%016llXull, 0x%04X, %u, %u, kStarts, kPageHashes, &run };\n\n"
+        "} // namespace\n\n"
+        "NES_AOT_EXPORT const AotModule* nesAotModule() {\n"
+        "    return &kModule;\n"
+        "}\n",
+        (unsigned long long)map.getImageHash(), unsigned(base), unsigned(image.size()), unsigned(blocks.size()));
+
+    bool ok = ferror(file) == 0;
+    fclose(file);
+    return ok;
+}
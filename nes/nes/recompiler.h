@@ -0,0 +1,54 @@
+/************************************************************************************
+
+Filename    :   recompiler.h
+Content     :   Ahead-of-time recompiler from a program image to C++ (header)
+Authors     :   Yash Patel
+
+Turns the code a CodeMap found into a C++ translation unit implementing the module
+interface in aotabi.h. Blocks start at routines, branch/jump targets, and after
+every branch or JSR (where execution resumes); a block runs until a control-flow
+instruction, or falls straight into the next block with a goto. Each instruction
+becomes an aotStep() (aotops.h) with its opcode and operand as constants, which the
+compiler inlines down to that one instruction's work. Branches and jumps with a
+known target go straight to its block; after anything else (returns, indirect
+jumps) the generated code dispatches on PC with a switch over the block starts,
+which the compiler turns into a jump table.
+
+The output is built into a shared library outside of this project (the command
+lines are in the generated file's header) and loaded with AotCode (aotcode.h).
+
+*************************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+class CodeMap;
+
+class Recompiler {
+public:
+	static const int kMaxBlockInstructions = 64; // bounds what aotMatches() compares per entry
+
+	explicit Recompiler(const CodeMap& map);
+	~Recompiler() = default;
+
+	bool emit(const std::string& path) const; // false if it couldn't be written
+
+	size_t blockCount() const { return blocks.size(); }
+
+private:
+	struct Block {
+		uint16_t start;
+		std::vector<uint16_t> instructions;
+		int32_t next; // block it falls into, -1 to dispatch on PC instead
+	};
+
+	void findBlocks();
+
+	const CodeMap& map;
+	std::vector<Block> blocks;
+};
@@ -0,0 +1,197 @@
+/************************************************************************************
+
+Filename    :   rom.cpp
+Content     :   iNES / NES 2.0 ROM files
+Authors     :   Yash Patel
+
+*************************************************************************************/
+
+#include "rom.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <iostream>
+
+#include "console.h"
+#include "romdb.h"
+
+namespace {
+
+bool readFile(const std::string& path, std::vector<uint8_t>& data) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    data.resize(size > 0 ? size_t(size) : 0);
+    bool ok = size >= 0 && fread(data.data(), 1, data.size(), file) == data.size();
+    fclose(file);
+    return ok;
+}
+
+// NES 2.0 sizes: a plain count of units, or 2^E * (2M + 1) bytes when the MSB nibble is $F
+uint32_t nes2Size(uint8_t lsb, uint8_t msb, uint32_t unit) {
+    if (msb == 0x0F) {
+        uint32_t exponent = lsb >> 2;
+        return exponent < 32 ? (1u << exponent) * ((lsb & 3) * 2 + 1) : 0;
+    }
+    return ((uint32_t(msb) << 8) | lsb) * unit;
+}
+
+// header + checksums of the PRG+CHR data behind it
+bool hashData(const std::string& path, const std::vector<uint8_t>& file, RomInfo& header, RomId& id) {
+    if (file.size() < size_t(RomInfo::kHeaderSize) || !header.parse(file.data())) {
+        std::cout << path << " isn't an iNES ROM" << std::endl;
+        return false;
+    }
+    size_t offset = header.dataOffset();
+    size_t size = size_t(header.prgSize) + header.chrSize;
+    if (file.size() < offset + size) {
+        std::cout << path << " is truncated" << std::endl;
+        return false;
+    }
+    id.crc32 = crc32(file.data() + offset, size);
+    Sha1 sha1;
+    sha1.update(file.data() + offset, size);
+    id.sha1 = sha1.finish();
+    return true;
+}
+
+void correct(const RomDatabase* database, RomIdentity& identity) {
+    identity.info = identity.header;
+    identity.name.clear();
+    identity.known = false;
+    identity.corrected = false;
+    const RomDatabase::Entry* entry = database != nullptr ? database->find(identity.id) : nullptr;
+    if (entry != nullptr) {
+        identity.known = true;
+        identity.name = entry->name;
+        identity.corrected = RomDatabase::apply(*entry, identity.info);
+    }
+}
+
+} // namespace
+
+bool RomInfo::parse(const uint8_t* header) {
+    if (memcmp(header, "NES\x1A", 4) != 0) {
+        return false;
+    }
+    uint8_t flags6 = header[6];
+    uint8_t flags7 = header[7];
+    bool nes2 = (flags7 & 0x0C) == 0x08;
+
+    // iNES 1.0 leaves bytes 8-15 zero; tools that wrote their name there ("DiskDude!")
+    // also left junk in byte 7, so the high mapper nibble can't be trusted either
+    bool junk = !nes2 && (header[12] | header[13] | header[14] | header[15]) != 0;
+    if (junk) {
+        flags7 = 0;
+    }
+
+    mapper = (flags6 >> 4) | (flags7 & 0xF0);
+    mirroring = (flags6 & 0x01) ? Mirroring::Vertical : Mirroring::Horizontal;
+    battery = (flags6 & 0x02) != 0;
+    trainer = (flags6 & 0x04) != 0;
+    fourScreen = (flags6 & 0x08) != 0;
+    if (nes2) {
+        mapper |= (header[8] & 0x0F) << 8;
+        prgSize = nes2Size(header[4], header[9] & 0x0F, 16384);
+        chrSize = nes2Size(header[5], header[9] >> 4, 8192);
+        region = (header[12] & 0x03) == 1 ? Region::PAL : Region::NTSC; // multi-region/Dendy run as NTSC
+    } else {
+        prgSize = uint32_t(header[4]) * 16384;
+        chrSize = uint32_t(header[5]) * 8192;
+        region = (!junk && (header[9] & 0x01)) ? Region::PAL : Region::NTSC;
+    }
+    return true;
+}
+
+bool identifyRom(const std::string& path, const RomDatabase* database, RomCache* cache, RomIdentity& identity) {
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    if (!RomCache::stat(path, size, mtime)) {
+        std::cout << "couldn't open " << path << std::endl;
+        return false;
+    }
+
+    RomCache::Entry cached;
+    if (cache != nullptr && cache->lookup(path, size, mtime, cached) && identity.header.parse(cached.header)) {
+        identity.id = cached.id;
+    } else {
+        std::vector<uint8_t> file;
+        if (!readFile(path, file)) {
+            std::cout << "couldn't read " << path << std::endl;
+            return false;
+        }
+        if (!hashData(path, file, identity.header, identity.id)) {
+            return false;
+        }
+        if (cache != nullptr) {
+            cached.size = size;
+            cached.mtime = mtime;
+            cached.id = identity.id;
+            memcpy(cached.header, file.data(), sizeof(cached.header));
+            cache->store(path, cached);
+        }
+    }
+    correct(database, identity);
+    return true;
+}
+
+bool Rom::load(const std::string& path, const RomDatabase* database, RomCache* cache) {
+    std::vector<uint8_t> file;
+    if (!readFile(path, file)) {
+        std::cout << "couldn't read " << path << std::endl;
+        return false;
+    }
+
+    // the data has to be read anyway; the cache only saves hashing it
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    RomCache::Entry cached;
+    bool hit = cache != nullptr && RomCache::stat(path, size, mtime) && size == file.size() &&
+        cache->lookup(path, size, mtime, cached) && memcmp(cached.header, file.data(), sizeof(cached.header)) == 0 &&
+        identity.header.parse(file.data());
+    if (hit) {
+        identity.id = cached.id;
+        hit = file.size() >= identity.header.dataOffset() + identity.header.prgSize + identity.header.chrSize;
+    }
+    if (!hit) {
+        if (!hashData(path, file, identity.header, identity.id)) {
+            return false;
+        }
+        if (cache != nullptr && size == file.size()) {
+            cached.size = size;
+            cached.mtime = mtime;
+            cached.id = identity.id;
+            memcpy(cached.header, file.data(), sizeof(cached.header));
+            cache->store(path, cached);
+        }
+    }
+    correct(database, identity);
+
+    // corrections can't change where the data is, only what it means
+    const uint8_t* data = file.data() + identity.header.dataOffset();
+    prg.assign(data, data + identity.header.prgSize);
+    chr.assign(data + identity.header.prgSize, data + identity.header.prgSize + identity.header.chrSize);
+    return true;
+}
+
+bool Rom::install(Console& console) const {
+    const RomInfo& info = identity.info;
+    if (info.mapper != 0 || (prg.size() != 16384 && prg.size() != 32768) || (chr.size() != 0 && chr.size() != 8192)) {
+        std::cout << "mapper " << info.mapper << " (" << prg.size() / 1024 << "K PRG, " << chr.size() / 1024
+            << "K CHR) isn't supported yet" << std::endl;
+        return false;
+    }
+
+    // both ROMs are used in place: every console installed from this Rom shares them
+    console.mapPRG(prg.data(), uint32_t(prg.size()));
+    PPU& ppu = console.getPPU();
+    ppu.loadCHR(chr.empty() ? nullptr : chr.data()); // none: the board has CHR-RAM
+    ppu.setMirroring(info.mirroring); // four-screen VRAM isn't emulated
+    console.reset();
+    return true;
+}
@@ -0,0 +1,90 @@
+/************************************************************************************
+
+Filename    :   rom.h
+Content     :   iNES / NES 2.0 ROM files (header)
+Authors     :   Yash Patel
+
+A ROM file is a 16-byte header, an optional 512-byte trainer, then PRG and CHR data.
+Cartridges are identified by the CRC32 and SHA-1 of PRG+CHR (header and trainer left
+out, so re-headered dumps still match), and what the header says is corrected from a
+RomDatabase when the checksums are known (see romdb.h).
+
+Only NROM (mapper 0) can be installed into a console so far; other mappers are
+identified but not mapped.
+
+*************************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "checksum.h"
+#include "pacer.h"
+#include "ppu.h"
+
+class Console;
+class RomCache;
+class RomDatabase;
+
+struct RomInfo {
+	static const int kHeaderSize = 16;
+	static const int kTrainerSize = 512;
+
+	int mapper;
+	Mirroring mirroring;
+	bool fourScreen;
+	bool battery;
+	bool trainer;
+	Region region;
+	uint32_t prgSize; // bytes
+	uint32_t chrSize; // bytes, 0 for CHR-RAM
+
+	// false if it isn't an iNES header; NES 2.0 extensions are read when present
+	bool parse(const uint8_t* header);
+	uint32_t dataOffset() const { return kHeaderSize + (trainer ? kTrainerSize : 0); }
+};
+
+struct RomId {
+	uint32_t crc32;
+	Sha1Digest sha1;
+};
+
+// everything known about a ROM file without its data
+struct RomIdentity {
+	RomInfo header;    // as the file says
+	RomInfo info;      // after database corrections
+	RomId id;
+	std::string name;  // from the database, empty if unknown
+	bool known;        // found in the database
+	bool corrected;    // the database changed something
+};
+
+// identifies a file: from the cache if it hasn't changed since (without reading it),
+// else by reading and hashing it. Either may be nullptr. False with a message if the
+// file can't be read or isn't a ROM.
+bool identifyRom(const std::string& path, const RomDatabase* database, RomCache* cache, RomIdentity& identity);
+
+class Rom {
+public:
+	Rom() = default;
+	~Rom() = default;
+
+	bool load(const std::string& path, const RomDatabase* database = nullptr, RomCache* cache = nullptr);
+
+	// maps PRG at $8000 (16K banks mirrored) and CHR into the PPU, both shared rather
+	// than copied (so the Rom must outlive the console), sets the mirroring, then resets
+	// the console; false with a message for other mappers. The console's region should
+	// already match getIdentity().info.region.
+	bool install(Console& console) const;
+
+	const RomIdentity& getIdentity() const { return identity; }
+
+private:
+	RomIdentity identity;
+	std::vector<uint8_t> prg;
+	std::vector<uint8_t> chr;
+};
@@ -0,0 +1,279 @@
+/************************************************************************************
+
+Filename    :   romdb.cpp
+Content     :   ROM identification database and metadata cache
+Authors     :   Yash Patel
+
+*************************************************************************************/
+
+#include "romdb.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <iostream>
+
+namespace {
+
+// one line without the newline; false at the end of the file
+bool readLine(FILE* file, std::string& line) {
+    line.clear();
+    int c;
+    while ((c = fgetc(file)) != EOF && c != '\n') {
+        if (c != '\r') {
+            line.push_back(char(c));
+        }
+    }
+    return c != EOF || !line.empty();
+}
+
+// next space-separated word from pos; empty at the end of the line
+std::string nextWord(const std::string& line, size_t& pos) {
+    while (pos < line.size() && line[pos] == ' ') {
+        pos++;
+    }
+    size_t start = pos;
+    while (pos < line.size() && line[pos] != ' ') {
+        pos++;
+    }
+    return line.substr(start, pos - start);
+}
+
+bool parseHex(const std::string& text, uint64_t& value) {
+    if (text.empty()) {
+        return false;
+    }
+    char* end = nullptr;
+    value = strtoull(text.c_str(), &end, 16);
+    return *end == '\0';
+}
+
+bool parseDecimal(const std::string& text, int64_t& value) {
+    if (text.empty()) {
+        return false;
+    }
+    char* end = nullptr;
+    value = strtoll(text.c_str(), &end, 10);
+    return *end == '\0';
+}
+
+bool parseField(const std::string& key, const std::string& value, RomDatabase::Entry& entry) {
+    int64_t number = 0;
+    if (key == "mapper") {
+        if (!parseDecimal(value, number) || number < 0 || number > 4095) {
+            return false;
+        }
+        entry.mapper = int(number);
+    } else if (key == "mirroring") {
+        if (value == "h") {
+            entry.mirroring = 0;
+        } else if (value == "v") {
+            entry.mirroring = 1;
+        } else if (value == "4") {
+            entry.mirroring = 2;
+        } else {
+            return false;
+        }
+    } else if (key == "region") {
+        if (value == "ntsc") {
+            entry.region = int(Region::NTSC);
+        } else if (value == "pal") {
+            entry.region = int(Region::PAL);
+        } else {
+            return false;
+        }
+    } else if (key == "battery") {
+        if (value != "0" && value != "1") {
+            return false;
+        }
+        entry.battery = value == "1";
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool parseEntry(const std::string& line, RomDatabase::Entry& entry) {
+    size_t pos = 0;
+    uint64_t crc = 0;
+    if (!parseHex(nextWord(line, pos), crc) || crc > 0xFFFFFFFF) {
+        return false;
+    }
+    entry.crc32 = uint32_t(crc);
+    std::string sha1 = nextWord(line, pos);
+    entry.hasSha1 = sha1 != "-";
+    if (entry.hasSha1 && !entry.sha1.parse(sha1)) {
+        return false;
+    }
+    entry.mapper = entry.mirroring = entry.region = entry.battery = -1;
+    entry.name.clear();
+
+    for (;;) {
+        while (pos < line.size() && line[pos] == ' ') {
+            pos++;
+        }
+        if (line.compare(pos, 5, "name=") == 0) {
+            entry.name = line.substr(pos + 5);
+            return true;
+        }
+        std::string word = nextWord(line, pos);
+        if (word.empty()) {
+            return true;
+        }
+        size_t equals = word.find('=');
+        if (equals == std::string::npos || !parseField(word.substr(0, equals), word.substr(equals + 1), entry)) {
+            return false;
+        }
+    }
+}
+
+} // namespace
+
+bool RomDatabase::load(const std::string& path) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    std::string line;
+    int number = 0;
+    while (readLine(file, line)) {
+        number++;
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        Entry entry;
+        if (!parseEntry(line, entry)) {
+            std::cout << path << ":" << number << ": bad entry, skipped" << std::endl;
+            continue;
+        }
+        entries.emplace(entry.crc32, entry);
+    }
+    fclose(file);
+    return true;
+}
+
+const RomDatabase::Entry* RomDatabase::find(const RomId& id) const {
+    auto range = entries.equal_range(id.crc32);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (!it->second.hasSha1 || it->second.sha1 == id.sha1) {
+            return &it->second;
+        }
+    }
+    return nullptr;
+}
+
+bool RomDatabase::apply(const Entry& entry, RomInfo& info) {
+    RomInfo before = info;
+    if (entry.mapper >= 0) {
+        info.mapper = entry.mapper;
+    }
+    if (entry.mirroring >= 0) {
+        info.fourScreen = entry.mirroring == 2;
+        if (!info.fourScreen) {
+            info.mirroring = entry.mirroring == 1 ? Mirroring::Vertical : Mirroring::Horizontal;
+        }
+    }
+    if (entry.region >= 0) {
+        info.region = Region(entry.region);
+    }
+    if (entry.battery >= 0) {
+        info.battery = entry.battery != 0;
+    }
+    return info.mapper != before.mapper || info.mirroring != before.mirroring ||
+        info.fourScreen != before.fourScreen || info.region != before.region || info.battery != before.battery;
+}
+
+RomCache::RomCache(const std::string& path) :
+    path(path),
+    dirty(false) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        return;
+    }
+    std::string line;
+    while (readLine(file, line)) {
+        size_t pos = 0;
+        Entry entry;
+        int64_t size = 0;
+        uint64_t crc = 0;
+        std::string sha1;
+        std::string header;
+        bool ok = parseDecimal(nextWord(line, pos), size) && size >= 0 &&
+            parseDecimal(nextWord(line, pos), entry.mtime) &&
+            parseHex(nextWord(line, pos), crc) && crc <= 0xFFFFFFFF &&
+            entry.id.sha1.parse(nextWord(line, pos)) &&
+            (header = nextWord(line, pos)).size() == sizeof(entry.header) * 2;
+        for (size_t i = 0; ok && i < sizeof(entry.header); i++) {
+            uint64_t byte = 0;
+            ok = parseHex(header.substr(i * 2, 2), byte);
+            entry.header[i] = uint8_t(byte);
+        }
+        if (!ok || pos + 1 >= line.size()) {
+            continue; // stale or damaged lines just get rebuilt
+        }
+        entry.size = uint64_t(size);
+        entry.id.crc32 = uint32_t(crc);
+        entries[line.substr(pos + 1)] = entry;
+    }
+    fclose(file);
+}
+
+RomCache::~RomCache() {
+    if (dirty) {
+        save();
+    }
+}
+
+bool RomCache::lookup(const std::string& file, uint64_t size, int64_t mtime, Entry& entry) const {
+    auto it = entries.find(file);
+    if (it == entries.end() || it->second.size != size || it->second.mtime != mtime) {
+        return false;
+    }
+    entry = it->second;
+    return true;
+}
+
+void RomCache::store(const std::string& file, const Entry& entry) {
+    entries[file] = entry;
+    dirty = true;
+}
+
+bool RomCache::save() {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        std::cout << "couldn't write " << path << std::endl;
+        return false;
+    }
+    for (const auto& it : entries) {
+        const Entry& entry = it.second;
+        char header[sizeof(entry.header) * 2 + 1];
+        for (size_t i = 0; i < sizeof(entry.header); i++) {
+            snprintf(header + i * 2, 3, "%02x", entry.header[i]);
+        }
+        fprintf(file, "%llu %lld %08x %s %s %s\n", (unsigned long long)entry.size, (long long)entry.mtime,
+            entry.id.crc32, entry.id.sha1.hex().c_str(), header, it.first.c_str());
+    }
+    bool ok = fclose(file) == 0;
+    dirty = !ok;
+    return ok;
+}
+
+bool RomCache::stat(const std::string& file, uint64_t& size, int64_t& mtime) {
+#ifdef _WIN32
+    struct _stat64 info;
+    if (_stat64(file.c_str(), &info) != 0) {
+        return false;
+    }
+#else
+    struct stat info;
+    if (::stat(file.c_str(), &info) != 0) {
+        return false;
+    }
+#endif
+    size = uint64_t(info.st_size);
+    mtime = int64_t(info.st_mtime);
+    return true;
+}
@@ -0,0 +1,87 @@
+/************************************************************************************
+
+Filename    :   romdb.h
+Content     :   ROM identification database and metadata cache (header)
+Authors     :   Yash Patel
+
+iNES headers are often wrong (bad dumps, headers written by old tools, "DiskDude!"
+junk in the reserved bytes), so what the header says is only the starting point.
+RomDatabase maps a cartridge's PRG+CHR checksums to the mapper, mirroring, region
+and battery it really has. It's a text file, one cartridge per line:
+
+    <crc32> <sha1 or -> [mapper=<n>] [mirroring=h|v|4] [region=ntsc|pal] [battery=0|1] [name=<rest of line>]
+
+(hashes in hex). Only the fields that are given override the header. When an entry
+has a SHA-1, a CRC32 match is confirmed with it.
+
+RomCache remembers, per file, what reading it produced: the header and both hashes,
+keyed by the path with the file's size and modification time. A file that hasn't
+changed is then identified from a stat() alone, without opening it, which is what
+keeps scans over large ROM collections fast. Also text, one file per line:
+
+    <size> <mtime> <crc32> <sha1> <header, 32 hex digits> <path>
+
+*************************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <unordered_map>
+
+#include "rom.h"
+
+class RomDatabase {
+public:
+	struct Entry {
+		uint32_t crc32;
+		bool hasSha1;
+		Sha1Digest sha1;
+		int mapper;    // -1: keep the header's
+		int mirroring; // -1, or 0 horizontal, 1 vertical, 2 four-screen
+		int region;    // -1, or int(Region)
+		int battery;   // -1, 0 or 1
+		std::string name;
+	};
+
+	RomDatabase() = default;
+	~RomDatabase() = default;
+
+	bool load(const std::string& path); // false if it can't be read; bad lines are skipped
+	size_t size() const { return entries.size(); }
+
+	const Entry* find(const RomId& id) const;
+
+	// overrides what the entry specifies; true if anything changed
+	static bool apply(const Entry& entry, RomInfo& info);
+
+private:
+	std::unordered_multimap<uint32_t, Entry> entries;
+};
+
+class RomCache {
+public:
+	struct Entry {
+		uint64_t size;
+		int64_t mtime;
+		RomId id;
+		uint8_t header[RomInfo::kHeaderSize];
+	};
+
+	explicit RomCache(const std::string& path); // loads the cache file if there is one
+	~RomCache();                                // and writes it back if it changed
+
+	bool lookup(const std::string& file, uint64_t size, int64_t mtime, Entry& entry) const;
+	void store(const std::string& file, const Entry& entry);
+	bool save();
+
+	// size and modification time of a file; false if it doesn't exist
+	static bool stat(const std::string& file, uint64_t& size, int64_t& mtime);
+
+private:
+	std::string path;
+	std::unordered_map<std::string, Entry> entries;
+	bool dirty;
+};
@@ -0,0 +1,215 @@
+/************************************************************************************
+
+Filename    :   saveram.cpp
+Content     :   Battery-backed PRG-RAM mapped from a save file
+Authors     :   Yash Patel
+
+*************************************************************************************/
+
+#include "saveram.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "console.h"
+
+namespace {
+
+// one thread for every open save in the process, however many consoles there are;
+// started with the first save and kept until exit
+class Flusher {
+public:
+    Flusher() : interval(1000), stopping(false) {}
+
+    ~Flusher() {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            stopping = true;
+            wake.notify_all();
+        }
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+
+    void add(SaveRam* save) {
+        std::unique_lock<std::mutex> lock(mutex);
+        saves.push_back(save);
+        if (!thread.joinable()) {
+            thread = std::thread(&Flusher::run, this);
+        }
+    }
+
+    // after this returns the thread no longer touches the save
+    void remove(SaveRam* save) {
+        std::unique_lock<std::mutex> lock(mutex);
+        saves.erase(std::remove(saves.begin(), saves.end(), save), saves.end());
+    }
+
+    void setInterval(int milliseconds) {
+        std::unique_lock<std::mutex> lock(mutex);
+        interval = std::chrono::milliseconds(milliseconds);
+        wake.notify_all();
+    }
+
+private:
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!stopping) {
+            wake.wait_for(lock, interval);
+            // under the lock, so a save can't be closed mid-flush; the flushes don't block
+            for (SaveRam* save : saves) {
+                save->flush();
+            }
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<SaveRam*> saves;
+    std::thread thread;
+    std::chrono::milliseconds interval;
+    bool stopping;
+};
+
+Flusher& flusher() {
+    static Flusher instance;
+    return instance;
+}
+
+} // namespace
+
+SaveRam::SaveRam() :
+    data(nullptr),
+    handle(nullptr),
+    console(nullptr) {
+}
+
+SaveRam::~SaveRam() {
+    close();
+}
+
+bool SaveRam::open(const std::string& path) {
+    close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        std::cerr << "Unable to open save " << path << std::endl;
+        return false;
+    }
+    // a mapping larger than the file grows it, zero filled
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, 0, kSize, NULL);
+    CloseHandle(file); // the mapping keeps it open
+    if (mapping == NULL) {
+        std::cerr << "Unable to map save " << path << std::endl;
+        return false;
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, kSize);
+    if (view == NULL) {
+        CloseHandle(mapping);
+        std::cerr << "Unable to map save " << path << std::endl;
+        return false;
+    }
+    handle = mapping;
+#else
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        std::cerr << "Unable to open save " << path << std::endl;
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (info.st_size < off_t(kSize) && ftruncate(fd, off_t(kSize)) != 0)) {
+        ::close(fd);
+        std::cerr << "Unable to size save " << path << std::endl;
+        return false;
+    }
+    void* view = mmap(nullptr, kSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd); // the mapping keeps the file open
+    if (view == MAP_FAILED) {
+        std::cerr << "Unable to map save " << path << std::endl;
+        return false;
+    }
+#endif
+    data = static_cast<uint8_t*>(view);
+    flusher().add(this);
+    return true;
+}
+
+void SaveRam::close() {
+    if (data == nullptr) {
+        return;
+    }
+    detach();
+    flusher().remove(this);
+    flush();
+#ifdef _WIN32
+    UnmapViewOfFile(data);
+    CloseHandle(handle);
+#else
+    munmap(data, kSize);
+#endif
+    data = nullptr;
+    handle = nullptr;
+}
+
+void SaveRam::attach(Console& target) {
+    if (data == nullptr) {
+        return;
+    }
+    if (console != &target) {
+        detach();
+    }
+    // mapping the save in untracks the console's own PRG-RAM (see bus.h)
+    target.getBus().mapMemory(0x6000, 0x7FFF, data, kSize, true);
+    console = &target;
+}
+
+void SaveRam::detach() {
+    if (console == nullptr) {
+        return;
+    }
+    memcpy(console->getCartRam(), data, kSize);
+    console->getBus().mapMemory(0x6000, 0x7FFF, console->getCartRam(), kSize, true);
+    console = nullptr;
+}
+
+void SaveRam::flush() {
+    if (data == nullptr) {
+        return;
+    }
+#ifdef _WIN32
+    FlushViewOfFile(data, kSize);
+#else
+    msync(data, kSize, MS_ASYNC);
+#endif
+}
+
+void SaveRam::setFlushInterval(int milliseconds) {
+    flusher().setInterval(milliseconds);
+}
+
+std::string SaveRam::pathFor(const std::string& romPath) {
+    size_t slash = romPath.find_last_of("/\\");
+    size_t dot = romPath.rfind('.');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        return romPath + ".sav";
+    }
+    return romPath.substr(0, dot) + ".sav";
+}
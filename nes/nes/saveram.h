@@ -0,0 +1,63 @@
+/************************************************************************************
+
+Filename    :   saveram.h
+Content     :   Battery-backed PRG-RAM mapped from a save file (header)
+Authors     :   Yash Patel
+
+A cartridge with a battery keeps its 8K of PRG-RAM ($6000-$7FFF) across power-offs.
+Here that RAM *is* the save file: it's mapped shared (mmap MAP_SHARED, or a file
+mapping on Windows) and the bus points the $6000 pages straight at the mapping, so a
+game's writes land in the page cache with the same single store as any other RAM
+write. Nothing is ever copied into or out of a save buffer, and the emulation
+thread never writes to the file.
+
+Write-back is left to the OS, nudged by one background thread for the whole process
+that asks for an asynchronous flush (msync MS_ASYNC / FlushViewOfFile) of every open
+save at a fixed interval, and once more when a save is closed. Neither waits for
+the disk. Since the data lives in the page cache, a crash of the emulator loses
+nothing; only losing the machine before write-back does.
+
+*************************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+
+class Console;
+
+class SaveRam {
+public:
+	static const uint32_t kSize = 8192;
+
+	SaveRam();
+	~SaveRam();
+
+	// maps the file, creating it (zero filled) or growing it to kSize if needed;
+	// false with a message if the OS refuses
+	bool open(const std::string& path);
+	void close(); // detaches, asks for a final flush, then unmaps
+	bool isOpen() const { return data != nullptr; }
+
+	// points $6000-$7FFF of the console's bus at the save (detaching it from any
+	// console it was attached to before); the console has to outlive the attachment
+	void attach(Console& console);
+	// points the console back at its own PRG-RAM, which takes over the save's
+	// contents, so it can run on after close()
+	void detach();
+
+	uint8_t* getData() { return data; }
+	void flush(); // asynchronous: schedules write-back and returns
+
+	// period of the background flush, for all saves (default 1 s)
+	static void setFlushInterval(int milliseconds);
+
+	// the .sav next to a ROM file ("games/zelda.nes" -> "games/zelda.sav")
+	static std::string pathFor(const std::string& romPath);
+
+private:
+	uint8_t* data;
+	void* handle; // file mapping handle (Windows only)
+	Console* console; // attached to, or nullptr
+};
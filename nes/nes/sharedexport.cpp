@@ -0,0 +1,223 @@
+/************************************************************************************
+
+Filename    :   sharedexport.cpp
+Content     :   Frame / RAM export through shared memory
+Authors     :   Yash Patel
+
+*************************************************************************************/
+
+#include "sharedexport.h"
+
+#include <string.h>
+
+#include <atomic>
+#include <iostream>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "console.h"
+
+namespace {
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "sequence is shared with other processes");
+
+// the sequence lives in plain shared memory; both sides access it as an atomic
+std::atomic<uint32_t>& sequenceOf(const void* header) {
+    const SharedHeader* h = static_cast<const SharedHeader*>(header);
+    return *reinterpret_cast<std::atomic<uint32_t>*>(const_cast<uint32_t*>(&h->sequence));
+}
+
+// maps the named segment; returns null on failure
+uint8_t* mapSegment(const std::string& name, bool create, void** handle) {
+#ifdef _WIN32
+    HANDLE mapping = create ?
+        CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, DWORD(SharedExport::kSegmentSize), name.c_str()) :
+        OpenFileMappingA(FILE_MAP_READ, FALSE, name.c_str());
+    if (mapping == NULL) {
+        return nullptr;
+    }
+    void* view = MapViewOfFile(mapping, create ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ, 0, 0, SharedExport::kSegmentSize);
+    if (view == NULL) {
+        CloseHandle(mapping);
+        return nullptr;
+    }
+    *handle = mapping;
+    return static_cast<uint8_t*>(view);
+#else
+    *handle = nullptr;
+    int fd = shm_open(name.c_str(), create ? (O_CREAT | O_RDWR) : O_RDONLY, 0600);
+    if (fd < 0) {
+        return nullptr;
+    }
+    if (create && ftruncate(fd, off_t(SharedExport::kSegmentSize)) != 0) {
+        ::close(fd);
+        return nullptr;
+    }
+    void* view = mmap(nullptr, SharedExport::kSegmentSize, create ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd); // the mapping keeps the segment alive
+    return (view == MAP_FAILED) ? nullptr : static_cast<uint8_t*>(view);
+#endif
+}
+
+void unmapSegment(const void* base, void* handle) {
+#ifdef _WIN32
+    UnmapViewOfFile(base);
+    CloseHandle(handle);
+#else
+    (void)handle;
+    munmap(const_cast<void*>(base), SharedExport::kSegmentSize);
+#endif
+}
+
+} // namespace
+
+// writer
+
+SharedExport::SharedExport() :
+    handle(nullptr),
+    base(nullptr),
+    header(nullptr) {
+}
+
+SharedExport::~SharedExport() {
+    close();
+}
+
+bool SharedExport::open(const std::string& segmentName) {
+    close();
+    base = mapSegment(segmentName, true, &handle);
+    if (base == nullptr) {
+        std::cerr << "Unable to create shared memory segment " << segmentName << std::endl;
+        return false;
+    }
+    name = segmentName;
+    header = reinterpret_cast<SharedHeader*>(base);
+
+    // readers treat a zero sequence as "nothing published yet"
+    memset(base, 0, kSegmentSize);
+    header->magic = SharedHeader::kMagic;
+    header->version = SharedHeader::kVersion;
+    header->headerSize = sizeof(SharedHeader);
+    header->ramOffset = sizeof(SharedHeader);
+    header->ramSize = kRamSize;
+    header->frameOffset = sizeof(SharedHeader) + kRamSize;
+    header->emphasisOffset = header->frameOffset + kFrameBytes;
+    header->frameWidth = PPU::kWidth;
+    header->frameHeight = PPU::kHeight;
+    return true;
+}
+
+void SharedExport::close() {
+    if (base == nullptr) {
+        return;
+    }
+    unmapSegment(base, handle);
+#ifndef _WIN32
+    shm_unlink(name.c_str()); // readers that still have it mapped keep their view
+#endif
+    base = nullptr;
+    header = nullptr;
+    handle = nullptr;
+}
+
+void SharedExport::publish(Console& console) {
+    if (header == nullptr) {
+        return;
+    }
+    std::atomic<uint32_t>& sequence = sequenceOf(header);
+    uint32_t start = sequence.load(std::memory_order_relaxed);
+    sequence.store(start + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release); // odd sequence lands before the data
+
+    CPUState regs = console.getCPU().state();
+    header->frame = console.getFrame();
+    header->cycles = regs.cycles;
+    header->stateHash = console.stateHash();
+    header->pc = regs.pc;
+    header->a = regs.ac;
+    header->x = regs.x;
+    header->y = regs.y;
+    header->sr = regs.sr;
+    header->sp = regs.sp;
+    memcpy(base + header->ramOffset, console.getRam(), kRamSize);
+    if (console.lastFrameRendered()) {
+        memcpy(base + header->frameOffset, console.getPPU().getPixels(), kFrameBytes);
+        memcpy(base + header->emphasisOffset, console.getPPU().getEmphasis(), kEmphasisBytes);
+        header->framePixels = header->frame;
+    }
+
+    sequence.store(start + 2, std::memory_order_release);
+}
+
+// reader
+
+SharedView::SharedView() :
+    handle(nullptr),
+    base(nullptr) {
+}
+
+SharedView::~SharedView() {
+    close();
+}
+
+bool SharedView::open(const std::string& name) {
+    close();
+    base = mapSegment(name, false, &handle);
+    if (base == nullptr) {
+        return false;
+    }
+    const SharedHeader* header = reinterpret_cast<const SharedHeader*>(base);
+    if (header->magic != SharedHeader::kMagic || header->version != SharedHeader::kVersion) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void SharedView::close() {
+    if (base == nullptr) {
+        return;
+    }
+    unmapSegment(base, handle);
+    base = nullptr;
+    handle = nullptr;
+}
+
+bool SharedView::read(SharedHeader* header, uint8_t* ram, uint8_t* pixels, uint8_t* emphasis) {
+    if (base == nullptr) {
+        return false;
+    }
+    std::atomic<uint32_t>& sequence = sequenceOf(base);
+    const SharedHeader* shared = reinterpret_cast<const SharedHeader*>(base);
+
+    while (true) {
+        uint32_t start = sequence.load(std::memory_order_acquire);
+        if (start & 1) {
+            std::this_thread::yield(); // a publish is in progress
+            continue;
+        }
+        if (header != nullptr) {
+            memcpy(header, shared, sizeof(SharedHeader));
+        }
+        if (ram != nullptr) {
+            memcpy(ram, base + shared->ramOffset, SharedExport::kRamSize);
+        }
+        if (pixels != nullptr) {
+            memcpy(pixels, base + shared->frameOffset, SharedExport::kFrameBytes);
+        }
+        if (emphasis != nullptr) {
+            memcpy(emphasis, base + shared->emphasisOffset, SharedExport::kEmphasisBytes);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire); // copies complete before the recheck
+        if (sequence.load(std::memory_order_relaxed) == start) {
+            return start != 0;
+        }
+    }
+}
@@ -0,0 +1,106 @@
+/************************************************************************************
+
+Filename    :   sharedexport.h
+Content     :   Frame / RAM export through shared memory (header)
+Authors     :   Yash Patel
+
+Publishes the console's state after every frame into a named shared-memory segment
+(POSIX shm_open, or a named file mapping on Windows) so local processes can read it
+in place: no serialization, no sockets, no copies on the consumer side.
+
+Segment layout (little endian, offsets from the start of the segment):
+
+    0       SharedHeader (control block, 128 bytes)
+    128     work RAM, 2048 bytes ($0000-$07FF)
+    2176    frame, 256 x 240 palette indices (only updated on rendered frames)
+    63616   emphasis, 240 bytes (one per line, see PPU::getEmphasis)
+
+Frames are exported as the PPU produces them; readers that want colors run them
+through a palette themselves (see video.h for the conversion and the palette).
+
+Consistency is a seqlock: the writer bumps `sequence` to an odd value, updates
+everything, then bumps it to the next even value. A reader copies what it needs and
+retries if the sequence was odd or changed in the meantime. The writer never waits
+for readers; readers only ever retry for as long as one publish takes.
+
+*************************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "ppu.h"
+
+class Console;
+
+struct SharedHeader {
+	static const uint32_t kMagic = 0x5853454E; // "NESX"
+	static const uint32_t kVersion = 2;
+
+	uint32_t magic;
+	uint32_t version;
+	uint32_t sequence;     // odd while an update is in progress; accessed atomically
+	uint32_t headerSize;
+	uint32_t ramOffset;
+	uint32_t ramSize;
+	uint32_t frameOffset;
+	uint32_t emphasisOffset;
+	uint16_t frameWidth;
+	uint16_t frameHeight;
+	uint32_t reserved0;
+
+	uint64_t frame;        // console frame counter
+	uint64_t framePixels;  // frame counter of the image in the frame area
+	uint64_t cycles;       // CPU cycles
+	uint64_t stateHash;
+	uint16_t pc;
+	uint8_t a, x, y, sr, sp;
+	uint8_t reserved[128 - 79];
+};
+static_assert(sizeof(SharedHeader) == 128, "shared header layout is part of the ABI");
+
+class SharedExport {
+public:
+	static const uint32_t kRamSize = 2048;
+	static const uint32_t kFrameBytes = PPU::kWidth * PPU::kHeight;
+	static const uint32_t kEmphasisBytes = PPU::kHeight;
+	static const size_t kSegmentSize = sizeof(SharedHeader) + kRamSize + kFrameBytes + kEmphasisBytes;
+
+	SharedExport();
+	~SharedExport();
+
+	// creates (or reuses) the segment, e.g. "/nes0"; false if the OS refuses
+	bool open(const std::string& name);
+	void close();
+	bool isOpen() const { return header != nullptr; }
+
+	// emulation thread, after each frame
+	void publish(Console& console);
+
+private:
+	std::string name;
+	void* handle; // Windows file mapping; unused on POSIX
+	uint8_t* base;
+	SharedHeader* header;
+};
+
+// consumer side, for C++ readers in other processes
+class SharedView {
+public:
+	SharedView();
+	~SharedView();
+
+	bool open(const std::string& name);
+	void close();
+
+	// consistent copies of the control block / RAM / frame / emphasis (any may be
+	// null); false if the writer hasn't published anything yet
+	bool read(SharedHeader* header, uint8_t* ram, uint8_t* pixels, uint8_t* emphasis = nullptr);
+
+private:
+	void* handle;
+	const uint8_t* base;
+};
@@ -0,0 +1,202 @@
+/************************************************************************************
+
+Filename    :   statehash.cpp
+Content     :   Incrementally maintained hash of emulator memory
+Authors     :   Yash Patel
+
+hashBytes() is an XXH64-style hash: four independent 64-bit accumulators consume
+32 bytes per round (so the multiplies pipeline), followed by a tail and avalanche.
+
+*************************************************************************************/
+
+#include "statehash.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+
+const uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+const uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+const uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+
+inline uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t load64(const uint8_t* p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline uint64_t mixLane(uint64_t acc, uint64_t lane) {
+    acc += lane * kPrime2;
+    acc = rotl(acc, 31);
+    return acc * kPrime1;
+}
+
+inline uint64_t avalanche(uint64_t h) {
+    h ^= h >> 33;
+    h *= kPrime2;
+    h ^= h >> 29;
+    h *= kPrime3;
+    h ^= h >> 32;
+    return h;
+}
+
+inline int lowestBit(uint64_t word) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, word);
+    return int(index);
+#else
+    return __builtin_ctzll(word);
+#endif
+}
+
+} // namespace
+
+uint64_t hashBytes(const uint8_t* data, size_t size, uint64_t seed) {
+    uint64_t acc0 = seed + kPrime1 + kPrime2;
+    uint64_t acc1 = seed + kPrime2;
+    uint64_t acc2 = seed;
+    uint64_t acc3 = seed - kPrime1;
+
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        acc0 = mixLane(acc0, load64(data + i));
+        acc1 = mixLane(acc1, load64(data + i + 8));
+        acc2 = mixLane(acc2, load64(data + i + 16));
+        acc3 = mixLane(acc3, load64(data + i + 24));
+    }
+
+    uint64_t h = rotl(acc0, 1) + rotl(acc1, 7) + rotl(acc2, 12) + rotl(acc3, 18);
+    for (; i + 8 <= size; i += 8) {
+        h = rotl(h ^ mixLane(0, load64(data + i)), 27) * kPrime1 + kPrime3;
+    }
+    for (; i < size; i++) {
+        h = rotl(h ^ (data[i] * kPrime3), 11) * kPrime1;
+    }
+    return avalanche(h + size);
+}
+
+StateHash::StateHash() : combined(0) {
+}
+
+uint32_t StateHash::track(const uint8_t* base, uint32_t size) {
+    if (size % kBlockSize != 0) {
+        throw std::runtime_error("Tracked memory must be a multiple of the block size");
+    }
+
+    for (const Region& region : regions) {
+        if (base >= region.base && base + size <= region.base + region.size) {
+            return region.firstBlock + uint32_t((base - region.base) >> kBlockShift);
+        }
+    }
+
+    Region region;
+    region.base = base;
+    region.size = size;
+    auto reusable = std::find_if(released.begin(), released.end(), [size](const Region& r) { return r.size == size; });
+    if (reusable != released.end()) {
+        region.firstBlock = reusable->firstBlock;
+        released.erase(reusable);
+        for (uint32_t offset = 0; offset < size; offset += kBlockSize) {
+            blocks[region.firstBlock + (offset >> kBlockShift)].data = base + offset;
+        }
+    } else {
+        region.firstBlock = uint32_t(blocks.size());
+        for (uint32_t offset = 0; offset < size; offset += kBlockSize) {
+            Block block;
+            block.data = base + offset;
+            block.hash = 0;
+            blocks.push_back(block);
+        }
+        dirty.resize((blocks.size() + 63) / 64, 0);
+        changed.resize(dirty.size(), 0);
+    }
+    regions.push_back(region);
+
+    markDirty(region.firstBlock, size >> kBlockShift);
+    return region.firstBlock;
+}
+
+void StateHash::untrack(const uint8_t* base, uint32_t size) {
+    auto found = std::find_if(regions.begin(), regions.end(),
+        [base, size](const Region& r) { return r.base == base && r.size == size; });
+    if (found == regions.end()) {
+        return;
+    }
+
+    Region region = *found;
+    regions.erase(found);
+    for (uint32_t block = region.firstBlock; block < region.firstBlock + (size >> kBlockShift); block++) {
+        combined ^= blocks[block].hash;
+        blocks[block].data = nullptr;
+        blocks[block].hash = 0;
+        uint64_t bit = uint64_t(1) << (block & 63);
+        dirty[block >> 6] &= ~bit;
+        changed[block >> 6] &= ~bit;
+    }
+    region.base = nullptr;
+    released.push_back(region);
+}
+
+void StateHash::markDirty(uint32_t block, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        markDirty(block + i);
+    }
+}
+
+void StateHash::invalidate() {
+    for (const Region& region : regions) {
+        markDirty(region.firstBlock, region.size >> kBlockShift);
+    }
+}
+
+uint64_t StateHash::hashBlock(uint32_t block) const {
+    return hashBytes(blocks[block].data, kBlockSize, block);
+}
+
+uint64_t StateHash::hash() {
+    for (size_t word = 0; word < dirty.size(); word++) {
+        uint64_t bits = dirty[word];
+        if (bits == 0) {
+            continue;
+        }
+        changed[word] |= bits;
+        dirty[word] = 0;
+
+        while (bits != 0) {
+            uint32_t block = uint32_t(word * 64 + lowestBit(bits));
+            bits &= bits - 1;
+
+            uint64_t fresh = hashBlock(block);
+            combined ^= blocks[block].hash ^ fresh;
+            blocks[block].hash = fresh;
+        }
+    }
+    return combined;
+}
+
+std::vector<uint32_t> StateHash::takeChanged() {
+    hash();
+
+    std::vector<uint32_t> result;
+    for (size_t word = 0; word < changed.size(); word++) {
+        uint64_t bits = changed[word];
+        changed[word] = 0;
+        while (bits != 0) {
+            result.push_back(uint32_t(word * 64 + lowestBit(bits)));
+            bits &= bits - 1;
+        }
+    }
+    return result;
+}
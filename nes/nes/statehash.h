@@ -0,0 +1,84 @@
+/************************************************************************************
+
+Filename    :   statehash.h
+Content     :   Incrementally maintained hash of emulator memory (header)
+Authors     :   Yash Patel
+
+Tracked memory (RAM, VRAM, OAM, ...) is split into 256-byte blocks. Every write marks
+its block in a dirty bitmap; hash() rehashes only the dirty blocks and folds the
+difference into a combined hash, so the cost of hashing the state scales with what
+changed since the last call rather than with the size of memory.
+
+Each block hash is seeded with the block's index, and the combined hash is the XOR of
+all block hashes, which lets a block be swapped out (old ^ new) in O(1).
+
+Blocks that were rehashed are also accumulated into a "changed" set that consumers
+(delta snapshots, copy-on-write forks) drain with takeChanged().
+
+Memory that goes away (a save file unmapped, RAM swapped for another mapping) is
+untracked: its blocks drop out of the combined hash and are left empty, so block
+indices handed out earlier stay valid, and the next region of the same size reuses
+them.
+
+*************************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+// 64-bit hash of an arbitrary byte range (used for blocks and small register files)
+uint64_t hashBytes(const uint8_t* data, size_t size, uint64_t seed);
+
+class StateHash {
+public:
+	static const int kBlockShift = 8;
+	static const int kBlockSize  = 1 << kBlockShift;
+	static const uint32_t kUntracked = 0xFFFFFFFF;
+
+	StateHash();
+	~StateHash() = default;
+
+	// starts tracking [base, base + size) (size a multiple of kBlockSize) and returns
+	// the index of its first block; memory that is already tracked isn't added twice
+	uint32_t track(const uint8_t* base, uint32_t size);
+	// stops tracking a region track() added (same base and size, otherwise nothing
+	// happens); its blocks mustn't be marked dirty any more
+	void untrack(const uint8_t* base, uint32_t size);
+
+	void markDirty(uint32_t block) {
+		dirty[block >> 6] |= uint64_t(1) << (block & 63);
+	}
+	void markDirty(uint32_t block, uint32_t count); // a run of blocks (bulk copies)
+	void invalidate(); // memory changed behind our back (ROM load, reset): rehash everything
+
+	uint64_t hash();
+
+	// blocks rehashed since the last call, in ascending order
+	std::vector<uint32_t> takeChanged();
+
+	uint32_t blockCount() const { return uint32_t(blocks.size()); }
+	const uint8_t* blockData(uint32_t block) const { return blocks[block].data; } // nullptr once untracked
+
+private:
+	struct Region {
+		const uint8_t* base;
+		uint32_t size;
+		uint32_t firstBlock;
+	};
+	struct Block {
+		const uint8_t* data;
+		uint64_t hash;
+	};
+
+	uint64_t hashBlock(uint32_t block) const;
+
+	std::vector<Region> regions;
+	std::vector<Region> released; // untracked block runs (base is nullptr), for reuse
+	std::vector<Block> blocks;
+	std::vector<uint64_t> dirty;   // one bit per block, pending rehash
+	std::vector<uint64_t> changed; // one bit per block, pending takeChanged()
+	uint64_t combined;
+};
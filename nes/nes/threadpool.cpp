@@ -0,0 +1,93 @@
+/************************************************************************************
+
+Filename    :   threadpool.cpp
+Content     :   Fixed-size worker pool for data-parallel loops
+Authors     :   Yash Patel
+
+*************************************************************************************/
+
+#include "threadpool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(int threads) :
+    generation(0),
+    quitting(false),
+    busy(0),
+    job(nullptr),
+    jobCount(0),
+    nextIndex(0) {
+    if (threads <= 0) {
+        threads = std::max(1, int(std::thread::hardware_concurrency()));
+    }
+    for (int i = 0; i < threads - 1; i++) { // the caller is the last thread
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quitting = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallelFor(int count, const std::function<void(int index)>& fn) {
+    if (workers.empty() || count <= 1) {
+        for (int i = 0; i < count; i++) {
+            fn(i);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &fn;
+        jobCount = count;
+        nextIndex.store(0, std::memory_order_relaxed);
+        busy = int(workers.size());
+        generation++;
+    }
+    wake.notify_all();
+
+    drain();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this]() { return busy == 0; });
+    job = nullptr;
+}
+
+void ThreadPool::drain() {
+    while (true) {
+        int index = nextIndex.fetch_add(1, std::memory_order_relaxed);
+        if (index >= jobCount) {
+            return;
+        }
+        (*job)(index);
+    }
+}
+
+void ThreadPool::workerLoop() {
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&]() { return quitting || generation != seen; });
+            if (quitting) {
+                return;
+            }
+            seen = generation;
+        }
+
+        drain();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--busy == 0) {
+            idle.notify_one();
+        }
+    }
+}
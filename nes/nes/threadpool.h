@@ -0,0 +1,47 @@
+/************************************************************************************
+
+Filename    :   threadpool.h
+Content     :   Fixed-size worker pool for data-parallel loops (header)
+Authors     :   Yash Patel
+
+parallelFor(count, fn) runs fn(0) .. fn(count - 1) across the workers and the calling
+thread, and returns once all of them are done. Items are claimed one at a time from a
+shared atomic counter, so an instance that happens to run a slow frame doesn't hold
+up a whole pre-assigned chunk.
+
+*************************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+	explicit ThreadPool(int threads = 0); // 0: one per hardware thread
+	~ThreadPool();
+
+	void parallelFor(int count, const std::function<void(int index)>& fn);
+	int size() const { return int(workers.size()) + 1; } // workers plus the caller
+
+private:
+	void workerLoop();
+	void drain(); // claims and runs items of the current job until none are left
+
+	std::vector<std::thread> workers;
+
+	std::mutex mutex;
+	std::condition_variable wake; // workers: a job was posted
+	std::condition_variable idle; // caller: the last worker finished the job
+	uint64_t generation;          // bumped per job so workers run each job once
+	bool quitting;
+	int busy;                     // workers still inside the current job
+
+	const std::function<void(int)>* job;
+	int jobCount;
+	std::atomic<int> nextIndex;
+};
@@ -0,0 +1,204 @@
+/************************************************************************************
+
+Filename    :   transport.cpp
+Content     :   Packet transports for netplay
+Authors     :   Yash Patel
+
+*************************************************************************************/
+
+#include "transport.h"
+
+#include <string.h>
+
+#include <iostream>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+// loopback
+
+void LoopbackTransport::connect(LoopbackTransport& a, LoopbackTransport& b, int latency, int dropEvery) {
+    std::shared_ptr<Link> there(new Link());
+    std::shared_ptr<Link> back(new Link());
+    there->latency = back->latency = latency;
+    there->dropEvery = back->dropEvery = dropEvery;
+    a.outgoing = b.incoming = there;
+    b.outgoing = a.incoming = back;
+}
+
+bool LoopbackTransport::send(const uint8_t* data, size_t size) {
+    if (!outgoing) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(outgoing->mutex);
+    outgoing->sent++;
+    if (outgoing->dropEvery > 0 && outgoing->sent % uint64_t(outgoing->dropEvery) == 0) {
+        return true; // lost on the way
+    }
+    outgoing->packets.emplace_back(outgoing->sent, std::vector<uint8_t>(data, data + size));
+    return true;
+}
+
+bool LoopbackTransport::receive(std::vector<uint8_t>& packet) {
+    if (!incoming) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(incoming->mutex);
+    if (incoming->packets.empty() ||
+        incoming->sent < incoming->packets.front().first + uint64_t(incoming->latency)) {
+        return false;
+    }
+    packet.swap(incoming->packets.front().second);
+    incoming->packets.pop_front();
+    return true;
+}
+
+// UDP
+
+namespace {
+
+const intptr_t kClosed = -1;
+const size_t kMaxDatagram = 1500;
+
+#ifdef _WIN32
+typedef SOCKET NativeSocket;
+void closeSocket(intptr_t s) { closesocket(SOCKET(s)); }
+#else
+typedef int NativeSocket;
+void closeSocket(intptr_t s) { ::close(int(s)); }
+#endif
+
+NativeSocket native(intptr_t s) {
+    return NativeSocket(s);
+}
+
+} // namespace
+
+UdpTransport::UdpTransport() :
+    socket(kClosed),
+    started(false),
+    remoteAddr(0),
+    remotePort(0) {
+}
+
+UdpTransport::~UdpTransport() {
+    close();
+}
+
+bool UdpTransport::open(uint16_t localPort, const std::string& remoteHost, uint16_t port) {
+    close();
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        std::cerr << "Unable to start Winsock" << std::endl;
+        return false;
+    }
+#endif
+    started = true;
+
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo* found = nullptr;
+    if (getaddrinfo(remoteHost.c_str(), nullptr, &hints, &found) != 0 || found == nullptr) {
+        std::cerr << "Unable to resolve " << remoteHost << std::endl;
+        close();
+        return false;
+    }
+    remoteAddr = reinterpret_cast<const sockaddr_in*>(found->ai_addr)->sin_addr.s_addr;
+    remotePort = htons(port);
+    freeaddrinfo(found);
+
+    NativeSocket created = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+#ifdef _WIN32
+    if (created == INVALID_SOCKET) {
+#else
+    if (created < 0) {
+#endif
+        std::cerr << "Unable to create a UDP socket" << std::endl;
+        close();
+        return false;
+    }
+    intptr_t s = intptr_t(created);
+    socket = s;
+
+    sockaddr_in local;
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons(localPort);
+    bool ok = bind(native(s), reinterpret_cast<const sockaddr*>(&local), sizeof(local)) == 0;
+#ifdef _WIN32
+    u_long nonBlocking = 1;
+    ok = ok && ioctlsocket(native(s), FIONBIO, &nonBlocking) == 0;
+#else
+    ok = ok && fcntl(native(s), F_SETFL, fcntl(native(s), F_GETFL, 0) | O_NONBLOCK) == 0;
+#endif
+    if (!ok) {
+        std::cerr << "Unable to bind UDP port " << localPort << std::endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+void UdpTransport::close() {
+    if (socket != kClosed) {
+        closeSocket(socket);
+        socket = kClosed;
+    }
+#ifdef _WIN32
+    if (started) {
+        WSACleanup();
+    }
+#endif
+    started = false;
+}
+
+bool UdpTransport::isOpen() const {
+    return socket != kClosed;
+}
+
+bool UdpTransport::send(const uint8_t* data, size_t size) {
+    if (socket == kClosed) {
+        return false;
+    }
+    sockaddr_in remote;
+    memset(&remote, 0, sizeof(remote));
+    remote.sin_family = AF_INET;
+    remote.sin_addr.s_addr = remoteAddr;
+    remote.sin_port = remotePort;
+    return sendto(native(socket), reinterpret_cast<const char*>(data), int(size), 0,
+        reinterpret_cast<const sockaddr*>(&remote), sizeof(remote)) == int(size);
+}
+
+bool UdpTransport::receive(std::vector<uint8_t>& packet) {
+    if (socket == kClosed) {
+        return false;
+    }
+    uint8_t buffer[kMaxDatagram];
+    for (;;) {
+        sockaddr_in from;
+        socklen_t fromSize = sizeof(from);
+        int size = int(recvfrom(native(socket), reinterpret_cast<char*>(buffer), int(sizeof(buffer)), 0,
+            reinterpret_cast<sockaddr*>(&from), &fromSize));
+        if (size < 0) {
+            return false; // nothing waiting (or an ICMP error from a peer that isn't up yet)
+        }
+        if (from.sin_addr.s_addr == remoteAddr && from.sin_port == remotePort) {
+            packet.assign(buffer, buffer + size);
+            return true;
+        }
+    }
+}
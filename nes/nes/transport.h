@@ -0,0 +1,83 @@
+/************************************************************************************
+
+Filename    :   transport.h
+Content     :   Packet transports for netplay (header)
+Authors     :   Yash Patel
+
+Netplay (netplay.h) only needs to fire off small packets and pick up whatever has
+arrived, without ever waiting: lost, duplicated and reordered packets are its
+problem, not the transport's. Two implementations:
+
+  - LoopbackTransport: two ends connected in-process, for tests. Latency is counted
+    in packets rather than time (a packet is delivered once its sender has sent
+    `latency` more), which with one packet per frame is that many frames, and
+    deterministic however fast the test runs. Every dropEvery-th packet can be lost.
+  - UdpTransport: a non-blocking UDP socket talking to one peer, e.g. another
+    process on localhost.
+
+*************************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class Transport {
+public:
+	virtual ~Transport() = default;
+
+	// fire and forget; false if it couldn't even be sent
+	virtual bool send(const uint8_t* data, size_t size) = 0;
+	// the next packet that arrived, without waiting; false if there is none
+	virtual bool receive(std::vector<uint8_t>& packet) = 0;
+};
+
+class LoopbackTransport : public Transport {
+public:
+	LoopbackTransport() = default;
+	~LoopbackTransport() = default;
+
+	// connects two ends (either may live on another thread); see top of file
+	static void connect(LoopbackTransport& a, LoopbackTransport& b, int latency = 0, int dropEvery = 0);
+
+	bool send(const uint8_t* data, size_t size) override;
+	bool receive(std::vector<uint8_t>& packet) override;
+
+private:
+	struct Link {
+		std::mutex mutex;
+		std::deque<std::pair<uint64_t, std::vector<uint8_t>>> packets; // with the send count
+		uint64_t sent = 0;
+		int latency = 0;
+		int dropEvery = 0;
+	};
+
+	std::shared_ptr<Link> outgoing;
+	std::shared_ptr<Link> incoming;
+};
+
+class UdpTransport : public Transport {
+public:
+	UdpTransport();
+	~UdpTransport();
+
+	// binds localPort and sends to remoteHost:remotePort (IPv4); false with a message
+	bool open(uint16_t localPort, const std::string& remoteHost, uint16_t remotePort);
+	void close();
+	bool isOpen() const;
+
+	bool send(const uint8_t* data, size_t size) override;
+	bool receive(std::vector<uint8_t>& packet) override; // only from the peer
+
+private:
+	intptr_t socket;     // SOCKET / file descriptor, -1 when closed
+	bool started;        // Winsock initialized (Windows)
+	uint32_t remoteAddr; // network byte order
+	uint16_t remotePort;
+};
@@ -0,0 +1,62 @@
+/************************************************************************************
+
+Filename    :   triplebuffer.h
+Content     :   Lock-free triple buffer for handing frames between two threads
+Authors     :   Yash Patel
+
+Three slots: the producer owns one (back), the consumer owns one (front), and the
+third (middle) holds the most recent complete value. Publishing swaps back and
+middle; picking up swaps front and middle. Each swap is a single atomic exchange of
+the middle index, so neither side ever waits: a slow consumer simply skips values,
+and a fast one sees the same value until a new one is published.
+
+Exactly one producer thread and one consumer thread; anything fanning frames out to
+several consumers does it from the consumer side.
+
+*************************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <vector>
+
+template <typename T>
+class TripleBuffer {
+public:
+	TripleBuffer() :
+		slots(3),
+		middle(1),
+		back(0),
+		front(2) {
+	}
+	~TripleBuffer() = default;
+
+	// producer: fill writeSlot(), then publish() it
+	T& writeSlot() { return slots[back]; }
+	void publish() {
+		// release: the slot's contents are visible before its index is
+		back = middle.exchange(uint8_t(back | kFresh), std::memory_order_acq_rel) & kIndex;
+	}
+
+	// consumer: update() picks up the latest published value if there is a new one
+	// (returns false otherwise); readSlot() stays valid until the next update()
+	bool update() {
+		if (!(middle.load(std::memory_order_relaxed) & kFresh)) {
+			return false;
+		}
+		front = middle.exchange(front, std::memory_order_acq_rel) & kIndex;
+		return true;
+	}
+	const T& readSlot() const { return slots[front]; }
+
+private:
+	static const uint8_t kIndex = 0x03;
+	static const uint8_t kFresh = 0x04; // middle holds a value the consumer hasn't seen
+
+	std::vector<T> slots;
+	alignas(64) std::atomic<uint8_t> middle;
+	alignas(64) uint8_t back;  // producer only
+	alignas(64) uint8_t front; // consumer only
+};
@@ -0,0 +1,300 @@
+/************************************************************************************
+
+Filename    :   video.cpp
+Content     :   Palette-indexed frames to RGB / YUV
+Authors     :   Yash Patel
+
+*************************************************************************************/
+
+#include "video.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "cpufeatures.h"
+
+#ifdef NES_X86
+#define NES_VIDEO_SSSE3 1
+#include <tmmintrin.h>
+#endif
+
+namespace {
+
+// 2C02 master palette, ARGB
+const uint32_t kStandardPalette[64] = {
+    0xFF666666, 0xFF002A88, 0xFF1412A7, 0xFF3B00A4, 0xFF5C007E, 0xFF6E0040, 0xFF6C0600, 0xFF561D00,
+    0xFF333500, 0xFF0B4800, 0xFF005200, 0xFF004F08, 0xFF00404D, 0xFF000000, 0xFF000000, 0xFF000000,
+    0xFFADADAD, 0xFF155FD9, 0xFF4240FF, 0xFF7527FE, 0xFFA01ACC, 0xFFB71E7B, 0xFFB53120, 0xFF994E00,
+    0xFF6B6D00, 0xFF388700, 0xFF0C9300, 0xFF008F32, 0xFF007C8D, 0xFF000000, 0xFF000000, 0xFF000000,
+    0xFFFFFEFF, 0xFF64B0FF, 0xFF9290FF, 0xFFC676FF, 0xFFF36AFF, 0xFFFE6ECC, 0xFFFE8170, 0xFFEA9E22,
+    0xFFBCBE00, 0xFF88D800, 0xFF5CE430, 0xFF45E082, 0xFF48CDDE, 0xFF4F4F4F, 0xFF000000, 0xFF000000,
+    0xFFFFFEFF, 0xFFC0DFFF, 0xFFD3D2FF, 0xFFE8C8FF, 0xFFFBC2FF, 0xFFFEC4EA, 0xFFFECCC5, 0xFFF7D8A5,
+    0xFFE4E594, 0xFFCFEF96, 0xFFBDF4AB, 0xFFB3F3CC, 0xFFB5EBF2, 0xFFB8B8B8, 0xFF000000, 0xFF000000,
+};
+
+// how much each emphasis bit darkens the two channels it doesn't emphasize
+const double kAttenuation = 0.816;
+
+uint32_t argb(int r, int g, int b) {
+    return 0xFF000000 | (uint32_t(r) << 16) | (uint32_t(g) << 8) | uint32_t(b);
+}
+
+uint8_t clampByte(double value) {
+    return uint8_t(std::max(0.0, std::min(255.0, value + 0.5)));
+}
+
+// per-emphasis byte tables for the three planes, built from the palette on first use
+struct YUVTables {
+    bool built[8];
+    uint8_t y[8][64];
+    uint8_t u[8][64];
+    uint8_t v[8][64];
+
+    explicit YUVTables(const Palette& palette) : built(), palette(palette) {}
+
+    int prepare(uint8_t emphasis) {
+        int e = emphasis & 7;
+        if (!built[e]) {
+            // BT.601, limited range
+            const uint32_t* colors = palette.table(uint8_t(e));
+            for (int i = 0; i < 64; i++) {
+                double r = (colors[i] >> 16) & 0xFF;
+                double g = (colors[i] >> 8) & 0xFF;
+                double b = colors[i] & 0xFF;
+                y[e][i] = clampByte(16.0 + (65.481 * r + 128.553 * g + 24.966 * b) / 255.0);
+                u[e][i] = clampByte(128.0 + (-37.797 * r - 74.203 * g + 112.0 * b) / 255.0);
+                v[e][i] = clampByte(128.0 + (112.0 * r - 93.786 * g - 18.214 * b) / 255.0);
+            }
+            built[e] = true;
+        }
+        return e;
+    }
+
+    const Palette& palette;
+};
+
+// rounds up like pavgb, so the scalar and SIMD paths agree bit for bit
+inline uint8_t average(uint8_t a, uint8_t b) {
+    return uint8_t((a + b + 1) >> 1);
+}
+
+// the scalar conversions, from pixel x to the end of the line (the SIMD paths leave
+// them what doesn't fill a register)
+void argbPixels(const uint32_t* colors, const uint8_t* in, uint32_t* line, int x, int width) {
+    for (; x < width; x++) {
+        line[x] = colors[in[x] & 63];
+    }
+}
+
+void yuvPixels(const YUVTables& tables, int e0, int e1, const uint8_t* in0, const uint8_t* in1,
+    uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, int x, int width) {
+    for (; x + 1 < width; x += 2) {
+        uint8_t i00 = in0[x] & 63, i01 = in0[x + 1] & 63;
+        uint8_t i10 = in1[x] & 63, i11 = in1[x + 1] & 63;
+        y0[x] = tables.y[e0][i00];
+        y0[x + 1] = tables.y[e0][i01];
+        y1[x] = tables.y[e1][i10];
+        y1[x + 1] = tables.y[e1][i11];
+        u[x / 2] = average(average(tables.u[e0][i00], tables.u[e1][i10]), average(tables.u[e0][i01], tables.u[e1][i11]));
+        v[x / 2] = average(average(tables.v[e0][i00], tables.v[e1][i10]), average(tables.v[e0][i01], tables.v[e1][i11]));
+    }
+}
+
+#ifdef NES_VIDEO_SSSE3
+// 64-entry byte table as four shuffle registers
+NES_TARGET("ssse3") void loadTable(const uint8_t* bytes, __m128i table[4]) {
+    for (int h = 0; h < 4; h++) {
+        table[h] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + h * 16));
+    }
+}
+
+// looks up 16 indices (0-63): the low nibble picks the entry, the top two bits the register
+NES_TARGET("ssse3") inline __m128i lookup(const __m128i table[4], __m128i index) {
+    __m128i lo = _mm_and_si128(index, _mm_set1_epi8(0x0F));
+    __m128i hi = _mm_and_si128(_mm_srli_epi16(index, 4), _mm_set1_epi8(0x03));
+    __m128i value = _mm_setzero_si128();
+    for (int h = 0; h < 4; h++) {
+        __m128i select = _mm_cmpeq_epi8(hi, _mm_set1_epi8(char(h)));
+        value = _mm_or_si128(value, _mm_and_si128(select, _mm_shuffle_epi8(table[h], lo)));
+    }
+    return value;
+}
+
+// averages adjacent byte pairs: 16 bytes in, 8 out (low half)
+NES_TARGET("ssse3") inline __m128i halve(__m128i value) {
+    const __m128i even = _mm_and_si128(value, _mm_set1_epi16(0x00FF));
+    const __m128i odd = _mm_srli_epi16(value, 8);
+    __m128i averaged = _mm_avg_epu16(even, odd);
+    return _mm_packus_epi16(averaged, averaged);
+}
+
+NES_TARGET("ssse3") void indicesToARGBSSSE3(const uint8_t* indices, const uint8_t* emphasis, int width, int height,
+    const Palette& palette, uint32_t* out) {
+    __m128i tables[3][4]; // R, G, B
+    int tableEmphasis = -1;
+    const __m128i alpha = _mm_set1_epi8(-1);
+
+    for (int y = 0; y < height; y++) {
+        const uint32_t* colors = palette.table(emphasis[y]);
+        const uint8_t* in = indices + y * width;
+        uint32_t* line = out + y * width;
+        int x = 0;
+
+        if (tableEmphasis != (emphasis[y] & 7)) {
+            tableEmphasis = emphasis[y] & 7;
+            uint8_t bytes[3][64];
+            for (int i = 0; i < 64; i++) {
+                bytes[0][i] = uint8_t(colors[i] >> 16);
+                bytes[1][i] = uint8_t(colors[i] >> 8);
+                bytes[2][i] = uint8_t(colors[i]);
+            }
+            for (int c = 0; c < 3; c++) {
+                loadTable(bytes[c], tables[c]);
+            }
+        }
+
+        for (; x + 16 <= width; x += 16) {
+            __m128i index = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + x));
+            __m128i r = lookup(tables[0], index);
+            __m128i g = lookup(tables[1], index);
+            __m128i b = lookup(tables[2], index);
+
+            // interleave into little-endian ARGB: B, G, R, A
+            __m128i bgLo = _mm_unpacklo_epi8(b, g);
+            __m128i bgHi = _mm_unpackhi_epi8(b, g);
+            __m128i raLo = _mm_unpacklo_epi8(r, alpha);
+            __m128i raHi = _mm_unpackhi_epi8(r, alpha);
+            __m128i* dst = reinterpret_cast<__m128i*>(line + x);
+            _mm_storeu_si128(dst + 0, _mm_unpacklo_epi16(bgLo, raLo));
+            _mm_storeu_si128(dst + 1, _mm_unpackhi_epi16(bgLo, raLo));
+            _mm_storeu_si128(dst + 2, _mm_unpacklo_epi16(bgHi, raHi));
+            _mm_storeu_si128(dst + 3, _mm_unpackhi_epi16(bgHi, raHi));
+        }
+        argbPixels(colors, in, line, x, width);
+    }
+}
+
+// one pair of lines
+NES_TARGET("ssse3") void yuvLinesSSSE3(const YUVTables& tables, int e0, int e1, const uint8_t* in0, const uint8_t* in1,
+    uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, int width) {
+    __m128i luma[2][4], blue[2][4], red[2][4];
+    loadTable(tables.y[e0], luma[0]);
+    loadTable(tables.y[e1], luma[1]);
+    loadTable(tables.u[e0], blue[0]);
+    loadTable(tables.u[e1], blue[1]);
+    loadTable(tables.v[e0], red[0]);
+    loadTable(tables.v[e1], red[1]);
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i index0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in0 + x));
+        __m128i index1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in1 + x));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(y0 + x), lookup(luma[0], index0));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(y1 + x), lookup(luma[1], index1));
+
+        // 2x2 box filter: vertical average, then horizontal pairs
+        __m128i cb = _mm_avg_epu8(lookup(blue[0], index0), lookup(blue[1], index1));
+        __m128i cr = _mm_avg_epu8(lookup(red[0], index0), lookup(red[1], index1));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(u + x / 2), halve(cb));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(v + x / 2), halve(cr));
+    }
+    yuvPixels(tables, e0, e1, in0, in1, y0, y1, u, v, x, width);
+}
+#endif
+
+} // namespace
+
+Palette::Palette() {
+    memcpy(colors[0], kStandardPalette, sizeof(kStandardPalette));
+    deriveEmphasis();
+}
+
+bool Palette::load(const std::string& path) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    std::vector<uint8_t> data(8 * 64 * 3 + 1);
+    size_t size = fread(data.data(), 1, data.size(), file);
+    fclose(file);
+    if (size != 64 * 3 && size != 8 * 64 * 3) {
+        return false;
+    }
+
+    int sets = int(size / (64 * 3));
+    for (int e = 0; e < sets; e++) {
+        for (int i = 0; i < 64; i++) {
+            const uint8_t* rgb = &data[(e * 64 + i) * 3];
+            colors[e][i] = argb(rgb[0], rgb[1], rgb[2]);
+        }
+    }
+    if (sets == 1) {
+        deriveEmphasis();
+    }
+    return true;
+}
+
+void Palette::deriveEmphasis() {
+    // emphasis bit 0 is red, 1 green, 2 blue (NTSC)
+    for (int e = 1; e < 8; e++) {
+        double scale[3] = { 1.0, 1.0, 1.0 };
+        for (int bit = 0; bit < 3; bit++) {
+            if (e & (1 << bit)) {
+                for (int channel = 0; channel < 3; channel++) {
+                    if (channel != bit) {
+                        scale[channel] *= kAttenuation;
+                    }
+                }
+            }
+        }
+        for (int i = 0; i < 64; i++) {
+            uint32_t c = colors[0][i];
+            colors[e][i] = argb(int(((c >> 16) & 0xFF) * scale[0]),
+                int(((c >> 8) & 0xFF) * scale[1]), int((c & 0xFF) * scale[2]));
+        }
+    }
+}
+
+void indicesToARGB(const uint8_t* indices, const uint8_t* emphasis, int width, int height,
+    const Palette& palette, uint32_t* out) {
+#ifdef NES_VIDEO_SSSE3
+    if (cpuFeatures().ssse3) {
+        indicesToARGBSSSE3(indices, emphasis, width, height, palette, out);
+        return;
+    }
+#endif
+    for (int y = 0; y < height; y++) {
+        argbPixels(palette.table(emphasis[y]), indices + y * width, out + y * width, 0, width);
+    }
+}
+
+void indicesToYUV420(const uint8_t* indices, const uint8_t* emphasis, int width, int height,
+    const Palette& palette, uint8_t* yPlane, uint8_t* uPlane, uint8_t* vPlane) {
+    YUVTables tables(palette);
+#ifdef NES_VIDEO_SSSE3
+    bool ssse3 = cpuFeatures().ssse3;
+#endif
+
+    // two lines at a time: each gets its own luma, the pair shares one chroma line
+    for (int y = 0; y + 1 < height; y += 2) {
+        int e0 = tables.prepare(emphasis[y]);
+        int e1 = tables.prepare(emphasis[y + 1]);
+        const uint8_t* in0 = indices + y * width;
+        const uint8_t* in1 = in0 + width;
+        uint8_t* y0 = yPlane + y * width;
+        uint8_t* y1 = y0 + width;
+        uint8_t* u = uPlane + (y / 2) * (width / 2);
+        uint8_t* v = vPlane + (y / 2) * (width / 2);
+
+#ifdef NES_VIDEO_SSSE3
+        if (ssse3) {
+            yuvLinesSSSE3(tables, e0, e1, in0, in1, y0, y1, u, v, width);
+            continue;
+        }
+#endif
+        yuvPixels(tables, e0, e1, in0, in1, y0, y1, u, v, 0, width);
+    }
+}
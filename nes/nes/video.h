@@ -0,0 +1,50 @@
+/************************************************************************************
+
+Filename    :   video.h
+Content     :   Palette-indexed frames to RGB / YUV (header)
+Authors     :   Yash Patel
+
+The PPU produces palette indices (see ppu.h); this is the stage that turns them into
+colors, run only by consumers that actually need RGB. A Palette holds the 64 master
+colors under each of the 8 emphasis combinations, so conversion is a pure table
+lookup: on x86 CPUs with SSSE3 (checked at run time, see cpufeatures.h) it's done 16
+pixels at a time with byte shuffles (four 16-entry tables per channel, selected by
+the top two index bits), otherwise one load per pixel. Both give the same bytes.
+
+Encoders get planar YUV 4:2:0 the same way: the palette is converted to BT.601 once
+per emphasis value, every pixel is a byte lookup into those tables, and chroma is a
+2x2 box filter of the looked-up values (centered, as in 420jpeg).
+
+*************************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+
+class Palette {
+public:
+	Palette(); // the standard 2C02 palette
+	~Palette() = default;
+
+	// .pal file: 64 RGB triplets (emphasis is derived) or 512 (one set per emphasis)
+	bool load(const std::string& path);
+
+	uint32_t color(uint8_t index, uint8_t emphasis) const { return colors[emphasis & 7][index & 63]; }
+	const uint32_t* table(uint8_t emphasis) const { return colors[emphasis & 7]; } // ARGB
+
+private:
+	void deriveEmphasis(); // attenuates the non-emphasized channels of colors[0]
+
+	uint32_t colors[8][64];
+};
+
+// indices (width x height) with one emphasis value per line, to ARGB
+void indicesToARGB(const uint8_t* indices, const uint8_t* emphasis, int width, int height,
+	const Palette& palette, uint32_t* out);
+
+// indices to planar BT.601 YUV 4:2:0 (limited range); width and height must be even,
+// u and v are (width / 2) x (height / 2)
+void indicesToYUV420(const uint8_t* indices, const uint8_t* emphasis, int width, int height,
+	const Palette& palette, uint8_t* y, uint8_t* u, uint8_t* v);